@@ -2,205 +2,417 @@
 #include "midi_filters.h"
 #include "imu_handler.h"
 #include "serial_utils.h"
+#include "crc_utils.h"
+#include "config_journal.h"
+#include "json_arena.h"
+#include "version.h"
 #include <EEPROM.h>
 
- // EEPROM layout: 
- // - Source MIDI filters: 3*8 = 24 bytes (bools as bytes)
- // - Destination MIDI filters: 3*8 = 24 bytes (bools as bytes)
- // - Channels: 16 bytes (bools as bytes)  
- // - IMU config: 27 bytes
- // Total: 91 bytes
-#define CONFIG_EEPROM_SIZE 128
+ // The config is one ConfigImage. It is saved as a record of the flash
+ // journal (config_journal.h) when the journal is available, otherwise to
+ // the EEPROM sector with a single put(). The EEPROM sector is still read
+ // at boot to migrate older images, including the raw byte-per-setting
+ // layout from before the versioned format.
+#define CONFIG_EEPROM_SIZE 256
 #define EEPROM_START_ADDR 0
+#define CONFIG_IMAGE_MAGIC 0x4746434D // "MCFG"
+#define CONFIG_IMAGE_VERSION 1
 
-void saveConfigToEEPROM() {
-    EEPROM.begin(CONFIG_EEPROM_SIZE);
-    int addr = EEPROM_START_ADDR;
-    
-    // Save source midiFilters
+// Legacy layout: 24 source filter bytes, 24 destination filter bytes, 16
+// channel bytes, 27 IMU bytes, then optionally the channel mask and preset
+// blocks, each introduced by a marker byte
+#define LEGACY_IMU_ADDR 64
+#define LEGACY_MASKS_ADDR 91
+#define LEGACY_PRESETS_ADDR 104
+#define LEGACY_CHANNEL_MASKS_MARKER 0xC5
+#define LEGACY_PRESETS_MARKER 0xA7
+
+// Filter settings without the compiled routes
+typedef struct __attribute__((packed)) {
+    uint8_t sourceFilters[MIDI_INTERFACE_COUNT];   // Bit msgType set = blocked
+    uint8_t destFilters[MIDI_INTERFACE_COUNT];
+    uint16_t enabledChannels;                      // Bit n = channel n+1
+    uint16_t sourceChannelMasks[MIDI_INTERFACE_COUNT];
+    uint16_t destChannelMasks[MIDI_INTERFACE_COUNT];
+} FilterImage;
+
+typedef struct __attribute__((packed)) {
+    uint8_t enabled;
+    uint8_t channel;
+    uint8_t cc;
+    uint8_t defaultValue;
+    uint8_t toSerial;
+    uint8_t toUSBDevice;
+    uint8_t toUSBHost;
+    float sensitivity;
+    float range;
+} IMUAxisImage;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;                  // sizeof(ConfigImage) when written
+    FilterImage filters;
+    IMUAxisImage imu[3];            // Roll, pitch, yaw
+    MidiPresetControl presetControl;
+    uint8_t storedPresets;          // Bit n = slot n holds a preset
+    FilterImage presets[MIDI_PRESET_SLOTS];
+    uint32_t crc;                   // CRC32 of everything above
+} ConfigImage;
+
+static_assert(sizeof(ConfigImage) <= CONFIG_EEPROM_SIZE, "Config image does not fit the EEPROM area");
+static_assert(sizeof(ConfigImage) <= CONFIG_JOURNAL_MAX_RECORD, "Config image does not fit a journal record");
+
+// CRC of the image last read or written, so saving an unchanged config
+// does not touch flash
+static bool storedImageKnown = false;
+static uint32_t storedImageCrc = 0;
+
+static uint32_t imageCrc(const ConfigImage &image) {
+    return crc32((const uint8_t *)&image, offsetof(ConfigImage, crc));
+}
+
+static void filterToImage(const MidiFilterConfig &config, FilterImage &image) {
     for (int iface = 0; iface < MIDI_INTERFACE_COUNT; ++iface) {
-        for (int msg = 0; msg < MIDI_MSG_COUNT; ++msg) {
-            EEPROM.write(addr++, getMidiFilterState(iface, msg) ? 1 : 0);
-        }
+        image.sourceFilters[iface] = config.sourceFilters[iface];
+        image.destFilters[iface] = config.destFilters[iface];
+        image.sourceChannelMasks[iface] = config.sourceChannelMasks[iface];
+        image.destChannelMasks[iface] = config.destChannelMasks[iface];
     }
+    image.enabledChannels = config.enabledChannels;
+}
 
-    // Save destination midiFilters
+static void filterFromImage(const FilterImage &image, MidiFilterConfig &config) {
     for (int iface = 0; iface < MIDI_INTERFACE_COUNT; ++iface) {
-        for (int msg = 0; msg < MIDI_MSG_COUNT; ++msg) {
-            EEPROM.write(addr++, getMidiDestFilterState(iface, msg) ? 1 : 0);
+        config.sourceFilters[iface] = image.sourceFilters[iface];
+        config.destFilters[iface] = image.destFilters[iface];
+        config.sourceChannelMasks[iface] = image.sourceChannelMasks[iface];
+        config.destChannelMasks[iface] = image.destChannelMasks[iface];
+    }
+    config.enabledChannels = image.enabledChannels;
+}
+
+static void imuToImage(const IMUConfig &imu, ConfigImage &image) {
+    image.imu[0] = {imu.rollEnabled, imu.rollMidiChannel, imu.rollMidiCC, imu.rollDefaultValue,
+                    imu.rollToSerial, imu.rollToUSBDevice, imu.rollToUSBHost,
+                    imu.rollSensitivity, imu.rollRange};
+    image.imu[1] = {imu.pitchEnabled, imu.pitchMidiChannel, imu.pitchMidiCC, imu.pitchDefaultValue,
+                    imu.pitchToSerial, imu.pitchToUSBDevice, imu.pitchToUSBHost,
+                    imu.pitchSensitivity, imu.pitchRange};
+    image.imu[2] = {imu.yawEnabled, imu.yawMidiChannel, imu.yawMidiCC, imu.yawDefaultValue,
+                    imu.yawToSerial, imu.yawToUSBDevice, imu.yawToUSBHost,
+                    imu.yawSensitivity, imu.yawRange};
+}
+
+static void imuFromImage(const ConfigImage &image, IMUConfig &imu) {
+    const IMUAxisImage &roll = image.imu[0];
+    imu.rollEnabled = roll.enabled;
+    imu.rollMidiChannel = roll.channel;
+    imu.rollMidiCC = roll.cc;
+    imu.rollDefaultValue = roll.defaultValue;
+    imu.rollToSerial = roll.toSerial;
+    imu.rollToUSBDevice = roll.toUSBDevice;
+    imu.rollToUSBHost = roll.toUSBHost;
+    imu.rollSensitivity = roll.sensitivity;
+    imu.rollRange = roll.range;
+
+    const IMUAxisImage &pitch = image.imu[1];
+    imu.pitchEnabled = pitch.enabled;
+    imu.pitchMidiChannel = pitch.channel;
+    imu.pitchMidiCC = pitch.cc;
+    imu.pitchDefaultValue = pitch.defaultValue;
+    imu.pitchToSerial = pitch.toSerial;
+    imu.pitchToUSBDevice = pitch.toUSBDevice;
+    imu.pitchToUSBHost = pitch.toUSBHost;
+    imu.pitchSensitivity = pitch.sensitivity;
+    imu.pitchRange = pitch.range;
+
+    const IMUAxisImage &yaw = image.imu[2];
+    imu.yawEnabled = yaw.enabled;
+    imu.yawMidiChannel = yaw.channel;
+    imu.yawMidiCC = yaw.cc;
+    imu.yawDefaultValue = yaw.defaultValue;
+    imu.yawToSerial = yaw.toSerial;
+    imu.yawToUSBDevice = yaw.toUSBDevice;
+    imu.yawToUSBHost = yaw.toUSBHost;
+    imu.yawSensitivity = yaw.sensitivity;
+    imu.yawRange = yaw.range;
+}
+
+// Snapshot of the running configuration, header and CRC filled in
+static void buildConfigImage(ConfigImage &image) {
+    memset(&image, 0, sizeof(image));
+    image.magic = CONFIG_IMAGE_MAGIC;
+    image.version = CONFIG_IMAGE_VERSION;
+    image.size = sizeof(ConfigImage);
+
+    filterToImage(*getMidiFilterConfig(), image.filters);
+    imuToImage(getIMUConfig(), image);
+
+    image.presetControl = getMidiPresetControl();
+    for (int slot = 0; slot < MIDI_PRESET_SLOTS; ++slot) {
+        const MidiFilterConfig *preset = getMidiPresetConfig(slot);
+        if (preset != nullptr) {
+            image.storedPresets |= 1 << slot;
+            filterToImage(*preset, image.presets[slot]);
         }
     }
-    
-    // Save enabledChannels
-    for (int ch = 0; ch < 16; ++ch) {
-        EEPROM.write(addr++, getChannelEnabledState(ch) ? 1 : 0);
-    }
-    
-    // Save IMU configuration
-    IMUConfig imuConfig = getIMUConfig();
-    // Note: No global enabled flag stored - calculated automatically from individual axis enables
-    
-    dualPrintf("[DEBUG] Saving IMU config: Roll en=%d, ch=%d, cc=%d\n", 
-               imuConfig.rollEnabled, imuConfig.rollMidiChannel, imuConfig.rollMidiCC);
-    dualPrintf("[DEBUG] Pitch en=%d, ch=%d, cc=%d\n", 
-               imuConfig.pitchEnabled, imuConfig.pitchMidiChannel, imuConfig.pitchMidiCC);
-    dualPrintf("[DEBUG] Yaw en=%d, ch=%d, cc=%d\n", 
-               imuConfig.yawEnabled, imuConfig.yawMidiChannel, imuConfig.yawMidiCC);
-    
-    // Roll configuration
-    EEPROM.write(addr++, imuConfig.rollEnabled ? 1 : 0);
-    EEPROM.write(addr++, imuConfig.rollMidiChannel);
-    EEPROM.write(addr++, imuConfig.rollMidiCC);
-    EEPROM.write(addr++, imuConfig.rollDefaultValue);
-    EEPROM.write(addr++, imuConfig.rollToSerial ? 1 : 0);
-    EEPROM.write(addr++, imuConfig.rollToUSBDevice ? 1 : 0);
-    EEPROM.write(addr++, imuConfig.rollToUSBHost ? 1 : 0);
-    // Store sensitivity and range as integers (multiply by 10)
-    EEPROM.write(addr++, (uint8_t)(imuConfig.rollSensitivity * 10));
-    EEPROM.write(addr++, (uint8_t)(imuConfig.rollRange));
-    
-    // Pitch configuration
-    EEPROM.write(addr++, imuConfig.pitchEnabled ? 1 : 0);
-    EEPROM.write(addr++, imuConfig.pitchMidiChannel);
-    EEPROM.write(addr++, imuConfig.pitchMidiCC);
-    EEPROM.write(addr++, imuConfig.pitchDefaultValue);
-    EEPROM.write(addr++, imuConfig.pitchToSerial ? 1 : 0);
-    EEPROM.write(addr++, imuConfig.pitchToUSBDevice ? 1 : 0);
-    EEPROM.write(addr++, imuConfig.pitchToUSBHost ? 1 : 0);
-    EEPROM.write(addr++, (uint8_t)(imuConfig.pitchSensitivity * 10));
-    EEPROM.write(addr++, (uint8_t)(imuConfig.pitchRange));
-    
-    // Yaw configuration
-    EEPROM.write(addr++, imuConfig.yawEnabled ? 1 : 0);
-    EEPROM.write(addr++, imuConfig.yawMidiChannel);
-    EEPROM.write(addr++, imuConfig.yawMidiCC);
-    EEPROM.write(addr++, imuConfig.yawDefaultValue);
-    EEPROM.write(addr++, imuConfig.yawToSerial ? 1 : 0);
-    EEPROM.write(addr++, imuConfig.yawToUSBDevice ? 1 : 0);
-    EEPROM.write(addr++, imuConfig.yawToUSBHost ? 1 : 0);
-    EEPROM.write(addr++, (uint8_t)(imuConfig.yawSensitivity * 10));
-    EEPROM.write(addr++, (uint8_t)(imuConfig.yawRange));
-    
-    dualPrintf("[DEBUG] IMU config saved to EEPROM (used %d bytes total)\n", addr);
-    
-    EEPROM.commit();
-    EEPROM.end();
+    image.crc = imageCrc(image);
 }
 
-void loadConfigFromEEPROM() {
-    EEPROM.begin(CONFIG_EEPROM_SIZE);
-    int addr = EEPROM_START_ADDR;
-    
-    // Load source midiFilters
+static bool isValidConfigImage(const ConfigImage &image) {
+    return image.magic == CONFIG_IMAGE_MAGIC &&
+           image.version == CONFIG_IMAGE_VERSION &&
+           image.size == sizeof(ConfigImage) &&
+           image.crc == imageCrc(image);
+}
+
+static void applyConfigImage(const ConfigImage &image) {
+    static MidiFilterConfig settings; // Too large for the stack
+
+    filterFromImage(image.filters, settings);
+    loadMidiFilterConfig(settings);
+
+    // Presets are compiled here so a switch later costs nothing
+    clearMidiPresets();
+    for (int slot = 0; slot < MIDI_PRESET_SLOTS; ++slot) {
+        if (image.storedPresets & (1 << slot)) {
+            filterFromImage(image.presets[slot], settings);
+            loadMidiPresetConfig(slot, settings);
+        }
+    }
+    // Writers check values first (hasValidSettings()); a stored image that
+    // fails anyway falls back to a safe setting instead of bricking boot
+    MidiPresetControl control = image.presetControl;
+    if (!isValidMidiPresetControl(control)) {
+        control = {0, MIDI_PRESET_CONTROL_PROGRAM_CHANGE, 0};
+    }
+    setMidiPresetControl(control);
+
+    IMUConfig imu = getIMUConfig();
+    imuFromImage(image, imu);
+    if (isValidIMUConfig(imu)) {
+        setIMUConfig(imu);
+    } else {
+        resetIMUConfig();
+    }
+}
+
+// Same checks as the JSON writers: isValidIMUConfig() and
+// isValidMidiPresetControl(). Filter images hold bit masks only.
+static bool hasValidSettings(const ConfigImage &image) {
+    IMUConfig imu = getIMUConfig();
+    imuFromImage(image, imu);
+    return isValidIMUConfig(imu) && isValidMidiPresetControl(image.presetControl);
+}
+
+static uint16_t readLegacyMask(const uint8_t *data, int &addr) {
+    uint16_t mask = data[addr] | (data[addr + 1] << 8);
+    addr += 2;
+    return mask;
+}
+
+static void readLegacyFilters(const uint8_t *data, int &addr, FilterImage &filters) {
     for (int iface = 0; iface < MIDI_INTERFACE_COUNT; ++iface) {
-        for (int msg = 0; msg < MIDI_MSG_COUNT; ++msg) {
-            setMidiFilterState(iface, msg, EEPROM.read(addr++) ? true : false);
+        filters.sourceFilters[iface] = data[addr++];
+        filters.destFilters[iface] = data[addr++];
+    }
+    filters.enabledChannels = readLegacyMask(data, addr);
+    for (int iface = 0; iface < MIDI_INTERFACE_COUNT; ++iface) {
+        filters.sourceChannelMasks[iface] = readLegacyMask(data, addr);
+        filters.destChannelMasks[iface] = readLegacyMask(data, addr);
+    }
+}
+
+// Converts the byte-per-setting layout used before ConfigImage. Returns
+// false if the data does not look like it (e.g. erased flash).
+static bool migrateLegacyImage(const uint8_t *data, ConfigImage &image) {
+    // Filter and channel bytes were always written as 0 or 1
+    for (int addr = 0; addr < LEGACY_IMU_ADDR; ++addr) {
+        if (data[addr] > 1) {
+            return false;
         }
     }
 
-    // Load destination midiFilters
+    memset(&image, 0, sizeof(image));
+    int addr = 0;
+    for (int iface = 0; iface < MIDI_INTERFACE_COUNT; ++iface) {
+        for (int msg = 0; msg < MIDI_MSG_COUNT; ++msg) {
+            image.filters.sourceFilters[iface] |= data[addr++] << msg;
+        }
+    }
     for (int iface = 0; iface < MIDI_INTERFACE_COUNT; ++iface) {
         for (int msg = 0; msg < MIDI_MSG_COUNT; ++msg) {
-            setMidiDestFilterState(iface, msg, EEPROM.read(addr++) ? true : false);
+            image.filters.destFilters[iface] |= data[addr++] << msg;
         }
     }
-    
-    // Load enabledChannels
     for (int ch = 0; ch < 16; ++ch) {
-        setChannelEnabledState(ch, EEPROM.read(addr++) ? true : false);
-    }
-    
-    // Load IMU configuration if enough data exists
-    // IMU config needs 27 bytes: 9*3 = 27 bytes total (removed global enable)
-    dualPrintf("[DEBUG] EEPROM load: addr=%d, need 27 bytes, size=%d\n", addr, CONFIG_EEPROM_SIZE);
-    if (addr + 27 <= CONFIG_EEPROM_SIZE) { // Check if we have enough bytes for IMU config
-        dualPrintln("[DEBUG] Loading IMU config from EEPROM...");
-        IMUConfig imuConfig;
-        // Note: No global enabled flag loaded - calculated automatically from individual axis enables
-        
-        // Roll configuration
-        imuConfig.rollEnabled = EEPROM.read(addr++) ? true : false;
-        imuConfig.rollMidiChannel = EEPROM.read(addr++);
-        imuConfig.rollMidiCC = EEPROM.read(addr++);
-        imuConfig.rollDefaultValue = EEPROM.read(addr++);
-        imuConfig.rollToSerial = EEPROM.read(addr++) ? true : false;
-        imuConfig.rollToUSBDevice = EEPROM.read(addr++) ? true : false;
-        imuConfig.rollToUSBHost = EEPROM.read(addr++) ? true : false;
-        imuConfig.rollSensitivity = EEPROM.read(addr++) / 10.0f;
-        imuConfig.rollRange = EEPROM.read(addr++);
-        
-        dualPrintf("[DEBUG] Roll loaded: en=%d, ch=%d, cc=%d, def=%d, sens=%.1f, range=%.0f\n", 
-                   imuConfig.rollEnabled, imuConfig.rollMidiChannel, imuConfig.rollMidiCC, 
-                   imuConfig.rollDefaultValue, imuConfig.rollSensitivity, imuConfig.rollRange);
-        
-        // Pitch configuration
-        imuConfig.pitchEnabled = EEPROM.read(addr++) ? true : false;
-        imuConfig.pitchMidiChannel = EEPROM.read(addr++);
-        imuConfig.pitchMidiCC = EEPROM.read(addr++);
-        imuConfig.pitchDefaultValue = EEPROM.read(addr++);
-        imuConfig.pitchToSerial = EEPROM.read(addr++) ? true : false;
-        imuConfig.pitchToUSBDevice = EEPROM.read(addr++) ? true : false;
-        imuConfig.pitchToUSBHost = EEPROM.read(addr++) ? true : false;
-        imuConfig.pitchSensitivity = EEPROM.read(addr++) / 10.0f;
-        imuConfig.pitchRange = EEPROM.read(addr++);
-        
-        dualPrintf("[DEBUG] Pitch loaded: en=%d, ch=%d, cc=%d, def=%d, sens=%.1f, range=%.0f\n", 
-                   imuConfig.pitchEnabled, imuConfig.pitchMidiChannel, imuConfig.pitchMidiCC, 
-                   imuConfig.pitchDefaultValue, imuConfig.pitchSensitivity, imuConfig.pitchRange);
-        
-        // Yaw configuration
-        imuConfig.yawEnabled = EEPROM.read(addr++) ? true : false;
-        imuConfig.yawMidiChannel = EEPROM.read(addr++);
-        imuConfig.yawMidiCC = EEPROM.read(addr++);
-        imuConfig.yawDefaultValue = EEPROM.read(addr++);
-        imuConfig.yawToSerial = EEPROM.read(addr++) ? true : false;
-        imuConfig.yawToUSBDevice = EEPROM.read(addr++) ? true : false;
-        imuConfig.yawToUSBHost = EEPROM.read(addr++) ? true : false;
-        imuConfig.yawSensitivity = EEPROM.read(addr++) / 10.0f;
-        imuConfig.yawRange = EEPROM.read(addr++);
-        
-        dualPrintf("[DEBUG] Yaw loaded: en=%d, ch=%d, cc=%d, def=%d, sens=%.1f, range=%.0f\n", 
-                   imuConfig.yawEnabled, imuConfig.yawMidiChannel, imuConfig.yawMidiCC, 
-                   imuConfig.yawDefaultValue, imuConfig.yawSensitivity, imuConfig.yawRange);
-        
-        setIMUConfig(imuConfig);
-        dualPrintln("[DEBUG] IMU config loaded from EEPROM");
-    } else {
-        // Initialize with defaults if no IMU config in EEPROM
-        dualPrintf("[DEBUG] No IMU config in EEPROM, using defaults (addr=%d + 27 > %d)\n", addr, CONFIG_EEPROM_SIZE);
-        resetIMUConfig();
+        image.filters.enabledChannels |= data[addr++] << ch;
     }
-    
+
+    // Sensitivity was stored times ten, range in whole degrees
+    for (int axis = 0; axis < 3; ++axis) {
+        IMUAxisImage &imu = image.imu[axis];
+        imu.enabled = data[addr++];
+        imu.channel = data[addr++];
+        imu.cc = data[addr++];
+        imu.defaultValue = data[addr++];
+        imu.toSerial = data[addr++];
+        imu.toUSBDevice = data[addr++];
+        imu.toUSBHost = data[addr++];
+        imu.sensitivity = data[addr++] / 10.0f;
+        imu.range = data[addr++];
+    }
+
+    bool hasChannelMasks = data[LEGACY_MASKS_ADDR] == LEGACY_CHANNEL_MASKS_MARKER;
+    addr = LEGACY_MASKS_ADDR + 1;
+    for (int iface = 0; iface < MIDI_INTERFACE_COUNT; ++iface) {
+        image.filters.sourceChannelMasks[iface] = hasChannelMasks ? readLegacyMask(data, addr) : 0xFFFF;
+    }
+    for (int iface = 0; iface < MIDI_INTERFACE_COUNT; ++iface) {
+        image.filters.destChannelMasks[iface] = hasChannelMasks ? readLegacyMask(data, addr) : 0xFFFF;
+    }
+
+    if (hasChannelMasks && data[LEGACY_PRESETS_ADDR] == LEGACY_PRESETS_MARKER) {
+        addr = LEGACY_PRESETS_ADDR + 1;
+        image.presetControl.channel = data[addr++];
+        image.presetControl.type = data[addr++];
+        image.presetControl.cc = data[addr++];
+        image.storedPresets = data[addr++];
+        for (int slot = 0; slot < MIDI_PRESET_SLOTS; ++slot) {
+            readLegacyFilters(data, addr, image.presets[slot]);
+        }
+    }
+
+    image.magic = CONFIG_IMAGE_MAGIC;
+    image.version = CONFIG_IMAGE_VERSION;
+    image.size = sizeof(ConfigImage);
+    image.crc = imageCrc(image);
+    return true;
+}
+
+void saveConfigToEEPROM() {
+    ConfigImage image;
+    buildConfigImage(image);
+    if (storedImageKnown && image.crc == storedImageCrc) {
+        dualPrintln("[DEBUG] Config unchanged, nothing to save");
+        return;
+    }
+    storedImageKnown = true;
+    storedImageCrc = image.crc;
+
+    // One page program instead of a sector erase
+    if (appendConfigJournal(&image, sizeof(image))) {
+        ConfigJournalStats journal = getConfigJournalStats();
+        dualPrintf("[DEBUG] Config image v%d appended to journal (sector %d, page %d, crc %08lx)\n",
+                   CONFIG_IMAGE_VERSION, journal.sector, journal.nextPage - 1, (unsigned long)image.crc);
+        return;
+    }
+
+    EEPROM.begin(CONFIG_EEPROM_SIZE);
+    EEPROM.put(EEPROM_START_ADDR, image);
+    EEPROM.commit();
     EEPROM.end();
+
+    dualPrintf("[DEBUG] Config image v%d saved to EEPROM (%d bytes, crc %08lx)\n",
+               CONFIG_IMAGE_VERSION, (int)sizeof(ConfigImage), (unsigned long)image.crc);
 }
 
-void configToJson(JsonDocument& doc) {
+void loadConfigFromEEPROM() {
+    ConfigImage image;
+    bool migrated = false;
+
+    // Replay the journal: its newest intact record is the current config
+    if (setupConfigJournal() && readConfigJournal(&image, sizeof(image)) && isValidConfigImage(image)) {
+        applyConfigImage(image);
+        storedImageKnown = true;
+        storedImageCrc = image.crc;
+        return;
+    }
+
+    EEPROM.begin(CONFIG_EEPROM_SIZE);
+    const uint8_t *data = EEPROM.getConstDataPtr() + EEPROM_START_ADDR;
+    memcpy(&image, data, sizeof(image));
+    bool valid = isValidConfigImage(image);
+    if (!valid && image.magic != CONFIG_IMAGE_MAGIC) {
+        valid = migrated = migrateLegacyImage(data, image);
+    }
+    EEPROM.end();
+
+    if (!valid) {
+        // Keep the pass-everything filters from setupMidiFilters() so a
+        // damaged image never silences the device
+        dualPrintln("[DEBUG] No valid config image in EEPROM, using defaults");
+        resetIMUConfig();
+        return;
+    }
+
+    applyConfigImage(image);
+    if (migrated || isConfigJournalAvailable()) {
+        // Move the image to its current home so the next boot finds it there
+        dualPrintln("[DEBUG] EEPROM config migrated");
+        saveConfigToEEPROM();
+    }
+}
+
+void configToJson(JsonStreamWriter& json) {
     // Filters
-    JsonArray filters = doc["filters"].to<JsonArray>();
+    json.beginArray("filters");
     for (int iface = 0; iface < MIDI_INTERFACE_COUNT; ++iface) {
-        JsonArray ifaceArr = filters.add<JsonArray>();
+        json.beginArray();
         for (int msg = 0; msg < MIDI_MSG_COUNT; ++msg) {
-            ifaceArr.add(getMidiFilterState(iface, msg));
+            json.value(getMidiFilterState(iface, msg));
         }
+        json.endArray();
     }
+    json.endArray();
     // Destination Filters
-    JsonArray destFilters = doc["destFilters"].to<JsonArray>();
+    json.beginArray("destFilters");
     for (int iface = 0; iface < MIDI_INTERFACE_COUNT; ++iface) {
-        JsonArray ifaceArr = destFilters.add<JsonArray>();
+        json.beginArray();
         for (int msg = 0; msg < MIDI_MSG_COUNT; ++msg) {
-            ifaceArr.add(getMidiDestFilterState(iface, msg));
+            json.value(getMidiDestFilterState(iface, msg));
         }
+        json.endArray();
     }
+    json.endArray();
     // Channels
-    JsonArray channels = doc["channels"].to<JsonArray>();
+    json.beginArray("channels");
     for (int ch = 0; ch < 16; ++ch) {
-        channels.add(getChannelEnabledState(ch));
+        json.value(getChannelEnabledState(ch));
+    }
+    json.endArray();
+    // Per-interface channel masks (bit n = channel n+1)
+    json.beginArray("sourceChannels");
+    for (int iface = 0; iface < MIDI_INTERFACE_COUNT; ++iface) {
+        json.value(getSourceChannelMask((MidiInterfaceType)iface));
     }
+    json.endArray();
+    json.beginArray("destChannels");
+    for (int iface = 0; iface < MIDI_INTERFACE_COUNT; ++iface) {
+        json.value(getDestChannelMask((MidiInterfaceType)iface));
+    }
+    json.endArray();
+    // Presets
+    json.beginObject("presets");
+    json.member("active", getActiveMidiPreset());
+    json.beginArray("stored");
+    for (int slot = 0; slot < MIDI_PRESET_SLOTS; ++slot) {
+        json.value(isMidiPresetStored(slot));
+    }
+    json.endArray();
+    MidiPresetControl control = getMidiPresetControl();
+    json.member("channel", control.channel);
+    json.member("type", control.type == MIDI_PRESET_CONTROL_CC ? "CC" : "PC");
+    json.member("cc", control.cc);
+    json.endObject();
     // IMU configuration
-    imuConfigToJson(doc);
+    imuConfigToJson(json);
 }
 
-bool updateConfigFromJson(const JsonDocument& doc) {
+// Applies the JSON to the open filter update and to `imu`. Nothing
+// becomes live here; on failure the caller discards both.
+static bool stageConfigFromJson(const JsonDocument& doc, IMUConfig &imu) {
     // Filters
     JsonArray filtersArr = ((JsonDocument&)doc)["filters"].as<JsonArray>();
     if (filtersArr.isNull()) {
@@ -297,9 +509,201 @@ bool updateConfigFromJson(const JsonDocument& doc) {
         setChannelEnabledState(ch, channelsArr[ch].as<bool>());
     }
 
+    // Per-interface channel masks (optional, left unchanged when missing)
+    JsonArray sourceChannelsArr = ((JsonDocument&)doc)["sourceChannels"].as<JsonArray>();
+    JsonArray destChannelsArr = ((JsonDocument&)doc)["destChannels"].as<JsonArray>();
+    if ((!sourceChannelsArr.isNull() && sourceChannelsArr.size() != MIDI_INTERFACE_COUNT) ||
+        (!destChannelsArr.isNull() && destChannelsArr.size() != MIDI_INTERFACE_COUNT)) {
+        Serial.println("[DEBUG] updateConfigFromJson: 'sourceChannels'/'destChannels' need one mask per interface.");
+        return false;
+    }
+    for (int iface = 0; iface < MIDI_INTERFACE_COUNT; iface++) {
+        if (!sourceChannelsArr.isNull()) {
+            setSourceChannelMask((MidiInterfaceType)iface, sourceChannelsArr[iface].as<uint16_t>());
+        }
+        if (!destChannelsArr.isNull()) {
+            setDestChannelMask((MidiInterfaceType)iface, destChannelsArr[iface].as<uint16_t>());
+        }
+    }
+
     // Update IMU configuration if present
-    updateIMUConfigFromJson(doc);
+    return imuConfigFromJson(doc, imu);
+}
+
+bool updateConfigFromJson(const JsonDocument& doc) {
+    // Build the complete new configuration on the side, then publish it at
+    // once so neither core ever routes with a half-applied config
+    IMUConfig imu = getIMUConfig();
+    beginMidiFilterUpdate();
+    if (!stageConfigFromJson(doc, imu)) {
+        abortMidiFilterUpdate();
+        return false;
+    }
+    commitMidiFilterUpdate();
+    setIMUConfig(imu); // IMU runs on core 0 after this returns
 
     Serial.println("[DEBUG] updateConfigFromJson: config accepted.");
     return true;
 }
+
+// Index path segment, e.g. the "2" of "/filters/2/5"
+static bool pathIndex(const char *segment, int count, int &index) {
+    char *end;
+    long value = strtol(segment, &end, 10);
+    if (end == segment || *end != '\0' || value < 0 || value >= count) {
+        return false;
+    }
+    index = value;
+    return true;
+}
+
+bool patchConfig(const char *path, JsonVariantConst value) {
+    // Split "/section/a/b" into at most four segments
+    char buffer[64];
+    if (path == nullptr || path[0] != '/' || strlen(path) >= sizeof(buffer)) {
+        return false;
+    }
+    strcpy(buffer, path + 1);
+    const char *segments[4];
+    int count = 0;
+    char *save = nullptr;
+    for (char *token = strtok_r(buffer, "/", &save); token != nullptr && count < 4;
+         token = strtok_r(nullptr, "/", &save)) {
+        segments[count++] = token;
+    }
+    if (count == 0 || value.isNull()) {
+        return false;
+    }
+
+    const char *section = segments[0];
+    int iface, msg, ch;
+    if (strcmp(section, "filters") == 0 || strcmp(section, "destFilters") == 0) {
+        if (count != 3 || !pathIndex(segments[1], MIDI_INTERFACE_COUNT, iface) ||
+            !pathIndex(segments[2], MIDI_MSG_COUNT, msg)) {
+            return false;
+        }
+        if (section[0] == 'f') {
+            setMidiFilterState(iface, msg, value.as<bool>());
+        } else {
+            setMidiDestFilterState(iface, msg, value.as<bool>());
+        }
+    } else if (strcmp(section, "channels") == 0) {
+        if (count != 2 || !pathIndex(segments[1], 16, ch)) {
+            return false;
+        }
+        setChannelEnabledState(ch, value.as<bool>());
+    } else if (strcmp(section, "sourceChannels") == 0 || strcmp(section, "destChannels") == 0) {
+        long mask = value.is<long>() ? value.as<long>() : -1;
+        if (count != 2 || !pathIndex(segments[1], MIDI_INTERFACE_COUNT, iface) || mask < 0 || mask > 0xFFFF) {
+            return false;
+        }
+        if (section[0] == 's') {
+            setSourceChannelMask((MidiInterfaceType)iface, mask);
+        } else {
+            setDestChannelMask((MidiInterfaceType)iface, mask);
+        }
+    } else if (strcmp(section, "imu") == 0) {
+        // "/imu/roll" takes an object of axis fields, "/imu/roll/cc" one value
+        IMUConfig imu = getIMUConfig();
+        if (count == 2) {
+            if (!imuAxisFromJson(segments[1], value.as<JsonObjectConst>(), imu)) {
+                return false;
+            }
+        } else if (count == 3) {
+            JsonDocument field(&jsonArena);
+            field[segments[2]] = value;
+            if (!imuAxisFromJson(segments[1], field.as<JsonObjectConst>(), imu)) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+        setIMUConfig(imu);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// --- Binary (TLV) Form ---
+
+static bool appendTlv(uint8_t *out, size_t capacity, size_t &length, uint8_t type,
+                      const void *value, size_t valueLength) {
+    if (length + 2 + valueLength > capacity) {
+        return false;
+    }
+    out[length++] = type;
+    out[length++] = valueLength;
+    memcpy(out + length, value, valueLength);
+    length += valueLength;
+    return true;
+}
+
+size_t configToTlv(uint8_t *out, size_t capacity) {
+    ConfigImage image;
+    buildConfigImage(image);
+
+    size_t length = 0;
+    bool ok = appendTlv(out, capacity, length, CONFIG_TLV_FILTERS, &image.filters, sizeof(image.filters));
+    for (uint8_t axis = 0; axis < 3; axis++) {
+        uint8_t value[1 + sizeof(IMUAxisImage)];
+        value[0] = axis;
+        memcpy(value + 1, &image.imu[axis], sizeof(IMUAxisImage));
+        ok = ok && appendTlv(out, capacity, length, CONFIG_TLV_IMU_AXIS, value, sizeof(value));
+    }
+    ok = ok && appendTlv(out, capacity, length, CONFIG_TLV_PRESET_CONTROL,
+                         &image.presetControl, sizeof(image.presetControl));
+    uint8_t presets[2] = {(uint8_t)getActiveMidiPreset(), image.storedPresets};
+    ok = ok && appendTlv(out, capacity, length, CONFIG_TLV_PRESETS, presets, sizeof(presets));
+    ok = ok && appendTlv(out, capacity, length, CONFIG_TLV_VERSION, FIRMWARE_VERSION, strlen(FIRMWARE_VERSION));
+    return ok ? length : 0;
+}
+
+bool updateConfigFromTlv(const uint8_t *data, size_t length) {
+    // Start from the running config, so types that are left out keep
+    // their value, and validate every TLV before anything is applied
+    ConfigImage image;
+    buildConfigImage(image);
+
+    size_t pos = 0;
+    while (pos < length) {
+        if (pos + 2 > length || pos + 2 + data[pos + 1] > length) {
+            return false;
+        }
+        uint8_t type = data[pos];
+        uint8_t valueLength = data[pos + 1];
+        const uint8_t *value = data + pos + 2;
+        pos += 2 + valueLength;
+
+        switch (type) {
+        case CONFIG_TLV_FILTERS:
+            if (valueLength != sizeof(FilterImage)) {
+                return false;
+            }
+            memcpy(&image.filters, value, sizeof(FilterImage));
+            break;
+        case CONFIG_TLV_IMU_AXIS:
+            if (valueLength != 1 + sizeof(IMUAxisImage) || value[0] >= 3) {
+                return false;
+            }
+            memcpy(&image.imu[value[0]], value + 1, sizeof(IMUAxisImage));
+            break;
+        case CONFIG_TLV_PRESET_CONTROL:
+            if (valueLength != sizeof(MidiPresetControl)) {
+                return false;
+            }
+            memcpy(&image.presetControl, value, sizeof(MidiPresetControl));
+            break;
+        default:
+            // Read-only and unknown types are skipped, so a client can send
+            // back what it read
+            break;
+        }
+    }
+
+    if (!hasValidSettings(image)) {
+        return false;
+    }
+    applyConfigImage(image);
+    return true;
+}
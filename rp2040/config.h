@@ -2,15 +2,41 @@
 #define CONFIG_H
 
 #include <ArduinoJson.h>
+#include "json_stream.h"
 
-// Save/load filter and channel config to/from EEPROM
+// Save/load filter, channel, preset and IMU config to/from flash (journal,
+// or the EEPROM sector when no flash partition is configured)
 void saveConfigToEEPROM();
 void loadConfigFromEEPROM();
 
-// Serialize/deserialize filter and channel config to/from JSON
-void configToJson(JsonDocument& doc);
+// Serialize/deserialize filter and channel config to/from JSON.
+// configToJson() streams the members of the READALL object; the caller
+// opens and closes it.
+void configToJson(JsonStreamWriter& json);
 bool updateConfigFromJson(const JsonDocument& doc);
 
+// Change one setting at a JSON-pointer-style path into the READALL document:
+// "/filters/<iface>/<msg>", "/destFilters/<iface>/<msg>", "/channels/<0-15>",
+// "/sourceChannels/<iface>", "/destChannels/<iface>", "/imu/<axis>" (object
+// of axis fields) or "/imu/<axis>/<field>". Only the affected route columns
+// are recompiled.
+bool patchConfig(const char *path, JsonVariantConst value);
+
+// Binary form of configToJson()/updateConfigFromJson() for config_frame.h:
+// a sequence of TLVs (type byte, length byte, value). Multi-byte values are
+// little-endian; the layouts are the packed ConfigImage blocks.
+#define CONFIG_TLV_FILTERS        0x01 // Filters, channels and masks (20 bytes)
+#define CONFIG_TLV_IMU_AXIS       0x02 // Axis index (0 roll, 1 pitch, 2 yaw) + axis block (15 bytes)
+#define CONFIG_TLV_PRESET_CONTROL 0x03 // Channel, type, CC (3 bytes)
+#define CONFIG_TLV_PRESETS        0x04 // Read only: active slot (int8), stored-slot bits
+#define CONFIG_TLV_VERSION        0x05 // Read only: firmware version string
+
+// Returns the number of bytes written, 0 if `capacity` is too small
+size_t configToTlv(uint8_t *out, size_t capacity);
+// Types left out keep their current value. Applied atomically; false (and
+// nothing changed) on a malformed TLV or an out-of-range value.
+bool updateConfigFromTlv(const uint8_t *data, size_t length);
+
 #endif // CONFIG_H
 
 
@@ -33,7 +59,10 @@ bool updateConfigFromJson(const JsonDocument& doc);
     // USB HOST destination filters (8 booleans)
     [false, true, false, true, false, true, false, true]
   ],
-  "channels": [true, true, true, true, false, false, true, true, true, true, true, true, true, true, true, true]
+  "channels": [true, true, true, true, false, false, true, true, true, true, true, true, true, true, true, true],
+  // Optional per-interface channel masks, bit n = channel n+1 (SERIAL, USB DEVICE, USB HOST)
+  "sourceChannels": [65535, 65535, 65535],
+  "destChannels": [65535, 65535, 255]
 }
 
 ### First Dimension (Interfaces):
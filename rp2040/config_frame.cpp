@@ -0,0 +1,124 @@
+#include "config_frame.h"
+#include "config.h"
+#include "crc_utils.h"
+
+// Consistent Overhead Byte Stuffing: removes every 0x00 from the packet so
+// 0x00 can end the frame. Returns the decoded length, 0 if malformed.
+static size_t cobsDecode(const uint8_t *in, size_t length, uint8_t *out, size_t capacity) {
+    size_t read = 0;
+    size_t written = 0;
+    while (read < length) {
+        uint8_t code = in[read++];
+        if (code == 0 || read + code - 1 > length) {
+            return 0;
+        }
+        for (uint8_t i = 1; i < code; i++) {
+            if (written >= capacity) {
+                return 0;
+            }
+            out[written++] = in[read++];
+        }
+        // A group shorter than 254 bytes stands for a zero, except at the end
+        if (code != 0xFF && read < length) {
+            if (written >= capacity) {
+                return 0;
+            }
+            out[written++] = 0;
+        }
+    }
+    return written;
+}
+
+static size_t cobsEncode(const uint8_t *in, size_t length, uint8_t *out) {
+    size_t codeIndex = 0;
+    size_t written = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < length; i++) {
+        if (in[i] == 0) {
+            out[codeIndex] = code;
+            codeIndex = written++;
+            code = 1;
+            continue;
+        }
+        out[written++] = in[i];
+        if (++code == 0xFF) {
+            out[codeIndex] = code;
+            codeIndex = written++;
+            code = 1;
+        }
+    }
+    out[codeIndex] = code;
+    return written;
+}
+
+static void putCrc(uint8_t *packet, size_t length) {
+    uint32_t crc = crc32(packet, length);
+    for (int i = 0; i < 4; i++) {
+        packet[length + i] = crc >> (8 * i);
+    }
+}
+
+// Fill in the response header and CRC around a payload already written at
+// packet + 3. Returns the response packet length.
+static size_t buildResponse(uint8_t *packet, uint8_t requestId, uint8_t op,
+                            ConfigFrameStatus status, size_t payloadLength) {
+    packet[0] = requestId;
+    packet[1] = op | 0x80;
+    packet[2] = status;
+    size_t length = 3 + payloadLength;
+    putCrc(packet, length);
+    return length + 4;
+}
+
+size_t processConfigPacket(uint8_t *packet, size_t length, bool &changed) {
+    changed = false;
+    if (length < 2 + 4) {
+        return 0; // Too short to even carry a request id to answer
+    }
+    uint8_t requestId = packet[0];
+    uint8_t op = packet[1];
+
+    size_t crcOffset = length - 4;
+    uint32_t received = packet[crcOffset] | (packet[crcOffset + 1] << 8) |
+                        (packet[crcOffset + 2] << 16) | ((uint32_t)packet[crcOffset + 3] << 24);
+    if (received != crc32(packet, crcOffset)) {
+        return buildResponse(packet, requestId, op, CONFIG_FRAME_BAD_CRC, 0);
+    }
+
+    // Responses are built in the same buffer once the request is consumed
+    uint8_t *payload = packet + 3;
+    size_t payloadCapacity = CONFIG_FRAME_MAX_PACKET - 3 - 4;
+    switch (op) {
+    case CONFIG_OP_READ: {
+        size_t payloadLength = configToTlv(payload, payloadCapacity);
+        return buildResponse(packet, requestId, op,
+                             payloadLength > 0 ? CONFIG_FRAME_OK : CONFIG_FRAME_BAD_PAYLOAD,
+                             payloadLength);
+    }
+    case CONFIG_OP_WRITE: {
+        changed = updateConfigFromTlv(packet + 2, crcOffset - 2);
+        return buildResponse(packet, requestId, op,
+                             changed ? CONFIG_FRAME_OK : CONFIG_FRAME_BAD_PAYLOAD, 0);
+    }
+    default:
+        return buildResponse(packet, requestId, op, CONFIG_FRAME_BAD_OPCODE, 0);
+    }
+}
+
+bool handleConfigFrame(const uint8_t *encoded, size_t length) {
+    static uint8_t packet[CONFIG_FRAME_MAX_PACKET];
+    static uint8_t response[CONFIG_FRAME_MAX_ENCODED];
+
+    size_t packetLength = cobsDecode(encoded, length, packet, sizeof(packet));
+    bool changed;
+    size_t responseLength = processConfigPacket(packet, packetLength, changed);
+    if (responseLength == 0) {
+        return false;
+    }
+
+    size_t encodedLength = cobsEncode(packet, responseLength, response);
+    Serial.write((uint8_t)CONFIG_FRAME_MAGIC);
+    Serial.write(response, encodedLength);
+    Serial.write((uint8_t)0);
+    return changed;
+}
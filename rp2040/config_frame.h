@@ -0,0 +1,46 @@
+#ifndef CONFIG_FRAME_H
+#define CONFIG_FRAME_H
+
+#include <Arduino.h>
+
+// Binary config protocol on the web serial (CDC) port, next to the JSON
+// commands. A frame is CONFIG_FRAME_MAGIC, the COBS-encoded packet, then
+// 0x00. Since JSON commands start with '{', the first byte of a line tells
+// the two apart.
+//
+// Request packet:  request id, opcode, payload, CRC32
+// Response packet: request id, opcode | 0x80, status, payload, CRC32
+// The CRC32 (crc_utils.h) covers everything before it, little-endian.
+// Payloads are config TLVs (config.h).
+#define CONFIG_FRAME_MAGIC 0xA5
+
+// Largest decoded packet in either direction
+#define CONFIG_FRAME_MAX_PACKET 192
+// Largest COBS-encoded packet
+#define CONFIG_FRAME_MAX_ENCODED (CONFIG_FRAME_MAX_PACKET + CONFIG_FRAME_MAX_PACKET / 254 + 1)
+
+typedef enum {
+    CONFIG_OP_READ = 0x01,   // No payload; response carries the config TLVs
+    CONFIG_OP_WRITE = 0x02   // Config TLVs; applied at once and saved like SAVEALL
+} ConfigFrameOp;
+
+typedef enum {
+    CONFIG_FRAME_OK = 0,
+    CONFIG_FRAME_BAD_CRC,
+    CONFIG_FRAME_BAD_OPCODE,
+    CONFIG_FRAME_BAD_PAYLOAD
+} ConfigFrameStatus;
+
+// Handle one decoded request packet in place: on return `packet` (at least
+// CONFIG_FRAME_MAX_PACKET bytes) holds the response packet and the result
+// is its length, 0 if the request was too short to answer. `changed` is
+// set if the config was changed and should be saved. Shared by the framing
+// below and the SysEx channel (config_sysex.h).
+size_t processConfigPacket(uint8_t *packet, size_t length, bool &changed);
+
+// Handle one received frame: `encoded` holds the bytes between the magic
+// byte and the terminating 0x00. Sends the response frame on Serial.
+// Returns true if the config was changed and should be saved.
+bool handleConfigFrame(const uint8_t *encoded, size_t length);
+
+#endif // CONFIG_FRAME_H
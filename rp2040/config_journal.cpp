@@ -0,0 +1,254 @@
+#include "config_journal.h"
+#include "crc_utils.h"
+#include "serial_utils.h"
+#include "flash_commit.h"
+#include "hardware/flash.h"
+
+#define JOURNAL_SECTOR_MAGIC 0x4E524A43 // "CJRN"
+#define JOURNAL_RECORD_MAGIC 0x4352
+#define JOURNAL_PAGES_PER_SECTOR (FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE)
+
+// Page 0 of a sector. Written last, so a sector only counts once its first
+// record is complete.
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t sequence;  // Higher = newer
+} JournalSectorHeader;
+
+// Pages 1 to JOURNAL_PAGES_PER_SECTOR - 1, filled in order
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint16_t length;
+    uint8_t data[CONFIG_JOURNAL_MAX_RECORD];
+    uint32_t crc;       // CRC32 of everything above
+} JournalRecord;
+
+static_assert(sizeof(JournalRecord) == FLASH_PAGE_SIZE, "A journal record is one flash page");
+
+// Filesystem partition, provided by the arduino-pico linker script
+extern uint8_t _FS_start;
+extern uint8_t _FS_end;
+
+static bool journalAvailable = false;
+static uint32_t journalOffset = 0;      // Flash offset of journal sector 0
+static bool hasCurrentSector = false;
+static uint8_t currentSector = 0;
+static uint32_t currentSequence = 0;
+static uint8_t nextPage = 0;
+static bool spareBlank = false;          // Next sector known to be erased
+static ConfigJournalStats stats = {0, 0, 0, 0, 0};
+
+static uint32_t pageOffset(uint8_t sector, uint8_t page) {
+    return journalOffset + sector * FLASH_SECTOR_SIZE + page * FLASH_PAGE_SIZE;
+}
+
+static const uint8_t *pageAddress(uint8_t sector, uint8_t page) {
+    return (const uint8_t *)(uintptr_t)(XIP_BASE + pageOffset(sector, page));
+}
+
+static bool readSectorHeader(uint8_t sector, uint32_t &sequence) {
+    JournalSectorHeader header;
+    memcpy(&header, pageAddress(sector, 0), sizeof(header));
+    sequence = header.sequence;
+    return header.magic == JOURNAL_SECTOR_MAGIC;
+}
+
+static bool isPageErased(uint8_t sector, uint8_t page) {
+    const uint8_t *data = pageAddress(sector, page);
+    for (uint32_t i = 0; i < FLASH_PAGE_SIZE; i++) {
+        if (data[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool isRecordValid(const JournalRecord &record) {
+    return record.magic == JOURNAL_RECORD_MAGIC &&
+           record.length <= CONFIG_JOURNAL_MAX_RECORD &&
+           record.crc == crc32((const uint8_t *)&record, offsetof(JournalRecord, crc));
+}
+
+// Each call is one flash_commit.h slice; core 1 gets a USB host pass in
+// between
+static void eraseSector(uint8_t sector) {
+    flashCommitErase(pageOffset(sector, 0));
+    stats.sectorErases++;
+}
+
+static bool programPage(uint8_t sector, uint8_t page, const uint8_t *data) {
+    flashCommitProgram(pageOffset(sector, page), data);
+    return memcmp(pageAddress(sector, page), data, FLASH_PAGE_SIZE) == 0;
+}
+
+static bool isSectorErased(uint8_t sector) {
+    for (uint8_t page = 0; page < JOURNAL_PAGES_PER_SECTOR; page++) {
+        if (!isPageErased(sector, page)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Sector the next compaction moves to: the oldest one
+static uint8_t spareSector() {
+    return hasCurrentSector ? (currentSector + 1) % CONFIG_JOURNAL_SECTORS : 0;
+}
+
+// Newest intact record of the requested length in one sector
+static bool readNewestRecord(uint8_t sector, void *data, size_t length) {
+    JournalRecord record;
+    for (uint8_t page = JOURNAL_PAGES_PER_SECTOR - 1; page >= 1; page--) {
+        memcpy(&record, pageAddress(sector, page), sizeof(record));
+        if (isRecordValid(record) && record.length == length) {
+            memcpy(data, record.data, length);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Sector with the highest sequence below `sequence`
+static bool findOlderSector(uint32_t &sequence, uint8_t &sector) {
+    bool found = false;
+    uint32_t best = 0;
+    for (uint8_t s = 0; s < CONFIG_JOURNAL_SECTORS; s++) {
+        uint32_t seq;
+        if (readSectorHeader(s, seq) && (int32_t)(seq - sequence) < 0 &&
+            (!found || (int32_t)(seq - best) > 0)) {
+            best = seq;
+            sector = s;
+            found = true;
+        }
+    }
+    sequence = best;
+    return found;
+}
+
+bool setupConfigJournal() {
+    uint32_t size = &_FS_end - &_FS_start;
+    if (size < CONFIG_JOURNAL_SECTORS * FLASH_SECTOR_SIZE) {
+        dualPrintf("Config journal: flash partition too small (%lu bytes), using EEPROM\n", (unsigned long)size);
+        journalAvailable = false;
+        return false;
+    }
+    journalOffset = (uintptr_t)&_FS_start - XIP_BASE;
+    journalAvailable = true;
+
+    // The current sector is the one with the highest sequence
+    hasCurrentSector = false;
+    for (uint8_t sector = 0; sector < CONFIG_JOURNAL_SECTORS; sector++) {
+        uint32_t sequence;
+        if (readSectorHeader(sector, sequence) &&
+            (!hasCurrentSector || (int32_t)(sequence - currentSequence) > 0)) {
+            currentSector = sector;
+            currentSequence = sequence;
+            hasCurrentSector = true;
+        }
+    }
+
+    // Append after the last used page; a page torn by a power cut is
+    // skipped rather than programmed over
+    nextPage = JOURNAL_PAGES_PER_SECTOR;
+    spareBlank = false;
+    if (hasCurrentSector) {
+        nextPage = 1;
+        while (nextPage < JOURNAL_PAGES_PER_SECTOR && !isPageErased(currentSector, nextPage)) {
+            nextPage++;
+        }
+    }
+
+    dualPrintf("Config journal: %d sectors, current %d (seq %lu), next page %d\n",
+               CONFIG_JOURNAL_SECTORS, hasCurrentSector ? currentSector : -1,
+               (unsigned long)currentSequence, nextPage);
+    return true;
+}
+
+bool isConfigJournalAvailable() {
+    return journalAvailable;
+}
+
+bool readConfigJournal(void *data, size_t length) {
+    if (!journalAvailable || !hasCurrentSector) {
+        return false;
+    }
+
+    // Newest sector first; older ones only matter if its records are torn
+    uint8_t sector = currentSector;
+    uint32_t sequence = currentSequence;
+    do {
+        if (readNewestRecord(sector, data, length)) {
+            return true;
+        }
+    } while (findOlderSector(sequence, sector));
+    return false;
+}
+
+bool appendConfigJournal(const void *data, size_t length) {
+    if (!journalAvailable || length > CONFIG_JOURNAL_MAX_RECORD) {
+        return false;
+    }
+
+    JournalRecord record;
+    memset(&record, 0xFF, sizeof(record));
+    record.magic = JOURNAL_RECORD_MAGIC;
+    record.length = length;
+    memcpy(record.data, data, length);
+    record.crc = crc32((const uint8_t *)&record, offsetof(JournalRecord, crc));
+
+    bool ok;
+    if (hasCurrentSector && nextPage < JOURNAL_PAGES_PER_SECTOR) {
+        ok = programPage(currentSector, nextPage++, (const uint8_t *)&record);
+    } else {
+        // Compaction: the record is a complete config, so starting the next
+        // sector with it supersedes everything else. The sector reused is
+        // the oldest one; the current sector stays intact until the new
+        // header is written.
+        uint8_t sector = spareSector();
+        if (!spareBlank && !isSectorErased(sector)) {
+            eraseSector(sector);
+        }
+        spareBlank = false;
+        ok = programPage(sector, 1, (const uint8_t *)&record);
+        if (ok) {
+            uint8_t headerPage[FLASH_PAGE_SIZE];
+            memset(headerPage, 0xFF, sizeof(headerPage));
+            JournalSectorHeader header = {JOURNAL_SECTOR_MAGIC, currentSequence + 1};
+            memcpy(headerPage, &header, sizeof(header));
+            ok = programPage(sector, 0, headerPage);
+        }
+        if (ok) {
+            currentSector = sector;
+            currentSequence++;
+            hasCurrentSector = true;
+            nextPage = 2;
+        }
+    }
+
+    if (ok) {
+        stats.records++;
+    }
+    return ok;
+}
+
+bool prepareConfigJournal() {
+    // The spare is the oldest sector; the ones after it stay readable as
+    // fallback for a torn record
+    if (!journalAvailable || spareBlank) {
+        return false;
+    }
+    uint8_t sector = spareSector();
+    bool erase = !isSectorErased(sector);
+    if (erase) {
+        eraseSector(sector);
+        stats.preErases++;
+    }
+    spareBlank = true;
+    return erase;
+}
+
+ConfigJournalStats getConfigJournalStats() {
+    stats.sector = currentSector;
+    stats.nextPage = nextPage;
+    return stats;
+}
@@ -0,0 +1,51 @@
+#ifndef CONFIG_JOURNAL_H
+#define CONFIG_JOURNAL_H
+
+#include <Arduino.h>
+
+// Append-only config store spread over several flash sectors. Every save
+// programs one 256-byte page; a sector is only erased before the journal
+// moves on to it, so erases are spread evenly over all sectors and happen
+// once every (pages per sector - 1) saves instead of on every save. The
+// erase is normally done by prepareConfigJournal() while idle, so saves
+// hold core 1 for page programs only.
+//
+// Lives in the filesystem partition (Tools > Flash Size with FS). Without
+// one, or if it is too small, the journal reports itself unavailable and
+// config.cpp keeps using the EEPROM sector.
+#ifndef CONFIG_JOURNAL_SECTORS
+#define CONFIG_JOURNAL_SECTORS 4
+#endif
+
+// Largest record the journal can hold
+#define CONFIG_JOURNAL_MAX_RECORD 248
+
+typedef struct {
+    uint32_t records;       // Pages programmed since boot
+    uint32_t sectorErases;  // Sectors erased since boot
+    uint32_t preErases;     // Of which done ahead of a save
+    uint8_t sector;         // Sector currently appended to
+    uint8_t nextPage;       // Next free page in that sector
+} ConfigJournalStats;
+
+// Scan the journal sectors. Call once before the other functions.
+bool setupConfigJournal();
+bool isConfigJournalAvailable();
+
+// Copy the newest intact record into `data`. Returns false if the journal
+// is empty or holds no record of exactly `length` bytes.
+bool readConfigJournal(void *data, size_t length);
+
+// Append a record. Moving to a new sector erases the oldest one first
+// unless prepareConfigJournal() already did; the newest record stays
+// readable until the new one is complete.
+bool appendConfigJournal(const void *data, size_t length);
+
+// Erase the sector the journal moves to next, ahead of time, so that a
+// save only programs pages. Does nothing once that sector is blank, so it
+// can be called on every idle pass. Returns true if it erased.
+bool prepareConfigJournal();
+
+ConfigJournalStats getConfigJournalStats();
+
+#endif // CONFIG_JOURNAL_H
@@ -0,0 +1,115 @@
+#include "config_sysex.h"
+#include "midi_router.h"
+#include "web_serial_config.h"
+
+// Reassembly state per accepting endpoint (serial, USB device)
+#define CONFIG_SYSEX_ENDPOINTS 2
+
+typedef struct {
+    bool active;      // Inside a config message
+    bool malformed;   // Too long or a stray status byte; dropped at F7
+    uint16_t length;
+    uint8_t packed[CONFIG_SYSEX_MAX_PACKED];
+} ConfigSysExReceiver;
+
+static ConfigSysExReceiver receivers[CONFIG_SYSEX_ENDPOINTS];
+
+// Decoded request, then response; and the response message. Shared by all
+// endpoints since a request is handled as soon as it is complete.
+static uint8_t packet[CONFIG_FRAME_MAX_PACKET];
+static uint8_t replyMessage[CONFIG_SYSEX_MAX_MESSAGE];
+
+// Returns the unpacked length, 0 if malformed
+static size_t unpack7(const uint8_t *in, size_t length, uint8_t *out, size_t capacity) {
+    size_t written = 0;
+    size_t pos = 0;
+    while (pos < length) {
+        uint8_t msbs = in[pos++];
+        for (uint8_t i = 0; i < 7 && pos < length; i++) {
+            if (written >= capacity) {
+                return 0;
+            }
+            out[written++] = in[pos++] | (((msbs >> i) & 1) << 7);
+        }
+    }
+    return written;
+}
+
+static size_t pack7(const uint8_t *in, size_t length, uint8_t *out) {
+    size_t written = 0;
+    for (size_t pos = 0; pos < length; pos += 7) {
+        size_t msbIndex = written++;
+        uint8_t msbs = 0;
+        for (uint8_t i = 0; i < 7 && pos + i < length; i++) {
+            msbs |= (in[pos + i] >> 7) << i;
+            out[written++] = in[pos + i] & 0x7F;
+        }
+        out[msbIndex] = msbs;
+    }
+    return written;
+}
+
+bool isConfigSysExEndpoint(uint8_t endpoint) {
+    return endpoint == MIDI_ENDPOINT_SERIAL || endpoint == MIDI_ENDPOINT_USB_DEVICE;
+}
+
+static unsigned completeRequest(ConfigSysExReceiver &rx) {
+    rx.active = false;
+    if (rx.malformed) {
+        return 0;
+    }
+
+    size_t packetLength = unpack7(rx.packed, rx.length, packet, sizeof(packet));
+    bool changed;
+    size_t responseLength = processConfigPacket(packet, packetLength, changed);
+    if (changed) {
+        scheduleConfigSave();
+    }
+    if (responseLength == 0) {
+        return 0;
+    }
+
+    replyMessage[0] = 0xF0;
+    replyMessage[1] = CONFIG_SYSEX_MANUFACTURER;
+    replyMessage[2] = CONFIG_SYSEX_SIGNATURE;
+    size_t size = CONFIG_SYSEX_HEADER + pack7(packet, responseLength, replyMessage + CONFIG_SYSEX_HEADER);
+    replyMessage[size++] = 0xF7;
+    return size;
+}
+
+bool receiveConfigSysEx(uint8_t endpoint, const uint8_t *data, unsigned size,
+                        const uint8_t **reply, unsigned *replySize) {
+    *replySize = 0;
+    if (!isConfigSysExEndpoint(endpoint) || size == 0) {
+        return false;
+    }
+    ConfigSysExReceiver &rx = receivers[endpoint];
+
+    unsigned pos = 0;
+    if (data[0] == 0xF0) {
+        // Any new message ends an unterminated one
+        rx.active = size >= CONFIG_SYSEX_HEADER &&
+                    data[1] == CONFIG_SYSEX_MANUFACTURER && data[2] == CONFIG_SYSEX_SIGNATURE;
+        rx.malformed = false;
+        rx.length = 0;
+        pos = CONFIG_SYSEX_HEADER;
+    }
+    if (!rx.active) {
+        return false;
+    }
+
+    for (; pos < size; pos++) {
+        uint8_t value = data[pos];
+        if (value == 0xF7) {
+            *replySize = completeRequest(rx);
+            *reply = replyMessage;
+            return true;
+        }
+        if (value & 0x80 || rx.length >= sizeof(rx.packed)) {
+            rx.malformed = true;
+            continue;
+        }
+        rx.packed[rx.length++] = value;
+    }
+    return true;
+}
@@ -0,0 +1,41 @@
+#ifndef CONFIG_SYSEX_H
+#define CONFIG_SYSEX_H
+
+#include <Arduino.h>
+#include "config_frame.h"
+
+// Config channel over MIDI SysEx, for hosts that only see the USB MIDI
+// interface and not the CDC port. A message is
+//   F0 CONFIG_SYSEX_MANUFACTURER CONFIG_SYSEX_SIGNATURE <packed packet> F7
+// where the packet is a config_frame.h request (request id, opcode, TLVs,
+// CRC32) packed into 7-bit bytes: each group of up to 7 bytes is preceded
+// by one byte holding their top bits (bit n = top bit of byte n). The
+// response packet comes back in the same form on the port the request
+// arrived on.
+//
+// Accepted on the serial and USB device ports (both handled on core 0).
+// Config messages are taken out by the router and never forwarded.
+#define CONFIG_SYSEX_MANUFACTURER 0x7D   // Non-commercial / educational use
+#define CONFIG_SYSEX_SIGNATURE 0x4D
+
+// Header bytes before the packed packet: F0, manufacturer, signature
+#define CONFIG_SYSEX_HEADER 3
+// Packed size of the largest packet
+#define CONFIG_SYSEX_MAX_PACKED (CONFIG_FRAME_MAX_PACKET + (CONFIG_FRAME_MAX_PACKET + 6) / 7)
+// Largest complete message, header and F7 included
+#define CONFIG_SYSEX_MAX_MESSAGE (CONFIG_SYSEX_HEADER + CONFIG_SYSEX_MAX_PACKED + 1)
+
+// True for endpoints (midi_router.h) config SysEx is accepted from
+bool isConfigSysExEndpoint(uint8_t endpoint);
+
+// Feed one SysEx fragment received on `endpoint`. A fragment starting with
+// F0 decides, from its first three bytes, whether the whole message is a
+// config message. Returns true if the fragment belongs to one; it must
+// then not be forwarded. Once the closing F7 arrives the request is
+// handled and *reply/*replySize are set to the response message to send
+// back on `endpoint` (size 0 while the message is incomplete, or if it was
+// malformed). Config changes are saved like SAVEALL. Core 0 only.
+bool receiveConfigSysEx(uint8_t endpoint, const uint8_t *data, unsigned size,
+                        const uint8_t **reply, unsigned *replySize);
+
+#endif // CONFIG_SYSEX_H
@@ -0,0 +1,10 @@
+#ifndef CRC_UTILS_H
+#define CRC_UTILS_H
+
+#include <Arduino.h>
+
+// CRC-32 (IEEE 802.3, as used by zlib). Bitwise, no table: only used for
+// small config blocks.
+uint32_t crc32(const uint8_t *data, size_t length);
+
+#endif // CRC_UTILS_H
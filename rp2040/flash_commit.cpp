@@ -0,0 +1,112 @@
+#include "flash_commit.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "pico/platform.h"
+
+// Handshake between the cores. Both flags live in SRAM, so core 1 can
+// poll them while flash is unavailable.
+static volatile bool parkRequested = false;
+static volatile bool core1Parked = false;
+
+static FlashCommitStats stats = {0, 0, 0, 0, 0, 0, 0, 0};
+
+// Runs from SRAM: core 1 must not fetch from flash while it is parked, and
+// with interrupts off no flash-resident handler can run either
+void __not_in_flash_func(flashCommitSafePoint)() {
+    if (!parkRequested) {
+        return;
+    }
+
+    uint32_t irq = save_and_disable_interrupts();
+    core1Parked = true;
+    __mem_fence_release();
+    while (parkRequested) {
+        tight_loop_contents();
+    }
+    core1Parked = false;
+    __mem_fence_release();
+    restore_interrupts(irq);
+}
+
+// Returns false if core 1 did not reach its safe point in time; the caller
+// then idles it the generic way
+static bool parkCore1() {
+    uint32_t start = micros();
+    parkRequested = true;
+    __mem_fence_release();
+    while (!core1Parked) {
+        if (micros() - start > FLASH_PARK_TIMEOUT_US) {
+            parkRequested = false;
+            // Core 1 may have seen the request just before it was withdrawn
+            while (core1Parked) {
+                tight_loop_contents();
+            }
+            stats.parkTimeouts++;
+            return false;
+        }
+    }
+    uint32_t waited = micros() - start;
+    if (waited > stats.maxParkWaitUs) {
+        stats.maxParkWaitUs = waited;
+    }
+    return true;
+}
+
+static void releaseCore1() {
+    parkRequested = false;
+    __mem_fence_release();
+    while (core1Parked) {
+        tight_loop_contents();
+    }
+}
+
+// Common frame for one slice: core 1 out of the way, core 0 interrupts off
+static void runSlice(bool erase, uint32_t offset, const uint8_t *page) {
+    bool parked = parkCore1();
+    uint32_t start = micros();
+
+    noInterrupts();
+    if (!parked) {
+        rp2040.idleOtherCore();
+    }
+    if (erase) {
+        flash_range_erase(offset, FLASH_SECTOR_SIZE);
+    } else {
+        flash_range_program(offset, page, FLASH_PAGE_SIZE);
+    }
+    if (!parked) {
+        rp2040.resumeOtherCore();
+    }
+    interrupts();
+
+    uint32_t stall = micros() - start;
+    if (parked) {
+        releaseCore1();
+    }
+
+    stats.slices++;
+    if (erase) {
+        stats.erases++;
+        stats.lastEraseStallUs = stall;
+        if (stall > stats.maxEraseStallUs) {
+            stats.maxEraseStallUs = stall;
+        }
+    } else {
+        stats.lastProgramStallUs = stall;
+        if (stall > stats.maxProgramStallUs) {
+            stats.maxProgramStallUs = stall;
+        }
+    }
+}
+
+void flashCommitErase(uint32_t offset) {
+    runSlice(true, offset, nullptr);
+}
+
+void flashCommitProgram(uint32_t offset, const uint8_t *page) {
+    runSlice(false, offset, page);
+}
+
+FlashCommitStats getFlashCommitStats() {
+    return stats;
+}
@@ -0,0 +1,44 @@
+#ifndef FLASH_COMMIT_H
+#define FLASH_COMMIT_H
+
+#include <Arduino.h>
+
+// Flash writes with core 1 parked at a known-safe point instead of being
+// interrupted wherever it happens to be. While flash is programmed or erased
+// nothing can execute from it, so core 1 (USB host) waits in SRAM with its
+// interrupts off. Work is done in slices of one page program or one sector
+// erase, and core 1 runs a full USB host pass between slices.
+//
+// Core 0 calls the write functions; core 1 calls flashCommitSafePoint() at
+// the top of loop1(), between two USB host tasks.
+
+// How long core 0 waits for core 1 to park before falling back to
+// rp2040.idleOtherCore() (e.g. while core 1 is still in setup1())
+#ifndef FLASH_PARK_TIMEOUT_US
+#define FLASH_PARK_TIMEOUT_US 20000
+#endif
+
+// Time core 1 was held, kept apart for the two kinds of slice: a page
+// program takes well under a millisecond, a sector erase tens of
+// milliseconds, long enough for attached USB devices to miss SOFs
+typedef struct {
+    uint32_t slices;              // Page programs and sector erases done
+    uint32_t erases;              // Of which sector erases
+    uint32_t parkTimeouts;        // Slices that fell back to idleOtherCore()
+    uint32_t lastProgramStallUs;
+    uint32_t maxProgramStallUs;
+    uint32_t lastEraseStallUs;
+    uint32_t maxEraseStallUs;
+    uint32_t maxParkWaitUs;       // Longest wait for core 1 to reach its safe point
+} FlashCommitStats;
+
+// Core 1: park here if core 0 is about to write flash
+void flashCommitSafePoint();
+
+// Core 0: one slice each. Offsets are relative to the start of flash.
+void flashCommitErase(uint32_t offset);
+void flashCommitProgram(uint32_t offset, const uint8_t *page);
+
+FlashCommitStats getFlashCommitStats();
+
+#endif // FLASH_COMMIT_H
@@ -315,7 +315,7 @@ void sendIMUMidiCC(uint8_t channel, uint8_t cc, uint8_t value, bool toSerial, bo
     msg.sysexSize = 0;
     msg.rtType = midi::InvalidType;
 
-    byte destMask = 0;
+    MidiEndpointMask destMask = 0;
     if (toSerial) {
         destMask |= ROUTE_TO_SERIAL;
     }
@@ -337,6 +337,21 @@ IMUConfig getIMUConfig() {
     return imuConfig;
 }
 
+static bool isValidAxis(uint8_t channel, uint8_t cc, uint8_t defaultValue, float sensitivity, float range) {
+    // angleToMidiCC() divides by the range
+    return channel >= 1 && channel <= 16 && cc <= 127 && defaultValue <= 127 &&
+           isfinite(sensitivity) && isfinite(range) && range > 0;
+}
+
+bool isValidIMUConfig(const IMUConfig &config) {
+    return isValidAxis(config.rollMidiChannel, config.rollMidiCC, config.rollDefaultValue,
+                       config.rollSensitivity, config.rollRange) &&
+           isValidAxis(config.pitchMidiChannel, config.pitchMidiCC, config.pitchDefaultValue,
+                       config.pitchSensitivity, config.pitchRange) &&
+           isValidAxis(config.yawMidiChannel, config.yawMidiCC, config.yawDefaultValue,
+                       config.yawSensitivity, config.yawRange);
+}
+
 void resetIMUConfig() {
     // Note: No global enabled flag - determined automatically by individual axis enables
     
@@ -374,98 +389,128 @@ void resetIMUConfig() {
     imuConfig.yawRange = DEFAULT_RANGE;
 }
 
-void imuConfigToJson(JsonDocument& doc) {
-    JsonObject imu = doc["imu"].to<JsonObject>();
+void imuConfigToJson(JsonStreamWriter& json) {
+    json.beginObject("imu");
     
     // Note: No global enabled field - determined automatically by individual axis enables
     
     // Roll configuration
-    JsonObject roll = imu["roll"].to<JsonObject>();
-    roll["enabled"] = imuConfig.rollEnabled;
-    roll["channel"] = imuConfig.rollMidiChannel;
-    roll["cc"] = imuConfig.rollMidiCC;
-    roll["defaultValue"] = imuConfig.rollDefaultValue;
-    roll["toSerial"] = imuConfig.rollToSerial;
-    roll["toUSBDevice"] = imuConfig.rollToUSBDevice;
-    roll["toUSBHost"] = imuConfig.rollToUSBHost;
-    roll["sensitivity"] = imuConfig.rollSensitivity;
-    roll["range"] = imuConfig.rollRange;
+    json.beginObject("roll");
+    json.member("enabled", imuConfig.rollEnabled);
+    json.member("channel", imuConfig.rollMidiChannel);
+    json.member("cc", imuConfig.rollMidiCC);
+    json.member("defaultValue", imuConfig.rollDefaultValue);
+    json.member("toSerial", imuConfig.rollToSerial);
+    json.member("toUSBDevice", imuConfig.rollToUSBDevice);
+    json.member("toUSBHost", imuConfig.rollToUSBHost);
+    json.member("sensitivity", imuConfig.rollSensitivity);
+    json.member("range", imuConfig.rollRange);
+    json.endObject();
     
     // Pitch configuration
-    JsonObject pitch = imu["pitch"].to<JsonObject>();
-    pitch["enabled"] = imuConfig.pitchEnabled;
-    pitch["channel"] = imuConfig.pitchMidiChannel;
-    pitch["cc"] = imuConfig.pitchMidiCC;
-    pitch["defaultValue"] = imuConfig.pitchDefaultValue;
-    pitch["toSerial"] = imuConfig.pitchToSerial;
-    pitch["toUSBDevice"] = imuConfig.pitchToUSBDevice;
-    pitch["toUSBHost"] = imuConfig.pitchToUSBHost;
-    pitch["sensitivity"] = imuConfig.pitchSensitivity;
-    pitch["range"] = imuConfig.pitchRange;
+    json.beginObject("pitch");
+    json.member("enabled", imuConfig.pitchEnabled);
+    json.member("channel", imuConfig.pitchMidiChannel);
+    json.member("cc", imuConfig.pitchMidiCC);
+    json.member("defaultValue", imuConfig.pitchDefaultValue);
+    json.member("toSerial", imuConfig.pitchToSerial);
+    json.member("toUSBDevice", imuConfig.pitchToUSBDevice);
+    json.member("toUSBHost", imuConfig.pitchToUSBHost);
+    json.member("sensitivity", imuConfig.pitchSensitivity);
+    json.member("range", imuConfig.pitchRange);
+    json.endObject();
     
     // Yaw configuration
-    JsonObject yaw = imu["yaw"].to<JsonObject>();
-    yaw["enabled"] = imuConfig.yawEnabled;
-    yaw["channel"] = imuConfig.yawMidiChannel;
-    yaw["cc"] = imuConfig.yawMidiCC;
-    yaw["defaultValue"] = imuConfig.yawDefaultValue;
-    yaw["toSerial"] = imuConfig.yawToSerial;
-    yaw["toUSBDevice"] = imuConfig.yawToUSBDevice;
-    yaw["toUSBHost"] = imuConfig.yawToUSBHost;
-    yaw["sensitivity"] = imuConfig.yawSensitivity;
-    yaw["range"] = imuConfig.yawRange;
+    json.beginObject("yaw");
+    json.member("enabled", imuConfig.yawEnabled);
+    json.member("channel", imuConfig.yawMidiChannel);
+    json.member("cc", imuConfig.yawMidiCC);
+    json.member("defaultValue", imuConfig.yawDefaultValue);
+    json.member("toSerial", imuConfig.yawToSerial);
+    json.member("toUSBDevice", imuConfig.yawToUSBDevice);
+    json.member("toUSBHost", imuConfig.yawToUSBHost);
+    json.member("sensitivity", imuConfig.yawSensitivity);
+    json.member("range", imuConfig.yawRange);
+    json.endObject();
+
+    json.endObject();
 }
 
 bool updateIMUConfigFromJson(const JsonDocument& doc) {
-    JsonObject imu = ((JsonDocument&)doc)["imu"].as<JsonObject>();
+    IMUConfig config = imuConfig;
+    if (!imuConfigFromJson(doc, config)) {
+        return false;
+    }
+    imuConfig = config;
+    return true;
+}
+
+// Fields missing from `axis` are left unchanged. False if a number is not
+// one (or, for the byte fields, not an integer from 0 to 255), so that
+// as<uint8_t>() never quietly turns it into 0.
+static bool axisFromJson(JsonObjectConst axis, bool &enabled, uint8_t &channel, uint8_t &cc,
+                         uint8_t &defaultValue, bool &toSerial, bool &toUSBDevice, bool &toUSBHost,
+                         float &sensitivity, float &range) {
+    const char *bytes[] = {"channel", "cc", "defaultValue"};
+    for (const char *key : bytes) {
+        if (!axis[key].isNull() && !axis[key].is<uint8_t>()) return false;
+    }
+    const char *floats[] = {"sensitivity", "range"};
+    for (const char *key : floats) {
+        if (!axis[key].isNull() && !axis[key].is<float>()) return false;
+    }
+
+    if (!axis["enabled"].isNull()) enabled = axis["enabled"].as<bool>();
+    if (!axis["channel"].isNull()) channel = axis["channel"].as<uint8_t>();
+    if (!axis["cc"].isNull()) cc = axis["cc"].as<uint8_t>();
+    if (!axis["defaultValue"].isNull()) defaultValue = axis["defaultValue"].as<uint8_t>();
+    if (!axis["toSerial"].isNull()) toSerial = axis["toSerial"].as<bool>();
+    if (!axis["toUSBDevice"].isNull()) toUSBDevice = axis["toUSBDevice"].as<bool>();
+    if (!axis["toUSBHost"].isNull()) toUSBHost = axis["toUSBHost"].as<bool>();
+    if (!axis["sensitivity"].isNull()) sensitivity = axis["sensitivity"].as<float>();
+    if (!axis["range"].isNull()) range = axis["range"].as<float>();
+    return true;
+}
+
+bool imuAxisFromJson(const char *axisName, JsonObjectConst axis, IMUConfig& config) {
+    if (axis.isNull()) {
+        return false;
+    }
+    bool parsed;
+    if (strcmp(axisName, "roll") == 0) {
+        parsed = axisFromJson(axis, config.rollEnabled, config.rollMidiChannel, config.rollMidiCC,
+                              config.rollDefaultValue, config.rollToSerial, config.rollToUSBDevice,
+                              config.rollToUSBHost, config.rollSensitivity, config.rollRange);
+    } else if (strcmp(axisName, "pitch") == 0) {
+        parsed = axisFromJson(axis, config.pitchEnabled, config.pitchMidiChannel, config.pitchMidiCC,
+                              config.pitchDefaultValue, config.pitchToSerial, config.pitchToUSBDevice,
+                              config.pitchToUSBHost, config.pitchSensitivity, config.pitchRange);
+    } else if (strcmp(axisName, "yaw") == 0) {
+        parsed = axisFromJson(axis, config.yawEnabled, config.yawMidiChannel, config.yawMidiCC,
+                              config.yawDefaultValue, config.yawToSerial, config.yawToUSBDevice,
+                              config.yawToUSBHost, config.yawSensitivity, config.yawRange);
+    } else {
+        return false;
+    }
+    return parsed && isValidIMUConfig(config);
+}
+
+bool imuConfigFromJson(const JsonDocument& doc, IMUConfig& config) {
+    JsonObjectConst imu = doc["imu"].as<JsonObjectConst>();
     if (imu.isNull()) {
         return true; // IMU config is optional
     }
     
     // Note: No global enable/disable - determined automatically by individual axis enables
-    
-    // Roll configuration
-    JsonObject roll = imu["roll"].as<JsonObject>();
-    if (!roll.isNull()) {
-        if (!roll["enabled"].isNull()) imuConfig.rollEnabled = roll["enabled"].as<bool>();
-        if (!roll["channel"].isNull()) imuConfig.rollMidiChannel = roll["channel"].as<uint8_t>();
-        if (!roll["cc"].isNull()) imuConfig.rollMidiCC = roll["cc"].as<uint8_t>();
-        if (!roll["defaultValue"].isNull()) imuConfig.rollDefaultValue = roll["defaultValue"].as<uint8_t>();
-        if (!roll["toSerial"].isNull()) imuConfig.rollToSerial = roll["toSerial"].as<bool>();
-        if (!roll["toUSBDevice"].isNull()) imuConfig.rollToUSBDevice = roll["toUSBDevice"].as<bool>();
-        if (!roll["toUSBHost"].isNull()) imuConfig.rollToUSBHost = roll["toUSBHost"].as<bool>();
-        if (!roll["sensitivity"].isNull()) imuConfig.rollSensitivity = roll["sensitivity"].as<float>();
-        if (!roll["range"].isNull()) imuConfig.rollRange = roll["range"].as<float>();
-    }
-    
-    // Pitch configuration
-    JsonObject pitch = imu["pitch"].as<JsonObject>();
-    if (!pitch.isNull()) {
-        if (!pitch["enabled"].isNull()) imuConfig.pitchEnabled = pitch["enabled"].as<bool>();
-        if (!pitch["channel"].isNull()) imuConfig.pitchMidiChannel = pitch["channel"].as<uint8_t>();
-        if (!pitch["cc"].isNull()) imuConfig.pitchMidiCC = pitch["cc"].as<uint8_t>();
-        if (!pitch["defaultValue"].isNull()) imuConfig.pitchDefaultValue = pitch["defaultValue"].as<uint8_t>();
-        if (!pitch["toSerial"].isNull()) imuConfig.pitchToSerial = pitch["toSerial"].as<bool>();
-        if (!pitch["toUSBDevice"].isNull()) imuConfig.pitchToUSBDevice = pitch["toUSBDevice"].as<bool>();
-        if (!pitch["toUSBHost"].isNull()) imuConfig.pitchToUSBHost = pitch["toUSBHost"].as<bool>();
-        if (!pitch["sensitivity"].isNull()) imuConfig.pitchSensitivity = pitch["sensitivity"].as<float>();
-        if (!pitch["range"].isNull()) imuConfig.pitchRange = pitch["range"].as<float>();
-    }
-    
-    // Yaw configuration
-    JsonObject yaw = imu["yaw"].as<JsonObject>();
-    if (!yaw.isNull()) {
-        if (!yaw["enabled"].isNull()) imuConfig.yawEnabled = yaw["enabled"].as<bool>();
-        if (!yaw["channel"].isNull()) imuConfig.yawMidiChannel = yaw["channel"].as<uint8_t>();
-        if (!yaw["cc"].isNull()) imuConfig.yawMidiCC = yaw["cc"].as<uint8_t>();
-        if (!yaw["defaultValue"].isNull()) imuConfig.yawDefaultValue = yaw["defaultValue"].as<uint8_t>();
-        if (!yaw["toSerial"].isNull()) imuConfig.yawToSerial = yaw["toSerial"].as<bool>();
-        if (!yaw["toUSBDevice"].isNull()) imuConfig.yawToUSBDevice = yaw["toUSBDevice"].as<bool>();
-        if (!yaw["toUSBHost"].isNull()) imuConfig.yawToUSBHost = yaw["toUSBHost"].as<bool>();
-        if (!yaw["sensitivity"].isNull()) imuConfig.yawSensitivity = yaw["sensitivity"].as<float>();
-        if (!yaw["range"].isNull()) imuConfig.yawRange = yaw["range"].as<float>();
+    // Each axis is optional too
+    const char *axes[] = {"roll", "pitch", "yaw"};
+    for (const char *name : axes) {
+        if (!imu[name].isNull() && !imuAxisFromJson(name, imu[name].as<JsonObjectConst>(), config)) {
+            dualPrintf("[DEBUG] Invalid IMU %s config in JSON\n", name);
+            return false;
+        }
     }
     
-    dualPrintln("[DEBUG] IMU config updated from JSON");
+    dualPrintln("[DEBUG] IMU config parsed from JSON");
     return true;
 }
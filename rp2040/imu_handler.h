@@ -5,6 +5,7 @@
 #include "pin_config.h"
 #include "FastIMU.h"
 #include <ArduinoJson.h>
+#include "json_stream.h"
 
 // IMU Configuration Structure
 typedef struct {
@@ -60,12 +61,21 @@ void sendIMUMidiCC(uint8_t channel, uint8_t cc, uint8_t value, bool toSerial, bo
 
 // Configuration functions
 void setIMUConfig(const IMUConfig &config);
+// Every axis has channel 1-16, cc and defaultValue 0-127, a finite
+// sensitivity and a finite range above 0. All config writers check this.
+bool isValidIMUConfig(const IMUConfig &config);
 IMUConfig getIMUConfig();
 void resetIMUConfig();
 
 // JSON serialization
-void imuConfigToJson(JsonDocument& doc);
+void imuConfigToJson(JsonStreamWriter& json);
 bool updateIMUConfigFromJson(const JsonDocument& doc);
+// Apply the optional "imu" object to a copy without touching the live config.
+// False if a field has the wrong type or the result is not valid.
+bool imuConfigFromJson(const JsonDocument& doc, IMUConfig& config);
+// Apply the fields present in `axis` to one axis ("roll", "pitch" or "yaw"),
+// with the same checks
+bool imuAxisFromJson(const char *axisName, JsonObjectConst axis, IMUConfig& config);
 
 // Default configuration values
 #define DEFAULT_MIDI_CHANNEL 1
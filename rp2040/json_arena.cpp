@@ -0,0 +1,106 @@
+#include "json_arena.h"
+
+// Every block starts with a header holding its size, so reallocate() can
+// copy a block that is not the newest one
+typedef struct {
+    uint32_t size;
+    uint32_t previous;   // Header offset of the block allocated before it
+} JsonArenaHeader;
+
+#define JSON_ARENA_ALIGN 8
+
+static_assert(sizeof(JsonArenaHeader) % JSON_ARENA_ALIGN == 0, "Header keeps blocks aligned");
+
+static uint8_t arena[JSON_ARENA_SIZE] __attribute__((aligned(JSON_ARENA_ALIGN)));
+
+JsonArenaAllocator jsonArena;
+
+static size_t alignSize(size_t size) {
+    return (size + JSON_ARENA_ALIGN - 1) & ~(size_t)(JSON_ARENA_ALIGN - 1);
+}
+
+static JsonArenaHeader *headerOf(void *ptr) {
+    return (JsonArenaHeader *)ptr - 1;
+}
+
+void *JsonArenaAllocator::allocate(size_t size) {
+    size_t needed = sizeof(JsonArenaHeader) + alignSize(size);
+    if (needed > JSON_ARENA_SIZE - top) {
+        counters.failures++;
+        return nullptr;
+    }
+
+    JsonArenaHeader *header = (JsonArenaHeader *)(arena + top);
+    header->size = size;
+    header->previous = lastBlock;
+    lastBlock = top;
+    top += needed;
+    live++;
+
+    counters.used = top;
+    if (top > counters.peak) {
+        counters.peak = top;
+    }
+    return header + 1;
+}
+
+void JsonArenaAllocator::deallocate(void *ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+
+    // Only the newest block can give its space back right away; the rest
+    // is reclaimed when the arena empties
+    JsonArenaHeader *header = headerOf(ptr);
+    if ((uint8_t *)header == arena + lastBlock) {
+        top = lastBlock;
+        lastBlock = header->previous;
+    }
+    if (--live == 0) {
+        top = 0;
+        lastBlock = 0;
+    }
+    counters.used = top;
+}
+
+void *JsonArenaAllocator::reallocate(void *ptr, size_t newSize) {
+    if (ptr == nullptr) {
+        return allocate(newSize);
+    }
+
+    JsonArenaHeader *header = headerOf(ptr);
+    size_t offset = (uint8_t *)header - arena;
+
+    // The newest block grows or shrinks in place
+    if (offset == lastBlock) {
+        size_t needed = sizeof(JsonArenaHeader) + alignSize(newSize);
+        if (needed > JSON_ARENA_SIZE - offset) {
+            counters.failures++;
+            return nullptr;
+        }
+        header->size = newSize;
+        top = offset + needed;
+        counters.used = top;
+        if (top > counters.peak) {
+            counters.peak = top;
+        }
+        return ptr;
+    }
+
+    // Older blocks shrink in place and move when they grow
+    if (newSize <= header->size) {
+        header->size = newSize;
+        return ptr;
+    }
+    void *moved = allocate(newSize);
+    if (moved == nullptr) {
+        return nullptr;
+    }
+    memcpy(moved, ptr, header->size);
+    deallocate(ptr);
+    return moved;
+}
+
+JsonArenaStats JsonArenaAllocator::stats() const {
+    return counters;
+}
@@ -0,0 +1,44 @@
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Fixed static memory for every config JsonDocument, so parsing and
+// serializing commands never touches the heap. Pass &jsonArena to the
+// JsonDocument constructor. Core 0 only.
+//
+// Allocation is a bump pointer; freeing the newest block rolls it back and
+// the arena resets whenever no block is live, which matches how documents
+// are created and destroyed per command. When the arena is full,
+// allocate() returns nullptr: ArduinoJson then reports NoMemory or
+// overflowed() instead of growing.
+#ifndef JSON_ARENA_SIZE
+#define JSON_ARENA_SIZE 8192
+#endif
+
+typedef struct {
+    uint32_t size;        // Arena capacity in bytes
+    uint32_t used;        // Bytes in use now
+    uint32_t peak;        // Most bytes ever in use
+    uint32_t failures;    // Allocations refused because the arena was full
+} JsonArenaStats;
+
+class JsonArenaAllocator : public ArduinoJson::Allocator {
+public:
+    void *allocate(size_t size) override;
+    void deallocate(void *ptr) override;
+    void *reallocate(void *ptr, size_t newSize) override;
+
+    JsonArenaStats stats() const;
+
+private:
+    size_t top = 0;       // Offset of the first free byte
+    size_t lastBlock = 0; // Offset of the newest block's header
+    uint32_t live = 0;    // Blocks allocated and not yet freed
+    JsonArenaStats counters = {JSON_ARENA_SIZE, 0, 0, 0};
+};
+
+extern JsonArenaAllocator jsonArena;
+
+#endif // JSON_ARENA_H
@@ -0,0 +1,213 @@
+#include "json_stream.h"
+#include <math.h>
+
+void JsonStreamWriter::separator() {
+    // A value right after its key needs no comma
+    if (afterKey) {
+        afterKey = false;
+        return;
+    }
+    if (depth == 0) {
+        return;
+    }
+    uint32_t bit = 1UL << depth;
+    if (hasItems & bit) {
+        out.write(',');
+    }
+    hasItems |= bit;
+}
+
+void JsonStreamWriter::beginObject() {
+    separator();
+    out.write('{');
+    if (depth < JSON_STREAM_MAX_DEPTH) {
+        depth++;
+        hasItems &= ~(1UL << depth);
+    }
+}
+
+void JsonStreamWriter::endObject() {
+    if (depth > 0) {
+        depth--;
+    }
+    out.write('}');
+}
+
+void JsonStreamWriter::beginArray() {
+    separator();
+    out.write('[');
+    if (depth < JSON_STREAM_MAX_DEPTH) {
+        depth++;
+        hasItems &= ~(1UL << depth);
+    }
+}
+
+void JsonStreamWriter::endArray() {
+    if (depth > 0) {
+        depth--;
+    }
+    out.write(']');
+}
+
+void JsonStreamWriter::key(const char *name) {
+    separator();
+    writeString(name);
+    out.write(':');
+    afterKey = true;
+}
+
+void JsonStreamWriter::value(bool v) {
+    separator();
+    out.print(v ? "true" : "false");
+}
+
+void JsonStreamWriter::value(int v) {
+    separator();
+    out.print(v);
+}
+
+void JsonStreamWriter::value(unsigned v) {
+    separator();
+    out.print(v);
+}
+
+void JsonStreamWriter::value(long v) {
+    separator();
+    out.print(v);
+}
+
+void JsonStreamWriter::value(unsigned long v) {
+    separator();
+    out.print(v);
+}
+
+void JsonStreamWriter::value(float v) {
+    separator();
+    writeFloat(v, 6);
+}
+
+void JsonStreamWriter::value(double v) {
+    separator();
+    writeFloat(v, 9);
+}
+
+void JsonStreamWriter::value(const char *v) {
+    separator();
+    if (v == nullptr) {
+        out.print("null");
+        return;
+    }
+    writeString(v);
+}
+
+void JsonStreamWriter::writeString(const char *s) {
+    static const char hex[] = "0123456789abcdef";
+    out.write('"');
+    for (; *s; s++) {
+        uint8_t c = (uint8_t)*s;
+        switch (c) {
+            case '"':  out.print("\\\""); break;
+            case '\\': out.print("\\\\"); break;
+            case '\b': out.print("\\b"); break;
+            case '\f': out.print("\\f"); break;
+            case '\n': out.print("\\n"); break;
+            case '\r': out.print("\\r"); break;
+            case '\t': out.print("\\t"); break;
+            default:
+                if (c < 0x20) {
+                    out.print("\\u00");
+                    out.write(hex[c >> 4]);
+                    out.write(hex[c & 0x0F]);
+                } else {
+                    out.write(c);
+                }
+                break;
+        }
+    }
+    out.write('"');
+}
+
+// Same digits as ArduinoJson's TextFormatter::writeFloat(), so streamed
+// output matches what serializeJson() printed for the same value: up to
+// `decimalPlaces` decimals less one per extra integral digit, rounded, no
+// trailing zeros, and an exponent from 1e7 up and from 1e-5 down.
+void JsonStreamWriter::writeFloat(double v, int8_t decimalPlaces) {
+    static const double positivePowers[] = { 1e1, 1e2, 1e4, 1e8, 1e16, 1e32, 1e64, 1e128, 1e256 };
+    static const double negativePowers[] = { 1e-1, 1e-2, 1e-4, 1e-8, 1e-16, 1e-32, 1e-64, 1e-128, 1e-256 };
+
+    if (isnan(v) || isinf(v)) {
+        out.print("null");
+        return;
+    }
+    if (v < 0.0) {
+        out.write('-');
+        v = -v;
+    }
+
+    // Bring the value into [1, 1e7) by binary powers of ten
+    int exponent = 0;
+    int index = 8;
+    int bit = 1 << index;
+    if (v >= 1e7) {
+        for (; index >= 0; index--) {
+            if (v >= positivePowers[index]) {
+                v *= negativePowers[index];
+                exponent += bit;
+            }
+            bit >>= 1;
+        }
+    }
+    if (v > 0 && v <= 1e-5) {
+        for (; index >= 0; index--) {
+            if (v < negativePowers[index] * 10) {
+                v *= positivePowers[index];
+                exponent -= bit;
+            }
+            bit >>= 1;
+        }
+    }
+
+    uint32_t maxDecimal = 1;
+    for (int8_t i = 0; i < decimalPlaces; i++) {
+        maxDecimal *= 10;
+    }
+    uint32_t integral = (uint32_t)v;
+    for (uint32_t tmp = integral; tmp >= 10; tmp /= 10) {
+        maxDecimal /= 10;
+        decimalPlaces--;
+    }
+
+    double remainder = (v - (double)integral) * (double)maxDecimal;
+    uint32_t decimal = (uint32_t)remainder;
+    remainder -= (double)decimal;
+    decimal += (uint32_t)(remainder * 2);
+    if (decimal >= maxDecimal) {
+        decimal = 0;
+        integral++;
+        if (exponent != 0 && integral >= 10) {
+            exponent++;
+            integral = 1;
+        }
+    }
+    while (decimal % 10 == 0 && decimalPlaces > 0) {
+        decimal /= 10;
+        decimalPlaces--;
+    }
+
+    out.print((unsigned long)integral);
+    if (decimalPlaces > 0) {
+        char digits[12];
+        int i = decimalPlaces;
+        digits[0] = '.';
+        digits[i + 1] = '\0';
+        for (; i > 0; i--) {
+            digits[i] = (char)('0' + decimal % 10);
+            decimal /= 10;
+        }
+        out.print(digits);
+    }
+    if (exponent != 0) {
+        out.write('e');
+        out.print(exponent);
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <Arduino.h>
+
+// Push-style JSON emitter: writes compact JSON (same layout as
+// serializeJson) straight to a Print as values are added. Nothing is
+// buffered and nothing is allocated, so large responses such as READALL
+// take constant memory and the first byte goes out immediately.
+//
+// Inside an object call key() (or member()) before every value or nested
+// container; inside an array call value()/begin*() directly. Nesting is
+// limited to JSON_STREAM_MAX_DEPTH levels.
+#define JSON_STREAM_MAX_DEPTH 31
+
+class JsonStreamWriter {
+public:
+    explicit JsonStreamWriter(Print &out) : out(out) {}
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+
+    void key(const char *name);
+
+    void value(bool v);
+    void value(int v);
+    void value(unsigned v);
+    void value(long v);
+    void value(unsigned long v);
+    void value(float v);         // 6 decimal places, as serializeJson
+    void value(double v);        // 9 decimal places, as serializeJson
+    void value(const char *v);   // nullptr writes null
+
+    // key(name) followed by value(v)
+    template <typename T>
+    void member(const char *name, T v) {
+        key(name);
+        value(v);
+    }
+
+    // key(name) followed by beginObject()/beginArray()
+    void beginObject(const char *name) { key(name); beginObject(); }
+    void beginArray(const char *name) { key(name); beginArray(); }
+
+private:
+    void separator();
+    void writeString(const char *s);
+    void writeFloat(double v, int8_t decimalPlaces);
+
+    Print &out;
+    uint32_t hasItems = 0;   // Bit n: container at depth n already has an item
+    uint8_t depth = 0;
+    bool afterKey = false;
+};
+
+#endif // JSON_STREAM_H
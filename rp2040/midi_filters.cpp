@@ -1,27 +1,304 @@
 #include "midi_filters.h"
+#include "midi_router.h"
 #include "serial_utils.h"
+#include "hardware/sync.h"
+#include "pico/platform.h"
+
+static_assert(MIDI_MSG_COUNT <= 8, "Filter bits are packed into one byte per interface");
+
+// Two complete configurations: the active one that the router reads and a
+// shadow that updates are built in. Committing publishes the shadow with a
+// single pointer store, so the router on either core only ever sees a whole
+// configuration. Before the old buffer is reused as the next shadow, core 1
+// must have left any read section that might still hold the old pointer.
+static MidiFilterConfig filterConfigs[2];
+MidiFilterConfig *volatile activeFilterConfig = &filterConfigs[0];
+
+// Preset slots hold complete, already compiled configurations; selecting
+// one just points activeFilterConfig at it
+static MidiFilterConfig presetConfigs[MIDI_PRESET_SLOTS];
+static bool presetValid[MIDI_PRESET_SLOTS] = {false};
+static volatile int8_t activePreset = -1;         // Slot currently live, -1 if edited
+static volatile int8_t requestedPreset = -1;      // Switch asked for by core 1
+static MidiPresetControl presetControl = {0, MIDI_PRESET_CONTROL_PROGRAM_CHANGE, 0};
+
+static MidiFilterConfig *shadowConfig = nullptr; // Non-null while an update is open
+static bool implicitUpdate = false;              // Opened by a single setter
+static uint8_t dirtyMsgTypes = 0;                // Route columns the open update changed
+
+// Core 1 read-section sequence: odd while inside, even while quiescent
+static volatile uint32_t core1ReadSequence = 0;
+static uint32_t graceSequence = 0;               // Sequence at the last commit
+static bool gracePending = false;
+
+// Router endpoints belonging to each interface
+static const uint16_t interfaceEndpoints[MIDI_INTERFACE_COUNT] = {
+    ROUTE_TO_SERIAL,
+    ROUTE_TO_USB_DEVICE,
+    ROUTE_TO_USB_HOST
+};
+
+#define ALL_MSG_TYPES ((1 << MIDI_MSG_COUNT) - 1)
+
+// Fold every filter and channel mask into the routing matrix, for the
+// message types in `msgTypes` (bit per MidiMsgType). A commit only rebuilds
+// the types its setters touched; the rest was copied from the active table.
+static void compileMidiRoutes(MidiFilterConfig &config, uint8_t msgTypes) {
+    for (int source = 0; source < MIDI_ROUTE_SOURCES; source++) {
+        bool internal = source == MIDI_ROUTE_SOURCES - 1;
+
+        for (int msgType = 0; msgType < MIDI_MSG_COUNT; msgType++) {
+            if ((msgTypes & (1 << msgType)) == 0) {
+                continue;
+            }
+            bool sourceBlocked = !internal && (config.sourceFilters[source] & (1 << msgType));
+
+            for (int channel = 0; channel < MIDI_ROUTE_CHANNELS; channel++) {
+                uint16_t routes = 0;
+
+                if (!sourceBlocked) {
+                    // Column 0 carries SysEx, realtime and other channel-less
+                    // messages, which no channel setting can block
+                    uint16_t channelBit = channel == 0 ? 0 : (1 << (channel - 1));
+                    bool channelPasses = channel == 0 ||
+                                         ((config.enabledChannels & channelBit) &&
+                                          (internal || (config.sourceChannelMasks[source] & channelBit)));
+
+                    for (int dest = 0; dest < MIDI_INTERFACE_COUNT && channelPasses; dest++) {
+                        if (config.destFilters[dest] & (1 << msgType)) {
+                            continue;
+                        }
+                        if (channel != 0 && (config.destChannelMasks[dest] & channelBit) == 0) {
+                            continue;
+                        }
+                        routes |= interfaceEndpoints[dest];
+                    }
+                }
+
+                config.routes[source][msgType][channel] = routes;
+            }
+        }
+    }
+}
+
+// --- Configuration Updates ---
+
+// Make `next` the configuration the router uses. Core 0 only.
+static void publishConfig(MidiFilterConfig *next) {
+    // The new buffer must be complete before it becomes visible
+    __mem_fence_release();
+    activeFilterConfig = next;
+    __mem_fence_release();
+
+    uint32_t sequence = core1ReadSequence;
+    gracePending = (sequence & 1) != 0;
+    graceSequence = sequence;
+}
+
+// Grace period: a buffer that was active before the last publish may still
+// be in use if core 1 was inside a read section then. Wait until it has left.
+static void waitForGracePeriod() {
+    if (gracePending) {
+        while (core1ReadSequence == graceSequence) {
+            tight_loop_contents();
+        }
+        gracePending = false;
+    }
+}
+
+void beginMidiFilterUpdate() {
+    if (shadowConfig != nullptr) {
+        return;
+    }
+
+    MidiFilterConfig *active = activeFilterConfig;
+    MidiFilterConfig *shadow = (active == &filterConfigs[0]) ? &filterConfigs[1] : &filterConfigs[0];
+
+    waitForGracePeriod();
+    *shadow = *active;
+    shadowConfig = shadow;
+    dirtyMsgTypes = 0;
+}
+
+void commitMidiFilterUpdate() {
+    if (shadowConfig == nullptr) {
+        return;
+    }
+
+    compileMidiRoutes(*shadowConfig, dirtyMsgTypes);
+    publishConfig(shadowConfig);
+    shadowConfig = nullptr;
+    activePreset = -1;
+}
+
+void abortMidiFilterUpdate() {
+    shadowConfig = nullptr;
+}
 
-// Global filter array: [interface][message type]
-// true = message is filtered (blocked), false = message passes through
-static bool midiFilters[MIDI_INTERFACE_COUNT][MIDI_MSG_COUNT] = {0};
-static bool midiDestFilters[MIDI_INTERFACE_COUNT][MIDI_MSG_COUNT] = {0};
+void beginMidiConfigRead() {
+    core1ReadSequence = core1ReadSequence + 1;
+    __mem_fence_acquire();
+}
+
+void endMidiConfigRead() {
+    __mem_fence_release();
+    core1ReadSequence = core1ReadSequence + 1;
+}
+
+// --- Presets ---
+
+bool storeMidiPreset(uint8_t slot) {
+    if (slot >= MIDI_PRESET_SLOTS) {
+        return false;
+    }
+
+    MidiFilterConfig *active = activeFilterConfig;
+    if (active != &presetConfigs[slot]) {
+        waitForGracePeriod(); // The slot may have been live a moment ago
+        presetConfigs[slot] = *active;
+    }
+    presetValid[slot] = true;
+    activePreset = slot;
+    dualPrintf("MIDI Presets: current config stored in slot %d\n", slot);
+    return true;
+}
+
+bool selectMidiPreset(uint8_t slot) {
+    if (slot >= MIDI_PRESET_SLOTS || !presetValid[slot]) {
+        return false;
+    }
+
+    if (get_core_num() != 0 || shadowConfig != nullptr) {
+        // Buffers are only published from core 0 and never over an open
+        // update; loopMidiPresets() picks this up once it is committed
+        requestedPreset = slot;
+        return true;
+    }
+
+    if (activeFilterConfig == &presetConfigs[slot]) {
+        return true;
+    }
+    publishConfig(&presetConfigs[slot]);
+    activePreset = slot;
+    return true;
+}
+
+void loopMidiPresets() {
+    int8_t slot = requestedPreset;
+    if (slot >= 0 && shadowConfig == nullptr) {
+        requestedPreset = -1;
+        selectMidiPreset(slot);
+    }
+}
+
+int8_t getActiveMidiPreset() {
+    return activePreset;
+}
+
+bool isMidiPresetStored(uint8_t slot) {
+    return slot < MIDI_PRESET_SLOTS && presetValid[slot];
+}
+
+const MidiFilterConfig *getMidiPresetConfig(uint8_t slot) {
+    return isMidiPresetStored(slot) ? &presetConfigs[slot] : nullptr;
+}
+
+void loadMidiPresetConfig(uint8_t slot, const MidiFilterConfig &config) {
+    if (slot >= MIDI_PRESET_SLOTS || activeFilterConfig == &presetConfigs[slot]) {
+        return;
+    }
+    waitForGracePeriod();
+    presetConfigs[slot] = config;
+    compileMidiRoutes(presetConfigs[slot], ALL_MSG_TYPES);
+    presetValid[slot] = true;
+}
+
+void clearMidiPresets() {
+    for (uint8_t slot = 0; slot < MIDI_PRESET_SLOTS; slot++) {
+        if (activeFilterConfig != &presetConfigs[slot]) {
+            presetValid[slot] = false;
+        }
+    }
+}
+
+MidiPresetControl getMidiPresetControl() {
+    return presetControl;
+}
+
+void setMidiPresetControl(const MidiPresetControl &control) {
+    presetControl = control;
+}
+
+bool isValidMidiPresetControl(const MidiPresetControl &control) {
+    return control.channel <= 16 && control.type <= MIDI_PRESET_CONTROL_CC && control.cc <= 127;
+}
+
+// Configuration that setters modify: the open shadow, or a new one that is
+// committed again by finishEdit(). `msgTypes` are the route columns the
+// edit can affect; channel settings affect all of them.
+static MidiFilterConfig *editConfig(uint8_t msgTypes = ALL_MSG_TYPES) {
+    implicitUpdate = shadowConfig == nullptr;
+    beginMidiFilterUpdate();
+    dirtyMsgTypes |= msgTypes;
+    return shadowConfig;
+}
+
+static void finishEdit() {
+    if (implicitUpdate) {
+        implicitUpdate = false;
+        commitMidiFilterUpdate();
+    }
+}
+
+// Configuration that getters report: pending changes included
+static const MidiFilterConfig *viewConfig() {
+    return shadowConfig != nullptr ? shadowConfig : activeFilterConfig;
+}
+
+static void setFilterBit(uint8_t *filters, int interface, int msgType, bool state) {
+    if (state) {
+        filters[interface] |= (1 << msgType);
+    } else {
+        filters[interface] &= ~(1 << msgType);
+    }
+}
 
 void setupMidiFilters() {
     // Initialize all filters to false (no filtering)
+    MidiFilterConfig *config = editConfig();
     for (int interface = 0; interface < MIDI_INTERFACE_COUNT; interface++) {
-        for (int msgType = 0; msgType < MIDI_MSG_COUNT; msgType++) {
-            midiFilters[interface][msgType] = false;
-            midiDestFilters[interface][msgType] = false;
-        }
+        config->sourceFilters[interface] = 0;
+        config->destFilters[interface] = 0;
+        config->sourceChannelMasks[interface] = 0xFFFF;
+        config->destChannelMasks[interface] = 0xFFFF;
     }
-    
+    config->enabledChannels = 0xFFFF;
+    finishEdit();
+
     dualPrintln("MIDI Filters: Initialized (all messages passing through)");
 }
 
+const MidiFilterConfig *getMidiFilterConfig() {
+    return viewConfig();
+}
+
+void loadMidiFilterConfig(const MidiFilterConfig &settings) {
+    MidiFilterConfig *config = editConfig();
+    for (int interface = 0; interface < MIDI_INTERFACE_COUNT; interface++) {
+        config->sourceFilters[interface] = settings.sourceFilters[interface];
+        config->destFilters[interface] = settings.destFilters[interface];
+        config->sourceChannelMasks[interface] = settings.sourceChannelMasks[interface];
+        config->destChannelMasks[interface] = settings.destChannelMasks[interface];
+    }
+    config->enabledChannels = settings.enabledChannels;
+    finishEdit();
+}
+
 void setMidiFilter(MidiInterfaceType interface, MidiMsgType msgType, bool enabled) {
     if (interface < MIDI_INTERFACE_COUNT && msgType < MIDI_MSG_COUNT) {
-        midiFilters[interface][msgType] = enabled;
-        
+        setFilterBit(editConfig(1 << msgType)->sourceFilters, interface, msgType, enabled);
+        finishEdit();
+
         // Log the filter change
         const char* interfaceNames[] = {"Serial", "USB Device", "USB Host"};
         const char* msgTypeNames[] = {
@@ -47,14 +324,15 @@ void disableMidiFilter(MidiInterfaceType interface, MidiMsgType msgType) {
 
 bool isMidiFiltered(MidiInterfaceType interface, MidiMsgType msgType) {
     if (interface < MIDI_INTERFACE_COUNT && msgType < MIDI_MSG_COUNT) {
-        return midiFilters[interface][msgType];
+        return viewConfig()->sourceFilters[interface] & (1 << msgType);
     }
     return false; // Default to not filtered if invalid parameters
 }
 
 void setMidiDestFilter(MidiInterfaceType interface, MidiMsgType msgType, bool enabled) {
     if (interface < MIDI_INTERFACE_COUNT && msgType < MIDI_MSG_COUNT) {
-        midiDestFilters[interface][msgType] = enabled;
+        setFilterBit(editConfig(1 << msgType)->destFilters, interface, msgType, enabled);
+        finishEdit();
     }
 }
 
@@ -68,41 +346,41 @@ void disableMidiDestFilter(MidiInterfaceType interface, MidiMsgType msgType) {
 
 bool isMidiDestFiltered(MidiInterfaceType interface, MidiMsgType msgType) {
     if (interface < MIDI_INTERFACE_COUNT && msgType < MIDI_MSG_COUNT) {
-        return midiDestFilters[interface][msgType];
+        return viewConfig()->destFilters[interface] & (1 << msgType);
     }
     return false;
 }
 
 void enableAllFilters(MidiInterfaceType interface) {
     if (interface < MIDI_INTERFACE_COUNT) {
-        for (int msgType = 0; msgType < MIDI_MSG_COUNT; msgType++) {
-            midiFilters[interface][msgType] = true;
-        }
-        
+        editConfig()->sourceFilters[interface] = (1 << MIDI_MSG_COUNT) - 1;
+        finishEdit();
+
         const char* interfaceNames[] = {"Serial", "USB Device", "USB Host"};
-        dualPrintf("MIDI Filter: ALL messages on %s interface BLOCKED\n", 
+        dualPrintf("MIDI Filter: ALL messages on %s interface BLOCKED\n",
             interfaceNames[interface]);
     }
 }
 
 void disableAllFilters(MidiInterfaceType interface) {
     if (interface < MIDI_INTERFACE_COUNT) {
-        for (int msgType = 0; msgType < MIDI_MSG_COUNT; msgType++) {
-            midiFilters[interface][msgType] = false;
-        }
-        
+        editConfig()->sourceFilters[interface] = 0;
+        finishEdit();
+
         const char* interfaceNames[] = {"Serial", "USB Device", "USB Host"};
-        dualPrintf("MIDI Filter: ALL messages on %s interface ENABLED\n", 
+        dualPrintf("MIDI Filter: ALL messages on %s interface ENABLED\n",
             interfaceNames[interface]);
     }
 }
 
 void filterMessageTypeForAll(MidiMsgType msgType, bool enabled) {
     if (msgType < MIDI_MSG_COUNT) {
+        MidiFilterConfig *config = editConfig(1 << msgType);
         for (int interface = 0; interface < MIDI_INTERFACE_COUNT; interface++) {
-            midiFilters[interface][msgType] = enabled;
+            setFilterBit(config->sourceFilters, interface, msgType, enabled);
         }
-        
+        finishEdit();
+
         const char* msgTypeNames[] = {
             "Note (On/Off)", "Poly Aftertouch", "Control Change",
             "Program Change", "Channel Aftertouch", "Pitch Bend",
@@ -149,75 +427,105 @@ void disableRealtimeForAll() {
 }
 
 // --- Global MIDI Channel Filter Implementation ---
-static bool enabledChannels[16] = {
-    true, true, true, true, true, true, true, true,
-    true, true, true, true, true, true, true, true
-};
 
 bool isChannelEnabled(byte channel) {
     // MIDI channels are 1-16
     if (channel < 1 || channel > 16) return false;
-    return enabledChannels[channel - 1];
+    return viewConfig()->enabledChannels & (1 << (channel - 1));
 }
 
 void setChannelEnabled(byte channel, bool enabled) {
     if (channel >= 1 && channel <= 16) {
-        enabledChannels[channel - 1] = enabled;
+        setChannelEnabledState(channel - 1, enabled);
         dualPrintf("MIDI Channel Filter: Channel %d %s\n", channel, enabled ? "ENABLED" : "DISABLED");
     }
 }
 
 void enableAllChannels() {
-    for (int i = 0; i < 16; ++i) enabledChannels[i] = true;
+    editConfig()->enabledChannels = 0xFFFF;
+    finishEdit();
     dualPrintln("MIDI Channel Filter: ALL channels ENABLED");
 }
 
 void disableAllChannels() {
-    for (int i = 0; i < 16; ++i) enabledChannels[i] = false;
+    editConfig()->enabledChannels = 0;
+    finishEdit();
     dualPrintln("MIDI Channel Filter: ALL channels DISABLED");
 }
 
+// --- Per-Interface Channel Masks ---
+
+void setSourceChannelMask(MidiInterfaceType interface, uint16_t mask) {
+    if (interface < MIDI_INTERFACE_COUNT) {
+        editConfig()->sourceChannelMasks[interface] = mask;
+        finishEdit();
+    }
+}
+
+uint16_t getSourceChannelMask(MidiInterfaceType interface) {
+    return interface < MIDI_INTERFACE_COUNT ? viewConfig()->sourceChannelMasks[interface] : 0xFFFF;
+}
+
+void setDestChannelMask(MidiInterfaceType interface, uint16_t mask) {
+    if (interface < MIDI_INTERFACE_COUNT) {
+        editConfig()->destChannelMasks[interface] = mask;
+        finishEdit();
+    }
+}
+
+uint16_t getDestChannelMask(MidiInterfaceType interface) {
+    return interface < MIDI_INTERFACE_COUNT ? viewConfig()->destChannelMasks[interface] : 0xFFFF;
+}
+
 // --- Config Storage Helpers Implementation ---
 
 bool getMidiFilterState(int interface, int msgType) {
-    if (interface >= 0 && interface < MIDI_INTERFACE_COUNT && 
+    if (interface >= 0 && interface < MIDI_INTERFACE_COUNT &&
         msgType >= 0 && msgType < MIDI_MSG_COUNT) {
-        return midiFilters[interface][msgType];
+        return viewConfig()->sourceFilters[interface] & (1 << msgType);
     }
     return false;
 }
 
 void setMidiFilterState(int interface, int msgType, bool state) {
-    if (interface >= 0 && interface < MIDI_INTERFACE_COUNT && 
+    if (interface >= 0 && interface < MIDI_INTERFACE_COUNT &&
         msgType >= 0 && msgType < MIDI_MSG_COUNT) {
-        midiFilters[interface][msgType] = state;
+        setFilterBit(editConfig(1 << msgType)->sourceFilters, interface, msgType, state);
+        finishEdit();
     }
 }
 
 bool getMidiDestFilterState(int interface, int msgType) {
-    if (interface >= 0 && interface < MIDI_INTERFACE_COUNT && 
+    if (interface >= 0 && interface < MIDI_INTERFACE_COUNT &&
         msgType >= 0 && msgType < MIDI_MSG_COUNT) {
-        return midiDestFilters[interface][msgType];
+        return viewConfig()->destFilters[interface] & (1 << msgType);
     }
     return false;
 }
 
 void setMidiDestFilterState(int interface, int msgType, bool state) {
-    if (interface >= 0 && interface < MIDI_INTERFACE_COUNT && 
+    if (interface >= 0 && interface < MIDI_INTERFACE_COUNT &&
         msgType >= 0 && msgType < MIDI_MSG_COUNT) {
-        midiDestFilters[interface][msgType] = state;
+        setFilterBit(editConfig(1 << msgType)->destFilters, interface, msgType, state);
+        finishEdit();
     }
 }
 
 bool getChannelEnabledState(int channel) {
     if (channel >= 0 && channel < 16) {
-        return enabledChannels[channel];
+        return viewConfig()->enabledChannels & (1 << channel);
     }
     return false;
 }
 
 void setChannelEnabledState(int channel, bool state) {
     if (channel >= 0 && channel < 16) {
-        enabledChannels[channel] = state;
+        MidiFilterConfig *config = editConfig();
+        if (state) {
+            config->enabledChannels |= (1 << channel);
+        } else {
+            config->enabledChannels &= ~(1 << channel);
+        }
+        finishEdit();
     }
 }
@@ -73,8 +73,108 @@ void enableAllChannels();
 // Disable all channels
 void disableAllChannels();
 
+// --- Per-Interface Channel Masks ---
+// Bit n = channel n+1 passes. Applied on top of the global channel filter:
+// the source mask to messages received on an interface, the destination
+// mask to messages sent to it. Default 0xFFFF (all channels).
+void setSourceChannelMask(MidiInterfaceType interface, uint16_t mask);
+uint16_t getSourceChannelMask(MidiInterfaceType interface);
+void setDestChannelMask(MidiInterfaceType interface, uint16_t mask);
+uint16_t getDestChannelMask(MidiInterfaceType interface);
+
+// --- Compiled Routing Matrix ---
+// Every filter and channel setting above is folded into one table:
+// [source][message type][channel] -> router endpoints (MidiEndpointMask)
+// the message may reach. Source MIDI_INTERFACE_COUNT is internally
+// generated MIDI (IMU); channel 0 is used for SysEx, real-time and other
+// channel-less messages.
+#define MIDI_ROUTE_SOURCES (MIDI_INTERFACE_COUNT + 1)
+#define MIDI_ROUTE_CHANNELS 17
+
+// One complete filter configuration together with its compiled matrix
+typedef struct {
+    uint8_t sourceFilters[MIDI_INTERFACE_COUNT];      // Bit msgType set = blocked
+    uint8_t destFilters[MIDI_INTERFACE_COUNT];
+    uint16_t enabledChannels;                         // Bit n = channel n+1
+    uint16_t sourceChannelMasks[MIDI_INTERFACE_COUNT];
+    uint16_t destChannelMasks[MIDI_INTERFACE_COUNT];
+    uint16_t routes[MIDI_ROUTE_SOURCES][MIDI_MSG_COUNT][MIDI_ROUTE_CHANNELS];
+} MidiFilterConfig;
+
+// Published configuration. Replaced as a whole by commitMidiFilterUpdate();
+// never modified in place.
+extern MidiFilterConfig *volatile activeFilterConfig;
+
+inline uint16_t getMidiRoute(uint8_t source, MidiMsgType msgType, uint8_t channel) {
+    if (msgType == MIDI_MSG_SYSEX || msgType == MIDI_MSG_REALTIME || channel > 16) {
+        channel = 0;
+    }
+    return activeFilterConfig->routes[source][msgType][channel];
+}
+
+// --- Atomic Configuration Updates ---
+// Setters called between begin and commit only change a shadow copy; the
+// router keeps using the previous configuration until commit publishes
+// the new one in a single pointer swap. Setters called outside an update
+// are committed one by one. Core 0 only.
+void beginMidiFilterUpdate();
+void commitMidiFilterUpdate();
+void abortMidiFilterUpdate();
+
+// Core 1 wraps each pass of its loop in these, so a commit can tell when
+// core 1 no longer holds the previous configuration (RCU grace period)
+void beginMidiConfigRead();
+void endMidiConfigRead();
+
+// --- Presets ---
+// Complete filter configurations kept compiled in RAM (and in flash via
+// config.cpp). Selecting a preset is a single pointer swap, so it can be
+// done from the MIDI stream between two notes.
+#define MIDI_PRESET_SLOTS 4
+
+typedef enum {
+    MIDI_PRESET_CONTROL_PROGRAM_CHANGE = 0, // Program n selects slot n
+    MIDI_PRESET_CONTROL_CC                  // Value n of `cc` selects slot n
+} MidiPresetControlType;
+
+// Incoming message that selects a preset; channel 0 disables it
+typedef struct {
+    uint8_t channel;   // 0 = off, 1-16
+    uint8_t type;      // MidiPresetControlType
+    uint8_t cc;        // Controller number for MIDI_PRESET_CONTROL_CC
+} MidiPresetControl;
+
+// Copy the live configuration into a slot. Core 0 only.
+bool storeMidiPreset(uint8_t slot);
+// Make a stored slot live. On core 1, or while an update is open, the
+// switch is latched and applied by loopMidiPresets().
+bool selectMidiPreset(uint8_t slot);
+// Apply a latched preset switch. Call from loop().
+void loopMidiPresets();
+// Slot that is live, or -1 once the configuration was edited
+int8_t getActiveMidiPreset();
+bool isMidiPresetStored(uint8_t slot);
+
+// Persistence helpers (config.cpp). The routes of a loaded config are
+// recompiled, only the filter settings are used.
+const MidiFilterConfig *getMidiPresetConfig(uint8_t slot);
+void loadMidiPresetConfig(uint8_t slot, const MidiFilterConfig &config);
+void clearMidiPresets();
+
+MidiPresetControl getMidiPresetControl();
+void setMidiPresetControl(const MidiPresetControl &control);
+// Channel 0-16, a known type and cc 0-127; what every config writer checks
+// before setMidiPresetControl()
+bool isValidMidiPresetControl(const MidiPresetControl &control);
+
 // --- Config Storage Helpers ---
 
+// Whole filter settings at once; the routes of `settings` are ignored and
+// recompiled. Follows the same update rules as the single setters.
+const MidiFilterConfig *getMidiFilterConfig();
+void loadMidiFilterConfig(const MidiFilterConfig &settings);
+
+
 // Get/set filter state directly (used by config.cpp)
 bool getMidiFilterState(int interface, int msgType);
 void setMidiFilterState(int interface, int msgType, bool state);
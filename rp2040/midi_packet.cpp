@@ -0,0 +1,267 @@
+#include "midi_packet.h"
+
+// MIDI byte count per Code Index Number (USB-MIDI 1.0, table 4-1)
+static const uint8_t cinLength[16] = {
+    0, 0, 2, 3, 3, 1, 2, 3, 3, 3, 3, 3, 2, 2, 3, 1
+};
+
+uint8_t midiPacketLength(uint8_t cin) {
+    return cinLength[cin & 0x0F];
+}
+
+uint8_t midiRealTimeByte(midi::MidiType type) {
+    switch (type) {
+        case midi::Clock:
+            return 0xF8;
+        case midi::Start:
+            return 0xFA;
+        case midi::Continue:
+            return 0xFB;
+        case midi::Stop:
+            return 0xFC;
+        default:
+            return 0xF8;
+    }
+}
+
+static bool midiMessageToPacket(const MidiMessage &msg, uint8_t packet[4]) {
+    uint8_t ch = (msg.channel - 1) & 0x0F;
+
+    packet[0] = 0;
+    packet[1] = 0;
+    packet[2] = 0;
+    packet[3] = 0;
+
+    switch (msg.type) {
+        case MIDI_MSG_NOTE:
+            if (msg.subType == 1) {
+                packet[0] = 0x08;
+                packet[1] = 0x80 | ch;
+            } else {
+                packet[0] = 0x09;
+                packet[1] = 0x90 | ch;
+            }
+            packet[2] = msg.data1 & 0x7F;
+            packet[3] = msg.data2 & 0x7F;
+            return true;
+        case MIDI_MSG_POLY_AFTERTOUCH:
+            packet[0] = 0x0A;
+            packet[1] = 0xA0 | ch;
+            packet[2] = msg.data1 & 0x7F;
+            packet[3] = msg.data2 & 0x7F;
+            return true;
+        case MIDI_MSG_CONTROL_CHANGE:
+            packet[0] = 0x0B;
+            packet[1] = 0xB0 | ch;
+            packet[2] = msg.data1 & 0x7F;
+            packet[3] = msg.data2 & 0x7F;
+            return true;
+        case MIDI_MSG_PROGRAM_CHANGE:
+            packet[0] = 0x0C;
+            packet[1] = 0xC0 | ch;
+            packet[2] = msg.data1 & 0x7F;
+            return true;
+        case MIDI_MSG_CHANNEL_AFTERTOUCH:
+            packet[0] = 0x0D;
+            packet[1] = 0xD0 | ch;
+            packet[2] = msg.data1 & 0x7F;
+            return true;
+        case MIDI_MSG_PITCH_BEND: {
+            int bend = msg.pitchBend + 8192; // Convert to unsigned 14-bit value
+            packet[0] = 0x0E;
+            packet[1] = 0xE0 | ch;
+            packet[2] = bend & 0x7F;
+            packet[3] = (bend >> 7) & 0x7F;
+            return true;
+        }
+        case MIDI_MSG_REALTIME:
+            packet[0] = 0x0F;
+            packet[1] = midiRealTimeByte(msg.rtType);
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool encodeMidiMessage(const MidiMessage &msg, EncodedMidiMessage &encoded) {
+    encoded.sysexData = nullptr;
+    encoded.sysexSize = 0;
+
+    if (msg.type == MIDI_MSG_SYSEX) {
+        if (msg.sysexData == nullptr || msg.sysexSize == 0) {
+            return false;
+        }
+        memset(encoded.packet, 0, sizeof(encoded.packet));
+        encoded.length = 0;
+        encoded.sysexData = msg.sysexData;
+        encoded.sysexSize = msg.sysexSize;
+        return true;
+    }
+
+    if (!midiMessageToPacket(msg, encoded.packet)) {
+        return false;
+    }
+    encoded.length = midiPacketLength(encoded.packet[0]);
+    return true;
+}
+
+void encodePacket(const uint8_t packet[4], EncodedMidiMessage &encoded) {
+    memcpy(encoded.packet, packet, sizeof(encoded.packet));
+    encoded.length = midiPacketLength(packet[0]);
+    encoded.sysexData = nullptr;
+    encoded.sysexSize = 0;
+}
+
+bool decodeMidiPacket(uint8_t packet[4], MidiMessage &msg) {
+    uint8_t cin = packet[0] & 0x0F;
+    uint8_t status = packet[1];
+
+    msg = {};
+    msg.channel = (status & 0x0F) + 1;
+    msg.data1 = packet[2];
+    msg.data2 = packet[3];
+
+    switch (cin) {
+        case 0x8:
+        case 0x9:
+            msg.type = MIDI_MSG_NOTE;
+            // Note On with velocity 0 is a Note Off
+            msg.subType = (cin == 0x8 || packet[3] == 0) ? 1 : 0;
+            return true;
+        case 0xA:
+            msg.type = MIDI_MSG_POLY_AFTERTOUCH;
+            return true;
+        case 0xB:
+            msg.type = MIDI_MSG_CONTROL_CHANGE;
+            return true;
+        case 0xC:
+            msg.type = MIDI_MSG_PROGRAM_CHANGE;
+            msg.data2 = 0;
+            return true;
+        case 0xD:
+            msg.type = MIDI_MSG_CHANNEL_AFTERTOUCH;
+            msg.data2 = 0;
+            return true;
+        case 0xE:
+            msg.type = MIDI_MSG_PITCH_BEND;
+            msg.pitchBend = ((packet[3] << 7) | packet[2]) - 8192;
+            msg.data1 = 0;
+            msg.data2 = 0;
+            return true;
+        case 0x5:
+            if (status != 0xF7) {
+                return false; // Single-byte system common (e.g. Tune Request)
+            }
+            // fall through
+        case 0x4:
+        case 0x6:
+        case 0x7:
+            msg.type = MIDI_MSG_SYSEX;
+            msg.channel = 0;
+            msg.data1 = 0;
+            msg.data2 = 0;
+            msg.sysexData = &packet[1];
+            msg.sysexSize = midiPacketLength(cin);
+            return true;
+        case 0xF:
+            if (status != 0xF8 && status != 0xFA && status != 0xFB && status != 0xFC) {
+                return false;
+            }
+            msg.type = MIDI_MSG_REALTIME;
+            msg.channel = 0;
+            msg.data1 = 0;
+            msg.data2 = 0;
+            msg.rtType = static_cast<midi::MidiType>(status);
+            return true;
+        default:
+            return false;
+    }
+}
+
+void midiSysExEncoderBegin(MidiSysExEncoder &encoder, const byte *data, unsigned size) {
+    encoder.data = data;
+    encoder.size = size;
+    encoder.pos = 0;
+}
+
+bool midiSysExEncoderNext(MidiSysExEncoder &encoder, uint8_t packet[4]) {
+    if (encoder.data == nullptr || encoder.pos >= encoder.size) {
+        return false;
+    }
+
+    const byte *p = encoder.data + encoder.pos;
+    unsigned remaining = encoder.size - encoder.pos;
+    unsigned take = remaining < 3 ? remaining : 3;
+
+    packet[1] = 0;
+    packet[2] = 0;
+    packet[3] = 0;
+
+    // A chunk holding the terminating F7 ends the message (CIN 0x5/0x6/0x7)
+    for (unsigned i = 0; i < take; i++) {
+        packet[i + 1] = p[i];
+        if (p[i] == 0xF7) {
+            packet[0] = 0x05 + i;
+            encoder.pos += i + 1;
+            return true;
+        }
+    }
+
+    if (take == 3) {
+        packet[0] = 0x04; // SysEx starts or continues
+        encoder.pos += 3;
+        return true;
+    }
+
+    // Trailing bytes of an unterminated fragment go out one per packet
+    packet[0] = 0x0F;
+    packet[2] = 0;
+    encoder.pos += 1;
+    return true;
+}
+
+unsigned midiSysExPacketCount(const byte *data, unsigned size) {
+    MidiSysExEncoder encoder;
+    uint8_t packet[4];
+    unsigned count = 0;
+
+    midiSysExEncoderBegin(encoder, data, size);
+    while (midiSysExEncoderNext(encoder, packet)) {
+        count++;
+    }
+    return count;
+}
+
+uint32_t midiCoalesceKey(const uint8_t packet[4]) {
+    uint8_t status = packet[1];
+    if ((packet[0] & 0x0F) != (status >> 4)) {
+        return 0; // Not a channel message packet
+    }
+    uint32_t key = ((uint32_t)(packet[0] & 0xF0) << 16) | ((uint32_t)status << 8);
+    switch (status & 0xF0) {
+        case 0xA0:
+            return key | packet[2];
+        case 0xB0: {
+            uint8_t cc = packet[2];
+            if (cc == 0 || cc == 6 || (cc >= 32 && cc <= 63) || (cc >= 96 && cc <= 101) || cc >= 120) {
+                return 0;
+            }
+            return key | cc;
+        }
+        case 0xD0:
+        case 0xE0:
+            return key;
+        default:
+            return 0;
+    }
+}
+
+bool midiIsControllerLsbOf(const uint8_t lsb[4], const uint8_t msb[4]) {
+    return (msb[1] & 0xF0) == 0xB0 && (msb[0] & 0x0F) == 0xB && msb[2] < 32 &&
+           lsb[0] == msb[0] && lsb[1] == msb[1] && lsb[2] == msb[2] + 32;
+}
+
+bool midiIsPriorityPacket(const uint8_t packet[4]) {
+    uint8_t cin = packet[0] & 0x0F;
+    return cin == 0x8 || cin == 0x9 || (cin == 0xF && packet[1] >= 0xF8);
+}
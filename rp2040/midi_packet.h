@@ -0,0 +1,78 @@
+#ifndef MIDI_PACKET_H
+#define MIDI_PACKET_H
+
+#include <Arduino.h>
+#include <MIDI.h>
+#include "midi_router.h"
+
+// USB-MIDI 1.0 event packet helpers.
+// packet[0] = cable number (high nibble) | Code Index Number (low nibble)
+// packet[1..3] = MIDI bytes, zero padded
+
+// Number of MIDI bytes carried by a packet with the given CIN
+uint8_t midiPacketLength(uint8_t cin);
+
+// Status byte for a real-time message type
+uint8_t midiRealTimeByte(midi::MidiType type);
+
+// A message encoded once by the router and handed to every destination.
+// Non-SysEx messages are a single canonical packet (cable 0) plus the raw
+// byte count in packet[1..3]. SysEx keeps a pointer to the complete byte
+// buffer so each sink can stream it in its own framing.
+typedef struct {
+    uint8_t packet[4];
+    uint8_t length;
+    const byte *sysexData;
+    unsigned sysexSize;
+} EncodedMidiMessage;
+
+// Per-interface output function consuming an encoded message for one of
+// the interface's endpoints (e.g. a USB host port)
+typedef void (*MidiPacketSink)(uint8_t endpoint, const EncodedMidiMessage &encoded);
+
+// Encode a router message. Returns false for unknown message types.
+bool encodeMidiMessage(const MidiMessage &msg, EncodedMidiMessage &encoded);
+
+// Wrap a single already encoded packet (e.g. popped from a queue)
+void encodePacket(const uint8_t packet[4], EncodedMidiMessage &encoded);
+
+// Decode a received packet into a router message. SysEx fragments
+// (CIN 0x4-0x7) point sysexData into packet[1..3]. Returns false for
+// packets the router does not carry (system common, reserved CINs).
+bool decodeMidiPacket(uint8_t packet[4], MidiMessage &msg);
+
+// Split a SysEx byte buffer into CIN 0x4-0x7 packets.
+// Usage:
+//   MidiSysExEncoder enc;
+//   midiSysExEncoderBegin(enc, data, size);
+//   while (midiSysExEncoderNext(enc, packet)) { ... }
+typedef struct {
+    const byte *data;
+    unsigned size;
+    unsigned pos;
+} MidiSysExEncoder;
+
+void midiSysExEncoderBegin(MidiSysExEncoder &encoder, const byte *data, unsigned size);
+bool midiSysExEncoderNext(MidiSysExEncoder &encoder, uint8_t packet[4]);
+unsigned midiSysExPacketCount(const byte *data, unsigned size);
+
+// Congested output queues keep only the latest value of continuous
+// controls: a new packet with the same key overwrites the queued one.
+// Keys cover (cable, status, controller) for CC and poly aftertouch and
+// (cable, status) for channel aftertouch and pitch bend. Returns 0 for
+// packets that must all be delivered: notes, real-time, SysEx, program
+// change, and CCs whose order or count matters (bank select, data entry
+// and (N)RPN, channel mode, and the LSBs 32-63 of 14-bit controllers).
+uint32_t midiCoalesceKey(const uint8_t packet[4]);
+
+// True if `lsb` is the CC 32-63 that pairs with the 14-bit controller MSB
+// (CC 0-31) in `msb`, on the same cable and channel. While such an LSB is
+// queued, the MSB must not be coalesced either, or the receiver would see
+// a new MSB with a stale LSB.
+bool midiIsControllerLsbOf(const uint8_t lsb[4], const uint8_t msb[4]);
+
+// Notes (on and off) and real-time: output queues keep room for these
+// that other traffic cannot take
+bool midiIsPriorityPacket(const uint8_t packet[4]);
+
+#endif // MIDI_PACKET_H
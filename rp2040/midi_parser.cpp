@@ -0,0 +1,201 @@
+#include "midi_parser.h"
+#include <string.h>
+
+static_assert(MIDI_PARSER_SYSEX_CHUNK % 3 == 0, "MIDI_PARSER_SYSEX_CHUNK must be a multiple of 3");
+
+typedef enum {
+    STATE_IDLE = 0,   // No status: power-up, after system common or SysEx
+    STATE_STATUS,     // Status known, waiting for its first data byte
+    STATE_DATA,       // First of two data bytes received
+    STATE_SYSEX,      // Between F0 and F7
+    STATE_COUNT
+} ParserState;
+
+typedef enum {
+    CLASS_DATA = 0,     // 00-7F
+    CLASS_CHANNEL,      // 80-EF
+    CLASS_SYSEX_START,  // F0
+    CLASS_COMMON,       // F1-F6
+    CLASS_SYSEX_END,    // F7
+    CLASS_REALTIME,     // F8-FF
+    CLASS_COUNT
+} ByteClass;
+
+typedef enum {
+    ACTION_IGNORE = 0,
+    ACTION_STRAY,         // Data without status
+    ACTION_STATUS,        // Start a channel or system common message
+    ACTION_DATA,          // Data byte of the current message
+    ACTION_REALTIME,
+    ACTION_SYSEX_START,
+    ACTION_SYSEX_DATA,
+    ACTION_SYSEX_END,
+    ACTION_SYSEX_ABORT    // Status byte inside SysEx: close it, then ACTION_STATUS
+} ParserAction;
+
+static const uint8_t transitions[STATE_COUNT][CLASS_COUNT] = {
+    //                 DATA                CHANNEL             F0                   F1-F6               F7                F8-FF
+    /* IDLE   */ { ACTION_STRAY,      ACTION_STATUS,      ACTION_SYSEX_START,  ACTION_STATUS,      ACTION_IGNORE,    ACTION_REALTIME },
+    /* STATUS */ { ACTION_DATA,       ACTION_STATUS,      ACTION_SYSEX_START,  ACTION_STATUS,      ACTION_IGNORE,    ACTION_REALTIME },
+    /* DATA   */ { ACTION_DATA,       ACTION_STATUS,      ACTION_SYSEX_START,  ACTION_STATUS,      ACTION_IGNORE,    ACTION_REALTIME },
+    /* SYSEX  */ { ACTION_SYSEX_DATA, ACTION_SYSEX_ABORT, ACTION_SYSEX_START,  ACTION_SYSEX_ABORT, ACTION_SYSEX_END, ACTION_REALTIME },
+};
+
+// Data bytes per status: channel messages by status >> 4, system common
+// by status & 0x07 (F4, F5 undefined)
+static const uint8_t dataLengths[16] = {
+    0, 0, 0, 0, 0, 0, 0, 0,
+    2, 2, 2, 2, 1, 1, 2, 0   // 80 90 A0 B0 C0 D0 E0 F0
+};
+static const uint8_t commonDataLengths[8] = {
+    0, 1, 2, 1, 0, 0, 0, 0   // F0 F1 F2 F3 F4 F5 F6 F7
+};
+
+static ByteClass classify(uint8_t value) {
+    if (value < 0x80) {
+        return CLASS_DATA;
+    }
+    if (value < 0xF0) {
+        return CLASS_CHANNEL;
+    }
+    if (value == 0xF0) {
+        return CLASS_SYSEX_START;
+    }
+    if (value < 0xF7) {
+        return CLASS_COMMON;
+    }
+    return value == 0xF7 ? CLASS_SYSEX_END : CLASS_REALTIME;
+}
+
+static void emitPacket(MidiParser &parser, uint8_t cin, uint8_t status, uint8_t data1, uint8_t data2) {
+    uint8_t packet[4] = { cin, status, data1, data2 };
+    parser.stats.messages++;
+    parser.onPacket(packet);
+}
+
+// Current message complete: emit it and keep running status for channel
+// messages only
+static void emitMessage(MidiParser &parser) {
+    uint8_t status = parser.status;
+    uint8_t data1 = parser.expected > 0 ? parser.data[0] : 0;
+    uint8_t data2 = parser.expected > 1 ? parser.data[1] : 0;
+    parser.count = 0;
+
+    if (status < 0xF0) {
+        emitPacket(parser, status >> 4, status, data1, data2);
+        parser.state = STATE_STATUS;
+        return;
+    }
+    // System common: CIN 0x2/0x3 by data length, 0x5 for single bytes
+    static const uint8_t commonCins[3] = { 0x5, 0x2, 0x3 };
+    emitPacket(parser, commonCins[parser.expected], status, data1, data2);
+    parser.status = 0;
+    parser.state = STATE_IDLE;
+}
+
+static void startMessage(MidiParser &parser, uint8_t status) {
+    if (parser.state == STATE_DATA) {
+        parser.stats.truncated++;
+    }
+    parser.status = status;
+    parser.count = 0;
+    if (status < 0xF0) {
+        parser.expected = dataLengths[status >> 4];
+        parser.state = STATE_STATUS;
+        return;
+    }
+    parser.expected = commonDataLengths[status & 0x07];
+    if (status == 0xF4 || status == 0xF5) {
+        parser.status = 0; // Undefined: ignored, but it still ends running status
+        parser.state = STATE_IDLE;
+        return;
+    }
+    parser.state = STATE_STATUS;
+    if (parser.expected == 0) {
+        emitMessage(parser);
+    }
+}
+
+static void flushSysEx(MidiParser &parser, unsigned count) {
+    if (count == 0) {
+        return;
+    }
+    parser.stats.sysexChunks++;
+    parser.onSysEx(parser.sysex, count);
+    parser.sysexLength -= count;
+    memmove(parser.sysex, parser.sysex + count, parser.sysexLength);
+}
+
+static void appendSysEx(MidiParser &parser, uint8_t value) {
+    parser.sysex[parser.sysexLength++] = value;
+    if (parser.sysexLength == sizeof(parser.sysex)) {
+        flushSysEx(parser, parser.sysexLength);
+    }
+}
+
+static void endSysEx(MidiParser &parser) {
+    appendSysEx(parser, 0xF7);
+    flushSysEx(parser, parser.sysexLength);
+    parser.status = 0;
+    parser.state = STATE_IDLE;
+}
+
+void midiParserInit(MidiParser &parser, MidiParserPacketHandler onPacket, MidiParserSysExHandler onSysEx) {
+    memset(&parser, 0, sizeof(parser));
+    parser.state = STATE_IDLE;
+    parser.onPacket = onPacket;
+    parser.onSysEx = onSysEx;
+}
+
+void midiParserFeed(MidiParser &parser, uint8_t value) {
+    switch (transitions[parser.state][classify(value)]) {
+        case ACTION_IGNORE:
+            break;
+        case ACTION_STRAY:
+            parser.stats.stray++;
+            break;
+        case ACTION_STATUS:
+            startMessage(parser, value);
+            break;
+        case ACTION_DATA:
+            parser.data[parser.count++] = value;
+            if (parser.count == parser.expected) {
+                emitMessage(parser);
+            } else {
+                parser.state = STATE_DATA;
+            }
+            break;
+        case ACTION_REALTIME:
+            emitPacket(parser, 0xF, value, 0, 0);
+            break;
+        case ACTION_SYSEX_START:
+            if (parser.state == STATE_SYSEX) {
+                endSysEx(parser); // Unterminated dump followed by a new one
+            } else if (parser.state == STATE_DATA) {
+                parser.stats.truncated++;
+            }
+            parser.status = 0;
+            parser.count = 0;
+            parser.state = STATE_SYSEX;
+            appendSysEx(parser, value);
+            break;
+        case ACTION_SYSEX_DATA:
+            appendSysEx(parser, value);
+            break;
+        case ACTION_SYSEX_END:
+            appendSysEx(parser, value);
+            flushSysEx(parser, parser.sysexLength);
+            parser.state = STATE_IDLE;
+            break;
+        case ACTION_SYSEX_ABORT:
+            endSysEx(parser);
+            startMessage(parser, value);
+            break;
+    }
+}
+
+void midiParserFlushSysEx(MidiParser &parser) {
+    if (parser.state == STATE_SYSEX && parser.sysexLength >= 3) {
+        flushSysEx(parser, parser.sysexLength - (parser.sysexLength % 3));
+    }
+}
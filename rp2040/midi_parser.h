@@ -0,0 +1,57 @@
+#ifndef MIDI_PARSER_H
+#define MIDI_PARSER_H
+
+// MIDI 1.0 byte-stream parser for the DIN input. A small state table turns
+// the byte stream into USB-MIDI event packets (midi_packet.h layout, cable
+// 0) and streamed SysEx chunks:
+//   - running status, cancelled by system common messages and SysEx
+//   - real-time bytes anywhere, including between the bytes of a message
+//     or inside SysEx, emitted at once without disturbing the message
+//   - system common messages (F1, F2, F3, F6)
+//   - SysEx forwarded in chunks as it arrives; a status byte other than
+//     real-time or F7 ends an unterminated dump with an added F7
+// Only depends on the C library so it can be built on the host.
+
+#include <stdint.h>
+#include <stddef.h>
+
+// SysEx bytes forwarded per chunk; a multiple of 3 so every chunk maps
+// onto whole USB-MIDI packets
+#ifndef MIDI_PARSER_SYSEX_CHUNK
+#define MIDI_PARSER_SYSEX_CHUNK 48
+#endif
+
+// Complete message other than SysEx, as a USB-MIDI event packet
+typedef void (*MidiParserPacketHandler)(uint8_t packet[4]);
+// SysEx chunk: the first starts with F0, the last ends with F7
+typedef void (*MidiParserSysExHandler)(uint8_t *data, unsigned size);
+
+typedef struct {
+    uint32_t messages;    // Packets emitted
+    uint32_t sysexChunks;
+    uint32_t stray;       // Data bytes without a status to belong to
+    uint32_t truncated;   // Messages cut short by a new status byte
+} MidiParserStats;
+
+typedef struct {
+    uint8_t state;
+    uint8_t status;       // Status of the message being collected, 0 if none
+    uint8_t expected;     // Data bytes the status takes
+    uint8_t count;        // Data bytes collected
+    uint8_t data[2];
+    uint8_t sysex[MIDI_PARSER_SYSEX_CHUNK];
+    unsigned sysexLength;
+    MidiParserPacketHandler onPacket;
+    MidiParserSysExHandler onSysEx;
+    MidiParserStats stats;
+} MidiParser;
+
+void midiParserInit(MidiParser &parser, MidiParserPacketHandler onPacket, MidiParserSysExHandler onSysEx);
+void midiParserFeed(MidiParser &parser, uint8_t value);
+
+// Forward the SysEx bytes collected so far in whole 3-byte groups. Call
+// when the input has gone idle, so receivers are not kept waiting for a
+// chunk to fill up.
+void midiParserFlushSysEx(MidiParser &parser);
+
+#endif // MIDI_PARSER_H
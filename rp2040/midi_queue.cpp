@@ -0,0 +1,69 @@
+#include "midi_queue.h"
+#include "hardware/sync.h"
+
+#define MIDI_QUEUE_MASK (MIDI_QUEUE_CAPACITY - 1)
+
+static_assert((MIDI_QUEUE_CAPACITY & MIDI_QUEUE_MASK) == 0, "MIDI_QUEUE_CAPACITY must be a power of two");
+
+bool midiQueuePush(MidiQueue &queue, const MidiQueueItem &item) {
+    uint16_t head = queue.head;
+    uint16_t next = (head + 1) & MIDI_QUEUE_MASK;
+    if (next == queue.tail) {
+        queue.drops++;
+        return false;
+    }
+
+    queue.items[head] = item;
+    // Item contents must be visible to the other core before the new head is
+    __mem_fence_release();
+    queue.head = next;
+
+    uint16_t depth = (next - queue.tail) & MIDI_QUEUE_MASK;
+    if (depth > queue.highWater) {
+        queue.highWater = depth;
+    }
+    return true;
+}
+
+uint16_t midiQueueSpace(const MidiQueue &queue) {
+    uint16_t depth = (queue.head - queue.tail) & MIDI_QUEUE_MASK;
+    return (MIDI_QUEUE_CAPACITY - 1) - depth;
+}
+
+void midiQueueCountDrops(MidiQueue &queue, uint32_t count) {
+    queue.drops += count;
+}
+
+bool midiQueuePeek(const MidiQueue &queue, MidiQueueItem &item) {
+    uint16_t tail = queue.tail;
+    if (tail == queue.head) {
+        return false;
+    }
+
+    __mem_fence_acquire();
+    item = queue.items[tail];
+    return true;
+}
+
+bool midiQueuePop(MidiQueue &queue, MidiQueueItem &item) {
+    uint16_t tail = queue.tail;
+    if (tail == queue.head) {
+        return false;
+    }
+
+    __mem_fence_acquire();
+    item = queue.items[tail];
+    // Finish reading the slot before handing it back to the producer
+    __mem_fence_release();
+    queue.tail = (tail + 1) & MIDI_QUEUE_MASK;
+    return true;
+}
+
+MidiQueueStats getMidiQueueStats(const MidiQueue &queue) {
+    MidiQueueStats stats;
+    stats.depth = (queue.head - queue.tail) & MIDI_QUEUE_MASK;
+    stats.highWater = queue.highWater;
+    stats.drops = queue.drops;
+    stats.coalesced = 0;
+    return stats;
+}
@@ -0,0 +1,49 @@
+#ifndef MIDI_QUEUE_H
+#define MIDI_QUEUE_H
+
+#include <Arduino.h>
+
+// Lock-free single-producer/single-consumer ring of USB-MIDI event packets.
+// One queue exists per direction between the two cores: the producer core
+// only touches `head`, the consumer core only touches `tail`.
+
+// Must be a power of two. Sized for a whole host SysEx dump to every core 0
+// output at once (ROUTER_SYSEX_BURST_PACKETS, checked in midi_router.cpp).
+#define MIDI_QUEUE_CAPACITY 1024
+
+// Compact record that crosses cores: one USB-MIDI event packet, the router
+// endpoint that should emit it and the endpoint it came from.
+typedef struct {
+    uint8_t packet[4];
+    uint8_t dest;
+    uint8_t source;
+} MidiQueueItem;
+
+typedef struct {
+    MidiQueueItem items[MIDI_QUEUE_CAPACITY];
+    volatile uint16_t head;       // Next slot to write (producer owned)
+    volatile uint16_t tail;       // Next slot to read (consumer owned)
+    volatile uint16_t highWater;  // Deepest fill level seen (producer owned)
+    volatile uint32_t drops;      // Items rejected because the queue was full (producer owned)
+} MidiQueue;
+
+typedef struct {
+    uint16_t depth;
+    uint16_t highWater;
+    uint32_t drops;
+    uint32_t coalesced;   // Packets merged into a queued one (output queues under congestion)
+} MidiQueueStats;
+
+// Producer side
+bool midiQueuePush(MidiQueue &queue, const MidiQueueItem &item);
+uint16_t midiQueueSpace(const MidiQueue &queue);
+void midiQueueCountDrops(MidiQueue &queue, uint32_t count);
+
+// Consumer side
+bool midiQueuePeek(const MidiQueue &queue, MidiQueueItem &item);
+bool midiQueuePop(MidiQueue &queue, MidiQueueItem &item);
+
+// Safe to call from either core
+MidiQueueStats getMidiQueueStats(const MidiQueue &queue);
+
+#endif // MIDI_QUEUE_H
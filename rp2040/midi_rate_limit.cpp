@@ -0,0 +1,194 @@
+#include "midi_rate_limit.h"
+#include "sysex_assembler.h"
+
+// Tokens are kept in thousandths, so a refill of `rate` per second adds
+// exactly `rate` per elapsed millisecond
+#define TOKEN_SCALE 1000
+
+typedef struct {
+    uint32_t tokens[MIDI_RATE_CLASS_COUNT];
+    uint32_t refilledAt[MIDI_RATE_CLASS_COUNT];   // millis() of the last refill
+    uint8_t primed;                               // Bit per class: bucket filled once
+    bool droppingSysEx;                           // Rest of the current dump is dropped
+    uint32_t windowStart;
+    uint32_t windowDrops;
+    uint32_t quarantineUntil;
+    uint32_t quarantineMs;                        // Length of the last quarantine
+    volatile MidiRateStats stats;
+} SourceLimiter;
+
+// Limits are written by core 0 and read by both cores; each field is a
+// single word
+static volatile MidiRateLimit limits[MIDI_RATE_CLASS_COUNT] = {
+    MIDI_RATE_NOTE_DEFAULT,
+    MIDI_RATE_CONTROL_DEFAULT,
+    MIDI_RATE_SYSEX_DEFAULT,
+    MIDI_RATE_REALTIME_DEFAULT
+};
+
+// Indexed by source endpoint
+static SourceLimiter sources[MIDI_ENDPOINT_COUNT];
+
+// Returns false for traffic that is never limited
+static bool rateClass(const MidiMessage &msg, MidiRateClass &cls) {
+    switch (msg.type) {
+        case MIDI_MSG_NOTE:
+            cls = MIDI_RATE_CLASS_NOTE;
+            return msg.subType == 0 && msg.data2 > 0; // Note offs always pass
+        case MIDI_MSG_SYSEX:
+            cls = MIDI_RATE_CLASS_SYSEX;
+            return true;
+        case MIDI_MSG_REALTIME:
+            cls = MIDI_RATE_CLASS_REALTIME;
+            return msg.rtType != midi::Clock;
+        default:
+            cls = MIDI_RATE_CLASS_CONTROL;
+            return true;
+    }
+}
+
+static void refill(SourceLimiter &src, MidiRateClass cls, uint32_t now) {
+    uint32_t rate = limits[cls].rate;
+    uint32_t capacity = limits[cls].burst * TOKEN_SCALE;
+    uint32_t elapsed = now - src.refilledAt[cls];
+    src.refilledAt[cls] = now;
+
+    if (!(src.primed & (1 << cls))) {
+        src.primed |= 1 << cls;
+        src.tokens[cls] = capacity;
+        return;
+    }
+    uint64_t tokens = src.tokens[cls] + (uint64_t)elapsed * rate;
+    src.tokens[cls] = tokens > capacity ? capacity : (uint32_t)tokens;
+}
+
+// Take `cost` tokens if the bucket holds them. A message costing more than
+// the whole bucket (a SysEx chunk longer than the burst) passes when the
+// bucket is full and empties it, so it is slowed down, not shut out.
+static bool take(SourceLimiter &src, MidiRateClass cls, uint32_t cost, uint32_t now) {
+    if (limits[cls].rate == 0) {
+        return true;
+    }
+    refill(src, cls, now);
+    uint32_t price = cost * TOKEN_SCALE;
+    uint32_t capacity = limits[cls].burst * TOKEN_SCALE;
+    if (price > capacity && src.tokens[cls] == capacity) {
+        src.tokens[cls] = 0;
+        return true;
+    }
+    if (src.tokens[cls] < price) {
+        return false;
+    }
+    src.tokens[cls] -= price;
+    return true;
+}
+
+// Charge a message that passes regardless (the rest of an admitted dump)
+static void charge(SourceLimiter &src, MidiRateClass cls, uint32_t cost, uint32_t now) {
+    if (limits[cls].rate == 0) {
+        return;
+    }
+    refill(src, cls, now);
+    uint32_t price = cost * TOKEN_SCALE;
+    src.tokens[cls] = src.tokens[cls] > price ? src.tokens[cls] - price : 0;
+}
+
+static void quarantine(SourceLimiter &src, uint32_t now) {
+    // A repeat offence within probation doubles the previous quarantine
+    bool repeat = src.stats.quarantines > 0 && now - src.quarantineUntil < MIDI_RATE_PROBATION_MS;
+    uint32_t duration = repeat ? src.quarantineMs * 2 : MIDI_RATE_QUARANTINE_MS;
+    if (duration > MIDI_RATE_QUARANTINE_MAX_MS) {
+        duration = MIDI_RATE_QUARANTINE_MAX_MS;
+    }
+    src.quarantineMs = duration;
+    src.quarantineUntil = now + duration;
+    src.stats.quarantined = true;
+    src.stats.quarantines++;
+}
+
+static void countDrop(SourceLimiter &src, uint32_t now) {
+    src.stats.limited++;
+    if (now - src.windowStart > MIDI_RATE_QUARANTINE_WINDOW_MS) {
+        src.windowStart = now;
+        src.windowDrops = 0;
+    }
+    if (++src.windowDrops >= MIDI_RATE_QUARANTINE_DROPS) {
+        src.windowDrops = 0;
+        quarantine(src, now);
+    }
+}
+
+bool midiRateLimitAllows(uint8_t endpoint, const MidiMessage &msg) {
+    MidiRateClass cls;
+    if (endpoint >= MIDI_ENDPOINT_COUNT || !rateClass(msg, cls)) {
+        return true;
+    }
+    SourceLimiter &src = sources[endpoint];
+    uint32_t now = millis();
+
+    // A dump is admitted or dropped as a whole, decided at its F0, so
+    // receivers and the router's SysEx lock never see half of one
+    bool isSysEx = cls == MIDI_RATE_CLASS_SYSEX && msg.sysexData != nullptr && msg.sysexSize > 0;
+    bool sysexEnds = isSysEx && msg.sysexData[msg.sysexSize - 1] == 0xF7;
+    if (isSysEx && msg.sysexData[0] != 0xF0) {
+        if (src.droppingSysEx) {
+            src.droppingSysEx = !sysexEnds;
+            return false;
+        }
+        charge(src, cls, msg.sysexSize, now);
+        return true;
+    }
+
+    if (src.stats.quarantined) {
+        if ((int32_t)(now - src.quarantineUntil) < 0) {
+            src.stats.quarantineDrops++;
+            src.droppingSysEx = isSysEx && !sysexEnds;
+            return false;
+        }
+        src.stats.quarantined = false;
+    }
+
+    uint32_t cost = isSysEx ? msg.sysexSize : 1;
+    bool allowed = take(src, cls, cost, now);
+    src.droppingSysEx = isSysEx && !allowed && !sysexEnds;
+    if (!allowed) {
+        countDrop(src, now);
+    }
+    return allowed;
+}
+
+bool setMidiRateLimit(MidiRateClass cls, const MidiRateLimit &limit) {
+    if (cls >= MIDI_RATE_CLASS_COUNT || limit.rate > MIDI_RATE_MAX ||
+        (limit.rate > 0 && (limit.burst == 0 || limit.burst > MIDI_RATE_MAX))) {
+        return false;
+    }
+    // A SysEx bucket must hold a whole reassembled message (USB host dumps
+    // arrive as one message of up to SYSEX_MAX_LENGTH bytes)
+    if (cls == MIDI_RATE_CLASS_SYSEX && limit.rate > 0 && limit.burst < SYSEX_MAX_LENGTH) {
+        return false;
+    }
+    limits[cls].rate = limit.rate;
+    limits[cls].burst = limit.burst;
+    return true;
+}
+
+MidiRateLimit getMidiRateLimit(MidiRateClass cls) {
+    MidiRateLimit limit = {0, 0};
+    if (cls < MIDI_RATE_CLASS_COUNT) {
+        limit.rate = limits[cls].rate;
+        limit.burst = limits[cls].burst;
+    }
+    return limit;
+}
+
+MidiRateStats getMidiRateStats(uint8_t endpoint) {
+    MidiRateStats stats = {0, 0, 0, false};
+    if (endpoint < MIDI_ENDPOINT_COUNT) {
+        const volatile MidiRateStats &src = sources[endpoint].stats;
+        stats.limited = src.limited;
+        stats.quarantines = src.quarantines;
+        stats.quarantineDrops = src.quarantineDrops;
+        stats.quarantined = src.quarantined;
+    }
+    return stats;
+}
@@ -0,0 +1,68 @@
+#ifndef MIDI_RATE_LIMIT_H
+#define MIDI_RATE_LIMIT_H
+
+#include <Arduino.h>
+#include "midi_router.h"
+
+// Flood protection for incoming MIDI, checked by routeMidiMessage() before
+// any other work. Every source endpoint has a token bucket per message
+// class; a message that finds its bucket empty is dropped. A source that
+// keeps overrunning its buckets is quarantined: all its limited traffic is
+// dropped for a while, doubling on repeat offences, until it behaves for
+// MIDI_RATE_PROBATION_MS. MIDI Clock and note offs are never limited, so
+// tempo and hanging notes are unaffected. Internally generated MIDI (IMU)
+// is not limited. Nothing is printed from here (it runs on core 1's
+// receive path); quarantines show up in the STATUS counters.
+//
+// Each endpoint's state is only touched by the core that receives from it;
+// the limits can be changed from core 0 at any time.
+
+typedef enum {
+    MIDI_RATE_CLASS_NOTE = 0,     // Note on
+    MIDI_RATE_CLASS_CONTROL,      // CC, program change, aftertouch, pitch bend
+    MIDI_RATE_CLASS_SYSEX,        // Counted in bytes
+    MIDI_RATE_CLASS_REALTIME,     // Start, stop, continue (not clock)
+    MIDI_RATE_CLASS_COUNT
+} MidiRateClass;
+
+typedef struct {
+    uint32_t rate;    // Messages (SysEx: bytes) per second, 0 = unlimited
+    uint32_t burst;   // Bucket size; for SysEx at least SYSEX_MAX_LENGTH
+} MidiRateLimit;
+
+// Default limits, well above what a player or a DAW sends on purpose
+#define MIDI_RATE_NOTE_DEFAULT      { 1000, 128 }
+#define MIDI_RATE_CONTROL_DEFAULT   { 2000, 256 }
+#define MIDI_RATE_SYSEX_DEFAULT     { 32000, 8192 }
+#define MIDI_RATE_REALTIME_DEFAULT  { 50, 16 }
+
+// Highest accepted rate
+#define MIDI_RATE_MAX 100000
+
+// Messages dropped within one window that put a source in quarantine
+#define MIDI_RATE_QUARANTINE_DROPS 256
+#define MIDI_RATE_QUARANTINE_WINDOW_MS 1000
+// First quarantine; doubled on each repeat up to the maximum
+#define MIDI_RATE_QUARANTINE_MS 1000
+#define MIDI_RATE_QUARANTINE_MAX_MS 30000
+// Time without a new quarantine after which the duration starts over
+#define MIDI_RATE_PROBATION_MS 10000
+
+typedef struct {
+    uint32_t limited;           // Messages dropped by an empty bucket
+    uint32_t quarantines;       // Times the source was quarantined
+    uint32_t quarantineDrops;   // Messages dropped while quarantined
+    bool quarantined;
+} MidiRateStats;
+
+// True if the message received on `endpoint` may be routed. Charges its
+// bucket. MIDI_ENDPOINT_NONE (internal sources) always passes.
+bool midiRateLimitAllows(uint8_t endpoint, const MidiMessage &msg);
+
+bool setMidiRateLimit(MidiRateClass cls, const MidiRateLimit &limit);
+MidiRateLimit getMidiRateLimit(MidiRateClass cls);
+
+// Counters for one source endpoint
+MidiRateStats getMidiRateStats(uint8_t endpoint);
+
+#endif // MIDI_RATE_LIMIT_H
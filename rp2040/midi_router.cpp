@@ -1,182 +1,351 @@
 #include "midi_router.h"
 #include "midi_filters.h"
+#include "midi_packet.h"
+#include "midi_queue.h"
+#include "config_sysex.h"
+#include "midi_rate_limit.h"
 #include "usb_host_wrapper.h"
 #include "serial_midi_handler.h"
-#include "midi_instances.h"
+#include "serial_midi_scheduler.h"
+#include "usb_device_midi_handlers.h"
 #include "led_utils.h"
 #include "serial_utils.h"
+#include "pico/platform.h"
 
 extern volatile bool isConnectedToComputer;
+extern bool debug;  // serial_utils.cpp
 
-static uint8_t realTimeByteFromType(midi::MidiType type) {
-    switch (type) {
-        case midi::Clock:
-            return 0xF8;
-        case midi::Start:
-            return 0xFA;
-        case midi::Continue:
-            return 0xFB;
-        case midi::Stop:
-            return 0xFC;
-        default:
-            return 0xF8;
-    }
-}
-
-static void forwardToInterface(MidiInterfaceType dest, const MidiMessage &msg) {
-    switch (dest) {
-        case MIDI_INTERFACE_USB_HOST: {
-            switch (msg.type) {
-                case MIDI_MSG_NOTE:
-                    if (msg.subType == 1) {
-                        sendNoteOff(msg.channel, msg.data1, msg.data2);
-                    } else {
-                        sendNoteOn(msg.channel, msg.data1, msg.data2);
-                    }
-                    break;
-                case MIDI_MSG_POLY_AFTERTOUCH:
-                    sendPolyAfterTouch(msg.channel, msg.data1, msg.data2);
-                    break;
-                case MIDI_MSG_CONTROL_CHANGE:
-                    sendControlChange(msg.channel, msg.data1, msg.data2);
-                    break;
-                case MIDI_MSG_PROGRAM_CHANGE:
-                    sendProgramChange(msg.channel, msg.data1);
-                    break;
-                case MIDI_MSG_CHANNEL_AFTERTOUCH:
-                    sendAfterTouch(msg.channel, msg.data1);
-                    break;
-                case MIDI_MSG_PITCH_BEND:
-                    sendPitchBend(msg.channel, msg.pitchBend);
-                    break;
-                case MIDI_MSG_SYSEX:
-                    sendSysEx(msg.sysexSize, msg.sysexData);
-                    break;
-                case MIDI_MSG_REALTIME:
-                    sendRealTime(realTimeByteFromType(msg.rtType));
-                    break;
-                default:
-                    break;
-            }
-            break;
-        }
-        case MIDI_INTERFACE_USB_DEVICE: {
-            switch (msg.type) {
-                case MIDI_MSG_NOTE:
-                    if (msg.subType == 1) {
-                        USB_D.sendNoteOff(msg.data1, msg.data2, msg.channel);
-                    } else {
-                        USB_D.sendNoteOn(msg.data1, msg.data2, msg.channel);
-                    }
-                    break;
-                case MIDI_MSG_POLY_AFTERTOUCH:
-                    USB_D.sendAfterTouch(msg.data1, msg.data2, msg.channel);
-                    break;
-                case MIDI_MSG_CONTROL_CHANGE:
-                    USB_D.sendControlChange(msg.data1, msg.data2, msg.channel);
-                    break;
-                case MIDI_MSG_PROGRAM_CHANGE:
-                    USB_D.sendProgramChange(msg.data1, msg.channel);
-                    break;
-                case MIDI_MSG_CHANNEL_AFTERTOUCH:
-                    USB_D.sendAfterTouch(msg.data1, msg.channel);
-                    break;
-                case MIDI_MSG_PITCH_BEND:
-                    USB_D.sendPitchBend(msg.pitchBend, msg.channel);
-                    break;
-                case MIDI_MSG_SYSEX:
-                    USB_D.sendSysEx(msg.sysexSize, msg.sysexData);
-                    break;
-                case MIDI_MSG_REALTIME:
-                    USB_D.sendRealTime(msg.rtType);
-                    break;
-                default:
-                    break;
-            }
-            break;
-        }
-        case MIDI_INTERFACE_SERIAL: {
-            switch (msg.type) {
-                case MIDI_MSG_NOTE:
-                    if (msg.subType == 1) {
-                        sendSerialMidiNoteOff(msg.channel, msg.data1, msg.data2);
-                    } else {
-                        sendSerialMidiNoteOn(msg.channel, msg.data1, msg.data2);
-                    }
-                    break;
-                case MIDI_MSG_POLY_AFTERTOUCH:
-                    sendSerialMidiAfterTouch(msg.channel, msg.data1, msg.data2);
-                    break;
-                case MIDI_MSG_CONTROL_CHANGE:
-                    sendSerialMidiControlChange(msg.channel, msg.data1, msg.data2);
-                    break;
-                case MIDI_MSG_PROGRAM_CHANGE:
-                    sendSerialMidiProgramChange(msg.channel, msg.data1);
-                    break;
-                case MIDI_MSG_CHANNEL_AFTERTOUCH:
-                    sendSerialMidiAfterTouchChannel(msg.channel, msg.data1);
-                    break;
-                case MIDI_MSG_PITCH_BEND:
-                    sendSerialMidiPitchBend(msg.channel, msg.pitchBend);
-                    break;
-                case MIDI_MSG_SYSEX:
-                    sendSerialMidiSysEx(msg.sysexSize, msg.sysexData);
-                    break;
-                case MIDI_MSG_REALTIME:
-                    sendSerialMidiRealTime(msg.rtType);
-                    break;
-                default:
-                    break;
-            }
-            break;
-        }
+// Each output interface is only ever written by one core. Core 0 runs the
+// USB device stack and Serial1, core 1 runs the TinyUSB host stack.
+static const uint8_t interfaceOwnerCore[MIDI_INTERFACE_COUNT] = {
+    0, // MIDI_INTERFACE_SERIAL
+    0, // MIDI_INTERFACE_USB_DEVICE
+    1  // MIDI_INTERFACE_USB_HOST
+};
+
+// Messages for an interface owned by the other core travel through these
+// queues as USB-MIDI packets: crossCoreQueues[n] is consumed by core n.
+static MidiQueue crossCoreQueues[2];
+
+static_assert(ROUTER_HEADROOM_PACKETS >= MIDI_HOST_PORTS, "ROUTER_HEADROOM_PACKETS is less than one packet per host port");
+static_assert(ROUTER_SYSEX_BURST_PACKETS < MIDI_QUEUE_CAPACITY,
+              "MIDI_QUEUE_CAPACITY cannot hold a SYSEX_MAX_LENGTH dump for every core 0 output");
+
+static inline MidiInterfaceType endpointInterface(uint8_t endpoint) {
+    if (endpoint >= MIDI_ENDPOINT_HOST_PORT_BASE) {
+        return MIDI_INTERFACE_USB_HOST;
+    }
+    return static_cast<MidiInterfaceType>(endpoint);
+}
+
+// The endpoint a message came in on, so that it is not echoed back there
+static inline uint8_t sourceEndpoint(MidiSource source, const MidiMessage &msg) {
+    switch (source) {
+        case MIDI_SOURCE_SERIAL:
+            return MIDI_ENDPOINT_SERIAL;
+        case MIDI_SOURCE_USB_DEVICE:
+            return MIDI_ENDPOINT_USB_DEVICE;
+        case MIDI_SOURCE_USB_HOST:
+            return msg.port < MIDI_HOST_PORTS ? MIDI_ENDPOINT_HOST_PORT_BASE + msg.port : MIDI_ENDPOINT_NONE;
         default:
-            break;
+            return MIDI_ENDPOINT_NONE;
     }
 }
 
-void routeMidiMessage(MidiSource source, const MidiMessage &msg, byte destMask) {
-    if (msg.type != MIDI_MSG_SYSEX && msg.type != MIDI_MSG_REALTIME) {
-        if (msg.channel != 0 && !isChannelEnabled(msg.channel)) {
-            return;
+// --- Packet sinks ---
+// Every message is encoded once by the router; each sink writes that
+// encoding unchanged. USB ports take the packet, serial takes the raw bytes.
+
+static void usbHostSink(uint8_t endpoint, const EncodedMidiMessage &encoded) {
+    uint8_t port = endpoint - MIDI_ENDPOINT_HOST_PORT_BASE;
+    if (encoded.sysexData != nullptr) {
+        sendHostPortSysEx(port, encoded.sysexSize, encoded.sysexData);
+        return;
+    }
+    sendHostPortPacket(port, encoded.packet);
+}
+
+static void usbDeviceSink(uint8_t endpoint, const EncodedMidiMessage &encoded) {
+    (void)endpoint;
+    if (!isConnectedToComputer) {
+        return;
+    }
+    if (encoded.sysexData != nullptr) {
+        MidiSysExEncoder encoder;
+        uint8_t packet[4];
+        midiSysExEncoderBegin(encoder, encoded.sysexData, encoded.sysexSize);
+        while (midiSysExEncoderNext(encoder, packet)) {
+            sendUsbDevicePacket(packet);
         }
+        return;
     }
+    sendUsbDevicePacket(encoded.packet);
+}
 
-    if (source != MIDI_SOURCE_INTERNAL) {
-        if (isMidiFiltered(static_cast<MidiInterfaceType>(source), msg.type)) {
-            return;
+static void serialSink(uint8_t endpoint, const EncodedMidiMessage &encoded) {
+    (void)endpoint;
+    if (encoded.sysexData != nullptr) {
+        sendSerialMidiRaw(encoded.sysexData, encoded.sysexSize);
+        return;
+    }
+    sendSerialMidiRaw(&encoded.packet[1], encoded.length);
+}
+
+// Indexed by MidiInterfaceType
+static const MidiPacketSink packetSinks[MIDI_INTERFACE_COUNT] = {
+    serialSink,     // MIDI_INTERFACE_SERIAL
+    usbDeviceSink,  // MIDI_INTERFACE_USB_DEVICE
+    usbHostSink     // MIDI_INTERFACE_USB_HOST
+};
+
+// --- SysEx lock ---
+// Streamed SysEx reaches a destination as a series of fragments. While one
+// source is between F0 and F7 the destination belongs to it; everything but
+// real-time (on DIN, only SysEx) from other sources waits in a small hold
+// ring. Each lock is only
+// touched by the core that owns its destination.
+
+#define SYSEX_HOLD_MASK (SYSEX_HOLD_CAPACITY - 1)
+
+static_assert((SYSEX_HOLD_CAPACITY & SYSEX_HOLD_MASK) == 0, "SYSEX_HOLD_CAPACITY must be a power of two");
+
+typedef struct {
+    bool locked;
+    bool replaying;                   // Held packets are being replayed
+    uint8_t owner;                    // Source endpoint mid-SysEx (while locked)
+    uint32_t lastActivity;            // millis() of the owner's last fragment
+    MidiQueueItem held[SYSEX_HOLD_CAPACITY];
+    uint16_t head;
+    uint16_t tail;
+    SysExLockStats stats;
+} SysExLock;
+
+// Indexed by destination endpoint
+static SysExLock sysexLocks[MIDI_ENDPOINT_COUNT];
+
+static void deliver(uint8_t dest, uint8_t source, const EncodedMidiMessage &encoded);
+
+static bool isRealTimePacket(const EncodedMidiMessage &encoded) {
+    return encoded.sysexData == nullptr && (encoded.packet[0] & 0x0F) == 0x0F && encoded.packet[1] >= 0xF8;
+}
+
+// Work out whether a message opens and/or closes a SysEx stream.
+// Returns false if it is not SysEx at all.
+static bool sysexBoundaries(const EncodedMidiMessage &encoded, bool &starts, bool &ends) {
+    if (encoded.sysexData != nullptr) {
+        starts = encoded.sysexData[0] == 0xF0;
+        ends = encoded.sysexData[encoded.sysexSize - 1] == 0xF7;
+        return true;
+    }
+
+    uint8_t cin = encoded.packet[0] & 0x0F;
+    if (cin == 0x4 || cin == 0x6 || cin == 0x7 || (cin == 0x5 && encoded.packet[1] == 0xF7)) {
+        starts = encoded.packet[1] == 0xF0;
+        ends = cin != 0x4;
+        return true;
+    }
+    if (cin == 0x0F && encoded.packet[1] < 0x80) {
+        starts = false; // Trailing byte of an unterminated fragment
+        ends = false;
+        return true;
+    }
+    return false;
+}
+
+static void holdPacket(SysExLock &lock, const MidiQueueItem &item) {
+    uint16_t next = (lock.head + 1) & SYSEX_HOLD_MASK;
+    if (next == lock.tail) {
+        lock.stats.dropped++;
+        return;
+    }
+    lock.held[lock.head] = item;
+    lock.head = next;
+    lock.stats.held++;
+}
+
+static void holdMessage(uint8_t dest, uint8_t source, const EncodedMidiMessage &encoded) {
+    SysExLock &lock = sysexLocks[dest];
+    MidiQueueItem item;
+    item.dest = dest;
+    item.source = source;
+
+    if (encoded.sysexData != nullptr) {
+        MidiSysExEncoder encoder;
+        midiSysExEncoderBegin(encoder, encoded.sysexData, encoded.sysexSize);
+        while (midiSysExEncoderNext(encoder, item.packet)) {
+            holdPacket(lock, item);
         }
+        return;
     }
 
-    struct DestEntry {
-        MidiInterfaceType iface;
-        byte mask;
-    };
+    memcpy(item.packet, encoded.packet, sizeof(item.packet));
+    holdPacket(lock, item);
+}
+
+// Replay held traffic in arrival order. A held SysEx start may take the lock
+// again, in which case the remaining packets of other sources are re-held
+// and replayed once that message has ended.
+static void releaseSysExLock(uint8_t dest) {
+    SysExLock &lock = sysexLocks[dest];
+    lock.locked = false;
+    if (lock.replaying) {
+        return; // Ended during a replay: the outer pass continues
+    }
 
-    const DestEntry interfaces[] = {
-        { MIDI_INTERFACE_USB_HOST, ROUTE_TO_USB_HOST },
-        { MIDI_INTERFACE_USB_DEVICE, ROUTE_TO_USB_DEVICE },
-        { MIDI_INTERFACE_SERIAL, ROUTE_TO_SERIAL }
-    };
+    lock.replaying = true;
+    while (!lock.locked && lock.tail != lock.head) {
+        uint16_t count = (lock.head - lock.tail) & SYSEX_HOLD_MASK;
+        while (count-- > 0 && lock.tail != lock.head) {
+            MidiQueueItem item = lock.held[lock.tail];
+            lock.tail = (lock.tail + 1) & SYSEX_HOLD_MASK;
 
-    for (const auto &destEntry : interfaces) {
-        if ((destMask & destEntry.mask) == 0) {
-            continue;
+            EncodedMidiMessage encoded;
+            encodePacket(item.packet, encoded);
+            deliver(dest, item.source, encoded);
         }
+    }
+    lock.replaying = false;
+}
 
-        if (destEntry.iface == MIDI_INTERFACE_USB_DEVICE && !isConnectedToComputer) {
-            continue;
+// Emit a message on an endpoint owned by the calling core
+static void deliver(uint8_t dest, uint8_t source, const EncodedMidiMessage &encoded) {
+    SysExLock &lock = sysexLocks[dest];
+    bool starts = false;
+    bool ends = false;
+    bool isSysEx = sysexBoundaries(encoded, starts, ends);
+
+    // The DIN scheduler keeps channel messages apart from a dump by itself
+    // (serial_midi_scheduler.h), so there only other SysEx has to wait
+    bool mustWait = dest == MIDI_ENDPOINT_SERIAL ? isSysEx : !isRealTimePacket(encoded);
+    if (lock.locked && lock.owner != source && mustWait) {
+        holdMessage(dest, source, encoded);
+        return;
+    }
+
+    if (isSysEx && (starts || (lock.locked && lock.owner == source))) {
+        lock.locked = !ends;
+        lock.owner = source;
+        lock.lastActivity = millis();
+    }
+
+    packetSinks[endpointInterface(dest)](dest, encoded);
+
+    if (isSysEx && ends && lock.head != lock.tail) {
+        releaseSysExLock(dest);
+    }
+}
+
+// Hand an encoded message to the core that owns `dest`.
+// SysEx is queued all-or-nothing so a full queue never truncates a message.
+static void queueForOtherCore(uint8_t dest, uint8_t source, const EncodedMidiMessage &encoded) {
+    MidiQueue &queue = crossCoreQueues[interfaceOwnerCore[endpointInterface(dest)]];
+    MidiQueueItem item;
+    item.dest = dest;
+    item.source = source;
+
+    if (encoded.sysexData != nullptr) {
+        unsigned count = midiSysExPacketCount(encoded.sysexData, encoded.sysexSize);
+        if (count > midiQueueSpace(queue)) {
+            midiQueueCountDrops(queue, count);
+            return;
         }
 
-        if (destEntry.iface == MIDI_INTERFACE_USB_HOST && !midi_host_mounted) {
-            continue;
+        MidiSysExEncoder encoder;
+        midiSysExEncoderBegin(encoder, encoded.sysexData, encoded.sysexSize);
+        while (midiSysExEncoderNext(encoder, item.packet)) {
+            midiQueuePush(queue, item);
         }
+        return;
+    }
 
-        if (isMidiDestFiltered(destEntry.iface, msg.type)) {
-            continue;
+    memcpy(item.packet, encoded.packet, sizeof(item.packet));
+    midiQueuePush(queue, item);
+}
+
+// Endpoints that can take output right now
+static MidiEndpointMask availableEndpoints() {
+    MidiEndpointMask mask = ROUTE_TO_SERIAL | getMountedHostPortMask();
+    if (isConnectedToComputer) {
+        mask |= ROUTE_TO_USB_DEVICE;
+    }
+    return mask;
+}
+
+static bool isPresetControl(const MidiMessage &msg) {
+    MidiPresetControl control = getMidiPresetControl();
+    if (control.channel == 0 || msg.channel != control.channel) {
+        return false;
+    }
+    if (control.type == MIDI_PRESET_CONTROL_CC) {
+        return msg.type == MIDI_MSG_CONTROL_CHANGE && msg.data1 == control.cc;
+    }
+    return msg.type == MIDI_MSG_PROGRAM_CHANGE;
+}
+
+void routeMidiMessage(MidiSource source, const MidiMessage &msg, MidiEndpointMask destMask) {
+    if (source > MIDI_SOURCE_INTERNAL || msg.type >= MIDI_MSG_COUNT) {
+        return;
+    }
+
+    uint8_t srcEndpoint = sourceEndpoint(source, msg);
+
+    // Flood protection comes first so a misbehaving source costs as little
+    // as possible
+    if (!midiRateLimitAllows(srcEndpoint, msg)) {
+        return;
+    }
+
+    // The preset control message switches the configuration and is not
+    // forwarded. Checked before the lookup so filters cannot lock it out.
+    if (source != MIDI_SOURCE_INTERNAL && isPresetControl(msg)) {
+        selectMidiPreset(msg.type == MIDI_MSG_PROGRAM_CHANGE ? msg.data1 : msg.data2);
+        return;
+    }
+
+    // Config SysEx (config_sysex.h) is answered on the port it came from
+    // and never forwarded, whatever the filters say
+    if (msg.type == MIDI_MSG_SYSEX && isConfigSysExEndpoint(srcEndpoint)) {
+        const uint8_t *reply;
+        unsigned replySize;
+        if (receiveConfigSysEx(srcEndpoint, msg.sysexData, msg.sysexSize, &reply, &replySize)) {
+            if (replySize > 0 && (availableEndpoints() & (1 << srcEndpoint))) {
+                MidiMessage replyMsg = {};
+                replyMsg.type = MIDI_MSG_SYSEX;
+                replyMsg.sysexData = (byte *)reply;
+                replyMsg.sysexSize = replySize;
+                EncodedMidiMessage encoded;
+                encodeMidiMessage(replyMsg, encoded);
+                deliver(srcEndpoint, MIDI_ENDPOINT_NONE, encoded);
+            }
+            return;
         }
+    }
+
+    // Source, channel and destination filters in one lookup
+    destMask &= getMidiRoute(source, msg.type, msg.channel);
+    if (destMask == 0) {
+        return;
+    }
+
+    EncodedMidiMessage encoded;
+    if (!encodeMidiMessage(msg, encoded)) {
+        return;
+    }
 
-        forwardToInterface(destEntry.iface, msg);
+    uint8_t core = get_core_num();
+
+    // Walk only the endpoints that are both requested and present, so the
+    // cost depends on the number of destinations, not on the port count
+    MidiEndpointMask pending = destMask & availableEndpoints();
+    while (pending != 0) {
+        uint8_t dest = __builtin_ctz(pending);
+        pending &= pending - 1;
+
+        if (interfaceOwnerCore[endpointInterface(dest)] == core) {
+            deliver(dest, srcEndpoint, encoded);
+        } else {
+            queueForOtherCore(dest, srcEndpoint, encoded);
+        }
     }
 
     if (source != MIDI_SOURCE_INTERNAL) {
@@ -189,28 +358,135 @@ void routeMidiMessage(MidiSource source, const MidiMessage &msg, byte destMask)
         }
     }
 
-    if (msg.type != MIDI_MSG_REALTIME || msg.rtType != midi::Clock) {
+    if (MIDI_ROUTER_TRACE && debug && (msg.type != MIDI_MSG_REALTIME || msg.rtType != midi::Clock)) {
         dualPrintf("Router: src=%d type=%d ch=%d d1=%d d2=%d\r\n", source, msg.type, msg.channel, msg.data1, msg.data2);
     }
 }
 
 void routeMidiMessage(MidiSource source, const MidiMessage &msg) {
-    byte destMask = ROUTE_TO_ALL;
+    MidiEndpointMask destMask = ROUTE_TO_ALL;
 
-    switch (source) {
-        case MIDI_SOURCE_SERIAL:
-            destMask &= ~ROUTE_TO_SERIAL;
-            break;
-        case MIDI_SOURCE_USB_DEVICE:
-            destMask &= ~ROUTE_TO_USB_DEVICE;
-            break;
-        case MIDI_SOURCE_USB_HOST:
-            destMask &= ~ROUTE_TO_USB_HOST;
-            break;
-        case MIDI_SOURCE_INTERNAL:
-        default:
-            break;
+    // Never echo a message back to the endpoint it came from. Other USB host
+    // ports still receive it, so one device can drive the others on a hub.
+    uint8_t srcEndpoint = sourceEndpoint(source, msg);
+    if (srcEndpoint != MIDI_ENDPOINT_NONE) {
+        destMask &= ~(1 << srcEndpoint);
     }
 
     routeMidiMessage(source, msg, destMask);
 }
+
+// --- Parked packets ---
+// Flow control for queued packets: a packet waits until its endpoint can
+// take it, instead of overrunning the output. Waiting happens per
+// destination, so a backed-up DIN output does not stall the packets behind
+// it for USB. Each ring is only touched by the core that owns its
+// destination.
+
+#define PARK_MASK (ROUTER_PARK_CAPACITY - 1)
+
+static_assert((ROUTER_PARK_CAPACITY & PARK_MASK) == 0, "ROUTER_PARK_CAPACITY must be a power of two");
+
+typedef struct {
+    MidiQueueItem items[ROUTER_PARK_CAPACITY];
+    uint16_t head;
+    uint16_t tail;
+} ParkRing;
+
+// Indexed by destination endpoint
+static ParkRing parkRings[MIDI_ENDPOINT_COUNT];
+
+// Notes and real-time may use the transmit slots kept for them
+static bool sinkHasRoom(const MidiQueueItem &item) {
+    if (item.dest == MIDI_ENDPOINT_SERIAL) {
+        return serialMidiSchedulerHasRoom();
+    }
+    if (item.dest >= MIDI_ENDPOINT_HOST_PORT_BASE) {
+        uint8_t port = item.dest - MIDI_ENDPOINT_HOST_PORT_BASE;
+        // Unmounted ports drop their packets, so they never stall the queue
+        return (getMountedHostPortMask() & routeToHostPort(port)) == 0 ||
+               getHostPortTxSpace(port, midiIsPriorityPacket(item.packet)) > 0;
+    }
+    // The staging ring is written out once per loop() pass; a computer
+    // that went away drops its packets like an unmounted port
+    return !isConnectedToComputer || getUsbDeviceTxSpace(midiIsPriorityPacket(item.packet)) > 0;
+}
+
+static void deliverItem(const MidiQueueItem &item) {
+    EncodedMidiMessage encoded;
+    encodePacket(item.packet, encoded);
+    deliver(item.dest, item.source, encoded);
+}
+
+bool midiRouterHasHeadroom() {
+    uint8_t core = get_core_num();
+    MidiQueue &outbound = crossCoreQueues[core ^ 1];
+    // A queued SysEx is all-or-nothing, so core 1 keeps room for the
+    // largest dump the next packet may complete
+    uint16_t needed = core == 0 ? ROUTER_HEADROOM_PACKETS : ROUTER_SYSEX_BURST_PACKETS;
+    if (midiQueueSpace(outbound) < needed) {
+        return false;
+    }
+    // The serial output is written directly from core 0
+    return core != 0 || serialMidiSchedulerHasRoom();
+}
+
+void loopMidiRouter() {
+    uint8_t core = get_core_num();
+    MidiQueue &queue = crossCoreQueues[core];
+    MidiQueueItem item;
+
+    // A source that stopped mid-dump (cable pulled, device unmounted) must
+    // not block its destinations forever
+    for (uint8_t dest = 0; dest < MIDI_ENDPOINT_COUNT; dest++) {
+        SysExLock &lock = sysexLocks[dest];
+        if (interfaceOwnerCore[endpointInterface(dest)] != core || !lock.locked) {
+            continue;
+        }
+        if (millis() - lock.lastActivity > SYSEX_LOCK_TIMEOUT_MS) {
+            lock.stats.timeouts++;
+            releaseSysExLock(dest);
+        }
+    }
+
+    // Parked packets first, so they keep their place ahead of newer ones
+    for (uint8_t dest = 0; dest < MIDI_ENDPOINT_COUNT; dest++) {
+        if (interfaceOwnerCore[endpointInterface(dest)] != core) {
+            continue;
+        }
+        ParkRing &park = parkRings[dest];
+        while (park.tail != park.head && sinkHasRoom(park.items[park.tail])) {
+            deliverItem(park.items[park.tail]);
+            park.tail = (park.tail + 1) & PARK_MASK;
+        }
+    }
+
+    while (midiQueuePeek(queue, item)) {
+        if (item.dest >= MIDI_ENDPOINT_COUNT) {
+            midiQueuePop(queue, item);
+            continue;
+        }
+        ParkRing &park = parkRings[item.dest];
+        if (park.tail == park.head && sinkHasRoom(item)) {
+            midiQueuePop(queue, item);
+            deliverItem(item);
+            continue;
+        }
+        uint16_t next = (park.head + 1) & PARK_MASK;
+        if (next == park.tail) {
+            break; // Resume once that output drains
+        }
+        midiQueuePop(queue, item);
+        park.items[park.head] = item;
+        park.head = next;
+    }
+}
+
+MidiQueueStats getCrossCoreQueueStats(uint8_t consumerCore) {
+    return getMidiQueueStats(crossCoreQueues[consumerCore & 1]);
+}
+
+SysExLockStats getSysExLockStats(uint8_t endpoint) {
+    SysExLockStats empty = {0, 0, 0};
+    return endpoint < MIDI_ENDPOINT_COUNT ? sysexLocks[endpoint].stats : empty;
+}
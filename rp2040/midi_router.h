@@ -4,6 +4,8 @@
 #include <Arduino.h>
 #include <MIDI.h>
 #include "midi_filters.h"
+#include "midi_queue.h"
+#include "sysex_assembler.h"
 
 // Source interface that received the MIDI message
 // (reuses MidiInterfaceType values but semantically means "where it came from")
@@ -14,11 +16,32 @@ typedef enum {
     MIDI_SOURCE_INTERNAL = MIDI_INTERFACE_COUNT
 } MidiSource;
 
+// Number of (device, cable) ports the USB host side can address. Ports are
+// handed out as devices mount, in the order of their cables.
+#define MIDI_HOST_PORTS 8
+
+// Endpoints are the individual sources/destinations the router addresses:
+// the serial port, the USB device port and every USB host port.
+#define MIDI_ENDPOINT_SERIAL 0
+#define MIDI_ENDPOINT_USB_DEVICE 1
+#define MIDI_ENDPOINT_HOST_PORT_BASE 2
+#define MIDI_ENDPOINT_COUNT (MIDI_ENDPOINT_HOST_PORT_BASE + MIDI_HOST_PORTS)
+#define MIDI_ENDPOINT_NONE 0xFF
+
+// One bit per endpoint
+typedef uint16_t MidiEndpointMask;
+
+static_assert(MIDI_ENDPOINT_COUNT <= 16, "MidiEndpointMask is too narrow for MIDI_HOST_PORTS");
+
 // Destination routing masks
-static const byte ROUTE_TO_SERIAL = (1 << 0);
-static const byte ROUTE_TO_USB_DEVICE = (1 << 1);
-static const byte ROUTE_TO_USB_HOST = (1 << 2);
-static const byte ROUTE_TO_ALL = (ROUTE_TO_SERIAL | ROUTE_TO_USB_DEVICE | ROUTE_TO_USB_HOST);
+static const MidiEndpointMask ROUTE_TO_SERIAL = (1 << MIDI_ENDPOINT_SERIAL);
+static const MidiEndpointMask ROUTE_TO_USB_DEVICE = (1 << MIDI_ENDPOINT_USB_DEVICE);
+static const MidiEndpointMask ROUTE_TO_USB_HOST = ((1 << MIDI_HOST_PORTS) - 1) << MIDI_ENDPOINT_HOST_PORT_BASE;
+static const MidiEndpointMask ROUTE_TO_ALL = (ROUTE_TO_SERIAL | ROUTE_TO_USB_DEVICE | ROUTE_TO_USB_HOST);
+
+inline MidiEndpointMask routeToHostPort(uint8_t port) {
+    return (MidiEndpointMask)(1 << (MIDI_ENDPOINT_HOST_PORT_BASE + port));
+}
 
 // Union-style struct to hold any MIDI message data
 typedef struct {
@@ -31,14 +54,69 @@ typedef struct {
     byte *sysexData;        // Pointer to SysEx data (only for SYSEX type)
     unsigned sysexSize;     // SysEx data size (only for SYSEX type)
     midi::MidiType rtType;  // Real-time message subtype (Clock, Start, Continue, Stop)
+    byte port;              // USB host port the message arrived on (USB_HOST source only)
 } MidiMessage;
 
-// Route a MIDI message from source to all other interfaces, applying filters
+// Set to 1 to log every routed message except clock through dualPrintf()
+// while `debug` is on. Formatting the line costs far more than routing
+// the message, so it is left out of normal builds.
+#ifndef MIDI_ROUTER_TRACE
+#define MIDI_ROUTER_TRACE 0
+#endif
+
+// Route a MIDI message from source to all other endpoints, applying filters
 void routeMidiMessage(MidiSource source, const MidiMessage &msg);
-void routeMidiMessage(MidiSource source, const MidiMessage &msg, byte destMask);
+void routeMidiMessage(MidiSource source, const MidiMessage &msg, MidiEndpointMask destMask);
 
 inline void routeMidiMessage(MidiInterfaceType source, const MidiMessage &msg) {
     routeMidiMessage(static_cast<MidiSource>(source), msg);
 }
 
+// Minimum free slots in the outbound cross-core queue before an input with
+// its own flow control reads another packet. The USB device port on core 0
+// is routed a packet at a time, one copy per host port at most.
+#define ROUTER_HEADROOM_PACKETS 16
+
+// Outputs owned by core 0: DIN and the USB device port
+#define ROUTER_CORE0_OUTPUTS 2
+
+// The same for the USB host port on core 1, which hands over reassembled
+// dumps: a whole SYSEX_MAX_LENGTH message to each core 0 output
+#define ROUTER_SYSEX_BURST_PACKETS (((SYSEX_MAX_LENGTH + 2) / 3) * ROUTER_CORE0_OUTPUTS)
+
+// True while the queue towards the other core (and, on core 0, the serial
+// output scheduler) has room for more input.
+// Inputs that can be paused (USB device and USB host) check this before
+// reading so that bulk SysEx, and a backlog of notes behind it, is
+// throttled at the source rather than dropped.
+bool midiRouterHasHeadroom();
+
+// A destination stays locked to the source streaming SysEx into it until the
+// closing F7. Other non-real-time traffic for that destination is held back
+// (up to SYSEX_HOLD_CAPACITY packets) and the lock is dropped if the owner
+// goes quiet for SYSEX_LOCK_TIMEOUT_MS.
+#define SYSEX_HOLD_CAPACITY 64
+#define SYSEX_LOCK_TIMEOUT_MS 500
+
+typedef struct {
+    uint32_t held;      // Times a packet was delayed behind another source's SysEx
+    uint32_t dropped;   // Packets lost because the hold buffer was full
+    uint32_t timeouts;  // Locks released because the owner went quiet
+} SysExLockStats;
+
+// Packets from the cross-core queue whose destination is full wait in a
+// per-destination ring, so the packets behind them for other destinations
+// keep flowing. Only a full ring holds up the whole queue again.
+#define ROUTER_PARK_CAPACITY 32
+
+// Drain messages queued for this core's interfaces by the other core.
+// Call from both loop() and loop1().
+void loopMidiRouter();
+
+// Fill level, high-water mark and drop count of the queue consumed by a core
+MidiQueueStats getCrossCoreQueueStats(uint8_t consumerCore);
+
+// SysEx lock counters for one destination endpoint
+SysExLockStats getSysExLockStats(uint8_t endpoint);
+
 #endif // MIDI_ROUTER_H
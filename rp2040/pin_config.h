@@ -10,9 +10,9 @@
 // --- USB Host (PIO USB) ---
 #define HOST_PIN_DP 12  // D+ pin for PIO USB Host (D- = D+ + 1 = GPIO 13)
 
-// --- Serial MIDI (DIN/TRS via Serial1) ---
-#define SERIAL_MIDI_RX_PIN 1  // GPIO pin for Serial1 RX (MIDI In)
-#define SERIAL_MIDI_TX_PIN 0  // GPIO pin for Serial1 TX (MIDI Out)
+// --- Serial MIDI (DIN/TRS via uart0, see serial_midi_port.h) ---
+#define SERIAL_MIDI_RX_PIN 1  // GPIO pin for uart0 RX (MIDI In)
+#define SERIAL_MIDI_TX_PIN 0  // GPIO pin for uart0 TX (MIDI Out)
 
 // --- LED Indicators ---
 #define LED_IN_PIN 29   // LED for incoming MIDI activity (USB)
@@ -15,6 +15,7 @@
 #include "serial_utils.h"
 #include "web_serial_config.h"
 #include "config.h"
+#include "flash_commit.h"
 #include "imu_handler.h"
 #include "pin_config.h"
 extern volatile uint8_t midi_dev_addr;
@@ -49,7 +50,6 @@ void setup() {
   usb_midi.setStringDescriptor("MIDI PicoLink");
   usb_midi.begin();
 
-  USB_D.begin(MIDI_CHANNEL_OMNI);
   setupUsbDeviceHandlers();
   setupUsbHostHandlers();
   uint32_t startTime = millis();
@@ -84,7 +84,6 @@ void setup() {
 
   rp2040.fifo.push(0);
   while(rp2040.fifo.pop() != 1){};
-  USB_D.turnThruOff();
   dualPrintln("Core0 setup complete");
   dualPrintln("");
   blinkBothLEDs(4, 100);
@@ -92,12 +91,15 @@ void setup() {
 
 void loop() {
   if (isConnectedToComputer) {
-    USB_D.read();
+    loopUsbDeviceMidi();
   }
   loopSerialMidi(); 
+  loopMidiRouter();
+  loopMidiPresets();
   processWebSerialConfig();
   handleDelayedEEPROMSave();
   loopIMU();
+  flushUsbDeviceMidi();
   handleLEDs();
 }
 
@@ -144,5 +146,11 @@ void setup1() {
 }
 
 void loop1() {
+  // Between two USB host passes: park here while core 0 writes flash
+  flashCommitSafePoint();
+  // Everything that routes on core 1 runs inside the config read section
+  beginMidiConfigRead();
+  loopMidiRouter();
   usb_host_wrapper_task();
+  endMidiConfigRead();
 }
@@ -1,5 +1,4 @@
 #include "serial_midi_handler.h"
-#include <HardwareSerial.h> // Needed for HardwareSerial object (Serial1)
 #include "usb_host_wrapper.h" // For midi_dev_addr and USB host functions
 #include "led_utils.h" // For triggerSerialLED()
 #include "midi_instances.h"
@@ -7,201 +6,128 @@
 #include "midi_router.h"
 #include "serial_utils.h" // Include the dual printing utilities
 #include "pin_config.h"
+#include "serial_midi_scheduler.h"
+#include "serial_midi_port.h"
+#include "midi_parser.h"
+#include "midi_packet.h"
 
-// --- MIDI Instances ---
-// Create Serial MIDI instance using Serial1
-MIDI_CREATE_INSTANCE(HardwareSerial, Serial1, SERIAL_M);
+// --- Input Parser ---
+// The DIN input is parsed in-tree (midi_parser.h) straight into USB-MIDI
+// packets, decoded the same way as USB input. SysEx is forwarded in chunks
+// as it arrives, so no fixed buffer ever truncates a dump and receivers see
+// the first bytes right away.
+static MidiParser serialParser;
+
+static void serialParserPacket(uint8_t packet[4]);
+static void serialParserSysEx(uint8_t *data, unsigned size);
 
 // --- External References ---
 // These objects are defined in the main sketch or other included files
 // and are needed here to forward MIDI messages *from* Serial MIDI *to* USB Host and Device.
 extern volatile uint8_t midi_dev_addr; // Set by USB Host connection callback
 extern volatile bool midi_host_mounted; // Set by USB Host connection callback
-// USB_D is now created by the macro in midi_instances.h
-
-
-// --- Local Handler Forward Declarations ---
-// These handlers are called by the MIDI library when messages arrive *on* Serial MIDI
-void serial_onNoteOn(byte channel, byte note, byte velocity);
-void serial_onNoteOff(byte channel, byte note, byte velocity);
-void serial_onControlChange(byte channel, byte controller, byte value);
-void serial_onProgramChange(byte channel, byte program);
-void serial_onChannelAftertouch(byte channel, byte pressure); // Channel Aftertouch
-// Note: The MIDI library doesn't directly support Polyphonic Aftertouch *input* handling
-// via a dedicated setHandle function like it does for output.
-// If you need to handle incoming Poly AT on Serial, you might need custom parsing
-// or check if the library version you use has added it.
-// We'll omit a specific handler for incoming Poly AT from Serial for now.
-void serial_onPitchBend(byte channel, int bend);
-void serial_onSysEx(byte * array, unsigned size);
-void serial_onClock();
-void serial_onStart();
-void serial_onContinue();
-void serial_onStop();
+// usb_midi (USB device port) is defined in midi_instances.cpp
+
 
 // --- Public Functions (declared in .h) ---
 
 void setupSerialMidi() {
-    // Configure Serial1 pins
-    Serial1.setRX(SERIAL_MIDI_RX_PIN);
-    Serial1.setTX(SERIAL_MIDI_TX_PIN);
-
-    // Initialize Serial MIDI
-    SERIAL_M.begin(MIDI_CHANNEL_OMNI);
-    SERIAL_M.setHandleNoteOn(serial_onNoteOn);
-    SERIAL_M.setHandleNoteOff(serial_onNoteOff);
-    SERIAL_M.setHandleControlChange(serial_onControlChange);
-    SERIAL_M.setHandleProgramChange(serial_onProgramChange);
-    SERIAL_M.setHandleAfterTouchChannel(serial_onChannelAftertouch); // Channel Aftertouch
-    SERIAL_M.setHandlePitchBend(serial_onPitchBend);
-    SERIAL_M.setHandleSystemExclusive(serial_onSysEx);
-    SERIAL_M.setHandleClock(serial_onClock);
-    SERIAL_M.setHandleStart(serial_onStart);
-    SERIAL_M.setHandleContinue(serial_onContinue);
-    SERIAL_M.setHandleStop(serial_onStop);
-    SERIAL_M.turnThruOff();
+    // Open the UART on SERIAL_MIDI_RX_PIN/TX_PIN at the MIDI baud rate
+    beginSerialMidiPort(SERIAL_MIDI_BAUD, serialMidiSchedulerNextByte);
+    midiParserInit(serialParser, serialParserPacket, serialParserSysEx);
 
     dualPrintf("Serial MIDI Module: Initialized using pins: RX=%d, TX=%d\n", SERIAL_MIDI_RX_PIN, SERIAL_MIDI_TX_PIN);
     dualPrintln("");
 }
 
 void loopSerialMidi() {
-    // Process incoming Serial MIDI messages
-    SERIAL_M.read();
+    // Process incoming Serial MIDI bytes, a bounded number per pass
+    uint8_t value;
+    uint32_t timestamp;
+    for (int i = 0; i < SERIAL_MIDI_RX_BUDGET && serialMidiPortRead(value, timestamp); i++) {
+        midiParserFeed(serialParser, value);
+    }
+    // Forward the SysEx received so far once the input goes quiet
+    if (serialMidiPortAvailable() == 0) {
+        midiParserFlushSysEx(serialParser);
+    }
+    // Output is sent from the UART interrupt; this only restarts it
+    loopSerialMidiScheduler();
+}
+
+// Implement functions to *send* messages *to* the Serial MIDI port.
+// Everything goes through the output scheduler, so these never bypass
+// real-time priority or running status.
+static void sendChannelMessage(byte kind, byte channel, byte data1, byte data2, unsigned length) {
+    byte bytes[3] = { (byte)(kind | ((channel - 1) & 0x0F)), (byte)(data1 & 0x7F), (byte)(data2 & 0x7F) };
+    serialMidiSchedulerWrite(bytes, length);
 }
 
-// Implement functions to *send* messages *to* the Serial MIDI port
 void sendSerialMidiNoteOn(byte channel, byte note, byte velocity) {
-    SERIAL_M.sendNoteOn(note, velocity, channel);
+    sendChannelMessage(0x90, channel, note, velocity, 3);
 }
 
 void sendSerialMidiNoteOff(byte channel, byte note, byte velocity) {
-    SERIAL_M.sendNoteOff(note, velocity, channel);
+    sendChannelMessage(0x80, channel, note, velocity, 3);
 }
 
 void sendSerialMidiAfterTouch(byte channel, byte note, byte amount) { // Polyphonic AT
-    SERIAL_M.sendAfterTouch(note, amount, channel);
+    sendChannelMessage(0xA0, channel, note, amount, 3);
 }
 
 void sendSerialMidiControlChange(byte channel, byte controller, byte value) {
-    SERIAL_M.sendControlChange(controller, value, channel);
+    sendChannelMessage(0xB0, channel, controller, value, 3);
 }
 
 void sendSerialMidiProgramChange(byte channel, byte program) {
-    SERIAL_M.sendProgramChange(program, channel);
+    sendChannelMessage(0xC0, channel, program, 0, 2);
 }
 
 void sendSerialMidiAfterTouchChannel(byte channel, byte pressure) { // Channel AT
-    SERIAL_M.sendAfterTouch(pressure, channel);
+    sendChannelMessage(0xD0, channel, pressure, 0, 2);
 }
 
 void sendSerialMidiPitchBend(byte channel, int bend) {
-    SERIAL_M.sendPitchBend(bend, channel);
+    unsigned value = constrain(bend + 8192, 0, 16383);
+    sendChannelMessage(0xE0, channel, value & 0x7F, value >> 7, 3);
 }
 
 void sendSerialMidiSysEx(unsigned size, const byte *array) {
-    SERIAL_M.sendSysEx(size, array);
+    static const byte start = 0xF0;
+    static const byte end = 0xF7;
+    serialMidiSchedulerWrite(&start, 1);
+    serialMidiSchedulerWrite(array, size);
+    serialMidiSchedulerWrite(&end, 1);
 }
 
 void sendSerialMidiRealTime(midi::MidiType type) {
-    SERIAL_M.sendRealTime(type);
-}
-
-
-// --- Local Handler Implementations ---
-// These handle messages *received from* Serial MIDI and forward them
-
-void serial_onNoteOn(byte channel, byte note, byte velocity) {
-    MidiMessage msg = {};
-    msg.type = MIDI_MSG_NOTE;
-    msg.subType = (velocity == 0) ? 1 : 0;
-    msg.channel = channel;
-    msg.data1 = note;
-    msg.data2 = velocity;
-    routeMidiMessage(MIDI_INTERFACE_SERIAL, msg);
+    byte value = (byte)type;
+    serialMidiSchedulerWrite(&value, 1);
 }
 
-void serial_onNoteOff(byte channel, byte note, byte velocity) {
-    MidiMessage msg = {};
-    msg.type = MIDI_MSG_NOTE;
-    msg.subType = 1;
-    msg.channel = channel;
-    msg.data1 = note;
-    msg.data2 = velocity;
-    routeMidiMessage(MIDI_INTERFACE_SERIAL, msg);
+void sendSerialMidiRaw(const byte *data, unsigned size) {
+    serialMidiSchedulerWrite(data, size);
 }
 
-void serial_onControlChange(byte channel, byte controller, byte value) {
-    MidiMessage msg = {};
-    msg.type = MIDI_MSG_CONTROL_CHANGE;
-    msg.channel = channel;
-    msg.data1 = controller;
-    msg.data2 = value;
-    routeMidiMessage(MIDI_INTERFACE_SERIAL, msg);
-}
 
-void serial_onProgramChange(byte channel, byte program) {
-    MidiMessage msg = {};
-    msg.type = MIDI_MSG_PROGRAM_CHANGE;
-    msg.channel = channel;
-    msg.data1 = program;
-    routeMidiMessage(MIDI_INTERFACE_SERIAL, msg);
-}
+// --- Local Handler Implementations ---
+// These handle messages *received from* Serial MIDI and forward them
 
-void serial_onChannelAftertouch(byte channel, byte pressure) {
-    MidiMessage msg = {};
-    msg.type = MIDI_MSG_CHANNEL_AFTERTOUCH;
-    msg.channel = channel;
-    msg.data1 = pressure;
-    routeMidiMessage(MIDI_INTERFACE_SERIAL, msg);
+static void serialParserPacket(uint8_t packet[4]) {
+    MidiMessage msg;
+    if (decodeMidiPacket(packet, msg)) {
+        routeMidiMessage(MIDI_INTERFACE_SERIAL, msg);
+    }
 }
 
-void serial_onPitchBend(byte channel, int bend) {
-    MidiMessage msg = {};
-    msg.type = MIDI_MSG_PITCH_BEND;
-    msg.channel = channel;
-    msg.pitchBend = bend;
-    routeMidiMessage(MIDI_INTERFACE_SERIAL, msg);
-}
-
-void serial_onSysEx(byte * array, unsigned size) {
+// Called by the parser for each chunk of a dump. The first chunk starts
+// with F0 and the last one ends with F7; the router keeps each destination
+// locked to this source in between.
+static void serialParserSysEx(uint8_t *data, unsigned size) {
     MidiMessage msg = {};
     msg.type = MIDI_MSG_SYSEX;
     msg.channel = 0;
-    msg.sysexData = array;
+    msg.sysexData = data;
     msg.sysexSize = size;
     routeMidiMessage(MIDI_INTERFACE_SERIAL, msg);
 }
-
-void serial_onClock() {
-    MidiMessage msg = {};
-    msg.type = MIDI_MSG_REALTIME;
-    msg.channel = 0;
-    msg.rtType = midi::Clock;
-    routeMidiMessage(MIDI_INTERFACE_SERIAL, msg);
-}
-
-
-void serial_onStart() {
-    MidiMessage msg = {};
-    msg.type = MIDI_MSG_REALTIME;
-    msg.channel = 0;
-    msg.rtType = midi::Start;
-    routeMidiMessage(MIDI_INTERFACE_SERIAL, msg);
-}
-
-void serial_onContinue() {
-    MidiMessage msg = {};
-    msg.type = MIDI_MSG_REALTIME;
-    msg.channel = 0;
-    msg.rtType = midi::Continue;
-    routeMidiMessage(MIDI_INTERFACE_SERIAL, msg);
-}
-
-void serial_onStop() {
-    MidiMessage msg = {};
-    msg.type = MIDI_MSG_REALTIME;
-    msg.channel = 0;
-    msg.rtType = midi::Stop;
-    routeMidiMessage(MIDI_INTERFACE_SERIAL, msg);
-}
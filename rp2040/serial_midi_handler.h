@@ -4,6 +4,14 @@
 #include <Arduino.h>
 #include <MIDI.h> // Include MIDI library header
 
+#define SERIAL_MIDI_BAUD 31250
+
+// Received bytes parsed per loopSerialMidi() call; the rest wait in the
+// receive ring (serial_midi_port.h)
+#ifndef SERIAL_MIDI_RX_BUDGET
+#define SERIAL_MIDI_RX_BUDGET 64
+#endif
+
 // Declare functions for setup and loop processing for Serial MIDI
 void setupSerialMidi();
 void loopSerialMidi();
@@ -19,5 +27,7 @@ void sendSerialMidiAfterTouchChannel(byte channel, byte pressure); // For Channe
 void sendSerialMidiPitchBend(byte channel, int bend);
 void sendSerialMidiSysEx(unsigned size, const byte *array);
 void sendSerialMidiRealTime(midi::MidiType type);
+// Write already encoded MIDI bytes (e.g. the payload of a USB-MIDI packet)
+void sendSerialMidiRaw(const byte *data, unsigned size);
 
 #endif // SERIAL_MIDI_HANDLER_H
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include "serial_midi_port.h"
+#include "pin_config.h"
+#include "hardware/uart.h"
+#include "hardware/irq.h"
+#include "hardware/gpio.h"
+#include "hardware/timer.h"
+#include "pico/platform.h"
+
+#define SERIAL_MIDI_UART uart0
+#define SERIAL_MIDI_UART_IRQ UART0_IRQ
+#define RX_MASK (SERIAL_MIDI_RX_CAPACITY - 1)
+
+// The receive timeout interrupt fires after 32 idle bit periods
+#define RX_TIMEOUT_US (32 * SERIAL_MIDI_BYTE_US / 10)
+
+static_assert((SERIAL_MIDI_RX_CAPACITY & RX_MASK) == 0, "SERIAL_MIDI_RX_CAPACITY must be a power of two");
+
+typedef struct {
+    uint8_t value;
+    uint32_t timestamp;
+} RxByte;
+
+// Written by the interrupt (head) and loop() (tail), both on core 0
+static RxByte rxRing[SERIAL_MIDI_RX_CAPACITY];
+static volatile uint16_t rxHead = 0;
+static volatile uint16_t rxTail = 0;
+
+static volatile SerialMidiPortStats stats;
+
+static SerialMidiTxSource txSource = nullptr;
+// The FIFO holds SERIAL_MIDI_TX_AHEAD bytes, so a transmit interrupt is on
+// its way. The UART raises it when the level drops through the trigger,
+// not while it stays below, so an idle transmitter needs a kick.
+static volatile bool txArmed = false;
+
+// Write up to `count` bytes from the source. Called with the UART interrupt
+// held off (from the interrupt itself or under serialMidiPortLock()).
+static void fillTx(unsigned count) {
+    uart_hw_t *hw = uart_get_hw(SERIAL_MIDI_UART);
+    uint8_t value;
+    bool drained = false;
+    for (unsigned i = 0; i < count && !(hw->fr & UART_UARTFR_TXFF_BITS); i++) {
+        if (!txSource(value)) {
+            drained = true;
+            break;
+        }
+        hw->dr = value;
+        stats.txBytes++;
+    }
+    txArmed = !drained;
+    if (txArmed) {
+        hw_set_bits(&hw->imsc, UART_UARTIMSC_TXIM_BITS);
+    } else {
+        hw_clear_bits(&hw->imsc, UART_UARTIMSC_TXIM_BITS);
+    }
+}
+
+// Drains the hardware FIFO. Bytes that waited in the FIFO get the time they
+// came off the wire, worked back from the newest one: that one arrived just
+// now for a FIFO level interrupt, or one timeout period ago for a receive
+// timeout interrupt.
+static void __not_in_flash_func(receiveBytes)(uart_hw_t *hw) {
+    uint32_t newest = time_us_32();
+    if (hw->mis & UART_UARTMIS_RTMIS_BITS) {
+        newest -= RX_TIMEOUT_US;
+    }
+
+    uint32_t data[32];
+    unsigned count = 0;
+    while (!(hw->fr & UART_UARTFR_RXFE_BITS) && count < 32) {
+        data[count++] = hw->dr;
+    }
+
+    for (unsigned i = 0; i < count; i++) {
+        uint32_t dr = data[i];
+        if (dr & UART_UARTDR_OE_BITS) {
+            stats.rxErrors++; // Bytes were lost before this one; it is valid
+        }
+        if (dr & (UART_UARTDR_FE_BITS | UART_UARTDR_BE_BITS)) {
+            stats.rxErrors++;
+            continue;
+        }
+        uint16_t next = (rxHead + 1) & RX_MASK;
+        if (next == rxTail) {
+            stats.rxDropped++;
+            continue;
+        }
+        rxRing[rxHead].value = (uint8_t)dr;
+        rxRing[rxHead].timestamp = newest - (count - 1 - i) * SERIAL_MIDI_BYTE_US;
+        rxHead = next;
+        stats.rxBytes++;
+    }
+}
+
+static void __not_in_flash_func(serialMidiIrq)() {
+    uart_hw_t *hw = uart_get_hw(SERIAL_MIDI_UART);
+    uint32_t pending = hw->mis;
+    if (pending & (UART_UARTMIS_RXMIS_BITS | UART_UARTMIS_RTMIS_BITS)) {
+        receiveBytes(hw);
+    }
+    if (pending & UART_UARTMIS_TXMIS_BITS) {
+        // The FIFO just drained to the trigger level; one byte re-arms it
+        hw->icr = UART_UARTICR_TXIC_BITS;
+        fillTx(1);
+    }
+}
+
+void beginSerialMidiPort(unsigned long baud, SerialMidiTxSource source) {
+    txSource = source;
+    uart_init(SERIAL_MIDI_UART, baud);
+    uart_set_format(SERIAL_MIDI_UART, 8, 1, UART_PARITY_NONE);
+    uart_set_hw_flow(SERIAL_MIDI_UART, false, false);
+    // The FIFO keeps bytes that arrive while interrupts are off (flash writes)
+    uart_set_fifo_enabled(SERIAL_MIDI_UART, true);
+    gpio_set_function(SERIAL_MIDI_TX_PIN, GPIO_FUNC_UART);
+    gpio_set_function(SERIAL_MIDI_RX_PIN, GPIO_FUNC_UART);
+
+    irq_set_exclusive_handler(SERIAL_MIDI_UART_IRQ, serialMidiIrq);
+    irq_set_enabled(SERIAL_MIDI_UART_IRQ, true);
+    // Lowest FIFO levels plus the receive timeout; the transmit interrupt
+    // stays masked until there is something to send
+    uart_set_irq_enables(SERIAL_MIDI_UART, true, true);
+    hw_clear_bits(&uart_get_hw(SERIAL_MIDI_UART)->imsc, UART_UARTIMSC_TXIM_BITS);
+}
+
+unsigned serialMidiPortAvailable() {
+    return (rxHead - rxTail) & RX_MASK;
+}
+
+bool serialMidiPortRead(uint8_t &value, uint32_t &timestamp) {
+    uint16_t tail = rxTail;
+    if (tail == rxHead) {
+        return false;
+    }
+    value = rxRing[tail].value;
+    timestamp = rxRing[tail].timestamp;
+    rxTail = (tail + 1) & RX_MASK;
+
+    uint32_t latency = time_us_32() - timestamp;
+    stats.lastRxLatencyUs = latency;
+    if (latency > stats.maxRxLatencyUs) {
+        stats.maxRxLatencyUs = latency;
+    }
+    return true;
+}
+
+void serialMidiPortLock() {
+    irq_set_enabled(SERIAL_MIDI_UART_IRQ, false);
+}
+
+void serialMidiPortUnlock() {
+    irq_set_enabled(SERIAL_MIDI_UART_IRQ, true);
+}
+
+void serialMidiPortKickTx() {
+    if (txSource == nullptr) {
+        return;
+    }
+    // Not armed means the FIFO is at or below the trigger level, so filling
+    // up to SERIAL_MIDI_TX_AHEAD makes the level drop through it again. The
+    // FIFO may still hold a few bytes, which only matters right after an
+    // idle spell.
+    serialMidiPortLock();
+    if (!txArmed) {
+        fillTx(SERIAL_MIDI_TX_AHEAD);
+    }
+    serialMidiPortUnlock();
+}
+
+SerialMidiPortStats getSerialMidiPortStats() {
+    SerialMidiPortStats copy;
+    copy.rxBytes = stats.rxBytes;
+    copy.rxDropped = stats.rxDropped;
+    copy.rxErrors = stats.rxErrors;
+    copy.txBytes = stats.txBytes;
+    copy.lastRxLatencyUs = stats.lastRxLatencyUs;
+    copy.maxRxLatencyUs = stats.maxRxLatencyUs;
+    return copy;
+}
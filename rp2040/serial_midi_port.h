@@ -0,0 +1,58 @@
+#ifndef SERIAL_MIDI_PORT_H
+#define SERIAL_MIDI_PORT_H
+
+#include <Arduino.h>
+
+// DIN MIDI UART (uart0 on SERIAL_MIDI_TX_PIN/SERIAL_MIDI_RX_PIN), driven
+// directly instead of through Serial1. Received bytes are taken out of the
+// hardware FIFO by the UART interrupt, stamped with their arrival time and
+// kept in a ring until loop() reads them, so arrival times do not depend on
+// the loop rate. Transmit is driven by the same interrupt: whenever the
+// hardware FIFO drains to its trigger level the next byte is pulled from a
+// source (the output scheduler), so the wire keeps going however long a
+// loop() pass takes. Core 0 only.
+
+// Microseconds per byte on the wire at 31250 baud (start + 8 data + stop)
+#define SERIAL_MIDI_BYTE_US 320
+
+// Received bytes buffered between the interrupt and loop(); must be a
+// power of two
+#ifndef SERIAL_MIDI_RX_CAPACITY
+#define SERIAL_MIDI_RX_CAPACITY 256
+#endif
+
+typedef struct {
+    uint32_t rxBytes;
+    uint32_t rxDropped;        // Bytes lost because the ring was full
+    uint32_t rxErrors;         // Framing/break errors and hardware FIFO overruns
+    uint32_t txBytes;
+    uint32_t lastRxLatencyUs;  // Arrival on the wire to read() by the parser
+    uint32_t maxRxLatencyUs;
+} SerialMidiPortStats;
+
+// Bytes kept in the transmit FIFO: the trigger level (4, the lowest the
+// UART offers) plus the one that re-arms it. A byte pulled from the source
+// goes on the wire at most this many byte times later.
+#define SERIAL_MIDI_TX_AHEAD 5
+
+// Next byte to transmit; false if there is nothing to send now. Called from
+// the UART interrupt.
+typedef bool (*SerialMidiTxSource)(uint8_t &value);
+
+void beginSerialMidiPort(unsigned long baud, SerialMidiTxSource txSource);
+
+// Receive side
+unsigned serialMidiPortAvailable();
+// Next received byte and its arrival time (time_us_32()). Returns false if
+// the ring is empty.
+bool serialMidiPortRead(uint8_t &value, uint32_t &timestamp);
+
+// Transmit side. The source's state is shared with the interrupt: change
+// it between lock and unlock, then kick so an idle transmitter restarts.
+void serialMidiPortLock();
+void serialMidiPortUnlock();
+void serialMidiPortKickTx();
+
+SerialMidiPortStats getSerialMidiPortStats();
+
+#endif // SERIAL_MIDI_PORT_H
@@ -0,0 +1,367 @@
+#include "serial_midi_scheduler.h"
+#include "serial_midi_port.h"
+#include "midi_packet.h"
+
+#define LANE_MASK (SERIAL_MIDI_LANE_CAPACITY - 1)
+#define SYSEX_MASK (SERIAL_MIDI_SYSEX_CAPACITY - 1)
+#define REALTIME_CAPACITY 16
+#define REALTIME_MASK (REALTIME_CAPACITY - 1)
+
+static_assert((SERIAL_MIDI_LANE_CAPACITY & LANE_MASK) == 0, "SERIAL_MIDI_LANE_CAPACITY must be a power of two");
+static_assert((SERIAL_MIDI_SYSEX_CAPACITY & SYSEX_MASK) == 0, "SERIAL_MIDI_SYSEX_CAPACITY must be a power of two");
+
+// Channel and system common messages, in priority order
+typedef enum {
+    LANE_NOTE_OFF = 0,
+    LANE_NOTE_ON,
+    LANE_CONTROL,     // CC, program change, aftertouch, pitch bend, system common
+    LANE_COUNT
+} SerialMidiLane;
+
+typedef struct {
+    uint8_t bytes[3];
+    uint8_t length;
+} LaneMessage;
+
+typedef struct {
+    LaneMessage items[SERIAL_MIDI_LANE_CAPACITY];
+    uint16_t head;
+    uint16_t tail;
+} MessageLane;
+
+static MessageLane lanes[LANE_COUNT];
+
+static uint8_t realtimeBytes[REALTIME_CAPACITY];
+static uint8_t realtimeHead = 0;
+static uint8_t realtimeTail = 0;
+
+static uint8_t sysexBytes[SERIAL_MIDI_SYSEX_CAPACITY];
+static uint16_t sysexHead = 0;
+static uint16_t sysexTail = 0;
+
+// Writer side: message being assembled from the written bytes
+static uint8_t inMessage[3];
+static uint8_t inLength = 0;
+static uint8_t inExpected = 0;
+static bool inSysEx = false;
+static uint32_t sysexWrittenAt = 0;  // millis() of the last dump byte queued
+
+// Wire side
+static LaneMessage current;          // Message on the wire
+static uint8_t currentPos = 0;       // Next byte of `current` to send
+static bool sysexOpen = false;       // F0 sent, F7 not yet
+static uint32_t sysexActivity = 0;   // millis() of the last dump byte sent
+static uint8_t runningStatus = 0;    // 0 = none
+static uint32_t statusSentAt = 0;
+
+static SerialMidiSchedulerStats stats;
+
+static uint8_t messageLength(uint8_t status) {
+    switch (status & 0xF0) {
+        case 0xC0:
+        case 0xD0:
+            return 2;
+        case 0xF0:
+            if (status == 0xF1 || status == 0xF3) {
+                return 2;
+            }
+            return status == 0xF2 ? 3 : 1;
+        default:
+            return 3;
+    }
+}
+
+// --- Wire side ---
+
+static bool startNextMessage() {
+    for (uint8_t l = 0; l < LANE_COUNT; l++) {
+        MessageLane &lane = lanes[l];
+        if (lane.tail == lane.head) {
+            continue;
+        }
+        current = lane.items[lane.tail];
+        lane.tail = (lane.tail + 1) & LANE_MASK;
+        currentPos = 0;
+
+        uint8_t status = current.bytes[0];
+        if (SERIAL_MIDI_RUNNING_STATUS && status < 0xF0 && status == runningStatus &&
+            millis() - statusSentAt < SERIAL_MIDI_STATUS_REFRESH_MS) {
+            currentPos = 1;
+            stats.statusSaved++;
+        } else {
+            // System common messages cancel running status
+            runningStatus = status < 0xF0 ? status : 0;
+            statusSentAt = millis();
+        }
+        return true;
+    }
+    return false;
+}
+
+static bool lanesEmpty() {
+    for (uint8_t l = 0; l < LANE_COUNT; l++) {
+        if (lanes[l].tail != lanes[l].head) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A dump takes the port only once the writer has finished it, has queued
+// enough that the wire will not catch up soon, or has gone quiet. Until
+// then the channel lanes keep going.
+static bool sysexReady() {
+    if (sysexTail == sysexHead) {
+        return false;
+    }
+    return !inSysEx || ((sysexHead - sysexTail) & SYSEX_MASK) >= SERIAL_MIDI_SYSEX_CAPACITY / 2 ||
+           millis() - sysexWrittenAt > SERIAL_MIDI_SYSEX_TIMEOUT_MS;
+}
+
+// Next byte for the wire; false if nothing can be sent now
+static bool nextByte(uint8_t &value) {
+    if (realtimeTail != realtimeHead) {
+        value = realtimeBytes[realtimeTail];
+        realtimeTail = (realtimeTail + 1) & REALTIME_MASK;
+        if (currentPos < current.length || sysexOpen) {
+            stats.realtimeInserted++;
+        }
+        return true;
+    }
+
+    if (currentPos < current.length) {
+        value = current.bytes[currentPos++];
+        return true;
+    }
+
+    if (sysexOpen) {
+        if (sysexTail == sysexHead) {
+            // Rest of the dump still on its way. Channel messages only wait
+            // for it briefly.
+            uint32_t limit = lanesEmpty() ? SERIAL_MIDI_SYSEX_TIMEOUT_MS : SERIAL_MIDI_SYSEX_YIELD_MS;
+            if (millis() - sysexActivity <= limit) {
+                return false;
+            }
+            stats.sysexTimeouts++;
+            sysexOpen = false;
+            value = 0xF7;
+            return true;
+        }
+        value = sysexBytes[sysexTail];
+        sysexTail = (sysexTail + 1) & SYSEX_MASK;
+        sysexActivity = millis();
+        sysexOpen = value != 0xF7;
+        return true;
+    }
+
+    if (startNextMessage()) {
+        value = current.bytes[currentPos++];
+        return true;
+    }
+
+    if (!sysexReady()) {
+        return false;
+    }
+    while (sysexTail != sysexHead) {
+        value = sysexBytes[sysexTail];
+        sysexTail = (sysexTail + 1) & SYSEX_MASK;
+        // Anything before an F0 is the rest of a dump closed on timeout
+        if (value == 0xF0) {
+            sysexOpen = true;
+            sysexActivity = millis();
+            runningStatus = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Transmit source of the UART; runs in its interrupt
+bool serialMidiSchedulerNextByte(uint8_t &value) {
+    if (!nextByte(value)) {
+        return false;
+    }
+    stats.bytes++;
+    return true;
+}
+
+void loopSerialMidiScheduler() {
+    // The interrupt stops when the lanes run dry; restart it for output
+    // that only became due since (a dump closed on timeout)
+    serialMidiPortKickTx();
+}
+
+// --- Writer side ---
+
+static bool hasQueuedNoteOn(uint8_t channel, uint8_t note) {
+    const MessageLane &lane = lanes[LANE_NOTE_ON];
+    for (uint16_t i = lane.tail; i != lane.head; i = (i + 1) & LANE_MASK) {
+        const LaneMessage &msg = lane.items[i];
+        if ((msg.bytes[0] & 0xF0) == 0x90 && (msg.bytes[0] & 0x0F) == channel && msg.bytes[1] == note) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static SerialMidiLane laneFor(const uint8_t *bytes, uint8_t length) {
+    uint8_t kind = bytes[0] & 0xF0;
+    if (kind == 0x80 || (kind == 0x90 && length == 3 && bytes[2] == 0)) {
+        // Behind a queued note on of the same note, so it cannot end it early
+        return hasQueuedNoteOn(bytes[0] & 0x0F, bytes[1]) ? LANE_NOTE_ON : LANE_NOTE_OFF;
+    }
+    return kind == 0x90 ? LANE_NOTE_ON : LANE_CONTROL;
+}
+
+static uint16_t laneDepth(const MessageLane &lane) {
+    return (lane.head - lane.tail) & LANE_MASK;
+}
+
+// USB-MIDI packet form of a channel message, for the midi_packet helpers
+static void toPacket(const uint8_t *bytes, uint8_t length, uint8_t packet[4]) {
+    packet[0] = bytes[0] >> 4;
+    packet[1] = bytes[0];
+    packet[2] = bytes[1];
+    packet[3] = length > 2 ? bytes[2] : 0;
+}
+
+// Wire time of the queued channel messages exceeds the latency budget
+static bool isCongested() {
+    uint32_t queued = 0;
+    for (uint8_t l = 0; l < LANE_COUNT; l++) {
+        queued += laneDepth(lanes[l]);
+    }
+    return queued * 3 * SERIAL_MIDI_BYTE_US > SERIAL_MIDI_LATENCY_BUDGET_US;
+}
+
+// Under congestion a continuous control overwrites its queued predecessor,
+// unless it is a 14-bit controller MSB whose LSB is still queued: the
+// receiver would pair the new MSB with the old LSB
+static bool coalesceMessage(MessageLane &lane, const uint8_t *bytes, uint8_t length) {
+    uint8_t packet[4];
+    toPacket(bytes, length, packet);
+    uint32_t key = midiCoalesceKey(packet);
+    if (key == 0) {
+        return false;
+    }
+    LaneMessage *match = nullptr;
+    for (uint16_t i = lane.tail; i != lane.head; i = (i + 1) & LANE_MASK) {
+        LaneMessage &msg = lane.items[i];
+        uint8_t queued[4];
+        toPacket(msg.bytes, msg.length, queued);
+        if (midiIsControllerLsbOf(queued, packet)) {
+            return false;
+        }
+        if (match == nullptr && midiCoalesceKey(queued) == key) {
+            match = &msg;
+        }
+    }
+    if (match == nullptr) {
+        return false;
+    }
+    memcpy(match->bytes, bytes, length);
+    stats.coalesced++;
+    return true;
+}
+
+static void pushMessage(const uint8_t *bytes, uint8_t length) {
+    SerialMidiLane laneIndex = laneFor(bytes, length);
+    MessageLane &lane = lanes[laneIndex];
+    if (laneIndex == LANE_CONTROL && isCongested() && coalesceMessage(lane, bytes, length)) {
+        return;
+    }
+    uint16_t next = (lane.head + 1) & LANE_MASK;
+    if (next == lane.tail) {
+        stats.drops++;
+        return;
+    }
+    LaneMessage &msg = lane.items[lane.head];
+    memcpy(msg.bytes, bytes, length);
+    msg.length = length;
+    lane.head = next;
+}
+
+static void pushRealtime(uint8_t value) {
+    uint8_t next = (realtimeHead + 1) & REALTIME_MASK;
+    if (next == realtimeTail) {
+        stats.drops++;
+        return;
+    }
+    realtimeBytes[realtimeHead] = value;
+    realtimeHead = next;
+}
+
+static void pushSysEx(uint8_t value) {
+    uint16_t next = (sysexHead + 1) & SYSEX_MASK;
+    if (next == sysexTail) {
+        stats.drops++;
+        return;
+    }
+    sysexBytes[sysexHead] = value;
+    sysexHead = next;
+    sysexWrittenAt = millis();
+}
+
+static void startMessage(uint8_t status) {
+    inMessage[0] = status;
+    inLength = 1;
+    inExpected = messageLength(status);
+    if (inExpected == 1) {
+        pushMessage(inMessage, 1);
+        inLength = 0;
+    }
+}
+
+void serialMidiSchedulerWrite(const byte *data, unsigned size) {
+    serialMidiPortLock();
+    for (unsigned i = 0; i < size; i++) {
+        uint8_t value = data[i];
+        if (value >= 0xF8) {
+            pushRealtime(value);
+        } else if (value == 0xF0) {
+            if (inSysEx) {
+                pushSysEx(0xF7); // Unterminated dump followed by a new one
+            }
+            inSysEx = true;
+            inLength = 0;
+            pushSysEx(value);
+        } else if (value == 0xF7) {
+            if (inSysEx) {
+                pushSysEx(value);
+                inSysEx = false;
+            } // Otherwise a stray end of SysEx
+        } else if (value & 0x80) {
+            // A message written between two fragments of a dump goes to its
+            // lane; the dump goes on with the next fragment
+            startMessage(value);
+        } else if (inLength > 0) {
+            inMessage[inLength++] = value;
+            if (inLength == inExpected) {
+                pushMessage(inMessage, inLength);
+                // Keep the status for data bytes written with running
+                // status; inside a dump they are SysEx data again
+                inLength = inMessage[0] < 0xF0 && !inSysEx ? 1 : 0;
+            }
+        } else if (inSysEx) {
+            pushSysEx(value);
+        }
+    }
+    serialMidiPortUnlock();
+    serialMidiPortKickTx();
+}
+
+bool serialMidiSchedulerHasRoom() {
+    for (uint8_t l = 0; l < LANE_COUNT; l++) {
+        if (((lanes[l].tail - lanes[l].head - 1) & LANE_MASK) < SERIAL_MIDI_HEADROOM_MESSAGES) {
+            return false;
+        }
+    }
+    if (((realtimeTail - realtimeHead - 1) & REALTIME_MASK) < SERIAL_MIDI_HEADROOM_MESSAGES) {
+        return false;
+    }
+    return ((sysexTail - sysexHead - 1) & SYSEX_MASK) >= SERIAL_MIDI_HEADROOM_SYSEX;
+}
+
+SerialMidiSchedulerStats getSerialMidiSchedulerStats() {
+    return stats;
+}
@@ -0,0 +1,95 @@
+#ifndef SERIAL_MIDI_SCHEDULER_H
+#define SERIAL_MIDI_SCHEDULER_H
+
+#include <Arduino.h>
+
+// Output scheduler for the DIN serial port. At 31250 baud a byte takes
+// 320 us, so instead of writing whole messages into the UART it keeps
+// outgoing traffic in priority lanes and the UART interrupt
+// (serial_midi_port.h) pulls one byte at a time, never more than
+// SERIAL_MIDI_TX_AHEAD bytes ahead of the wire:
+//
+//   real-time  >  note off  >  note on  >  other channel/system common  >  SysEx
+//
+// Real-time bytes (clock, start, stop, ...) go out between the bytes of any
+// message, as the MIDI spec allows, so their jitter stays within
+// SERIAL_MIDI_TX_AHEAD byte times (1.6 ms). Other messages are never split;
+// a SysEx dump that has started keeps the port (real-time excepted) until
+// its F7. Channel messages use running status. A note off never overtakes
+// a queued note on of the same note.
+//
+// Notes and real-time have lanes of their own, so other traffic cannot
+// take their room. Writing never blocks; instead every input checks
+// serialMidiSchedulerHasRoom() (through the router) before reading more,
+// which holds the sender back before any lane fills. A write that still
+// finds its lane full drops and counts. Core 0 only.
+
+// Queued messages per channel message lane; must be a power of two
+#ifndef SERIAL_MIDI_LANE_CAPACITY
+#define SERIAL_MIDI_LANE_CAPACITY 32
+#endif
+
+// Queued SysEx bytes; must be a power of two
+#ifndef SERIAL_MIDI_SYSEX_CAPACITY
+#define SERIAL_MIDI_SYSEX_CAPACITY 512
+#endif
+
+// Set to 0 for receivers that mishandle running status
+#ifndef SERIAL_MIDI_RUNNING_STATUS
+#define SERIAL_MIDI_RUNNING_STATUS 1
+#endif
+
+// Room serialMidiSchedulerHasRoom() asks for: enough for one more USB-MIDI
+// packet's worth of output with margin
+#define SERIAL_MIDI_HEADROOM_MESSAGES 4
+#define SERIAL_MIDI_HEADROOM_SYSEX 16
+
+// Queued channel messages may take this long on the wire before the port
+// counts as congested. Continuous controls (CC, pitch bend, aftertouch; see
+// midiCoalesceKey()) then replace their queued predecessor, latest value
+// wins, so a knob sweep cannot push notes further back. Notes and
+// real-time are never coalesced, nor is a 14-bit controller MSB (CC 0-31)
+// while its LSB (CC 32-63) is queued.
+#define SERIAL_MIDI_LATENCY_BUDGET_US 5000
+
+// The status byte is sent again after this long, so a receiver plugged in
+// mid-stream picks up running status
+#define SERIAL_MIDI_STATUS_REFRESH_MS 300
+
+// A dump whose next bytes do not arrive within this time is closed with F7
+// so the other lanes can go on; within the shorter time if channel
+// messages are waiting. A dump only starts once it is complete or at least
+// half the SysEx ring, so this only cuts off senders that stall mid-dump.
+#define SERIAL_MIDI_SYSEX_TIMEOUT_MS 500
+#define SERIAL_MIDI_SYSEX_YIELD_MS 20
+
+typedef struct {
+    uint32_t bytes;             // Bytes written to the UART
+    uint32_t statusSaved;       // Status bytes left out thanks to running status
+    uint32_t realtimeInserted;  // Real-time bytes sent inside another message
+    uint32_t drops;             // Bytes/messages lost because their lane was full
+    uint32_t coalesced;         // Continuous controls merged into a queued one
+    uint32_t sysexTimeouts;     // Dumps closed because their sender went quiet
+} SerialMidiSchedulerStats;
+
+// Queue raw MIDI bytes: complete channel or system common messages,
+// real-time bytes and SysEx, whole or in fragments. Messages written
+// between the fragments of a dump go to their lanes without ending it;
+// only a new F0 (or the timeout) closes an unterminated dump.
+void serialMidiSchedulerWrite(const byte *data, unsigned size);
+
+// True while every lane, real-time included, can take at least the
+// headroom above
+bool serialMidiSchedulerHasRoom();
+
+// Restart the UART interrupt for output that became due without a write.
+// Call from loop().
+void loopSerialMidiScheduler();
+
+// Next byte for the wire; the transmit source handed to
+// beginSerialMidiPort(). Runs in the UART interrupt.
+bool serialMidiSchedulerNextByte(uint8_t &value);
+
+SerialMidiSchedulerStats getSerialMidiSchedulerStats();
+
+#endif // SERIAL_MIDI_SCHEDULER_H
@@ -0,0 +1,123 @@
+#include "sysex_assembler.h"
+
+// Fixed pool of reassembly buffers, no heap. Not shared between cores:
+// all assemblers live on the core that feeds them.
+static byte sysexPool[SYSEX_POOL_BUFFERS][SYSEX_MAX_LENGTH];
+static bool sysexPoolUsed[SYSEX_POOL_BUFFERS] = {false};
+
+static volatile uint32_t statCompleted = 0;
+static volatile uint32_t statChunks = 0;
+static volatile uint32_t statPoolExhausted = 0;
+static volatile uint8_t statBuffersInUse = 0;
+
+static byte *acquireBuffer() {
+    for (int i = 0; i < SYSEX_POOL_BUFFERS; i++) {
+        if (!sysexPoolUsed[i]) {
+            sysexPoolUsed[i] = true;
+            statBuffersInUse++;
+            return sysexPool[i];
+        }
+    }
+    return nullptr;
+}
+
+static void releaseBuffer(byte *buffer) {
+    for (int i = 0; i < SYSEX_POOL_BUFFERS; i++) {
+        if (sysexPool[i] == buffer && sysexPoolUsed[i]) {
+            sysexPoolUsed[i] = false;
+            statBuffersInUse--;
+            return;
+        }
+    }
+}
+
+static void finishMessage(SysExAssembler &assembler) {
+    if (assembler.buffer != nullptr) {
+        releaseBuffer(assembler.buffer);
+    }
+    assembler.buffer = nullptr;
+    assembler.length = 0;
+    assembler.active = false;
+    assembler.streaming = false;
+}
+
+static void flushBuffer(SysExAssembler &assembler) {
+    if (assembler.length > 0 && assembler.handler != nullptr) {
+        assembler.handler(assembler.buffer, assembler.length);
+    }
+    assembler.length = 0;
+}
+
+void sysExAssemblerInit(SysExAssembler &assembler, SysExHandler handler) {
+    assembler.buffer = nullptr;
+    assembler.length = 0;
+    assembler.active = false;
+    assembler.streaming = false;
+    assembler.handler = handler;
+}
+
+void sysExAssemblerReset(SysExAssembler &assembler) {
+    finishMessage(assembler);
+}
+
+void sysExAssemblerFeed(SysExAssembler &assembler, const byte *data, unsigned size) {
+    if (size == 0) return;
+
+    if (data[0] == 0xF0) {
+        if (assembler.active && !assembler.streaming) {
+            // Unterminated message: pass on what we have before starting over
+            flushBuffer(assembler);
+        }
+        finishMessage(assembler);
+        assembler.active = true;
+        assembler.buffer = acquireBuffer();
+        if (assembler.buffer == nullptr) {
+            assembler.streaming = true;
+            statPoolExhausted++;
+        }
+    } else if (!assembler.active) {
+        return; // Continuation without a start byte
+    }
+
+    bool ended = false;
+    for (unsigned i = 0; i < size; i++) {
+        if (data[i] == 0xF7) {
+            size = i + 1;
+            ended = true;
+            break;
+        }
+    }
+
+    if (assembler.streaming) {
+        if (assembler.handler != nullptr) {
+            assembler.handler(const_cast<byte *>(data), size);
+        }
+        if (ended) {
+            finishMessage(assembler);
+        }
+        return;
+    }
+
+    for (unsigned i = 0; i < size; i++) {
+        if (assembler.length == SYSEX_MAX_LENGTH) {
+            flushBuffer(assembler);
+            statChunks++;
+        }
+        assembler.buffer[assembler.length++] = data[i];
+    }
+
+    if (ended) {
+        flushBuffer(assembler);
+        statCompleted++;
+        finishMessage(assembler);
+    }
+}
+
+SysExAssemblerStats getSysExAssemblerStats() {
+    SysExAssemblerStats stats;
+    stats.completed = statCompleted;
+    stats.chunks = statChunks;
+    stats.poolExhausted = statPoolExhausted;
+    stats.buffersInUse = statBuffersInUse;
+    return stats;
+}
@@ -0,0 +1,48 @@
+#ifndef SYSEX_ASSEMBLER_H
+#define SYSEX_ASSEMBLER_H
+
+#include <Arduino.h>
+
+// Longest SysEx forwarded as a single message. Longer dumps are forwarded
+// in chunks of this size as they arrive.
+#ifndef SYSEX_MAX_LENGTH
+#define SYSEX_MAX_LENGTH 1024
+#endif
+
+// Number of SysEx messages that can be reassembled at the same time.
+// Each buffer is SYSEX_MAX_LENGTH bytes of static RAM.
+#ifndef SYSEX_POOL_BUFFERS
+#define SYSEX_POOL_BUFFERS 4
+#endif
+
+// Receives a complete SysEx message or one streamed chunk of a long one
+typedef void (*SysExHandler)(byte *data, unsigned size);
+
+// Reassembly state for one input stream (e.g. one USB device cable).
+// Holds a pool buffer only while a message is in progress.
+typedef struct {
+    byte *buffer;
+    unsigned length;
+    bool active;      // Between F0 and F7
+    bool streaming;   // No pool buffer: fragments are forwarded as they arrive
+    SysExHandler handler;
+} SysExAssembler;
+
+typedef struct {
+    uint32_t completed;      // Messages forwarded whole
+    uint32_t chunks;         // Chunks forwarded because a message exceeded SYSEX_MAX_LENGTH
+    uint32_t poolExhausted;  // Messages streamed unbuffered because no pool buffer was free
+    uint8_t buffersInUse;
+} SysExAssemblerStats;
+
+void sysExAssemblerInit(SysExAssembler &assembler, SysExHandler handler);
+
+// Feed the payload of one SysEx packet (CIN 0x4-0x7)
+void sysExAssemblerFeed(SysExAssembler &assembler, const byte *data, unsigned size);
+
+// Drop any message in progress and return its buffer to the pool
+void sysExAssemblerReset(SysExAssembler &assembler);
+
+SysExAssemblerStats getSysExAssemblerStats();
+
+#endif // SYSEX_ASSEMBLER_H
@@ -0,0 +1,168 @@
+// SysEx transmit to a USB host device: 1, 16 and 64 KB dumps go through
+// sendHostPortSysEx() in SYSEX_MAX_LENGTH chunks (as the router forwards
+// them from the reassembler) and through sendHostPortPacket() one packet
+// at a time (as the router drains a parked SysEx), both under flow control
+// on getHostPortTxSpace(). The device side is fake_tinyusb: one 64-byte
+// transfer per 1 ms frame, so the simulated rate is the bus limit of that
+// model, and the CPU rate is what the wrapper itself costs.
+
+#include "host_test.h"
+#include "fake_tinyusb.h"
+#include "usb_host_wrapper.h"
+#include "usb_host_midi_handlers.h"
+#include "midi_packet.h"
+#include "sysex_assembler.h"
+#include "led_utils.h"
+#include <vector>
+
+// --- Router side of the wrapper (input is not used here) ---
+
+void usbh_setReceivePort(uint8_t port) { (void)port; }
+void usbh_onSysEx(byte *array, unsigned size) { (void)array; (void)size; }
+void usbh_onNoteOn(byte channel, byte note, byte velocity) { (void)channel; (void)note; (void)velocity; }
+void usbh_onNoteOff(byte channel, byte note, byte velocity) { (void)channel; (void)note; (void)velocity; }
+void usbh_onPolyAftertouch(byte channel, byte note, byte amount) { (void)channel; (void)note; (void)amount; }
+void usbh_onControlChange(byte channel, byte controller, byte value) { (void)channel; (void)controller; (void)value; }
+void usbh_onProgramChange(byte channel, byte program) { (void)channel; (void)program; }
+void usbh_onChannelAftertouch(byte channel, byte value) { (void)channel; (void)value; }
+void usbh_onPitchBend(byte channel, int value) { (void)channel; (void)value; }
+void usbh_onMidiClock() {}
+void usbh_onMidiStart() {}
+void usbh_onMidiContinue() {}
+void usbh_onMidiStop() {}
+
+bool midiRouterHasHeadroom() { return true; }
+void triggerUsbLED() {}
+
+// --- Helpers ---
+
+static std::vector<uint8_t> makeDump(unsigned size) {
+    std::vector<uint8_t> dump(size);
+    dump[0] = 0xF0;
+    for (unsigned i = 1; i + 1 < size; i++) {
+        dump[i] = (uint8_t)((i * 13) & 0x7F);
+    }
+    dump[size - 1] = 0xF7;
+    return dump;
+}
+
+// Bytes carried by the packets a device received, checking every packet
+// is SysEx on cable 0
+static std::vector<uint8_t> unpackSent(const std::vector<uint8_t> &sent, bool *valid) {
+    std::vector<uint8_t> bytes;
+    *valid = true;
+    for (size_t i = 0; i + 3 < sent.size(); i += 4) {
+        uint8_t cin = sent[i] & 0x0F;
+        unsigned length;
+        switch (cin) {
+            case 0x4: case 0x7: length = 3; break;
+            case 0x6: length = 2; break;
+            case 0x5: case 0xF: length = 1; break;
+            default: length = 0; break;
+        }
+        if (length == 0 || (sent[i] >> 4) != 0) {
+            *valid = false;
+        }
+        bytes.insert(bytes.end(), sent.begin() + i + 1, sent.begin() + i + 1 + length);
+    }
+    return bytes;
+}
+
+typedef struct {
+    uint32_t frames;        // Simulated milliseconds until the device had everything
+    uint64_t cycles;        // Spent in the wrapper's send, task and callback paths
+    uint64_t ns;
+    uint32_t drops;
+    bool intact;
+} TxRun;
+
+// Send `dump` to host port 0. Per frame: queue as much as fits, run the
+// host task, then let the bus move one transfer.
+static TxRun sendDump(const std::vector<uint8_t> &dump, bool chunked) {
+    fakeUsbUnmount(0);
+    fakeUsbMount(0, 1);
+    uint32_t dropsBefore = getHostTxQueueStats(0).drops;
+
+    TxRun run = {};
+    size_t pos = 0;
+    MidiSysExEncoder encoder;
+    uint8_t packet[4];
+    bool packetPending = false;
+    midiSysExEncoderBegin(encoder, dump.data(), dump.size());
+
+    while (run.frames < 100000) {
+        uint64_t startNs = hostBenchNanos();
+        uint64_t startCycles = hostBenchCycles();
+        if (chunked) {
+            while (pos < dump.size()) {
+                unsigned size = dump.size() - pos < SYSEX_MAX_LENGTH ? dump.size() - pos : SYSEX_MAX_LENGTH;
+                if (midiSysExPacketCount(&dump[pos], size) > getHostPortTxSpace(0)) {
+                    break;
+                }
+                sendHostPortSysEx(0, size, &dump[pos]);
+                pos += size;
+            }
+        } else {
+            while (getHostPortTxSpace(0) > 0) {
+                if (!packetPending && !midiSysExEncoderNext(encoder, packet)) {
+                    break;
+                }
+                packetPending = !sendHostPortPacket(0, packet);
+                if (packetPending) {
+                    break;
+                }
+            }
+        }
+        usb_host_wrapper_task();
+        fakeUsbFrame();
+        run.cycles += hostBenchCycles() - startCycles;
+        run.ns += hostBenchNanos() - startNs;
+        run.frames++;
+
+        bool allQueued = chunked ? pos == dump.size() : (!packetPending && encoder.pos >= encoder.size);
+        if (allQueued && getHostTxQueueStats(0).depth == 0) {
+            // The last transfer completes on the next frame
+            fakeUsbFrame();
+            run.frames++;
+            break;
+        }
+    }
+
+    bool valid;
+    run.intact = unpackSent(fakeUsbSent(0), &valid) == dump && valid;
+    run.drops = getHostTxQueueStats(0).drops - dropsBefore;
+    return run;
+}
+
+static void benchDump(unsigned size, bool chunked) {
+    std::vector<uint8_t> dump = makeDump(size);
+    TxRun run = sendDump(dump, chunked);
+    CHECK(run.intact);
+    CHECK_EQ(run.drops, 0);
+
+    char name[64];
+    snprintf(name, sizeof(name), "host_tx_%s_%ukb", chunked ? "chunks" : "packets", size / 1024);
+    std::string base = name;
+    hostBenchReport((base + "_bus_rate").c_str(), size / (run.frames / 1000.0) / 1000.0, "KB/s");
+    hostBenchReport((base + "_cpu_per_byte").c_str(), (double)run.cycles / size, hostBenchCycleUnit());
+    hostBenchReport((base + "_cpu_rate").c_str(), size / (run.ns / 1e9) / 1e6, "MB/s");
+}
+
+// --- Tests ---
+
+TEST(ChunkFitsTheTransmitQueue) {
+    // A full reassembler chunk without its F7 is the largest single send
+    fakeUsbUnmount(0);
+    fakeUsbMount(0, 1);
+    std::vector<uint8_t> chunk(SYSEX_MAX_LENGTH, 0x11);
+    chunk[0] = 0xF0;
+    CHECK(midiSysExPacketCount(chunk.data(), chunk.size()) <= getHostPortTxSpace(0));
+    CHECK(sendHostPortSysEx(0, chunk.size(), chunk.data()));
+}
+
+TEST(SysExChunks1KB) { benchDump(1024, true); }
+TEST(SysExChunks16KB) { benchDump(16 * 1024, true); }
+TEST(SysExChunks64KB) { benchDump(64 * 1024, true); }
+TEST(SysExPackets1KB) { benchDump(1024, false); }
+TEST(SysExPackets16KB) { benchDump(16 * 1024, false); }
+TEST(SysExPackets64KB) { benchDump(64 * 1024, false); }
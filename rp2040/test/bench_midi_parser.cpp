@@ -0,0 +1,88 @@
+// DIN input parser throughput: random well-formed streams (midi_streams.h)
+// fed one byte at a time through midiParserFeed(), with running status,
+// real-time bytes between and inside messages, system common and SysEx.
+// Every message the stream holds must come out, with nothing counted as
+// stray or truncated. The rate is also given as a multiple of the 3125
+// bytes/s a DIN line carries.
+// fuzz_midi_parser checks the output itself against the MIDI Library.
+
+#include "host_test.h"
+#include "midi_parser.h"
+#include "midi_streams.h"
+#include <string>
+
+#define STREAM_BYTES (1024 * 1024)
+#define DIN_BYTES_PER_SECOND 3125
+
+static uint32_t packets = 0;
+static uint32_t dumps = 0;
+static uint32_t sysexBytes = 0;
+
+static void onPacket(uint8_t packet[4]) {
+    (void)packet;
+    packets++;
+}
+
+static void onSysEx(uint8_t *data, unsigned size) {
+    sysexBytes += size;
+    if (data[size - 1] == 0xF7) {
+        dumps++;
+    }
+}
+
+static void benchStream(const char *name, const MidiStreamMix &mix) {
+    std::vector<uint8_t> stream;
+    uint32_t seed = 1;
+    uint32_t messages = appendMidiStream(stream, STREAM_BYTES, mix, seed);
+
+    MidiParser parser;
+    const unsigned long rounds = hostBenchIterations(4);
+    uint64_t cycles = 0, ns = 0;
+    for (unsigned long round = 0; round < rounds; round++) {
+        midiParserInit(parser, onPacket, onSysEx);
+        packets = dumps = sysexBytes = 0;
+        uint64_t startNs = hostBenchNanos();
+        uint64_t startCycles = hostBenchCycles();
+        for (uint8_t value : stream) {
+            midiParserFeed(parser, value);
+        }
+        cycles += hostBenchCycles() - startCycles;
+        ns += hostBenchNanos() - startNs;
+    }
+
+    CHECK_EQ(packets + dumps, messages);
+    CHECK_EQ(parser.stats.stray, 0);
+    CHECK_EQ(parser.stats.truncated, 0);
+
+    const double bytes = (double)stream.size() * rounds;
+    const double rate = bytes / (ns / 1e9);
+    std::string base = std::string("midi_parser_") + name;
+    hostBenchReport((base + "_per_byte").c_str(), cycles / bytes, hostBenchCycleUnit());
+    hostBenchReport((base + "_rate").c_str(), rate / 1e6, "MB/s");
+    hostBenchReport((base + "_x_din_rate").c_str(), rate / DIN_BYTES_PER_SECOND, "x");
+}
+
+TEST(ChannelRunningStatus) {
+    MidiStreamMix mix = { 1, 0, 0, 0, true, 0 };
+    benchStream("channel_running_status", mix);
+}
+
+TEST(ChannelExplicitStatus) {
+    MidiStreamMix mix = { 1, 0, 0, 0, false, 0 };
+    benchStream("channel_explicit_status", mix);
+}
+
+TEST(RealtimeInterleaved) {
+    MidiStreamMix mix = { 1, 0, 0, 25, true, 0 };
+    benchStream("realtime_interleaved", mix);
+}
+
+TEST(SysExDumps) {
+    MidiStreamMix mix = { 0, 0, 1, 0, false, 4096 };
+    benchStream("sysex", mix);
+}
+
+TEST(Mixed) {
+    MidiStreamMix mix = { 20, 2, 1, 5, true, 256 };
+    benchStream("mixed", mix);
+}
@@ -0,0 +1,345 @@
+// Cost of routing one message: rate limit, route lookup, a single
+// encodeMidiMessage() and the fan-out through the packet sinks, for one to
+// ten destinations. The sinks only count what reaches them, so the numbers
+// are the router's own share. Destinations on the other core are measured
+// in two halves: queueing on the source core and loopMidiRouter() on the
+// owning core.
+//
+// The *_before numbers are the baseline: the same fan-out done the way
+// forwardToInterface() did it, with filter lookups per destination and
+// each destination encoding the message itself. It writes DIN a byte at a
+// time, as the MIDI Library did to its transport. The MIDI Library's own
+// overhead is not in it (the host build has no library), so the baseline
+// is, if anything, too fast.
+
+#include "host_test.h"
+#include "midi_router.h"
+#include "midi_filters.h"
+#include "midi_packet.h"
+#include "midi_rate_limit.h"
+#include "usb_host_wrapper.h"
+#include "usb_device_midi_handlers.h"
+#include "serial_midi_handler.h"
+#include "serial_midi_scheduler.h"
+#include "config_sysex.h"
+#include "led_utils.h"
+#include "pico/platform.h"
+
+extern bool debug;  // serial_utils.cpp
+volatile bool isConnectedToComputer = true;
+
+// --- Counting sinks ---
+
+static uint32_t hostPackets = 0;
+static uint32_t devicePackets = 0;
+static uint32_t serialBytes = 0;
+static MidiEndpointMask mountedPorts = 0;
+
+bool sendHostPortPacket(uint8_t port, const uint8_t packet[4]) {
+    (void)port;
+    (void)packet;
+    hostPackets++;
+    return true;
+}
+
+bool sendHostPortSysEx(uint8_t port, unsigned size, const byte *array) {
+    (void)port;
+    (void)array;
+    hostPackets += (size + 2) / 3;
+    return true;
+}
+
+uint16_t getHostPortTxSpace(uint8_t port, bool priority) {
+    (void)port;
+    (void)priority;
+    return HOST_TX_QUEUE_CAPACITY - 1;
+}
+
+MidiEndpointMask getMountedHostPortMask() {
+    return mountedPorts;
+}
+
+bool sendUsbDevicePacket(const uint8_t packet[4]) {
+    (void)packet;
+    devicePackets++;
+    return true;
+}
+
+uint16_t getUsbDeviceTxSpace(bool priority) {
+    (void)priority;
+    return USB_DEVICE_TX_QUEUE_CAPACITY - 1;
+}
+
+void sendSerialMidiRaw(const byte *data, unsigned size) {
+    (void)data;
+    serialBytes += size;
+}
+
+bool serialMidiSchedulerHasRoom() {
+    return true;
+}
+
+void triggerSerialLED() {}
+void triggerUsbLED() {}
+
+bool isConfigSysExEndpoint(uint8_t endpoint) {
+    (void)endpoint;
+    return false;
+}
+
+bool receiveConfigSysEx(uint8_t endpoint, const uint8_t *data, unsigned size,
+                        const uint8_t **reply, unsigned *replySize) {
+    (void)endpoint;
+    (void)data;
+    (void)size;
+    (void)reply;
+    (void)replySize;
+    return false;
+}
+
+// --- Benchmark ---
+
+static MidiMessage noteOn(uint8_t note) {
+    MidiMessage msg = {};
+    msg.type = MIDI_MSG_NOTE;
+    msg.channel = 1;
+    msg.data1 = note & 0x7F;
+    msg.data2 = 100;
+    return msg;
+}
+
+// Filters pass everything; the router trace is off unless a test measures it
+static void setupBench() {
+    static bool done = false;
+    if (!done) {
+        setupMidiFilters();
+        done = true;
+    }
+    debug = false;
+    Serial.discardOutput();
+    Serial2.discardOutput();
+}
+
+static void resetCounters() {
+    setupBench();
+    hostPackets = 0;
+    devicePackets = 0;
+    serialBytes = 0;
+}
+
+// Routes `count` note ons from `source` on `core`, one simulated
+// millisecond apart so the default rate limits never kick in. Returns
+// timestamp ticks per message.
+static double routeNotes(MidiSource source, uint8_t port, uint8_t core, unsigned long count) {
+    shimCoreNum = core;
+    uint64_t total = 0;
+    for (unsigned long i = 0; i < count; i++) {
+        MidiMessage msg = noteOn((uint8_t)i);
+        msg.port = port;
+        shimAdvanceMillis(1);
+        uint64_t start = hostBenchCycles();
+        routeMidiMessage(source, msg);
+        total += hostBenchCycles() - start;
+        if (core == 0 && (i & 63) == 63) {
+            // Keep the core 1 queue from filling up
+            shimCoreNum = 1;
+            loopMidiRouter();
+            shimCoreNum = core;
+        }
+    }
+    shimCoreNum = 0;
+    return (double)total / count;
+}
+
+// --- Baseline: per-destination encoding ---
+
+// Status and data bytes of a channel message, as each send function of
+// the old forwardToInterface() worked them out. Returns the length.
+static uint8_t legacyBytes(const MidiMessage &msg, uint8_t bytes[3]) {
+    uint8_t channel = (msg.channel - 1) & 0x0F;
+    switch (msg.type) {
+        case MIDI_MSG_NOTE:
+            bytes[0] = (msg.subType == 1 ? 0x80 : 0x90) | channel;
+            bytes[1] = msg.data1 & 0x7F;
+            bytes[2] = msg.data2 & 0x7F;
+            return 3;
+        case MIDI_MSG_POLY_AFTERTOUCH:
+            bytes[0] = 0xA0 | channel;
+            bytes[1] = msg.data1 & 0x7F;
+            bytes[2] = msg.data2 & 0x7F;
+            return 3;
+        case MIDI_MSG_CONTROL_CHANGE:
+            bytes[0] = 0xB0 | channel;
+            bytes[1] = msg.data1 & 0x7F;
+            bytes[2] = msg.data2 & 0x7F;
+            return 3;
+        case MIDI_MSG_PROGRAM_CHANGE:
+            bytes[0] = 0xC0 | channel;
+            bytes[1] = msg.data1 & 0x7F;
+            return 2;
+        case MIDI_MSG_CHANNEL_AFTERTOUCH:
+            bytes[0] = 0xD0 | channel;
+            bytes[1] = msg.data1 & 0x7F;
+            return 2;
+        case MIDI_MSG_PITCH_BEND: {
+            unsigned bend = (unsigned)(msg.pitchBend + 8192);
+            bytes[0] = 0xE0 | channel;
+            bytes[1] = bend & 0x7F;
+            bytes[2] = (bend >> 7) & 0x7F;
+            return 3;
+        }
+        default:
+            return 0;
+    }
+}
+
+static void legacyForwardPacket(bool toHost, uint8_t port, const MidiMessage &msg) {
+    uint8_t bytes[3] = {0, 0, 0};
+    if (legacyBytes(msg, bytes) == 0) {
+        return;
+    }
+    uint8_t packet[4] = {(uint8_t)(bytes[0] >> 4), bytes[0], bytes[1], bytes[2]};
+    if (toHost) {
+        sendHostPortPacket(port, packet);
+    } else {
+        sendUsbDevicePacket(packet);
+    }
+}
+
+static void legacyForwardSerial(const MidiMessage &msg) {
+    uint8_t bytes[3];
+    uint8_t length = legacyBytes(msg, bytes);
+    for (uint8_t i = 0; i < length; i++) {
+        sendSerialMidiRaw(&bytes[i], 1);
+    }
+}
+
+// The old routeMidiMessage(): channel and filter checks, then every
+// destination in turn
+static void legacyRoute(MidiSource source, const MidiMessage &msg) {
+    if (msg.channel != 0 && !isChannelEnabled(msg.channel)) {
+        return;
+    }
+    if (isMidiFiltered((MidiInterfaceType)source, msg.type)) {
+        return;
+    }
+    if (!isMidiDestFiltered(MIDI_INTERFACE_USB_HOST, msg.type)) {
+        for (uint8_t port = 0; port < MIDI_HOST_PORTS; port++) {
+            bool self = source == MIDI_SOURCE_USB_HOST && port == msg.port;
+            if (!self && (mountedPorts & routeToHostPort(port))) {
+                legacyForwardPacket(true, port, msg);
+            }
+        }
+    }
+    if (isConnectedToComputer && source != MIDI_SOURCE_USB_DEVICE &&
+        !isMidiDestFiltered(MIDI_INTERFACE_USB_DEVICE, msg.type)) {
+        legacyForwardPacket(false, 0, msg);
+    }
+    if (source != MIDI_SOURCE_SERIAL && !isMidiDestFiltered(MIDI_INTERFACE_SERIAL, msg.type)) {
+        legacyForwardSerial(msg);
+    }
+}
+
+// routeNotes() through legacyRoute(), all on one core
+static double legacyRouteNotes(MidiSource source, uint8_t port, unsigned long count) {
+    uint64_t total = 0;
+    for (unsigned long i = 0; i < count; i++) {
+        MidiMessage msg = noteOn((uint8_t)i);
+        msg.port = port;
+        uint64_t start = hostBenchCycles();
+        legacyRoute(source, msg);
+        total += hostBenchCycles() - start;
+    }
+    return (double)total / count;
+}
+
+static void report(const char *name, double perMessage) {
+    hostBenchReport(name, perMessage, hostBenchCycleUnit());
+}
+
+TEST(RouteToOneLocalDestination) {
+    // USB device in, DIN out: both on core 0, no queue involved
+    mountedPorts = 0;
+    resetCounters();
+    unsigned long count = hostBenchIterations(20000);
+    double cost = routeNotes(MIDI_SOURCE_USB_DEVICE, 0, 0, count);
+    CHECK_EQ(serialBytes, count * 3);
+    CHECK_EQ(devicePackets, 0);
+    report("route_device_to_din", cost);
+}
+
+TEST(RouteToEveryDestination) {
+    // USB host port 0 in (core 1): DIN and USB device are queued for
+    // core 0, the seven other host ports are written directly
+    mountedPorts = ROUTE_TO_USB_HOST;
+    resetCounters();
+    unsigned long count = hostBenchIterations(20000);
+    uint64_t drainTotal = 0;
+    double cost = 0;
+    for (unsigned long done = 0; done < count; done += 64) {
+        cost += routeNotes(MIDI_SOURCE_USB_HOST, 0, 1, 64) * 64;
+        shimCoreNum = 0;
+        uint64_t start = hostBenchCycles();
+        loopMidiRouter();
+        drainTotal += hostBenchCycles() - start;
+    }
+    unsigned long routed = (count + 63) / 64 * 64;
+    CHECK_EQ(hostPackets, routed * 7);
+    CHECK_EQ(devicePackets, routed);
+    CHECK_EQ(serialBytes, routed * 3);
+    report("route_host_to_9_destinations", cost / routed);
+    report("deliver_queued_on_core0", (double)drainTotal / routed);
+    mountedPorts = 0;
+}
+
+TEST(BaselineRouteToOneLocalDestination) {
+    mountedPorts = 0;
+    resetCounters();
+    unsigned long count = hostBenchIterations(20000);
+    double cost = legacyRouteNotes(MIDI_SOURCE_USB_DEVICE, 0, count);
+    CHECK_EQ(serialBytes, count * 3);
+    CHECK_EQ(devicePackets, 0);
+    report("route_device_to_din_before", cost);
+}
+
+TEST(BaselineRouteToEveryDestination) {
+    mountedPorts = ROUTE_TO_USB_HOST;
+    resetCounters();
+    unsigned long count = hostBenchIterations(20000);
+    double cost = legacyRouteNotes(MIDI_SOURCE_USB_HOST, 0, count);
+    CHECK_EQ(hostPackets, count * 7);
+    CHECK_EQ(devicePackets, count);
+    CHECK_EQ(serialBytes, count * 3);
+    report("route_host_to_9_destinations_before", cost);
+    mountedPorts = 0;
+}
+
+TEST(DebugLogCost) {
+    // The trace (MIDI_ROUTER_TRACE, built in here) logs every non-clock
+    // message through dualPrintf()
+    resetCounters();
+    debug = true;
+    unsigned long count = hostBenchIterations(5000);
+    double cost = routeNotes(MIDI_SOURCE_USB_DEVICE, 0, 0, count);
+    debug = false;
+    Serial.discardOutput();
+    Serial2.discardOutput();
+    report("route_device_to_din_with_debug_log", cost);
+}
+
+TEST(EncodeOnly) {
+    setupBench();
+    MidiMessage msg = noteOn(60);
+    EncodedMidiMessage encoded;
+    unsigned long count = hostBenchIterations(200000);
+    uint32_t check = 0;
+    uint64_t start = hostBenchCycles();
+    for (unsigned long i = 0; i < count; i++) {
+        msg.data1 = i & 0x7F;
+        encodeMidiMessage(msg, encoded);
+        check += encoded.packet[2];
+    }
+    uint64_t total = hostBenchCycles() - start;
+    CHECK(check > 0);
+    report("encode_note_on", (double)total / count);
+}
@@ -0,0 +1,91 @@
+#include "fake_flash.h"
+#include "flash_commit.h"
+#include "host_test.h"
+
+#define FAKE_STR(x) #x
+#define FAKE_XSTR(x) FAKE_STR(x)
+
+// _FS_start/_FS_end normally come from the linker script
+alignas(FLASH_SECTOR_SIZE) uint8_t fakeFlashPartition[FAKE_FLASH_FS_SIZE];
+asm(".globl _FS_start\n.set _FS_start, fakeFlashPartition\n"
+    ".globl _FS_end\n.set _FS_end, fakeFlashPartition + " FAKE_XSTR(FAKE_FLASH_FS_SIZE) "\n");
+
+static uint32_t sectorErases[FAKE_FLASH_FS_SECTORS];
+static uint32_t busyUs = 0;
+static long opsUntilPowerCut = -1;
+static FlashCommitStats stats;
+
+static uint8_t *partitionAddress(uint32_t offset) {
+    CHECK(offset >= FAKE_FLASH_FS_OFFSET && offset < FAKE_FLASH_FS_OFFSET + FAKE_FLASH_FS_SIZE);
+    return fakeFlashPartition + (offset - FAKE_FLASH_FS_OFFSET);
+}
+
+// True if this operation is the one the power cut interrupts
+static bool powerCutNow() {
+    return opsUntilPowerCut >= 0 && opsUntilPowerCut-- == 0;
+}
+
+void fakeFlashReset() {
+    memset(fakeFlashPartition, 0xFF, sizeof(fakeFlashPartition));
+    memset(sectorErases, 0, sizeof(sectorErases));
+    memset(&stats, 0, sizeof(stats));
+    busyUs = 0;
+    opsUntilPowerCut = -1;
+    shimXipBase = (uintptr_t)fakeFlashPartition - FAKE_FLASH_FS_OFFSET;
+}
+
+uint32_t fakeFlashTakeBusyUs() {
+    uint32_t us = busyUs;
+    busyUs = 0;
+    return us;
+}
+
+uint32_t fakeFlashSectorErases(uint8_t sector) {
+    return sector < FAKE_FLASH_FS_SECTORS ? sectorErases[sector] : 0;
+}
+
+void fakeFlashCutPowerAfter(long ops) {
+    opsUntilPowerCut = ops;
+}
+
+void flashCommitSafePoint() {}
+
+void flashCommitErase(uint32_t offset) {
+    CHECK_EQ(offset % FLASH_SECTOR_SIZE, 0);
+    uint8_t *sector = partitionAddress(offset);
+    if (powerCutNow()) {
+        memset(sector, 0xFF, FLASH_SECTOR_SIZE / 2);
+        throw FakeFlashPowerCut();
+    }
+    memset(sector, 0xFF, FLASH_SECTOR_SIZE);
+    sectorErases[(offset - FAKE_FLASH_FS_OFFSET) / FLASH_SECTOR_SIZE]++;
+    busyUs += FAKE_FLASH_ERASE_US;
+    stats.slices++;
+    stats.erases++;
+    stats.lastEraseStallUs = FAKE_FLASH_ERASE_US;
+    stats.maxEraseStallUs = FAKE_FLASH_ERASE_US;
+}
+
+void flashCommitProgram(uint32_t offset, const uint8_t *page) {
+    CHECK_EQ(offset % FLASH_PAGE_SIZE, 0);
+    uint8_t *target = partitionAddress(offset);
+    size_t size = FLASH_PAGE_SIZE;
+    bool cut = powerCutNow();
+    if (cut) {
+        size /= 2;
+    }
+    for (size_t i = 0; i < size; i++) {
+        target[i] &= page[i];
+    }
+    if (cut) {
+        throw FakeFlashPowerCut();
+    }
+    busyUs += FAKE_FLASH_PROGRAM_US;
+    stats.slices++;
+    stats.lastProgramStallUs = FAKE_FLASH_PROGRAM_US;
+    stats.maxProgramStallUs = FAKE_FLASH_PROGRAM_US;
+}
+
+FlashCommitStats getFlashCommitStats() {
+    return stats;
+}
@@ -0,0 +1,42 @@
+#ifndef FAKE_FLASH_H
+#define FAKE_FLASH_H
+
+// Simulated flash behind flash_commit.h. flashCommitErase() and
+// flashCommitProgram() act on a RAM image of the filesystem partition
+// (_FS_start/_FS_end) with NOR semantics: erase sets 0xFF, program can only
+// clear bits. Each operation is charged a typical flash time, and power
+// can be cut in the middle of any of them.
+
+#include <Arduino.h>
+#include <stdexcept>
+#include "config_journal.h"
+#include "hardware/flash.h"
+
+// W25Q16JV typical sector erase and page program times
+#define FAKE_FLASH_ERASE_US 45000
+#define FAKE_FLASH_PROGRAM_US 400
+
+// The partition: just big enough for the config journal, at this offset
+#define FAKE_FLASH_FS_OFFSET 0x100000
+#define FAKE_FLASH_FS_SECTORS CONFIG_JOURNAL_SECTORS
+#define FAKE_FLASH_FS_SIZE (FAKE_FLASH_FS_SECTORS * FLASH_SECTOR_SIZE)
+
+// Thrown out of the operation a power cut interrupts. An erase is left
+// half done, a page half programmed.
+struct FakeFlashPowerCut : std::runtime_error {
+    FakeFlashPowerCut() : std::runtime_error("power cut") {}
+};
+
+// Blank partition, counters cleared, XIP_BASE pointing at the image
+void fakeFlashReset();
+
+// Flash time charged since the last call
+uint32_t fakeFlashTakeBusyUs();
+
+// Completed erases of a partition sector since fakeFlashReset()
+uint32_t fakeFlashSectorErases(uint8_t sector);
+
+// Cut power during the operation after `ops` more complete ones; -1 never
+void fakeFlashCutPowerAfter(long ops);
+
+#endif // FAKE_FLASH_H
@@ -0,0 +1,56 @@
+// The MIDI I/O modules as the config code sees them: routeMidiMessage()
+// (IMU output) counts messages, and the STATUS counters read as idle with
+// no USB host device mounted. For tests that link web_serial_config.cpp
+// without the router, the USB stacks and the serial port.
+
+#include "midi_router.h"
+#include "usb_host_wrapper.h"
+#include "usb_device_midi_handlers.h"
+#include "serial_midi_scheduler.h"
+#include "serial_midi_port.h"
+
+uint32_t fakeRoutedMessages = 0;
+
+void routeMidiMessage(MidiSource source, const MidiMessage &msg) {
+    (void)source;
+    (void)msg;
+    fakeRoutedMessages++;
+}
+
+void routeMidiMessage(MidiSource source, const MidiMessage &msg, MidiEndpointMask destMask) {
+    (void)destMask;
+    routeMidiMessage(source, msg);
+}
+
+MidiQueueStats getCrossCoreQueueStats(uint8_t consumerCore) {
+    (void)consumerCore;
+    return MidiQueueStats{};
+}
+
+SysExLockStats getSysExLockStats(uint8_t endpoint) {
+    (void)endpoint;
+    return SysExLockStats{};
+}
+
+MidiQueueStats getUsbDeviceTxQueueStats() {
+    return MidiQueueStats{};
+}
+
+bool getHostMidiDevice(uint8_t idx, HostMidiDevice *device) {
+    (void)idx;
+    (void)device;
+    return false;
+}
+
+MidiQueueStats getHostTxQueueStats(uint8_t idx) {
+    (void)idx;
+    return MidiQueueStats{};
+}
+
+SerialMidiSchedulerStats getSerialMidiSchedulerStats() {
+    return SerialMidiSchedulerStats{};
+}
+
+SerialMidiPortStats getSerialMidiPortStats() {
+    return SerialMidiPortStats{};
+}
@@ -0,0 +1,116 @@
+#include "fake_tinyusb.h"
+#include "usb_host_wrapper.h"
+#include <deque>
+
+Adafruit_USBH_Host USBHost;
+
+typedef struct {
+    bool mounted;
+    std::deque<uint32_t> rx;        // Packets, byte 0 in the low byte
+    uint8_t fifo[FAKE_USB_TX_PACKETS][4];
+    unsigned fifoCount;
+    unsigned inFlight;              // Packets of the transfer on the bus
+    std::vector<uint8_t> sent;
+} FakeDevice;
+
+static FakeDevice devices[CFG_TUH_MIDI];
+
+void Adafruit_USBH_Host::task() {}
+
+bool tuh_mounted(uint8_t daddr) {
+    return daddr >= 1 && daddr <= CFG_TUH_MIDI && devices[daddr - 1].mounted;
+}
+
+bool tuh_midi_packet_read(uint8_t idx, uint8_t packet[4]) {
+    if (idx >= CFG_TUH_MIDI || devices[idx].rx.empty()) {
+        return false;
+    }
+    uint32_t word = devices[idx].rx.front();
+    devices[idx].rx.pop_front();
+    for (int i = 0; i < 4; i++) {
+        packet[i] = (uint8_t)(word >> (8 * i));
+    }
+    return true;
+}
+
+bool tuh_midi_packet_write(uint8_t idx, const uint8_t packet[4]) {
+    if (idx >= CFG_TUH_MIDI) {
+        return false;
+    }
+    FakeDevice &device = devices[idx];
+    if (device.fifoCount >= FAKE_USB_TX_PACKETS) {
+        return false;
+    }
+    memcpy(device.fifo[device.fifoCount++], packet, 4);
+    return true;
+}
+
+// Move the FIFO into the endpoint buffer and start a transfer, unless one
+// is already on the bus
+static uint32_t startTransfer(FakeDevice &device) {
+    if (device.inFlight > 0 || device.fifoCount == 0) {
+        return 0;
+    }
+    for (unsigned i = 0; i < device.fifoCount; i++) {
+        device.sent.insert(device.sent.end(), device.fifo[i], device.fifo[i] + 4);
+    }
+    device.inFlight = device.fifoCount;
+    device.fifoCount = 0;
+    return device.inFlight * 4;
+}
+
+uint32_t tuh_midi_write_flush(uint8_t idx) {
+    if (idx >= CFG_TUH_MIDI) {
+        return 0;
+    }
+    return startTransfer(devices[idx]);
+}
+
+void fakeUsbMount(uint8_t idx, uint8_t cables) {
+    FakeDevice &device = devices[idx];
+    device.mounted = true;
+    device.rx.clear();
+    device.fifoCount = 0;
+    device.inFlight = 0;
+    device.sent.clear();
+    tuh_midi_mount_cb_t info = { (uint8_t)(idx + 1), 0, cables, cables };
+    tuh_midi_mount_cb(idx, &info);
+}
+
+void fakeUsbUnmount(uint8_t idx) {
+    devices[idx].mounted = false;
+    tuh_midi_umount_cb(idx);
+}
+
+void fakeUsbReceive(uint8_t idx, const uint8_t packet[4]) {
+    uint32_t word = packet[0] | (packet[1] << 8) | (packet[2] << 16) | ((uint32_t)packet[3] << 24);
+    devices[idx].rx.push_back(word);
+    tuh_midi_rx_cb(idx, 4);
+}
+
+size_t fakeUsbPendingRx(uint8_t idx) {
+    return devices[idx].rx.size();
+}
+
+void fakeUsbFrame() {
+    shimAdvanceMillis(1);
+    for (uint8_t idx = 0; idx < CFG_TUH_MIDI; idx++) {
+        FakeDevice &device = devices[idx];
+        if (device.mounted && device.inFlight > 0) {
+            // Like TinyUSB, the next transfer starts from the FIFO before
+            // the callback runs
+            uint32_t bytes = device.inFlight * 4;
+            device.inFlight = 0;
+            startTransfer(device);
+            tuh_midi_tx_cb(idx, bytes);
+        }
+    }
+}
+
+const std::vector<uint8_t> &fakeUsbSent(uint8_t idx) {
+    return devices[idx].sent;
+}
+
+void fakeUsbClearSent(uint8_t idx) {
+    devices[idx].sent.clear();
+}
@@ -0,0 +1,33 @@
+#ifndef FAKE_TINYUSB_H
+#define FAKE_TINYUSB_H
+
+// Simulated USB MIDI devices behind the TinyUSB host API that
+// usb_host_wrapper.cpp calls. Each device has a receive FIFO the test
+// fills and a bulk OUT endpoint modelled on TinyUSB over Pico-PIO-USB: a
+// 64-byte FIFO, and at most one 64-byte transfer per device in flight,
+// completed at the next 1 ms frame.
+
+#include <Arduino.h>
+#include <vector>
+
+// Packets per OUT transfer (64-byte full-speed bulk endpoint)
+#define FAKE_USB_TX_PACKETS 16
+
+// Mount device `idx` with `cables` cables each way, as TinyUSB would
+void fakeUsbMount(uint8_t idx, uint8_t cables);
+void fakeUsbUnmount(uint8_t idx);
+
+// Device to host: queue a packet and run the receive callback
+void fakeUsbReceive(uint8_t idx, const uint8_t packet[4]);
+// Packets still waiting in a device's receive FIFO (not read by the host)
+size_t fakeUsbPendingRx(uint8_t idx);
+
+// One 1 ms frame: the clock moves on, transfers in flight complete and
+// TinyUSB's transmit callback runs
+void fakeUsbFrame();
+
+// Everything a device has received from the host, packet by packet
+const std::vector<uint8_t> &fakeUsbSent(uint8_t idx);
+void fakeUsbClearSent(uint8_t idx);
+
+#endif // FAKE_TINYUSB_H
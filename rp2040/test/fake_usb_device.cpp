@@ -0,0 +1,48 @@
+#include "fake_usb_device.h"
+#include "midi_instances.h"
+#include <deque>
+
+Adafruit_USBD_MIDI usb_midi;
+
+static std::deque<uint32_t> toDevice;
+static std::vector<uint8_t> inFifo;
+static std::vector<uint8_t> received;
+
+bool Adafruit_USBD_MIDI::readPacket(uint8_t packet[4]) {
+    if (toDevice.empty()) {
+        return false;
+    }
+    uint32_t word = toDevice.front();
+    toDevice.pop_front();
+    for (int i = 0; i < 4; i++) {
+        packet[i] = (uint8_t)(word >> (8 * i));
+    }
+    return true;
+}
+
+bool Adafruit_USBD_MIDI::writePacket(const uint8_t packet[4]) {
+    if (inFifo.size() >= FAKE_USB_DEVICE_TX_PACKETS * 4) {
+        return false;
+    }
+    inFifo.insert(inFifo.end(), packet, packet + 4);
+    return true;
+}
+
+void fakeUsbDeviceReset() {
+    toDevice.clear();
+    inFifo.clear();
+    received.clear();
+}
+
+void fakeUsbDeviceSend(const uint8_t packet[4]) {
+    toDevice.push_back(packet[0] | (packet[1] << 8) | (packet[2] << 16) | ((uint32_t)packet[3] << 24));
+}
+
+void fakeUsbDeviceFrame() {
+    received.insert(received.end(), inFifo.begin(), inFifo.end());
+    inFifo.clear();
+}
+
+const std::vector<uint8_t> &fakeUsbDeviceReceived() {
+    return received;
+}
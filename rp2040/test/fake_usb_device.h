@@ -0,0 +1,27 @@
+#ifndef FAKE_USB_DEVICE_H
+#define FAKE_USB_DEVICE_H
+
+// Simulated computer on the USB MIDI device port, behind the usb_midi
+// object that usb_device_midi_handlers.cpp reads and writes. The IN
+// endpoint has a 64-byte FIFO that the computer empties once per 1 ms
+// frame, so writePacket() fails while it is full.
+
+#include <Arduino.h>
+#include <vector>
+
+// Packets per IN transfer (64-byte full-speed bulk endpoint)
+#define FAKE_USB_DEVICE_TX_PACKETS 16
+
+// Empty FIFOs, nothing received
+void fakeUsbDeviceReset();
+
+// Computer to device: queued for usb_midi.readPacket()
+void fakeUsbDeviceSend(const uint8_t packet[4]);
+
+// One 1 ms frame: the computer takes what is in the IN FIFO
+void fakeUsbDeviceFrame();
+
+// Everything the computer has received, packet by packet
+const std::vector<uint8_t> &fakeUsbDeviceReceived();
+
+#endif // FAKE_USB_DEVICE_H
@@ -0,0 +1,212 @@
+// Differential fuzz of the DIN input parser against the FortySevenEffects
+// MIDI Library, which parsed the DIN input before midi_parser.h. Random
+// well-formed streams (midi_streams.h) go through both; every message must
+// come out of each in the same order with the same bytes. The library
+// turns a Note On with velocity 0 into a Note Off and the parser forwards
+// it as sent, so those are compared as Note Off. SysEx is compared whole:
+// the parser's chunks are joined up to the F7.
+//
+// Only well-formed input is compared: the library stores a status byte
+// that interrupts a message as one of its data bytes, where the parser
+// starts the new message.
+// Needs the real MIDI Library (MIDI_LIBRARY_DIR).
+
+#include "host_test.h"
+#include "midi_parser.h"
+#include "midi_streams.h"
+#include <Arduino.h>
+#include <MIDI.h>
+#include <string>
+#include <vector>
+
+#define FUZZ_STREAM_BYTES 4096
+#define FUZZ_SYSEX_MAX 1024
+
+typedef std::vector<uint8_t> Event;
+
+// --- The library side ---
+
+// Serial stand-in: reads from a byte vector, output goes nowhere
+class VectorTransport {
+public:
+    static const bool thruActivated = false;
+
+    void begin() {}
+    bool beginTransmission(midi::MidiType) { return false; }
+    void write(byte) {}
+    void endTransmission() {}
+    byte read() { return (*stream)[pos++]; }
+    unsigned available() { return stream->size() - pos; }
+
+    const std::vector<uint8_t> *stream = nullptr;
+    size_t pos = 0;
+};
+
+struct FuzzSettings : public midi::DefaultSettings {
+    static const unsigned SysExMaxSize = FUZZ_SYSEX_MAX;
+};
+
+static VectorTransport transport;
+static midi::MidiInterface<VectorTransport, FuzzSettings> library(transport);
+
+static std::vector<Event> libraryEvents(const std::vector<uint8_t> &stream, uint64_t *cycles) {
+    std::vector<Event> events;
+    transport.stream = &stream;
+    transport.pos = 0;
+    library.begin(MIDI_CHANNEL_OMNI);
+
+    uint64_t start = hostBenchCycles();
+    while (transport.available()) {
+        if (!library.read()) {
+            continue;
+        }
+        midi::MidiType type = library.getType();
+        if (type == midi::SystemExclusive) {
+            const byte *data = library.getSysExArray();
+            events.push_back(Event(data, data + library.getSysExArrayLength()));
+            continue;
+        }
+        Event event;
+        if (type < midi::SystemExclusive) {
+            event.push_back((uint8_t)(type | (library.getChannel() - 1)));
+        } else {
+            event.push_back((uint8_t)type);
+        }
+        switch (type) {
+            case midi::ProgramChange:
+            case midi::AfterTouchChannel:
+            case midi::TimeCodeQuarterFrame:
+            case midi::SongSelect:
+                event.push_back(library.getData1());
+                break;
+            case midi::NoteOff:
+            case midi::NoteOn:
+            case midi::AfterTouchPoly:
+            case midi::ControlChange:
+            case midi::PitchBend:
+            case midi::SongPosition:
+                event.push_back(library.getData1());
+                event.push_back(library.getData2());
+                break;
+            default:
+                break;
+        }
+        events.push_back(event);
+    }
+    *cycles += hostBenchCycles() - start;
+    return events;
+}
+
+// --- The parser side ---
+
+static std::vector<Event> *parserOutput;
+static Event sysex;
+
+static void onPacket(uint8_t packet[4]) {
+    uint8_t cin = packet[0] & 0x0F;
+    uint8_t status = packet[1];
+    unsigned length = 0;
+    if (cin >= 0x8 && cin <= 0xE) {
+        length = (cin == 0xC || cin == 0xD) ? 1 : 2;
+    } else if (cin == 0x2 || cin == 0x3) {
+        length = cin - 1;
+    }
+    if ((status & 0xF0) == 0x90 && packet[3] == 0) {
+        status = 0x80 | (status & 0x0F);
+    }
+    Event event(1, status);
+    event.insert(event.end(), packet + 2, packet + 2 + length);
+    parserOutput->push_back(event);
+}
+
+static void onSysEx(uint8_t *data, unsigned size) {
+    sysex.insert(sysex.end(), data, data + size);
+    if (data[size - 1] == 0xF7) {
+        parserOutput->push_back(sysex);
+        sysex.clear();
+    }
+}
+
+static std::vector<Event> parserEvents(const std::vector<uint8_t> &stream, uint64_t *cycles) {
+    std::vector<Event> events;
+    parserOutput = &events;
+    sysex.clear();
+    MidiParser parser;
+    midiParserInit(parser, onPacket, onSysEx);
+
+    uint64_t start = hostBenchCycles();
+    for (uint8_t value : stream) {
+        midiParserFeed(parser, value);
+    }
+    *cycles += hostBenchCycles() - start;
+    CHECK_EQ(parser.stats.stray, 0);
+    CHECK_EQ(parser.stats.truncated, 0);
+    return events;
+}
+
+// --- Comparison ---
+
+static std::string hex(const Event &event) {
+    std::string text;
+    char byteText[4];
+    for (size_t i = 0; i < event.size() && i < 16; i++) {
+        snprintf(byteText, sizeof(byteText), "%02X ", event[i]);
+        text += byteText;
+    }
+    return event.size() > 16 ? text + "..." : text;
+}
+
+// Returns false at the first difference, after printing it
+static bool compare(const std::vector<Event> &parser, const std::vector<Event> &reference, uint32_t seed) {
+    size_t count = parser.size() < reference.size() ? parser.size() : reference.size();
+    for (size_t i = 0; i < count; i++) {
+        if (parser[i] != reference[i]) {
+            printf("  seed %u, message %zu: parser %s, library %s\n", seed, i, hex(parser[i]).c_str(),
+                   hex(reference[i]).c_str());
+            return false;
+        }
+    }
+    if (parser.size() != reference.size()) {
+        printf("  seed %u: parser %zu messages, library %zu\n", seed, parser.size(), reference.size());
+        return false;
+    }
+    return true;
+}
+
+static void fuzz(const char *name, const MidiStreamMix &mix) {
+    const unsigned long streams = hostBenchIterations(500);
+    uint64_t parserCycles = 0, libraryCycles = 0;
+    size_t bytes = 0;
+    unsigned failures = 0;
+    for (uint32_t n = 1; n <= streams && failures < 5; n++) {
+        std::vector<uint8_t> stream;
+        uint32_t seed = n;
+        uint32_t messages = appendMidiStream(stream, FUZZ_STREAM_BYTES, mix, seed);
+        std::vector<Event> parser = parserEvents(stream, &parserCycles);
+        std::vector<Event> reference = libraryEvents(stream, &libraryCycles);
+        bytes += stream.size();
+        if (!CHECK(compare(parser, reference, n)) || !CHECK_EQ(parser.size(), messages)) {
+            failures++;
+        }
+    }
+    std::string base = std::string("midi_parser_fuzz_") + name;
+    hostBenchReport((base + "_per_byte").c_str(), (double)parserCycles / bytes, hostBenchCycleUnit());
+    hostBenchReport((base + "_library_per_byte").c_str(), (double)libraryCycles / bytes, hostBenchCycleUnit());
+}
+
+// --- Tests ---
+
+TEST(ChannelMessages) {
+    MidiStreamMix mix = { 1, 0, 0, 0, true, 0 };
+    fuzz("channel", mix);
+}
+
+TEST(RealtimeInsideMessages) {
+    MidiStreamMix mix = { 8, 2, 1, 20, true, 64 };
+    fuzz("realtime", mix);
+}
+
+TEST(SystemCommonAndSysEx) {
+    MidiStreamMix mix = { 4, 4, 2, 2, true, FUZZ_SYSEX_MAX };
+    fuzz("system", mix);
+}
@@ -0,0 +1,96 @@
+#include "host_test.h"
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define HOST_TEST_MAX 128
+
+typedef struct {
+    const char *name;
+    HostTestFunction function;
+} HostTest;
+
+static HostTest tests[HOST_TEST_MAX];
+static unsigned testCount = 0;
+static unsigned failures = 0;
+
+HostTestRegistration::HostTestRegistration(const char *name, HostTestFunction function) {
+    if (testCount < HOST_TEST_MAX) {
+        tests[testCount].name = name;
+        tests[testCount].function = function;
+        testCount++;
+    }
+}
+
+bool hostTestCheck(bool ok, const char *expr, const char *file, int line) {
+    if (!ok) {
+        printf("%s:%d: CHECK(%s) failed\n", file, line, expr);
+        failures++;
+    }
+    return ok;
+}
+
+bool hostTestCheckEq(long long actual, long long expected, const char *actualExpr,
+                     const char *expectedExpr, const char *file, int line) {
+    if (actual != expected) {
+        printf("%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", file, line, actualExpr,
+               expectedExpr, actual, expected);
+        failures++;
+        return false;
+    }
+    return true;
+}
+
+uint64_t hostBenchNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t hostBenchCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return hostBenchNanos();
+#endif
+}
+
+const char *hostBenchCycleUnit() {
+#if defined(__x86_64__) || defined(__i386__)
+    return "cycles";
+#else
+    return "ns";
+#endif
+}
+
+void hostBenchReport(const char *name, double value, const char *unit) {
+    printf("BENCH %s %.2f %s\n", name, value, unit);
+}
+
+unsigned long hostBenchIterations(unsigned long base) {
+    const char *scale = getenv("HOST_BENCH_SCALE");
+    long factor = scale != nullptr ? atol(scale) : 1;
+    return factor > 1 ? base * (unsigned long)factor : base;
+}
+
+// Runs every registered test, or only those named on the command line
+int main(int argc, char **argv) {
+    unsigned run = 0;
+    for (unsigned i = 0; i < testCount; i++) {
+        bool selected = argc < 2;
+        for (int a = 1; a < argc && !selected; a++) {
+            selected = strcmp(argv[a], tests[i].name) == 0;
+        }
+        if (!selected) {
+            continue;
+        }
+        unsigned before = failures;
+        tests[i].function();
+        printf("%s %s\n", failures == before ? "PASS" : "FAIL", tests[i].name);
+        run++;
+    }
+    printf("%u tests, %u failed checks\n", run, failures);
+    return failures == 0 && run > 0 ? 0 : 1;
+}
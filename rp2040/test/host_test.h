@@ -0,0 +1,44 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+// Minimal harness for the host tests and benchmarks. TEST() registers a
+// function that host_test.cpp's main() runs; CHECK()/CHECK_EQ() report a
+// failure and let the test go on. The executable fails if any check did.
+// Benchmarks print "BENCH <name> <value> <unit>" lines through
+// hostBenchReport() so results can be collected with grep.
+
+#include <stdint.h>
+#include <stdio.h>
+
+typedef void (*HostTestFunction)();
+
+struct HostTestRegistration {
+    HostTestRegistration(const char *name, HostTestFunction function);
+};
+
+#define TEST(name) \
+    static void name(); \
+    static HostTestRegistration name##Registration(#name, name); \
+    static void name()
+
+#define CHECK(cond) hostTestCheck((cond), #cond, __FILE__, __LINE__)
+#define CHECK_EQ(actual, expected) \
+    hostTestCheckEq((long long)(actual), (long long)(expected), #actual, #expected, __FILE__, __LINE__)
+
+bool hostTestCheck(bool ok, const char *expr, const char *file, int line);
+bool hostTestCheckEq(long long actual, long long expected, const char *actualExpr,
+                     const char *expectedExpr, const char *file, int line);
+
+// Benchmark clock. hostBenchCycles() reads the CPU timestamp counter where
+// there is one (x86) and falls back to nanoseconds elsewhere.
+uint64_t hostBenchNanos();
+uint64_t hostBenchCycles();
+const char *hostBenchCycleUnit();
+
+void hostBenchReport(const char *name, double value, const char *unit);
+
+// Iteration count for benchmarks; HOST_BENCH_SCALE in the environment
+// multiplies it for steadier numbers
+unsigned long hostBenchIterations(unsigned long base);
+
+#endif // HOST_TEST_H
@@ -0,0 +1,70 @@
+#include "midi_streams.h"
+
+// F9 and FD are undefined and FE/FF change receiver state, so only the
+// bytes every receiver treats as a plain event
+static const uint8_t realtimeBytes[] = { 0xF8, 0xFA, 0xFB, 0xFC };
+
+static uint32_t nextRandom(uint32_t &seed) {
+    seed = seed * 1664525 + 1013904223;
+    return seed >> 8;
+}
+
+static unsigned randomBelow(uint32_t &seed, unsigned limit) {
+    return nextRandom(seed) % limit;
+}
+
+// Append one byte, possibly after a real-time byte
+static void put(std::vector<uint8_t> &stream, uint8_t value, const MidiStreamMix &mix, uint32_t &seed,
+                uint32_t &messages) {
+    if (randomBelow(seed, 100) < mix.realtimePercent) {
+        stream.push_back(realtimeBytes[randomBelow(seed, sizeof(realtimeBytes))]);
+        messages++;
+    }
+    stream.push_back(value);
+}
+
+uint32_t appendMidiStream(std::vector<uint8_t> &stream, size_t bytes, const MidiStreamMix &mix,
+                          uint32_t &seed) {
+    // Data bytes by status: channel messages by status >> 4, common by status
+    static const uint8_t channelLengths[8] = { 2, 2, 2, 2, 1, 1, 2, 0 };
+    static const uint8_t commonStatus[4] = { 0xF1, 0xF2, 0xF3, 0xF6 };
+    static const uint8_t commonLengths[4] = { 1, 2, 1, 0 };
+    const unsigned total = mix.channel + mix.common + mix.sysex;
+    uint32_t messages = 0;
+    uint8_t runningStatus = 0;
+
+    while (stream.size() < bytes) {
+        unsigned kind = randomBelow(seed, total);
+        if (kind < mix.channel) {
+            uint8_t status = (uint8_t)(0x80 + (randomBelow(seed, 7) << 4) + randomBelow(seed, 16));
+            // Repeats are made likely so running status gets exercised
+            if (runningStatus != 0 && randomBelow(seed, 2) == 0) {
+                status = runningStatus;
+            }
+            if (status != runningStatus || !mix.runningStatus || randomBelow(seed, 2) == 0) {
+                put(stream, status, mix, seed, messages);
+            }
+            for (unsigned i = 0; i < channelLengths[(status >> 4) - 8]; i++) {
+                put(stream, (uint8_t)randomBelow(seed, 128), mix, seed, messages);
+            }
+            runningStatus = status;
+        } else if (kind < mix.channel + mix.common) {
+            unsigned which = randomBelow(seed, 4);
+            put(stream, commonStatus[which], mix, seed, messages);
+            for (unsigned i = 0; i < commonLengths[which]; i++) {
+                put(stream, (uint8_t)randomBelow(seed, 128), mix, seed, messages);
+            }
+            runningStatus = 0;
+        } else {
+            unsigned length = 2 + randomBelow(seed, mix.maxSysExLength - 1);
+            put(stream, 0xF0, mix, seed, messages);
+            for (unsigned i = 2; i < length; i++) {
+                put(stream, (uint8_t)randomBelow(seed, 128), mix, seed, messages);
+            }
+            put(stream, 0xF7, mix, seed, messages);
+            runningStatus = 0;
+        }
+        messages++;
+    }
+    return messages;
+}
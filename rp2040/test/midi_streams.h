@@ -0,0 +1,29 @@
+#ifndef MIDI_STREAMS_H
+#define MIDI_STREAMS_H
+
+// Random well-formed MIDI 1.0 byte streams, for the DIN parser benchmark
+// and the differential fuzz harness. Messages are always complete; the
+// variety is in running status, real-time bytes dropped between or inside
+// messages (SysEx included), system common messages and SysEx lengths.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Relative weights of the message kinds and how they are sent
+typedef struct {
+    unsigned channel;          // Channel voice messages, all seven kinds
+    unsigned common;           // F1, F2, F3, F6
+    unsigned sysex;
+    unsigned realtimePercent;  // Chance of a real-time byte before each byte
+    bool runningStatus;        // Leave out a repeated status half the time
+    unsigned maxSysExLength;   // F0 and F7 included
+} MidiStreamMix;
+
+// Append messages to `stream` until it holds at least `bytes` bytes.
+// Returns the messages appended, counting each real-time byte and each
+// SysEx dump as one.
+uint32_t appendMidiStream(std::vector<uint8_t> &stream, size_t bytes, const MidiStreamMix &mix,
+                          uint32_t &seed);
+
+#endif // MIDI_STREAMS_H
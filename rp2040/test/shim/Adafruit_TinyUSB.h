@@ -0,0 +1,40 @@
+#ifndef ADAFRUIT_TINYUSB_SHIM_H
+#define ADAFRUIT_TINYUSB_SHIM_H
+
+// Declarations of the TinyUSB MIDI host API used by usb_host_wrapper.cpp,
+// and of the USB MIDI device class used by usb_device_midi_handlers.cpp.
+// A test that links either defines the functions, usually as a simulated
+// endpoint (fake_tinyusb.h, fake_usb_device.h).
+
+#include <Arduino.h>
+
+#define CFG_TUH_MIDI 4
+#define CFG_TUH_DEVICE_MAX 4
+
+typedef struct {
+    uint8_t daddr;
+    uint8_t bInterfaceNumber;
+    uint8_t rx_cable_count;
+    uint8_t tx_cable_count;
+} tuh_midi_mount_cb_t;
+
+class Adafruit_USBH_Host {
+public:
+    bool begin(uint8_t rhport) { (void)rhport; return true; }
+    void task();
+};
+
+// USB MIDI device interface, packet level
+class Adafruit_USBD_MIDI {
+public:
+    bool begin() { return true; }
+    bool readPacket(uint8_t packet[4]);
+    bool writePacket(const uint8_t packet[4]);
+};
+
+bool tuh_mounted(uint8_t daddr);
+bool tuh_midi_packet_read(uint8_t idx, uint8_t packet[4]);
+bool tuh_midi_packet_write(uint8_t idx, const uint8_t packet[4]);
+uint32_t tuh_midi_write_flush(uint8_t idx);
+
+#endif // ADAFRUIT_TINYUSB_SHIM_H
@@ -0,0 +1,140 @@
+#ifndef ARDUINO_SHIM_H
+#define ARDUINO_SHIM_H
+
+// Host stand-in for the parts of the arduino-pico core the firmware
+// modules use. Time is simulated: millis()/micros() only move when a test
+// advances them, so timeouts and rate limits are deterministic. Serial
+// keeps what is printed and reads what a test feeds it.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <string>
+
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define DEC 10
+#define HEX 16
+
+#ifndef PI
+#define PI 3.14159265358979323846
+#endif
+
+#define constrain(x, low, high) ((x) < (low) ? (low) : ((x) > (high) ? (high) : (x)))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+
+static inline void noInterrupts() {}
+static inline void interrupts() {}
+
+// Simulated clock
+void shimSetMicros(uint64_t us);
+void shimAdvanceMicros(uint64_t us);
+void shimAdvanceMillis(uint32_t ms);
+
+class String {
+public:
+    String(const char *s = "") : text(s != nullptr ? s : "") {}
+    String(int v) : text(std::to_string(v)) {}
+    String(unsigned v) : text(std::to_string(v)) {}
+    String(long v) : text(std::to_string(v)) {}
+    String(unsigned long v) : text(std::to_string(v)) {}
+
+    const char *c_str() const { return text.c_str(); }
+    unsigned length() const { return (unsigned)text.size(); }
+    void trim();
+
+    String &operator+=(const String &other) { text += other.text; return *this; }
+    String &operator+=(const char *s) { text += s; return *this; }
+    String operator+(const String &other) const { String s(*this); s += other; return s; }
+    String operator+(const char *other) const { String s(*this); s += other; return s; }
+    bool operator==(const char *s) const { return text == s; }
+    bool operator==(const String &s) const { return text == s.text; }
+
+private:
+    std::string text;
+};
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *data, size_t size);
+    size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+    size_t write(const char *s, size_t size) { return write((const uint8_t *)s, size); }
+    virtual int availableForWrite() { return 0; }
+    virtual void flush() {}
+
+    size_t print(const char *s) { return write(s); }
+    size_t print(const String &s) { return write(s.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char v, int base = DEC) { return print((unsigned long)v, base); }
+    size_t print(int v, int base = DEC) { return print((long)v, base); }
+    size_t print(unsigned v, int base = DEC) { return print((unsigned long)v, base); }
+    size_t print(long v, int base = DEC);
+    size_t print(unsigned long v, int base = DEC);
+    size_t print(double v, int digits = 2);
+
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(T v) { size_t n = print(v); return n + println(); }
+
+    size_t printf(const char *format, ...);
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    void setTimeout(unsigned long ms) { (void)ms; }
+};
+
+// Output is collected in a string; input is what the test queued with
+// feed(). Reads never block.
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    void end() {}
+    operator bool() const { return true; }
+
+    size_t write(uint8_t c) override;
+    using Print::write;
+    int availableForWrite() override { return 4096; }
+    int available() override;
+    int read() override;
+    int peek() override;
+
+    // Test side
+    void feed(const char *data, size_t size);
+    void feed(const char *s) { feed(s, strlen(s)); }
+    std::string takeOutput();
+    size_t outputSize() const { return output.size(); }
+    void discardOutput() { output.clear(); }
+
+private:
+    std::string input;
+    size_t inputPos = 0;
+    std::string output;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+
+#endif // ARDUINO_SHIM_H
@@ -0,0 +1,32 @@
+#ifndef EEPROM_SHIM_H
+#define EEPROM_SHIM_H
+
+// arduino-pico EEPROM emulation over a RAM buffer that keeps its contents
+// for the life of the test process, like the flash sector it stands for
+
+#include <Arduino.h>
+
+#define EEPROM_SHIM_SIZE 4096
+
+class EEPROMClass {
+public:
+    void begin(size_t size) { (void)size; }
+    bool commit() { commits++; return true; }
+    bool end() { return commit(); }
+
+    template <typename T>
+    T &put(int address, const T &value) {
+        memcpy(data + address, &value, sizeof(T));
+        return (T &)value;
+    }
+
+    const uint8_t *getConstDataPtr() const { return data; }
+
+    // Test side
+    uint32_t commits = 0;
+    uint8_t data[EEPROM_SHIM_SIZE];
+};
+
+extern EEPROMClass EEPROM;
+
+#endif // EEPROM_SHIM_H
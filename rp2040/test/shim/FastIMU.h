@@ -0,0 +1,40 @@
+#ifndef FASTIMU_SHIM_H
+#define FASTIMU_SHIM_H
+
+// FastIMU sensor that is always level and still
+
+#include <Arduino.h>
+#include <Wire.h>
+
+typedef struct {
+    bool valid;
+    float accelBias[3];
+    float gyroBias[3];
+    float magBias[3];
+    float magScale[3];
+} calData;
+
+typedef struct {
+    float accelX;
+    float accelY;
+    float accelZ;
+} AccelData;
+
+typedef struct {
+    float gyroX;
+    float gyroY;
+    float gyroZ;
+} GyroData;
+
+class MPU6050 {
+public:
+    explicit MPU6050(TwoWire &wire) { (void)wire; }
+    int init(calData cal, uint8_t address) { (void)cal; (void)address; return 0; }
+    int setGyroRange(int range) { (void)range; return 0; }
+    int setAccelRange(int range) { (void)range; return 0; }
+    void update() {}
+    void getAccel(AccelData *out) { out->accelX = 0; out->accelY = 0; out->accelZ = 1; }
+    void getGyro(GyroData *out) { out->gyroX = 0; out->gyroY = 0; out->gyroZ = 0; }
+};
+
+#endif // FASTIMU_SHIM_H
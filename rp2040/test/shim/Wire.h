@@ -0,0 +1,19 @@
+#ifndef WIRE_SHIM_H
+#define WIRE_SHIM_H
+
+// I2C bus with nothing attached
+
+#include <Arduino.h>
+
+class TwoWire {
+public:
+    bool setSDA(int pin) { (void)pin; return true; }
+    bool setSCL(int pin) { (void)pin; return true; }
+    void begin() {}
+    void setClock(uint32_t hz) { (void)hz; }
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
+
+#endif // WIRE_SHIM_H
@@ -0,0 +1,154 @@
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <Wire.h>
+#include "pico/platform.h"
+#include "hardware/flash.h"
+
+HardwareSerial Serial;
+HardwareSerial Serial1;
+HardwareSerial Serial2;
+EEPROMClass EEPROM;
+TwoWire Wire;
+TwoWire Wire1;
+
+static uint64_t nowUs = 0;
+uint8_t shimCoreNum = 0;
+uintptr_t shimXipBase = 0;
+
+unsigned long millis() {
+    return (unsigned long)(uint32_t)(nowUs / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long)(uint32_t)nowUs;
+}
+
+uint32_t time_us_32() {
+    return (uint32_t)nowUs;
+}
+
+void delay(unsigned long ms) {
+    nowUs += (uint64_t)ms * 1000;
+}
+
+void delayMicroseconds(unsigned int us) {
+    nowUs += us;
+}
+
+void shimSetMicros(uint64_t us) {
+    nowUs = us;
+}
+
+void shimAdvanceMicros(uint64_t us) {
+    nowUs += us;
+}
+
+void shimAdvanceMillis(uint32_t ms) {
+    nowUs += (uint64_t)ms * 1000;
+}
+
+void pinMode(int pin, int mode) {
+    (void)pin;
+    (void)mode;
+}
+
+void digitalWrite(int pin, int value) {
+    (void)pin;
+    (void)value;
+}
+
+uint32_t get_core_num() {
+    return shimCoreNum;
+}
+
+void String::trim() {
+    size_t start = 0;
+    while (start < text.size() && isspace((unsigned char)text[start])) {
+        start++;
+    }
+    size_t end = text.size();
+    while (end > start && isspace((unsigned char)text[end - 1])) {
+        end--;
+    }
+    text = text.substr(start, end - start);
+}
+
+size_t Print::write(const uint8_t *data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        write(data[i]);
+    }
+    return size;
+}
+
+size_t Print::print(long v, int base) {
+    if (base != DEC) {
+        return print((unsigned long)v, base);
+    }
+    char buf[24];
+    int len = snprintf(buf, sizeof(buf), "%ld", v);
+    return write((const uint8_t *)buf, len);
+}
+
+size_t Print::print(unsigned long v, int base) {
+    char buf[24];
+    int len = snprintf(buf, sizeof(buf), base == HEX ? "%lX" : "%lu", v);
+    return write((const uint8_t *)buf, len);
+}
+
+size_t Print::print(double v, int digits) {
+    if (isnan(v)) {
+        return write("nan");
+    }
+    if (isinf(v)) {
+        return write("inf");
+    }
+    char buf[48];
+    int len = snprintf(buf, sizeof(buf), "%.*f", digits, v);
+    return write((const uint8_t *)buf, len);
+}
+
+size_t Print::printf(const char *format, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (len < 0) {
+        return 0;
+    }
+    return write((const uint8_t *)buf, (size_t)len < sizeof(buf) ? (size_t)len : sizeof(buf) - 1);
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    output.push_back((char)c);
+    return 1;
+}
+
+int HardwareSerial::available() {
+    return (int)(input.size() - inputPos);
+}
+
+int HardwareSerial::read() {
+    if (inputPos >= input.size()) {
+        return -1;
+    }
+    return (uint8_t)input[inputPos++];
+}
+
+int HardwareSerial::peek() {
+    return inputPos < input.size() ? (uint8_t)input[inputPos] : -1;
+}
+
+void HardwareSerial::feed(const char *data, size_t size) {
+    if (inputPos == input.size()) {
+        input.clear();
+        inputPos = 0;
+    }
+    input.append(data, size);
+}
+
+std::string HardwareSerial::takeOutput() {
+    std::string out;
+    out.swap(output);
+    return out;
+}
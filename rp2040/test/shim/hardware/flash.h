@@ -0,0 +1,18 @@
+#ifndef HARDWARE_FLASH_SHIM_H
+#define HARDWARE_FLASH_SHIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FLASH_PAGE_SIZE (1u << 8)
+#define FLASH_SECTOR_SIZE (1u << 12)
+
+// Flash is a host buffer: XIP_BASE is wherever a test put it, so code that
+// reads flash through XIP_BASE + offset reads the buffer
+extern uintptr_t shimXipBase;
+#define XIP_BASE shimXipBase
+
+void flash_range_erase(uint32_t flash_offs, size_t count);
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count);
+
+#endif // HARDWARE_FLASH_SHIM_H
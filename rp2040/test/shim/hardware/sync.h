@@ -0,0 +1,13 @@
+#ifndef HARDWARE_SYNC_SHIM_H
+#define HARDWARE_SYNC_SHIM_H
+
+#include <stdint.h>
+
+// Tests run single-threaded, so barriers and interrupt masking are no-ops
+static inline void __mem_fence_acquire() {}
+static inline void __mem_fence_release() {}
+static inline void __dmb() {}
+static inline uint32_t save_and_disable_interrupts() { return 0; }
+static inline void restore_interrupts(uint32_t status) { (void)status; }
+
+#endif // HARDWARE_SYNC_SHIM_H
@@ -0,0 +1,6 @@
+#ifndef HARDWARE_TIMER_SHIM_H
+#define HARDWARE_TIMER_SHIM_H
+
+#include "pico/time.h"
+
+#endif // HARDWARE_TIMER_SHIM_H
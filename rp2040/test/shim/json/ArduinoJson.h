@@ -0,0 +1,288 @@
+#ifndef ARDUINOJSON_SHIM_H
+#define ARDUINOJSON_SHIM_H
+
+// Read-mostly subset of ArduinoJson 7 for host builds without the library:
+// what web_serial_config.cpp, config.cpp and imu_handler.cpp call to parse
+// commands. Only used when ARDUINOJSON_DIR has no ArduinoJson.h (see
+// CMakeLists.txt); the real library always wins.
+//
+// Standard JSON only, nesting limited to 10 levels as in the library.
+// Conversions follow the library: is<T>() of an integer type is true only
+// for integers in T's range, as<T>() returns 0 otherwise, and a missing
+// value reads as null. All memory, nodes and copied strings, comes from
+// the document's Allocator and is returned when the document goes away.
+// There is no serializer; output goes through json_stream.h.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <limits>
+#include <type_traits>
+
+namespace ArduinoJson {
+
+class Allocator {
+public:
+    virtual void *allocate(size_t size) = 0;
+    virtual void deallocate(void *ptr) = 0;
+    virtual void *reallocate(void *ptr, size_t newSize) = 0;
+
+protected:
+    ~Allocator() = default;
+};
+
+} // namespace ArduinoJson
+
+namespace ArduinoJsonShim {
+
+enum NodeType : uint8_t {
+    NODE_NULL,
+    NODE_BOOL,
+    NODE_INTEGER,
+    NODE_FLOAT,
+    NODE_STRING,
+    NODE_ARRAY,
+    NODE_OBJECT
+};
+
+struct Node {
+    Node *next;          // Next element or member of the parent
+    const char *key;     // Member name, inside an object
+    union {
+        bool boolean;
+        long long integer;
+        double real;
+        const char *string;
+        Node *first;     // First element or member
+    };
+    uint32_t count;      // Elements or members
+    NodeType type;
+};
+
+const Node *member(const Node *object, const char *key);
+const Node *element(const Node *array, size_t index);
+
+template <typename T, typename Enable = void>
+struct Converter;
+
+} // namespace ArduinoJsonShim
+
+class JsonVariantConst {
+public:
+    JsonVariantConst(const ArduinoJsonShim::Node *node = nullptr) : node_(node) {}
+
+    bool isNull() const { return node_ == nullptr || node_->type == ArduinoJsonShim::NODE_NULL; }
+
+    template <typename T>
+    T as() const { return ArduinoJsonShim::Converter<T>::as(node_); }
+
+    template <typename T>
+    bool is() const { return ArduinoJsonShim::Converter<T>::is(node_); }
+
+    JsonVariantConst operator[](const char *key) const { return ArduinoJsonShim::member(node_, key); }
+    JsonVariantConst operator[](int index) const { return ArduinoJsonShim::element(node_, index); }
+    JsonVariantConst operator[](size_t index) const { return ArduinoJsonShim::element(node_, index); }
+
+    // `variant | fallback`: the value if it has the fallback's type
+    const char *operator|(const char *fallback) const {
+        return is<const char *>() ? as<const char *>() : fallback;
+    }
+    template <typename T>
+    T operator|(T fallback) const { return is<T>() ? as<T>() : fallback; }
+
+    const ArduinoJsonShim::Node *node() const { return node_; }
+
+private:
+    const ArduinoJsonShim::Node *node_;
+};
+
+class JsonArrayConst {
+public:
+    JsonArrayConst(const ArduinoJsonShim::Node *node = nullptr) : node_(node) {}
+
+    bool isNull() const { return node_ == nullptr; }
+    size_t size() const { return node_ != nullptr ? node_->count : 0; }
+    JsonVariantConst operator[](int index) const { return ArduinoJsonShim::element(node_, index); }
+    JsonVariantConst operator[](size_t index) const { return ArduinoJsonShim::element(node_, index); }
+
+private:
+    const ArduinoJsonShim::Node *node_;
+};
+
+// The shim's documents are only read, so both forms are views
+typedef JsonArrayConst JsonArray;
+
+class JsonObjectConst {
+public:
+    JsonObjectConst(const ArduinoJsonShim::Node *node = nullptr) : node_(node) {}
+
+    bool isNull() const { return node_ == nullptr; }
+    size_t size() const { return node_ != nullptr ? node_->count : 0; }
+    JsonVariantConst operator[](const char *key) const { return ArduinoJsonShim::member(node_, key); }
+
+private:
+    const ArduinoJsonShim::Node *node_;
+};
+
+class JsonDocument;
+
+// Member of a document's root object; assigning to it adds or replaces it
+class JsonVariant : public JsonVariantConst {
+public:
+    JsonVariant(JsonDocument *doc, const char *key);
+    JsonVariant &operator=(JsonVariantConst value);
+
+private:
+    JsonDocument *doc_;
+    const char *key_;
+};
+
+class JsonDocument {
+public:
+    explicit JsonDocument(ArduinoJson::Allocator *allocator = nullptr);
+    ~JsonDocument();
+    JsonDocument(const JsonDocument &) = delete;
+    JsonDocument &operator=(const JsonDocument &) = delete;
+
+    void clear();
+    bool overflowed() const { return overflowed_; }
+    bool isNull() const { return root_ == nullptr || root_->type == ArduinoJsonShim::NODE_NULL; }
+
+    template <typename T>
+    T as() const { return JsonVariantConst(root_).as<T>(); }
+    template <typename T>
+    bool is() const { return JsonVariantConst(root_).is<T>(); }
+
+    JsonVariantConst operator[](const char *key) const { return JsonVariantConst(root_)[key]; }
+    JsonVariant operator[](const char *key) { return JsonVariant(this, key); }
+
+    // Used by the parser and by JsonVariant; nullptr when out of memory
+    ArduinoJsonShim::Node *newNode(ArduinoJsonShim::NodeType type);
+    const char *copyString(const char *text, size_t length);
+    ArduinoJsonShim::Node *copyNode(const ArduinoJsonShim::Node *source);
+    ArduinoJsonShim::Node *root() const { return root_; }
+    void setRoot(ArduinoJsonShim::Node *root) { root_ = root; }
+
+private:
+    void *allocate(size_t size);
+
+    ArduinoJson::Allocator *allocator_;
+    void *blocks_ = nullptr;                  // Every allocation, newest first
+    ArduinoJsonShim::Node *freeNodes_ = nullptr;
+    size_t freeNodeCount_ = 0;
+    ArduinoJsonShim::Node *root_ = nullptr;
+    bool overflowed_ = false;
+};
+
+class DeserializationError {
+public:
+    enum Code {
+        Ok,
+        EmptyInput,
+        IncompleteInput,
+        InvalidInput,
+        NoMemory,
+        TooDeep
+    };
+
+    DeserializationError(Code code = Ok) : code_(code) {}
+
+    explicit operator bool() const { return code_ != Ok; }
+    bool operator==(Code code) const { return code_ == code; }
+    bool operator!=(Code code) const { return code_ != code; }
+    Code code() const { return code_; }
+    const char *c_str() const;
+
+private:
+    Code code_;
+};
+
+DeserializationError deserializeJson(JsonDocument &doc, const char *input, size_t length);
+DeserializationError deserializeJson(JsonDocument &doc, const char *input);
+
+// --- Conversions ---
+
+namespace ArduinoJsonShim {
+
+template <>
+struct Converter<bool> {
+    static bool as(const Node *node) {
+        if (node == nullptr) return false;
+        switch (node->type) {
+            case NODE_BOOL: return node->boolean;
+            case NODE_INTEGER: return node->integer != 0;
+            case NODE_FLOAT: return node->real != 0;
+            default: return false;
+        }
+    }
+    static bool is(const Node *node) { return node != nullptr && node->type == NODE_BOOL; }
+};
+
+template <typename T>
+struct Converter<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type> {
+    static bool fits(long long value) {
+        if (std::is_unsigned<T>::value) {
+            return value >= 0 && (unsigned long long)value <= (unsigned long long)std::numeric_limits<T>::max();
+        }
+        return value >= (long long)std::numeric_limits<T>::min() && value <= (long long)std::numeric_limits<T>::max();
+    }
+    static T as(const Node *node) {
+        if (node == nullptr) return 0;
+        switch (node->type) {
+            case NODE_BOOL: return node->boolean;
+            case NODE_INTEGER: return fits(node->integer) ? (T)node->integer : 0;
+            case NODE_FLOAT:
+                return node->real >= (double)std::numeric_limits<T>::min() &&
+                               node->real <= (double)std::numeric_limits<T>::max()
+                           ? (T)node->real
+                           : 0;
+            default: return 0;
+        }
+    }
+    static bool is(const Node *node) { return node != nullptr && node->type == NODE_INTEGER && fits(node->integer); }
+};
+
+template <typename T>
+struct Converter<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+    static T as(const Node *node) {
+        if (node == nullptr) return 0;
+        switch (node->type) {
+            case NODE_BOOL: return node->boolean;
+            case NODE_INTEGER: return (T)node->integer;
+            case NODE_FLOAT: return (T)node->real;
+            default: return 0;
+        }
+    }
+    static bool is(const Node *node) {
+        return node != nullptr && (node->type == NODE_INTEGER || node->type == NODE_FLOAT);
+    }
+};
+
+template <>
+struct Converter<const char *> {
+    static const char *as(const Node *node) {
+        return node != nullptr && node->type == NODE_STRING ? node->string : nullptr;
+    }
+    static bool is(const Node *node) { return node != nullptr && node->type == NODE_STRING; }
+};
+
+template <>
+struct Converter<JsonVariantConst> {
+    static JsonVariantConst as(const Node *node) { return node; }
+    static bool is(const Node *node) { (void)node; return true; }
+};
+
+template <>
+struct Converter<JsonArrayConst> {
+    static JsonArrayConst as(const Node *node) { return is(node) ? node : nullptr; }
+    static bool is(const Node *node) { return node != nullptr && node->type == NODE_ARRAY; }
+};
+
+template <>
+struct Converter<JsonObjectConst> {
+    static JsonObjectConst as(const Node *node) { return is(node) ? node : nullptr; }
+    static bool is(const Node *node) { return node != nullptr && node->type == NODE_OBJECT; }
+};
+
+} // namespace ArduinoJsonShim
+
+#endif // ARDUINOJSON_SHIM_H
@@ -0,0 +1,444 @@
+#include "ArduinoJson.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+using namespace ArduinoJsonShim;
+
+#define NESTING_LIMIT 10
+#define NODES_PER_BLOCK 16
+
+// --- Lookup ---
+
+const Node *ArduinoJsonShim::member(const Node *object, const char *key) {
+    if (object == nullptr || object->type != NODE_OBJECT || key == nullptr) {
+        return nullptr;
+    }
+    for (const Node *node = object->first; node != nullptr; node = node->next) {
+        if (strcmp(node->key, key) == 0) {
+            return node;
+        }
+    }
+    return nullptr;
+}
+
+const Node *ArduinoJsonShim::element(const Node *array, size_t index) {
+    if (array == nullptr || array->type != NODE_ARRAY) {
+        return nullptr;
+    }
+    const Node *node = array->first;
+    while (node != nullptr && index-- > 0) {
+        node = node->next;
+    }
+    return node;
+}
+
+// --- Document memory ---
+
+namespace {
+
+class MallocAllocator : public ArduinoJson::Allocator {
+public:
+    void *allocate(size_t size) override { return malloc(size); }
+    void deallocate(void *ptr) override { free(ptr); }
+    void *reallocate(void *ptr, size_t newSize) override { return realloc(ptr, newSize); }
+};
+
+MallocAllocator mallocAllocator;
+
+// Header of every block a document allocates, so it can free them all
+struct Block {
+    Block *next;
+    alignas(8) char data[];
+};
+
+} // namespace
+
+JsonDocument::JsonDocument(ArduinoJson::Allocator *allocator)
+    : allocator_(allocator != nullptr ? allocator : &mallocAllocator) {}
+
+JsonDocument::~JsonDocument() {
+    clear();
+}
+
+void JsonDocument::clear() {
+    // Newest first, which gives a bump allocator all of its space back
+    Block *block = (Block *)blocks_;
+    while (block != nullptr) {
+        Block *next = block->next;
+        allocator_->deallocate(block);
+        block = next;
+    }
+    blocks_ = nullptr;
+    freeNodes_ = nullptr;
+    freeNodeCount_ = 0;
+    root_ = nullptr;
+    overflowed_ = false;
+}
+
+void *JsonDocument::allocate(size_t size) {
+    Block *block = (Block *)allocator_->allocate(sizeof(Block) + size);
+    if (block == nullptr) {
+        overflowed_ = true;
+        return nullptr;
+    }
+    block->next = (Block *)blocks_;
+    blocks_ = block;
+    return block->data;
+}
+
+Node *JsonDocument::newNode(NodeType type) {
+    if (freeNodeCount_ == 0) {
+        freeNodes_ = (Node *)allocate(NODES_PER_BLOCK * sizeof(Node));
+        if (freeNodes_ == nullptr) {
+            return nullptr;
+        }
+        freeNodeCount_ = NODES_PER_BLOCK;
+    }
+    Node *node = freeNodes_++;
+    freeNodeCount_--;
+    memset(node, 0, sizeof(*node));
+    node->type = type;
+    return node;
+}
+
+const char *JsonDocument::copyString(const char *text, size_t length) {
+    char *copy = (char *)allocate(length + 1);
+    if (copy == nullptr) {
+        return nullptr;
+    }
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+Node *JsonDocument::copyNode(const Node *source) {
+    Node *node = newNode(source != nullptr ? source->type : NODE_NULL);
+    if (node == nullptr || source == nullptr) {
+        return node;
+    }
+    switch (source->type) {
+        case NODE_STRING:
+            node->string = copyString(source->string, strlen(source->string));
+            return node->string != nullptr ? node : nullptr;
+        case NODE_ARRAY:
+        case NODE_OBJECT: {
+            Node **tail = &node->first;
+            for (const Node *child = source->first; child != nullptr; child = child->next) {
+                Node *copy = copyNode(child);
+                if (copy == nullptr) {
+                    return nullptr;
+                }
+                if (child->key != nullptr) {
+                    copy->key = copyString(child->key, strlen(child->key));
+                    if (copy->key == nullptr) {
+                        return nullptr;
+                    }
+                }
+                *tail = copy;
+                tail = &copy->next;
+                node->count++;
+            }
+            return node;
+        }
+        default:
+            node->integer = source->integer; // Copies whichever scalar it is
+            return node;
+    }
+}
+
+JsonVariant::JsonVariant(JsonDocument *doc, const char *key)
+    : JsonVariantConst(JsonVariantConst(doc->root())[key]), doc_(doc), key_(key) {}
+
+JsonVariant &JsonVariant::operator=(JsonVariantConst value) {
+    Node *root = doc_->root();
+    if (root == nullptr) {
+        root = doc_->newNode(NODE_OBJECT);
+        if (root == nullptr) {
+            return *this;
+        }
+        doc_->setRoot(root);
+    }
+    if (root->type != NODE_OBJECT) {
+        return *this;
+    }
+    Node *copy = doc_->copyNode(value.node());
+    const char *key = doc_->copyString(key_, strlen(key_));
+    if (copy == nullptr || key == nullptr) {
+        return *this;
+    }
+    copy->key = key;
+
+    // Replace the member in place, or append it
+    Node **link = &root->first;
+    while (*link != nullptr && strcmp((*link)->key, key_) != 0) {
+        link = &(*link)->next;
+    }
+    if (*link != nullptr) {
+        copy->next = (*link)->next;
+    } else {
+        root->count++;
+    }
+    *link = copy;
+    JsonVariantConst::operator=(JsonVariantConst(copy));
+    return *this;
+}
+
+// --- Parser ---
+
+namespace {
+
+class Parser {
+public:
+    Parser(JsonDocument &doc, const char *input, size_t length)
+        : doc_(doc), pos_(input), end_(input + length) {}
+
+    DeserializationError::Code parse() {
+        skipSpace();
+        if (pos_ == end_) {
+            return DeserializationError::EmptyInput;
+        }
+        Node *root = nullptr;
+        DeserializationError::Code code = value(root, 0);
+        if (code == DeserializationError::Ok) {
+            doc_.setRoot(root);
+        }
+        return code; // Anything after the value is ignored, as by the library
+    }
+
+private:
+    void skipSpace() {
+        while (pos_ < end_ && (*pos_ == ' ' || *pos_ == '\t' || *pos_ == '\r' || *pos_ == '\n')) {
+            pos_++;
+        }
+    }
+
+    // Reads `word` (true, false, null)
+    DeserializationError::Code literal(const char *word) {
+        for (; *word != '\0'; word++, pos_++) {
+            if (pos_ == end_) {
+                return DeserializationError::IncompleteInput;
+            }
+            if (*pos_ != *word) {
+                return DeserializationError::InvalidInput;
+            }
+        }
+        return DeserializationError::Ok;
+    }
+
+    static int hexDigit(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    // Quoted string, unescaped into a copy owned by the document
+    DeserializationError::Code string(const char *&out) {
+        std::string text;
+        pos_++; // Opening quote
+        while (true) {
+            if (pos_ == end_) {
+                return DeserializationError::IncompleteInput;
+            }
+            char c = *pos_++;
+            if (c == '"') {
+                break;
+            }
+            if ((unsigned char)c < 0x20) {
+                return DeserializationError::InvalidInput;
+            }
+            if (c != '\\') {
+                text += c;
+                continue;
+            }
+            if (pos_ == end_) {
+                return DeserializationError::IncompleteInput;
+            }
+            c = *pos_++;
+            switch (c) {
+                case '"': case '\\': case '/': text += c; break;
+                case 'b': text += '\b'; break;
+                case 'f': text += '\f'; break;
+                case 'n': text += '\n'; break;
+                case 'r': text += '\r'; break;
+                case 't': text += '\t'; break;
+                case 'u': {
+                    if (end_ - pos_ < 4) {
+                        return DeserializationError::IncompleteInput;
+                    }
+                    unsigned codepoint = 0;
+                    for (int i = 0; i < 4; i++) {
+                        int digit = hexDigit(*pos_++);
+                        if (digit < 0) {
+                            return DeserializationError::InvalidInput;
+                        }
+                        codepoint = codepoint << 4 | digit;
+                    }
+                    // UTF-8; surrogate pairs are not combined
+                    if (codepoint < 0x80) {
+                        text += (char)codepoint;
+                    } else if (codepoint < 0x800) {
+                        text += (char)(0xC0 | codepoint >> 6);
+                        text += (char)(0x80 | (codepoint & 0x3F));
+                    } else {
+                        text += (char)(0xE0 | codepoint >> 12);
+                        text += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+                        text += (char)(0x80 | (codepoint & 0x3F));
+                    }
+                    break;
+                }
+                default:
+                    return DeserializationError::InvalidInput;
+            }
+        }
+        out = doc_.copyString(text.data(), text.size());
+        return out != nullptr ? DeserializationError::Ok : DeserializationError::NoMemory;
+    }
+
+    DeserializationError::Code number(Node *&node) {
+        const char *start = pos_;
+        bool isFloat = false;
+        if (pos_ < end_ && *pos_ == '-') pos_++;
+        while (pos_ < end_ && ((*pos_ >= '0' && *pos_ <= '9') || *pos_ == '.' || *pos_ == 'e' ||
+                               *pos_ == 'E' || *pos_ == '+' || *pos_ == '-')) {
+            isFloat |= *pos_ == '.' || *pos_ == 'e' || *pos_ == 'E';
+            pos_++;
+        }
+        std::string text(start, pos_ - start);
+        if (pos_ == end_) {
+            return DeserializationError::IncompleteInput; // The number may go on
+        }
+
+        char *parsedEnd;
+        errno = 0;
+        long long integer = isFloat ? 0 : strtoll(text.c_str(), &parsedEnd, 10);
+        if (!isFloat && errno == 0 && *parsedEnd == '\0') {
+            node = doc_.newNode(NODE_INTEGER);
+            if (node == nullptr) return DeserializationError::NoMemory;
+            node->integer = integer;
+            return DeserializationError::Ok;
+        }
+        double real = strtod(text.c_str(), &parsedEnd);
+        if (parsedEnd == text.c_str() || *parsedEnd != '\0') {
+            return DeserializationError::InvalidInput;
+        }
+        node = doc_.newNode(NODE_FLOAT);
+        if (node == nullptr) return DeserializationError::NoMemory;
+        node->real = real;
+        return DeserializationError::Ok;
+    }
+
+    // Array or object; objects read a key before each value
+    DeserializationError::Code container(Node *&node, bool isObject, int depth) {
+        if (depth >= NESTING_LIMIT) {
+            return DeserializationError::TooDeep;
+        }
+        node = doc_.newNode(isObject ? NODE_OBJECT : NODE_ARRAY);
+        if (node == nullptr) {
+            return DeserializationError::NoMemory;
+        }
+        const char close = isObject ? '}' : ']';
+        Node **tail = &node->first;
+        pos_++;
+        skipSpace();
+        if (pos_ < end_ && *pos_ == close) {
+            pos_++;
+            return DeserializationError::Ok;
+        }
+        while (true) {
+            const char *key = nullptr;
+            if (isObject) {
+                skipSpace();
+                if (pos_ == end_) return DeserializationError::IncompleteInput;
+                if (*pos_ != '"') return DeserializationError::InvalidInput;
+                DeserializationError::Code code = string(key);
+                if (code != DeserializationError::Ok) return code;
+                skipSpace();
+                if (pos_ == end_) return DeserializationError::IncompleteInput;
+                if (*pos_++ != ':') return DeserializationError::InvalidInput;
+            }
+            Node *child = nullptr;
+            DeserializationError::Code code = value(child, depth + 1);
+            if (code != DeserializationError::Ok) return code;
+            child->key = key;
+            *tail = child;
+            tail = &child->next;
+            node->count++;
+
+            skipSpace();
+            if (pos_ == end_) return DeserializationError::IncompleteInput;
+            char c = *pos_++;
+            if (c == close) return DeserializationError::Ok;
+            if (c != ',') return DeserializationError::InvalidInput;
+        }
+    }
+
+    DeserializationError::Code value(Node *&node, int depth) {
+        skipSpace();
+        if (pos_ == end_) {
+            return DeserializationError::IncompleteInput;
+        }
+        DeserializationError::Code code;
+        switch (*pos_) {
+            case '{':
+                return container(node, true, depth);
+            case '[':
+                return container(node, false, depth);
+            case '"': {
+                const char *text = nullptr;
+                code = string(text);
+                if (code != DeserializationError::Ok) return code;
+                node = doc_.newNode(NODE_STRING);
+                if (node == nullptr) return DeserializationError::NoMemory;
+                node->string = text;
+                return DeserializationError::Ok;
+            }
+            case 't':
+            case 'f': {
+                bool truth = *pos_ == 't';
+                code = literal(truth ? "true" : "false");
+                if (code != DeserializationError::Ok) return code;
+                node = doc_.newNode(NODE_BOOL);
+                if (node == nullptr) return DeserializationError::NoMemory;
+                node->boolean = truth;
+                return DeserializationError::Ok;
+            }
+            case 'n':
+                code = literal("null");
+                if (code != DeserializationError::Ok) return code;
+                node = doc_.newNode(NODE_NULL);
+                return node != nullptr ? DeserializationError::Ok : DeserializationError::NoMemory;
+            default:
+                if (*pos_ == '-' || (*pos_ >= '0' && *pos_ <= '9')) {
+                    return number(node);
+                }
+                return DeserializationError::InvalidInput;
+        }
+    }
+
+    JsonDocument &doc_;
+    const char *pos_;
+    const char *end_;
+};
+
+} // namespace
+
+DeserializationError deserializeJson(JsonDocument &doc, const char *input, size_t length) {
+    doc.clear();
+    DeserializationError::Code code = Parser(doc, input, length).parse();
+    if (code != DeserializationError::Ok) {
+        doc.clear();
+    }
+    return code;
+}
+
+DeserializationError deserializeJson(JsonDocument &doc, const char *input) {
+    return deserializeJson(doc, input, strlen(input));
+}
+
+const char *DeserializationError::c_str() const {
+    static const char *const names[] = {"Ok", "EmptyInput", "IncompleteInput", "InvalidInput", "NoMemory", "TooDeep"};
+    return names[code_];
+}
@@ -0,0 +1,49 @@
+#ifndef MIDI_SHIM_H
+#define MIDI_SHIM_H
+
+// The definitions the firmware modules take from the FortySevenEffects MIDI
+// Library, for builds without the library. Values match midi_Defs.h.
+
+#include <Arduino.h>
+
+#define MIDI_CHANNEL_OMNI 0
+#define MIDI_CHANNEL_OFF 17
+
+#define USING_NAMESPACE_MIDI using namespace midi;
+
+namespace midi {
+
+typedef byte Channel;
+typedef byte DataByte;
+
+enum MidiType : uint8_t {
+    InvalidType           = 0x00,
+    NoteOff               = 0x80,
+    NoteOn                = 0x90,
+    AfterTouchPoly        = 0xA0,
+    ControlChange         = 0xB0,
+    ProgramChange         = 0xC0,
+    AfterTouchChannel     = 0xD0,
+    PitchBend             = 0xE0,
+    SystemExclusive       = 0xF0,
+    SystemExclusiveStart  = SystemExclusive,
+    TimeCodeQuarterFrame  = 0xF1,
+    SongPosition          = 0xF2,
+    SongSelect            = 0xF3,
+    Undefined_F4          = 0xF4,
+    Undefined_F5          = 0xF5,
+    TuneRequest           = 0xF6,
+    SystemExclusiveEnd    = 0xF7,
+    Clock                 = 0xF8,
+    Tick                  = 0xF9,
+    Start                 = 0xFA,
+    Continue              = 0xFB,
+    Stop                  = 0xFC,
+    Undefined_FD          = 0xFD,
+    ActiveSensing         = 0xFE,
+    SystemReset           = 0xFF,
+};
+
+} // namespace midi
+
+#endif // MIDI_SHIM_H
@@ -0,0 +1,15 @@
+#ifndef PICO_PLATFORM_SHIM_H
+#define PICO_PLATFORM_SHIM_H
+
+#include <stdint.h>
+
+// The core a test pretends to run on; 0 unless it sets shimCoreNum
+extern uint8_t shimCoreNum;
+uint32_t get_core_num();
+
+#define __not_in_flash_func(x) x
+#define __time_critical_func(x) x
+
+static inline void tight_loop_contents() {}
+
+#endif // PICO_PLATFORM_SHIM_H
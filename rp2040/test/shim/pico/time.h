@@ -0,0 +1,9 @@
+#ifndef PICO_TIME_SHIM_H
+#define PICO_TIME_SHIM_H
+
+#include <stdint.h>
+
+// Simulated clock of Arduino.h
+uint32_t time_us_32();
+
+#endif // PICO_TIME_SHIM_H
@@ -0,0 +1,7 @@
+#ifndef PIO_USB_SHIM_H
+#define PIO_USB_SHIM_H
+
+// The host build has no PIO USB port; usb_host_wrapper.h only needs the
+// include to resolve
+
+#endif // PIO_USB_SHIM_H
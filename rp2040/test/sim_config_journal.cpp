@@ -0,0 +1,188 @@
+// Config journal on simulated flash (fake_flash.h). Counts erase cycles
+// per sector over many saves, measures the longest a save holds core 1
+// with and without the idle pre-erase, and cuts power at every flash
+// operation around a compaction to check that boot always finds the
+// previous or the new record.
+
+#include "host_test.h"
+#include "fake_flash.h"
+#include "config_journal.h"
+
+#define SIM_PAGES_PER_SECTOR (FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE)
+
+// --- Helpers ---
+
+#define RECORD_SIZE 200
+
+typedef struct {
+    uint32_t version;
+    uint8_t fill[RECORD_SIZE - 4];
+} Record;
+
+static Record makeRecord(uint32_t version) {
+    Record record;
+    record.version = version;
+    for (unsigned i = 0; i < sizeof(record.fill); i++) {
+        record.fill[i] = (uint8_t)(version * 31 + i);
+    }
+    return record;
+}
+
+// Version of the newest readable record, 0 if there is none. Anything
+// readable must be a record exactly as it was written.
+static uint32_t readVersion() {
+    Record record;
+    if (!readConfigJournal(&record, sizeof(record))) {
+        return 0;
+    }
+    Record expected = makeRecord(record.version);
+    CHECK(memcmp(&record, &expected, sizeof(record)) == 0);
+    return record.version;
+}
+
+// Blank flash, fresh boot
+static void resetFlash() {
+    fakeFlashReset();
+    CHECK(setupConfigJournal());
+}
+
+// Flash time spent in one save
+static uint32_t timedAppend(uint32_t version) {
+    Record record = makeRecord(version);
+    fakeFlashTakeBusyUs();
+    CHECK(appendConfigJournal(&record, sizeof(record)));
+    return fakeFlashTakeBusyUs();
+}
+
+// --- Tests ---
+
+TEST(RecordsSurviveReboot) {
+    resetFlash();
+    CHECK_EQ(readVersion(), 0);
+    for (uint32_t version = 1; version <= 3 * SIM_PAGES_PER_SECTOR; version++) {
+        timedAppend(version);
+        CHECK_EQ(readVersion(), version);
+        CHECK(setupConfigJournal());
+        CHECK_EQ(readVersion(), version);
+    }
+}
+
+TEST(WearIsSpreadOverAllSectors) {
+    resetFlash();
+    const uint32_t saves = 100 * CONFIG_JOURNAL_SECTORS * (SIM_PAGES_PER_SECTOR - 1);
+    for (uint32_t version = 1; version <= saves; version++) {
+        timedAppend(version);
+        prepareConfigJournal();
+    }
+    CHECK_EQ(readVersion(), saves);
+
+    uint32_t total = 0, least = UINT32_MAX, most = 0;
+    for (uint8_t sector = 0; sector < FAKE_FLASH_FS_SECTORS; sector++) {
+        uint32_t erases = fakeFlashSectorErases(sector);
+        total += erases;
+        least = erases < least ? erases : least;
+        most = erases > most ? erases : most;
+    }
+    // One erase per sector's worth of records, shared evenly
+    CHECK(total <= saves / (SIM_PAGES_PER_SECTOR - 1) + 1);
+    CHECK(most - least <= 1);
+    hostBenchReport("journal_erases_per_1000_saves", total * 1000.0 / saves, "erases");
+    hostBenchReport("journal_max_sector_erases_per_1000_saves", most * 1000.0 / saves, "erases");
+    // The old EEPROM store erased its one sector on every save
+    hostBenchReport("eeprom_max_sector_erases_per_1000_saves", 1000, "erases");
+}
+
+TEST(PreEraseKeepsSavesFreeOfErases) {
+    resetFlash();
+    uint32_t worstIdle = 0, worstBusy = 0;
+    const uint32_t saves = 4 * CONFIG_JOURNAL_SECTORS * (SIM_PAGES_PER_SECTOR - 1);
+    uint32_t version = 1;
+
+    // Operator saving faster than the idle pass runs: compactions erase
+    for (uint32_t i = 0; i < saves; i++) {
+        uint32_t us = timedAppend(version++);
+        worstBusy = us > worstBusy ? us : worstBusy;
+    }
+    // Idle pass between saves: the spare sector is always ready
+    for (uint32_t i = 0; i < saves; i++) {
+        prepareConfigJournal();
+        uint32_t us = timedAppend(version++);
+        worstIdle = us > worstIdle ? us : worstIdle;
+    }
+
+    // A compaction programs the record and the sector header
+    CHECK_EQ(worstIdle, 2 * FAKE_FLASH_PROGRAM_US);
+    CHECK_EQ(worstBusy, FAKE_FLASH_ERASE_US + 2 * FAKE_FLASH_PROGRAM_US);
+    hostBenchReport("journal_worst_save_stall_pre_erased", worstIdle, "us");
+    hostBenchReport("journal_worst_save_stall_erasing", worstBusy, "us");
+}
+
+// Saves across two compactions on a journal that has been round every
+// sector, so both erase the oldest sector. Each save programs one page and
+// each compaction adds an erase and a header page.
+#define CUT_SAVES (2 * (SIM_PAGES_PER_SECTOR - 1) + 2)
+#define CUT_FLASH_OPS (CUT_SAVES + 2 * 2)
+
+// The saves, with power cut at flash operation `cutAt`. Returns false once
+// `cutAt` is past the last operation.
+static bool saveWithPowerCut(long cutAt, bool preErase, uint32_t *recoveryStallUs) {
+    resetFlash();
+    // Three records short of a compaction
+    const uint32_t prefill = (CONFIG_JOURNAL_SECTORS + 1) * (SIM_PAGES_PER_SECTOR - 1) - 3;
+    uint32_t version = 1;
+    for (; version <= prefill; version++) {
+        timedAppend(version);
+    }
+
+    fakeFlashCutPowerAfter(cutAt);
+    uint32_t lastComplete = prefill;
+    bool cut = false;
+    try {
+        for (; version <= prefill + CUT_SAVES; version++) {
+            if (preErase) {
+                prepareConfigJournal();
+            }
+            Record record = makeRecord(version);
+            CHECK(appendConfigJournal(&record, sizeof(record)));
+            lastComplete = version;
+        }
+    } catch (const FakeFlashPowerCut &) {
+        cut = true;
+    }
+    fakeFlashCutPowerAfter(-1);
+    if (!cut) {
+        return false;
+    }
+
+    // Boot: the previous record, or the interrupted one if it made it
+    CHECK(setupConfigJournal());
+    uint32_t found = readVersion();
+    CHECK(found == lastComplete || found == lastComplete + 1);
+
+    // The journal carries on past the damage
+    uint32_t next = lastComplete + 2;
+    if (preErase) {
+        prepareConfigJournal();
+    }
+    uint32_t us = timedAppend(next);
+    *recoveryStallUs = us > *recoveryStallUs ? us : *recoveryStallUs;
+    CHECK_EQ(readVersion(), next);
+    CHECK(setupConfigJournal());
+    CHECK_EQ(readVersion(), next);
+    return true;
+}
+
+TEST(PowerCutAtEveryFlashOperation) {
+    for (int preErase = 0; preErase < 2; preErase++) {
+        uint32_t recoveryStallUs = 0;
+        long cutAt = 0;
+        while (saveWithPowerCut(cutAt, preErase, &recoveryStallUs)) {
+            cutAt++;
+        }
+        // The idle pass also erases ahead for a third compaction
+        CHECK_EQ(cutAt, CUT_FLASH_OPS + preErase);
+        hostBenchReport(preErase ? "journal_worst_save_after_power_cut_pre_erased"
+                                 : "journal_worst_save_after_power_cut",
+                        recoveryStallUs, "us");
+    }
+}
@@ -0,0 +1,228 @@
+// Out-of-range settings are refused by every Web Serial config writer:
+// PATCH and SET_IMU_AXIS answer "Invalid setting", SAVEALL and
+// SET_PRESET_CONTROL fail, a binary config write answers
+// CONFIG_FRAME_BAD_PAYLOAD, and in each case the running config is left
+// exactly as it was. Values at the edges of their range are accepted.
+
+#include "host_test.h"
+#include "web_serial_config.h"
+#include "config.h"
+#include "config_frame.h"
+#include "crc_utils.h"
+#include "midi_filters.h"
+#include "imu_handler.h"
+#include <math.h>
+#include <string>
+#include <vector>
+
+// Send one command line and return everything printed in reply
+static std::string command(const std::string &line) {
+    Serial.discardOutput();
+    Serial.feed(line.c_str());
+    Serial.feed("\n");
+    while (Serial.available()) {
+        processWebSerialConfig();
+    }
+    return Serial.takeOutput();
+}
+
+static bool accepted(const std::string &line) {
+    return command(line).find("\"status\":\"Success\"") != std::string::npos;
+}
+
+static bool sameIMUConfig(const IMUConfig &a, const IMUConfig &b) {
+    return memcmp(&a, &b, sizeof(IMUConfig)) == 0;
+}
+
+static bool samePresetControl(const MidiPresetControl &a, const MidiPresetControl &b) {
+    return a.channel == b.channel && a.type == b.type && a.cc == b.cc;
+}
+
+// CONFIG_OP_WRITE of `tlvs` through the binary protocol; returns the status
+static uint8_t writeTlvs(const std::vector<uint8_t> &tlvs) {
+    uint8_t packet[CONFIG_FRAME_MAX_PACKET] = {0x11, CONFIG_OP_WRITE};
+    memcpy(packet + 2, tlvs.data(), tlvs.size());
+    size_t length = 2 + tlvs.size();
+    uint32_t crc = crc32(packet, length);
+    for (int i = 0; i < 4; i++) {
+        packet[length++] = crc >> (8 * i);
+    }
+    bool changed = false;
+    size_t reply = processConfigPacket(packet, length, changed);
+    CHECK(reply >= 3);
+    CHECK_EQ(changed, packet[2] == CONFIG_FRAME_OK);
+    return packet[2];
+}
+
+static void appendFloat(std::vector<uint8_t> &out, float value) {
+    uint8_t bytes[4];
+    memcpy(bytes, &value, 4);  // Little-endian on the host as on the RP2040
+    out.insert(out.end(), bytes, bytes + 4);
+}
+
+// CONFIG_TLV_IMU_AXIS for `axis`, enabled, to every output
+static std::vector<uint8_t> axisTlv(uint8_t axis, uint8_t channel, uint8_t cc, uint8_t defaultValue,
+                                    float sensitivity, float range) {
+    std::vector<uint8_t> tlv = {CONFIG_TLV_IMU_AXIS, 16, axis, 1, channel, cc, defaultValue, 1, 1, 1};
+    appendFloat(tlv, sensitivity);
+    appendFloat(tlv, range);
+    return tlv;
+}
+
+static std::vector<uint8_t> presetControlTlv(uint8_t channel, uint8_t type, uint8_t cc) {
+    return {CONFIG_TLV_PRESET_CONTROL, 3, channel, type, cc};
+}
+
+static void setupConfig() {
+    static bool done = false;
+    if (!done) {
+        setupMidiFilters();
+        done = true;
+    }
+    resetIMUConfig();
+}
+
+static const char *const invalidAxisFields[] = {
+    "\"channel\":0",
+    "\"channel\":17",
+    "\"channel\":300",
+    "\"channel\":-1",
+    "\"channel\":\"1\"",
+    "\"channel\":1.5",
+    "\"cc\":128",
+    "\"cc\":256",
+    "\"defaultValue\":128",
+    "\"sensitivity\":\"fast\"",
+    "\"range\":0",
+    "\"range\":-45",
+    "\"range\":1e39",
+};
+
+// --- Tests ---
+
+TEST(InvalidAxisFieldsAreRefused) {
+    setupConfig();
+    IMUConfig before = getIMUConfig();
+    for (const char *field : invalidAxisFields) {
+        std::string name(field + 1, strchr(field + 1, '"'));
+        std::string value = strchr(field, ':') + 1;
+        std::string setAxis = std::string("{\"command\":\"SET_IMU_AXIS\",\"axis\":\"pitch\",\"enabled\":true,") +
+                              field + "}";
+        std::string patchField = "{\"command\":\"PATCH\",\"path\":\"/imu/roll/" + name + "\",\"value\":" + value + "}";
+        std::string patchAxis = std::string("{\"command\":\"PATCH\",\"path\":\"/imu/yaw\",\"value\":{") + field + "}}";
+        for (const std::string &line : {setAxis, patchField, patchAxis}) {
+            std::string reply = command(line);
+            if (!CHECK(reply.find("\"status\":\"Invalid setting\"") != std::string::npos)) {
+                printf("  %s -> %s", line.c_str(), reply.c_str());
+            }
+        }
+    }
+    CHECK(sameIMUConfig(getIMUConfig(), before));
+}
+
+TEST(EdgeValuesAreAccepted) {
+    setupConfig();
+    CHECK(accepted("{\"command\":\"PATCH\",\"path\":\"/imu/roll/channel\",\"value\":16}"));
+    CHECK(accepted("{\"command\":\"PATCH\",\"path\":\"/imu/roll/cc\",\"value\":0}"));
+    CHECK(accepted("{\"command\":\"PATCH\",\"path\":\"/imu/roll/defaultValue\",\"value\":127}"));
+    CHECK(accepted("{\"command\":\"SET_IMU_AXIS\",\"axis\":\"yaw\",\"channel\":1,\"cc\":127,"
+                   "\"sensitivity\":-2.5,\"range\":0.5}"));
+    IMUConfig config = getIMUConfig();
+    CHECK_EQ(config.rollMidiChannel, 16);
+    CHECK_EQ(config.rollMidiCC, 0);
+    CHECK_EQ(config.rollDefaultValue, 127);
+    CHECK_EQ(config.yawMidiCC, 127);
+    CHECK(config.yawSensitivity == -2.5f);
+    CHECK(config.yawRange == 0.5f);
+    CHECK(isValidIMUConfig(config));
+}
+
+TEST(SaveAllWithAnInvalidAxisChangesNothing) {
+    setupConfig();
+    IMUConfig before = getIMUConfig();
+    bool channelBefore = getChannelEnabledState(4);
+    std::string saveAll = "{\"command\":\"SAVEALL\","
+                          "\"filters\":[[false,false,false,false,false,false,false,false],"
+                          "[false,false,false,false,false,false,false,false],"
+                          "[false,false,false,false,false,false,false,false]],"
+                          "\"channels\":[true,true,true,true,false,true,true,true,"
+                          "true,true,true,true,true,true,true,true],"
+                          "\"imu\":{\"roll\":{\"enabled\":true,\"cc\":20},\"pitch\":{\"range\":0}}}";
+    CHECK(!accepted(saveAll));
+    CHECK(sameIMUConfig(getIMUConfig(), before));
+    CHECK_EQ(getChannelEnabledState(4), channelBefore);
+}
+
+TEST(BinaryWriteWithAnInvalidValueChangesNothing) {
+    setupConfig();
+    IMUConfig before = getIMUConfig();
+    MidiPresetControl controlBefore = getMidiPresetControl();
+    const std::vector<uint8_t> invalid[] = {
+        axisTlv(0, 0, 1, 64, 1.0f, 45.0f),
+        axisTlv(1, 17, 1, 64, 1.0f, 45.0f),
+        axisTlv(2, 1, 128, 64, 1.0f, 45.0f),
+        axisTlv(0, 1, 1, 255, 1.0f, 45.0f),
+        axisTlv(1, 1, 1, 64, NAN, 45.0f),
+        axisTlv(2, 1, 1, 64, INFINITY, 45.0f),
+        axisTlv(0, 1, 1, 64, 1.0f, 0.0f),
+        axisTlv(1, 1, 1, 64, 1.0f, -45.0f),
+        axisTlv(2, 1, 1, 64, 1.0f, NAN),
+        presetControlTlv(17, MIDI_PRESET_CONTROL_PROGRAM_CHANGE, 0),
+        presetControlTlv(1, MIDI_PRESET_CONTROL_CC + 1, 0),
+        presetControlTlv(1, MIDI_PRESET_CONTROL_CC, 128),
+    };
+    for (const std::vector<uint8_t> &bad : invalid) {
+        // After a valid TLV, so the write must be refused as a whole
+        std::vector<uint8_t> tlvs = presetControlTlv(5, MIDI_PRESET_CONTROL_CC, 20);
+        std::vector<uint8_t> axis = axisTlv(2, 3, 30, 0, 2.0f, 90.0f);
+        tlvs.insert(tlvs.end(), axis.begin(), axis.end());
+        tlvs.insert(tlvs.end(), bad.begin(), bad.end());
+        CHECK_EQ(writeTlvs(tlvs), CONFIG_FRAME_BAD_PAYLOAD);
+        CHECK(!updateConfigFromTlv(tlvs.data(), tlvs.size()));
+    }
+    CHECK(sameIMUConfig(getIMUConfig(), before));
+    CHECK(samePresetControl(getMidiPresetControl(), controlBefore));
+
+    // The edges of each range are accepted
+    std::vector<uint8_t> tlvs = axisTlv(0, 16, 127, 127, -2.5f, 0.5f);
+    std::vector<uint8_t> control = presetControlTlv(16, MIDI_PRESET_CONTROL_CC, 127);
+    tlvs.insert(tlvs.end(), control.begin(), control.end());
+    CHECK_EQ(writeTlvs(tlvs), CONFIG_FRAME_OK);
+    IMUConfig config = getIMUConfig();
+    CHECK_EQ(config.rollMidiChannel, 16);
+    CHECK_EQ(config.rollMidiCC, 127);
+    CHECK(config.rollRange == 0.5f);
+    CHECK_EQ(getMidiPresetControl().channel, 16);
+    CHECK_EQ(getMidiPresetControl().cc, 127);
+    setMidiPresetControl(controlBefore);
+}
+
+TEST(InvalidPresetControlIsRefused) {
+    setupConfig();
+    MidiPresetControl before = getMidiPresetControl();
+    const char *const invalid[] = {
+        "{\"command\":\"SET_PRESET_CONTROL\",\"type\":\"PC\"}",
+        "{\"command\":\"SET_PRESET_CONTROL\",\"channel\":17}",
+        "{\"command\":\"SET_PRESET_CONTROL\",\"channel\":-1}",
+        "{\"command\":\"SET_PRESET_CONTROL\",\"channel\":256}",
+        "{\"command\":\"SET_PRESET_CONTROL\",\"channel\":1,\"type\":\"NRPN\"}",
+        "{\"command\":\"SET_PRESET_CONTROL\",\"channel\":1,\"type\":\"CC\",\"cc\":128}",
+        "{\"command\":\"SET_PRESET_CONTROL\",\"channel\":1,\"type\":\"CC\",\"cc\":\"7\"}",
+    };
+    for (const char *line : invalid) {
+        std::string reply = command(line);
+        if (!CHECK(reply.find("\"status\":\"Invalid preset control\"") != std::string::npos)) {
+            printf("  %s -> %s", line, reply.c_str());
+        }
+    }
+    CHECK(samePresetControl(getMidiPresetControl(), before));
+
+    CHECK(accepted("{\"command\":\"SET_PRESET_CONTROL\",\"channel\":16,\"type\":\"CC\",\"cc\":127}"));
+    CHECK_EQ(getMidiPresetControl().channel, 16);
+    CHECK_EQ(getMidiPresetControl().type, MIDI_PRESET_CONTROL_CC);
+    CHECK_EQ(getMidiPresetControl().cc, 127);
+    CHECK(accepted("{\"command\":\"SET_PRESET_CONTROL\",\"channel\":0}"));
+    CHECK_EQ(getMidiPresetControl().channel, 0);
+    CHECK_EQ(getMidiPresetControl().type, MIDI_PRESET_CONTROL_PROGRAM_CHANGE);
+    setMidiPresetControl(before);
+}
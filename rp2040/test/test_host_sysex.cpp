@@ -0,0 +1,193 @@
+// USB host SysEx receive: packets from a simulated device go through
+// tuh_midi_rx_cb() and the per-cable reassembly of usb_host_wrapper.cpp.
+// Checks that dumps come out byte for byte, whole up to SYSEX_MAX_LENGTH
+// and in chunks beyond, per cable and with the buffer pool exhausted, and
+// measures reassembly throughput on multi-kilobyte dumps.
+
+#include "host_test.h"
+#include "fake_tinyusb.h"
+#include "usb_host_wrapper.h"
+#include "usb_host_midi_handlers.h"
+#include "midi_packet.h"
+#include "sysex_assembler.h"
+#include "led_utils.h"
+#include <vector>
+
+// --- Router side of the wrapper ---
+
+static uint8_t receivePort = 0;
+static std::vector<uint8_t> received[MIDI_HOST_PORTS];
+static std::vector<unsigned> chunkSizes[MIDI_HOST_PORTS];
+static bool countOnly = false;
+static uint64_t countedBytes = 0;
+
+void usbh_setReceivePort(uint8_t port) { receivePort = port; }
+
+void usbh_onSysEx(byte *array, unsigned size) {
+    if (countOnly) {
+        countedBytes += size;
+        return;
+    }
+    received[receivePort].insert(received[receivePort].end(), array, array + size);
+    chunkSizes[receivePort].push_back(size);
+}
+
+void usbh_onNoteOn(byte channel, byte note, byte velocity) { (void)channel; (void)note; (void)velocity; }
+void usbh_onNoteOff(byte channel, byte note, byte velocity) { (void)channel; (void)note; (void)velocity; }
+void usbh_onPolyAftertouch(byte channel, byte note, byte amount) { (void)channel; (void)note; (void)amount; }
+void usbh_onControlChange(byte channel, byte controller, byte value) { (void)channel; (void)controller; (void)value; }
+void usbh_onProgramChange(byte channel, byte program) { (void)channel; (void)program; }
+void usbh_onChannelAftertouch(byte channel, byte value) { (void)channel; (void)value; }
+void usbh_onPitchBend(byte channel, int value) { (void)channel; (void)value; }
+void usbh_onMidiClock() {}
+void usbh_onMidiStart() {}
+void usbh_onMidiContinue() {}
+void usbh_onMidiStop() {}
+
+bool midiRouterHasHeadroom() { return true; }
+void triggerUsbLED() {}
+
+// --- Helpers ---
+
+static std::vector<uint8_t> makeDump(unsigned size, uint8_t seed) {
+    std::vector<uint8_t> dump(size);
+    dump[0] = 0xF0;
+    for (unsigned i = 1; i + 1 < size; i++) {
+        dump[i] = (uint8_t)((i * 7 + seed) & 0x7F);
+    }
+    dump[size - 1] = 0xF7;
+    return dump;
+}
+
+static std::vector<uint32_t> toPackets(const std::vector<uint8_t> &dump, uint8_t cable) {
+    std::vector<uint32_t> packets;
+    MidiSysExEncoder encoder;
+    uint8_t packet[4];
+    midiSysExEncoderBegin(encoder, dump.data(), dump.size());
+    while (midiSysExEncoderNext(encoder, packet)) {
+        packet[0] |= cable << 4;
+        packets.push_back(packet[0] | (packet[1] << 8) | (packet[2] << 16) | ((uint32_t)packet[3] << 24));
+    }
+    return packets;
+}
+
+static void receivePacket(uint8_t idx, uint32_t word) {
+    uint8_t packet[4] = { (uint8_t)word, (uint8_t)(word >> 8), (uint8_t)(word >> 16), (uint8_t)(word >> 24) };
+    fakeUsbReceive(idx, packet);
+}
+
+static void resetReceived() {
+    for (int port = 0; port < MIDI_HOST_PORTS; port++) {
+        received[port].clear();
+        chunkSizes[port].clear();
+    }
+}
+
+// One device on idx 0; its cables get ports 0, 1, ...
+static void mountDevice(uint8_t cables) {
+    fakeUsbUnmount(0);
+    fakeUsbMount(0, cables);
+    resetReceived();
+}
+
+// --- Tests ---
+
+TEST(DumpUpToMaxLengthArrivesWhole) {
+    mountDevice(1);
+    std::vector<uint8_t> dump = makeDump(SYSEX_MAX_LENGTH, 1);
+    for (uint32_t word : toPackets(dump, 0)) {
+        receivePacket(0, word);
+    }
+    CHECK_EQ(chunkSizes[0].size(), 1);
+    CHECK(received[0] == dump);
+}
+
+TEST(LongDumpIsForwardedInChunks) {
+    mountDevice(1);
+    std::vector<uint8_t> dump = makeDump(5000, 2);
+    for (uint32_t word : toPackets(dump, 0)) {
+        receivePacket(0, word);
+    }
+    CHECK_EQ(chunkSizes[0].size(), (5000 + SYSEX_MAX_LENGTH - 1) / SYSEX_MAX_LENGTH);
+    for (size_t i = 0; i + 1 < chunkSizes[0].size(); i++) {
+        CHECK_EQ(chunkSizes[0][i], SYSEX_MAX_LENGTH);
+    }
+    CHECK(received[0] == dump);
+}
+
+TEST(CablesAreReassembledSeparately) {
+    mountDevice(2);
+    std::vector<uint8_t> dumps[2] = { makeDump(3000, 3), makeDump(700, 4) };
+    std::vector<uint32_t> packets[2] = { toPackets(dumps[0], 0), toPackets(dumps[1], 1) };
+    size_t longest = packets[0].size() > packets[1].size() ? packets[0].size() : packets[1].size();
+    for (size_t i = 0; i < longest; i++) {
+        for (int cable = 0; cable < 2; cable++) {
+            if (i < packets[cable].size()) {
+                receivePacket(0, packets[cable][i]);
+            }
+        }
+    }
+    CHECK(received[0] == dumps[0]);
+    CHECK(received[1] == dumps[1]);
+    CHECK_EQ(getSysExAssemblerStats().buffersInUse, 0);
+}
+
+TEST(DumpsStreamWhenThePoolIsExhausted) {
+    // One more cable mid-dump than there are pool buffers: the last one is
+    // streamed fragment by fragment, but still arrives complete
+    const uint8_t cables = SYSEX_POOL_BUFFERS + 1;
+    mountDevice(cables);
+    uint32_t exhaustedBefore = getSysExAssemblerStats().poolExhausted;
+    std::vector<std::vector<uint8_t>> dumps;
+    std::vector<std::vector<uint32_t>> packets;
+    for (uint8_t cable = 0; cable < cables; cable++) {
+        dumps.push_back(makeDump(600, cable));
+        packets.push_back(toPackets(dumps.back(), cable));
+    }
+    for (size_t i = 0; i < packets[0].size(); i++) {
+        for (uint8_t cable = 0; cable < cables; cable++) {
+            receivePacket(0, packets[cable][i]);
+        }
+    }
+    for (uint8_t cable = 0; cable < cables; cable++) {
+        CHECK(received[cable] == dumps[cable]);
+    }
+    CHECK_EQ(getSysExAssemblerStats().poolExhausted - exhaustedBefore, 1);
+    CHECK_EQ(getSysExAssemblerStats().buffersInUse, 0);
+}
+
+TEST(UnplugMidDumpFreesTheBuffer) {
+    mountDevice(1);
+    std::vector<uint32_t> packets = toPackets(makeDump(900, 5), 0);
+    for (size_t i = 0; i < packets.size() / 2; i++) {
+        receivePacket(0, packets[i]);
+    }
+    CHECK_EQ(getSysExAssemblerStats().buffersInUse, 1);
+    fakeUsbUnmount(0);
+    CHECK_EQ(getSysExAssemblerStats().buffersInUse, 0);
+    fakeUsbMount(0, 1);
+}
+
+TEST(ReassemblyThroughput) {
+    mountDevice(1);
+    const unsigned dumpSize = 4096;
+    std::vector<uint32_t> packets = toPackets(makeDump(dumpSize, 6), 0);
+    unsigned long dumps = hostBenchIterations(256);
+
+    countOnly = true;
+    countedBytes = 0;
+    uint64_t startNs = hostBenchNanos();
+    uint64_t startCycles = hostBenchCycles();
+    for (unsigned long d = 0; d < dumps; d++) {
+        for (uint32_t word : packets) {
+            receivePacket(0, word);
+        }
+    }
+    uint64_t cycles = hostBenchCycles() - startCycles;
+    uint64_t ns = hostBenchNanos() - startNs;
+    countOnly = false;
+
+    CHECK_EQ(countedBytes, (uint64_t)dumps * dumpSize);
+    hostBenchReport("host_sysex_reassembly_per_byte", (double)cycles / countedBytes, hostBenchCycleUnit());
+    hostBenchReport("host_sysex_reassembly_throughput", countedBytes / (ns / 1e9) / 1e6, "MB/s");
+}
@@ -0,0 +1,178 @@
+// Host to computer: SysEx dumps from a simulated USB host device
+// (fake_tinyusb.h) cross to core 0 and go out of the USB device port
+// (fake_usb_device.h), through the router's park rings and the device
+// staging queue. Both cores are run in turn from one thread. A dump must
+// reach the computer byte for byte, with nothing dropped on the way, also
+// when it goes to DIN as well and when dumps come back to back.
+
+#include "host_test.h"
+#include "fake_tinyusb.h"
+#include "fake_usb_device.h"
+#include "midi_router.h"
+#include "midi_filters.h"
+#include "midi_packet.h"
+#include "usb_host_wrapper.h"
+#include "usb_device_midi_handlers.h"
+#include "serial_midi_handler.h"
+#include "serial_midi_scheduler.h"
+#include "config_sysex.h"
+#include "sysex_assembler.h"
+#include "led_utils.h"
+#include "pico/platform.h"
+#include <vector>
+
+volatile bool isConnectedToComputer = true;
+
+// --- Core 0 outputs besides the device port ---
+
+static std::vector<uint8_t> serialOut;
+
+void sendSerialMidiRaw(const byte *data, unsigned size) {
+    serialOut.insert(serialOut.end(), data, data + size);
+}
+
+bool serialMidiSchedulerHasRoom() {
+    return true;
+}
+
+void triggerSerialLED() {}
+void triggerUsbLED() {}
+
+bool isConfigSysExEndpoint(uint8_t endpoint) {
+    (void)endpoint;
+    return false;
+}
+
+bool receiveConfigSysEx(uint8_t endpoint, const uint8_t *data, unsigned size,
+                        const uint8_t **reply, unsigned *replySize) {
+    (void)endpoint;
+    (void)data;
+    (void)size;
+    (void)reply;
+    (void)replySize;
+    return false;
+}
+
+// --- Helpers ---
+
+static std::vector<uint8_t> makeDump(unsigned size, uint8_t seed) {
+    std::vector<uint8_t> dump(size);
+    dump[0] = 0xF0;
+    for (unsigned i = 1; i + 1 < size; i++) {
+        dump[i] = (uint8_t)((i * 5 + seed) & 0x7F);
+    }
+    dump[size - 1] = 0xF7;
+    return dump;
+}
+
+// The SysEx bytes in a stream of USB-MIDI packets, cable 0
+static std::vector<uint8_t> sysexBytes(const std::vector<uint8_t> &packets) {
+    std::vector<uint8_t> bytes;
+    for (size_t i = 0; i + 3 < packets.size(); i += 4) {
+        uint8_t cin = packets[i] & 0x0F;
+        unsigned length = cin == 0x4 || cin == 0x7 ? 3 : cin == 0x6 ? 2 : cin == 0x5 ? 1 : 0;
+        bytes.insert(bytes.end(), &packets[i + 1], &packets[i + 1 + length]);
+    }
+    return bytes;
+}
+
+// One pass of each core's loop(): core 1 services the host port, core 0
+// delivers what crossed over and writes out the staging queue, then a USB
+// frame goes by on both buses
+static void runCores() {
+    shimCoreNum = 1;
+    usb_host_wrapper_task();
+    loopMidiRouter();
+    shimCoreNum = 0;
+    loopMidiRouter();
+    flushUsbDeviceMidi();
+    fakeUsbDeviceFrame();
+    fakeUsbFrame();
+}
+
+// The device on the host port sends `dump`; the host reads it as fast as
+// the router lets it
+static void sendFromHost(const std::vector<uint8_t> &dump) {
+    MidiSysExEncoder encoder;
+    uint8_t packet[4];
+    midiSysExEncoderBegin(encoder, dump.data(), dump.size());
+    shimCoreNum = 1;
+    while (midiSysExEncoderNext(encoder, packet)) {
+        fakeUsbReceive(0, packet);
+    }
+}
+
+// Run the cores until everything has gone through
+static void runUntilIdle() {
+    for (int pass = 0; pass < 1000 && (fakeUsbPendingRx(0) > 0 || getCrossCoreQueueStats(0).depth > 0 ||
+                                      getUsbDeviceTxQueueStats().depth > 0); pass++) {
+        runCores();
+    }
+    runCores();
+}
+
+static void setup() {
+    static bool done = false;
+    if (!done) {
+        setupMidiFilters();
+        setupUsbDeviceHandlers();
+        fakeUsbMount(0, 1);
+        done = true;
+    }
+    fakeUsbDeviceReset();
+    serialOut.clear();
+}
+
+// --- Tests ---
+
+TEST(DumpReachesTheComputerWhole) {
+    setup();
+    setMidiDestFilter(MIDI_INTERFACE_SERIAL, MIDI_MSG_SYSEX, true);
+    std::vector<uint8_t> dump = makeDump(SYSEX_MAX_LENGTH, 1);
+    sendFromHost(dump);
+    runUntilIdle();
+    setMidiDestFilter(MIDI_INTERFACE_SERIAL, MIDI_MSG_SYSEX, false);
+
+    CHECK(sysexBytes(fakeUsbDeviceReceived()) == dump);
+    CHECK_EQ(fakeUsbDeviceReceived().size(), 4 * midiSysExPacketCount(dump.data(), dump.size()));
+    CHECK_EQ(getUsbDeviceTxQueueStats().drops, 0);
+    CHECK_EQ(getCrossCoreQueueStats(0).drops, 0);
+    CHECK(serialOut.empty());
+}
+
+TEST(BackToBackDumpsReachTheComputer) {
+    // Sent before either core runs: the host stops reading while the
+    // cross-core queue is short of room, and catches up as it drains
+    setup();
+    setMidiDestFilter(MIDI_INTERFACE_SERIAL, MIDI_MSG_SYSEX, true);
+    std::vector<uint8_t> expected;
+    for (uint8_t seed = 0; seed < 4; seed++) {
+        std::vector<uint8_t> dump = makeDump(SYSEX_MAX_LENGTH - seed * 100, seed);
+        sendFromHost(dump);
+        expected.insert(expected.end(), dump.begin(), dump.end());
+    }
+    runUntilIdle();
+    setMidiDestFilter(MIDI_INTERFACE_SERIAL, MIDI_MSG_SYSEX, false);
+
+    CHECK(sysexBytes(fakeUsbDeviceReceived()) == expected);
+    CHECK_EQ(getUsbDeviceTxQueueStats().drops, 0);
+    CHECK_EQ(getCrossCoreQueueStats(0).drops, 0);
+}
+
+TEST(DumpsReachDinAndTheComputer) {
+    // Default filters: each dump crosses over once per core 0 output
+    setup();
+    std::vector<uint8_t> expected;
+    for (uint8_t seed = 0; seed < 3; seed++) {
+        std::vector<uint8_t> dump = makeDump(SYSEX_MAX_LENGTH, seed + 10);
+        sendFromHost(dump);
+        expected.insert(expected.end(), dump.begin(), dump.end());
+    }
+    runUntilIdle();
+
+    CHECK(sysexBytes(fakeUsbDeviceReceived()) == expected);
+    CHECK(serialOut == expected);
+    CHECK_EQ(getUsbDeviceTxQueueStats().drops, 0);
+    CHECK_EQ(getCrossCoreQueueStats(0).drops, 0);
+    CHECK(getCrossCoreQueueStats(0).highWater >= 2 * midiSysExPacketCount(expected.data(), SYSEX_MAX_LENGTH));
+}
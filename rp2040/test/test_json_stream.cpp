@@ -0,0 +1,125 @@
+// JsonStreamWriter output format. The numbers are the cases ArduinoJson
+// checks its own TextFormatter::writeFloat() against, so streamed floats
+// print exactly as serializeJson() printed them. test_readall compares a
+// whole READALL with serializeJson() when ArduinoJson is available.
+
+#include "host_test.h"
+#include "json_stream.h"
+#include <string>
+
+class StringPrint : public Print {
+public:
+    size_t write(uint8_t c) override {
+        text.push_back((char)c);
+        return 1;
+    }
+    using Print::write;
+
+    std::string text;
+};
+
+template <typename T>
+static std::string format(T v) {
+    StringPrint out;
+    JsonStreamWriter json(out);
+    json.value(v);
+    return out.text;
+}
+
+static void checkText(const std::string &actual, const char *expected, const char *expr, int line) {
+    if (!hostTestCheck(actual == expected, expr, __FILE__, line)) {
+        printf("  got \"%s\", expected \"%s\"\n", actual.c_str(), expected);
+    }
+}
+
+#define CHECK_TEXT(actual, expected) checkText(actual, expected, #actual, __LINE__)
+#define CHECK_FORMAT(v, expected) CHECK_TEXT(format(v), expected)
+
+TEST(DoubleUpToNineDecimals) {
+    CHECK_FORMAT(0.0, "0");
+    CHECK_FORMAT(-0.0, "0");
+    CHECK_FORMAT(3.14159265359, "3.141592654");
+    CHECK_FORMAT(-3.14159265359, "-3.141592654");
+    CHECK_FORMAT(0.100000001, "0.100000001");
+    CHECK_FORMAT(0.999999999, "0.999999999");
+    CHECK_FORMAT(9.000000001, "9.000000001");
+    CHECK_FORMAT(9.999999999, "9.999999999");
+    CHECK_FORMAT(0.1000000001, "0.1");
+    CHECK_FORMAT(0.9999999999, "1");
+    CHECK_FORMAT(9.0000000001, "9");
+    CHECK_FORMAT(9.9999999999, "10");
+    CHECK_FORMAT(0.9999999996, "1");
+}
+
+TEST(DoubleExponents) {
+    CHECK_FORMAT(1e-4, "0.0001");
+    CHECK_FORMAT(1e-5, "1e-5");
+    CHECK_FORMAT(-1e-4, "-0.0001");
+    CHECK_FORMAT(-1e-5, "-1e-5");
+    CHECK_FORMAT(9999999.999, "9999999.999");
+    CHECK_FORMAT(10000000.0, "1e7");
+    CHECK_FORMAT(-9999999.999, "-9999999.999");
+    CHECK_FORMAT(-10000000.0, "-1e7");
+    CHECK_FORMAT(0.000099999999999, "0.0001");
+    CHECK_FORMAT(0.0000099999999999, "1e-5");
+    CHECK_FORMAT(9999999.9999999999, "1e7");
+    CHECK_FORMAT(2.2204460492503131e-16, "2.220446049e-16");
+    CHECK_FORMAT(-2.2204460492503131e-16, "-2.220446049e-16");
+    CHECK_FORMAT(1.7976931348623157e+308, "1.797693135e308");
+    CHECK_FORMAT(-1.7976931348623157e+308, "-1.797693135e308");
+    CHECK_FORMAT(2.2250738585072014e-308, "2.225073859e-308");
+    CHECK_FORMAT(1e255, "1e255");
+    CHECK_FORMAT(1e-255, "1e-255");
+}
+
+TEST(FloatUpToSixDecimals) {
+    CHECK_FORMAT(3.14159265359f, "3.141593");
+    CHECK_FORMAT(-3.14159265359f, "-3.141593");
+    CHECK_FORMAT(24.3f, "24.3");
+    CHECK_FORMAT(-24.3f, "-24.3");
+    CHECK_FORMAT(999.9f, "999.9");
+    CHECK_FORMAT(-999.9f, "-999.9");
+    CHECK_FORMAT(0.0f, "0");
+    CHECK_FORMAT(-0.0f, "0");
+    CHECK_FORMAT(1e-4f, "0.0001");
+    CHECK_FORMAT(1e-5f, "1e-5");
+    CHECK_FORMAT(1e7f, "1e7");
+    CHECK_FORMAT(1.19209290e-7f, "1.192093e-7");
+    CHECK_FORMAT(1.17549435e-38f, "1.175494e-38");
+    CHECK_FORMAT(3.40282346639e+38f, "3.402823e38");
+    CHECK_FORMAT(-3.40282346639e+38f, "-3.402823e38");
+    CHECK_FORMAT(1.0f, "1");
+    CHECK_FORMAT(1.5f, "1.5");
+    CHECK_FORMAT(0.1f, "0.1");
+    CHECK_FORMAT(45.0f, "45");
+    // One decimal fewer per extra integral digit: not the same as %g
+    CHECK_FORMAT(123.456787f, "123.4568");
+}
+
+TEST(NotANumberIsNull) {
+    CHECK_FORMAT(NAN, "null");
+    CHECK_FORMAT((double)INFINITY, "null");
+    CHECK_FORMAT(-(double)INFINITY, "null");
+}
+
+TEST(CompactLayout) {
+    StringPrint out;
+    JsonStreamWriter json(out);
+    json.beginObject();
+    json.beginArray("filters");
+    json.beginArray();
+    json.value(true);
+    json.value(false);
+    json.endArray();
+    json.beginArray();
+    json.endArray();
+    json.endArray();
+    json.member("active", (int8_t)-1);
+    json.member("name", "a\"b\\c\n\x01");
+    json.beginObject("imu");
+    json.member("range", 45.5f);
+    json.endObject();
+    json.endObject();
+    CHECK_TEXT(out.text, "{\"filters\":[[true,false],[]],\"active\":-1,"
+                         "\"name\":\"a\\\"b\\\\c\\n\\u0001\",\"imu\":{\"range\":45.5}}");
+}
@@ -0,0 +1,234 @@
+// Source flood protection on the simulated clock: bucket refill, the
+// exempt traffic, quarantine after a flood, its doubling on repeat
+// offences and the reset after probation, and SysEx dumps admitted whole.
+// The limiter keeps its state per endpoint for good, so each test uses its
+// own source endpoint.
+
+#include "host_test.h"
+#include "midi_rate_limit.h"
+#include "sysex_assembler.h"
+#include <vector>
+
+// --- Helpers ---
+
+static MidiMessage noteOn(byte velocity = 100) {
+    MidiMessage msg = {};
+    msg.type = MIDI_MSG_NOTE;
+    msg.channel = 1;
+    msg.data1 = 60;
+    msg.data2 = velocity;
+    return msg;
+}
+
+static MidiMessage noteOff() {
+    MidiMessage msg = noteOn(0);
+    msg.subType = 1;
+    return msg;
+}
+
+static MidiMessage controlChange() {
+    MidiMessage msg = {};
+    msg.type = MIDI_MSG_CONTROL_CHANGE;
+    msg.channel = 1;
+    msg.data1 = 74;
+    msg.data2 = 64;
+    return msg;
+}
+
+static MidiMessage realtime(midi::MidiType type) {
+    MidiMessage msg = {};
+    msg.type = MIDI_MSG_REALTIME;
+    msg.rtType = type;
+    return msg;
+}
+
+static MidiMessage sysex(std::vector<byte> &data) {
+    MidiMessage msg = {};
+    msg.type = MIDI_MSG_SYSEX;
+    msg.sysexData = data.data();
+    msg.sysexSize = data.size();
+    return msg;
+}
+
+// SysEx bytes: F0 first if `starts`, F7 last if `ends`
+static std::vector<byte> sysexBytes(unsigned size, bool starts = true, bool ends = true) {
+    std::vector<byte> data(size, 0x42);
+    if (starts) {
+        data.front() = 0xF0;
+    }
+    if (ends) {
+        data.back() = 0xF7;
+    }
+    return data;
+}
+
+// Messages of one kind allowed at the current instant, out of `count`
+static uint32_t allowedOf(uint8_t endpoint, const MidiMessage &msg, uint32_t count) {
+    uint32_t allowed = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        allowed += midiRateLimitAllows(endpoint, msg);
+    }
+    return allowed;
+}
+
+// Note ons at the current instant until the source is quarantined
+static void floodUntilQuarantined(uint8_t endpoint) {
+    uint32_t quarantines = getMidiRateStats(endpoint).quarantines;
+    MidiRateLimit limit = getMidiRateLimit(MIDI_RATE_CLASS_NOTE);
+    allowedOf(endpoint, noteOn(), limit.burst + MIDI_RATE_QUARANTINE_DROPS);
+    CHECK_EQ(getMidiRateStats(endpoint).quarantines, quarantines + 1);
+    CHECK(getMidiRateStats(endpoint).quarantined);
+}
+
+// The quarantine just started lasts exactly `ms`. Leaves the clock at its end.
+static void checkQuarantineLength(uint8_t endpoint, uint32_t ms) {
+    shimAdvanceMillis(ms - 1);
+    CHECK(!midiRateLimitAllows(endpoint, noteOn()));
+    shimAdvanceMillis(1);
+    CHECK(midiRateLimitAllows(endpoint, noteOn()));
+    CHECK(!getMidiRateStats(endpoint).quarantined);
+}
+
+// --- Tests ---
+
+TEST(BucketRefillsAtTheRate) {
+    const uint8_t src = MIDI_ENDPOINT_SERIAL;
+    // Note ons: 1000/s, so one token per millisecond, 128 at most
+    CHECK_EQ(allowedOf(src, noteOn(), 200), 128);
+    shimAdvanceMillis(1);
+    CHECK_EQ(allowedOf(src, noteOn(), 5), 1);
+    shimAdvanceMillis(10);
+    CHECK_EQ(allowedOf(src, noteOn(), 20), 10);
+    shimAdvanceMillis(5000);
+    CHECK_EQ(allowedOf(src, noteOn(), 200), 128);
+
+    // Each class has its own bucket
+    CHECK_EQ(allowedOf(src, controlChange(), 300), 256);
+    CHECK_EQ(getMidiRateStats(src).limited, 72 + 4 + 10 + 72 + 44);
+    CHECK_EQ(getMidiRateStats(src).quarantines, 0);
+}
+
+TEST(NoteOffsAndClockAreNeverLimited) {
+    const uint8_t src = MIDI_ENDPOINT_USB_DEVICE;
+    CHECK_EQ(allowedOf(src, noteOn(), 129), 128);
+    CHECK_EQ(allowedOf(src, noteOff(), 1000), 1000);
+    CHECK_EQ(allowedOf(src, noteOn(0), 1000), 1000);      // Note on with velocity 0
+    CHECK_EQ(allowedOf(src, realtime(midi::Clock), 1000), 1000);
+    CHECK_EQ(allowedOf(src, realtime(midi::Start), 20), 16);
+    CHECK_EQ(allowedOf(MIDI_ENDPOINT_NONE, noteOn(), 1000), 1000);
+}
+
+TEST(FloodIsQuarantined) {
+    const uint8_t src = MIDI_ENDPOINT_HOST_PORT_BASE;
+    // The bucket, then MIDI_RATE_QUARANTINE_DROPS refusals
+    CHECK_EQ(allowedOf(src, noteOn(), 128 + MIDI_RATE_QUARANTINE_DROPS - 1), 128);
+    CHECK(!getMidiRateStats(src).quarantined);
+    CHECK(!midiRateLimitAllows(src, noteOn()));
+    CHECK(getMidiRateStats(src).quarantined);
+
+    // Everything limited is dropped, even with tokens to spare
+    shimAdvanceMillis(500);
+    CHECK_EQ(allowedOf(src, noteOn(), 10), 0);
+    CHECK_EQ(allowedOf(src, controlChange(), 10), 0);
+    CHECK_EQ(allowedOf(src, noteOff(), 10), 10);
+    CHECK_EQ(getMidiRateStats(src).quarantineDrops, 20);
+    checkQuarantineLength(src, 500);
+    CHECK_EQ(allowedOf(src, controlChange(), 10), 10);
+}
+
+TEST(DropsBelowTheThresholdAreForgiven) {
+    const uint8_t src = MIDI_ENDPOINT_HOST_PORT_BASE + 1;
+    // A steady overload refused less than MIDI_RATE_QUARANTINE_DROPS times
+    // per window is throttled, not quarantined
+    allowedOf(src, noteOn(), 128);
+    for (int window = 0; window < 10; window++) {
+        CHECK_EQ(allowedOf(src, noteOn(), MIDI_RATE_QUARANTINE_DROPS - 1), 0);
+        shimAdvanceMillis(MIDI_RATE_QUARANTINE_WINDOW_MS + 1);
+        allowedOf(src, noteOn(), 128);
+    }
+    CHECK_EQ(getMidiRateStats(src).quarantines, 0);
+}
+
+TEST(RepeatOffencesDoubleUpToTheMaximum) {
+    const uint8_t src = MIDI_ENDPOINT_HOST_PORT_BASE + 2;
+    static const uint32_t lengths[] = { 1000, 2000, 4000, 8000, 16000, 30000, 30000 };
+    for (uint32_t ms : lengths) {
+        floodUntilQuarantined(src);
+        checkQuarantineLength(src, ms);
+    }
+    CHECK_EQ(getMidiRateStats(src).quarantines, 7);
+}
+
+TEST(ProbationResetsTheLength) {
+    const uint8_t src = MIDI_ENDPOINT_HOST_PORT_BASE + 3;
+    floodUntilQuarantined(src);
+    checkQuarantineLength(src, MIDI_RATE_QUARANTINE_MS);
+    shimAdvanceMillis(MIDI_RATE_PROBATION_MS - 1);
+    floodUntilQuarantined(src);
+    checkQuarantineLength(src, 2 * MIDI_RATE_QUARANTINE_MS);
+
+    // Well behaved for the whole probation: back to the first length
+    shimAdvanceMillis(MIDI_RATE_PROBATION_MS);
+    floodUntilQuarantined(src);
+    checkQuarantineLength(src, MIDI_RATE_QUARANTINE_MS);
+}
+
+TEST(SysExDumpsAreAdmittedWhole) {
+    const uint8_t src = MIDI_ENDPOINT_HOST_PORT_BASE + 4;
+    MidiRateLimit saved = getMidiRateLimit(MIDI_RATE_CLASS_SYSEX);
+    MidiRateLimit limit = { 1000, SYSEX_MAX_LENGTH };
+    CHECK(setMidiRateLimit(MIDI_RATE_CLASS_SYSEX, limit));
+
+    // A dump longer than the bucket passes when it is full, and empties it
+    std::vector<byte> large = sysexBytes(3 * SYSEX_MAX_LENGTH);
+    std::vector<byte> small = sysexBytes(10);
+    CHECK(midiRateLimitAllows(src, sysex(large)));
+    CHECK(!midiRateLimitAllows(src, sysex(small)));
+    shimAdvanceMillis(10);
+    CHECK(midiRateLimitAllows(src, sysex(small)));
+    CHECK(!midiRateLimitAllows(src, sysex(large)));
+    shimAdvanceMillis(SYSEX_MAX_LENGTH);
+    CHECK(midiRateLimitAllows(src, sysex(large)));
+
+    // A dump in chunks is decided at its F0: the rest follows it through,
+    // or is dropped up to its F7
+    std::vector<byte> first = sysexBytes(SYSEX_MAX_LENGTH, true, false);
+    std::vector<byte> middle = sysexBytes(SYSEX_MAX_LENGTH, false, false);
+    std::vector<byte> last = sysexBytes(100, false, true);
+    CHECK(!midiRateLimitAllows(src, sysex(first)));
+    CHECK(!midiRateLimitAllows(src, sysex(middle)));
+    CHECK(!midiRateLimitAllows(src, sysex(last)));
+    shimAdvanceMillis(SYSEX_MAX_LENGTH);
+    CHECK(midiRateLimitAllows(src, sysex(first)));
+    CHECK(midiRateLimitAllows(src, sysex(middle)));
+    CHECK(midiRateLimitAllows(src, sysex(last)));
+    // The chunks after the first are charged all the same
+    shimAdvanceMillis(SYSEX_MAX_LENGTH);
+    std::vector<byte> head = sysexBytes(10, true, false);
+    std::vector<byte> body = sysexBytes(SYSEX_MAX_LENGTH - 25, false, false);
+    std::vector<byte> tail = sysexBytes(10, false, true);
+    CHECK(midiRateLimitAllows(src, sysex(head)));
+    CHECK(midiRateLimitAllows(src, sysex(body)));
+    CHECK(midiRateLimitAllows(src, sysex(tail)));
+    CHECK(!midiRateLimitAllows(src, sysex(small)));
+
+    CHECK(setMidiRateLimit(MIDI_RATE_CLASS_SYSEX, saved));
+}
+
+TEST(SysExBurstHoldsAWholeMessage) {
+    MidiRateLimit saved = getMidiRateLimit(MIDI_RATE_CLASS_SYSEX);
+    MidiRateLimit tooSmall = { 32000, SYSEX_MAX_LENGTH - 1 };
+    MidiRateLimit smallest = { 32000, SYSEX_MAX_LENGTH };
+    MidiRateLimit unlimited = { 0, 0 };
+    MidiRateLimit tooFast = { MIDI_RATE_MAX + 1, 8192 };
+    CHECK(!setMidiRateLimit(MIDI_RATE_CLASS_SYSEX, tooSmall));
+    CHECK(!setMidiRateLimit(MIDI_RATE_CLASS_SYSEX, tooFast));
+    CHECK_EQ(getMidiRateLimit(MIDI_RATE_CLASS_SYSEX).burst, saved.burst);
+    CHECK(setMidiRateLimit(MIDI_RATE_CLASS_SYSEX, smallest));
+    CHECK(setMidiRateLimit(MIDI_RATE_CLASS_SYSEX, unlimited));
+    CHECK(setMidiRateLimit(MIDI_RATE_CLASS_SYSEX, saved));
+
+    // Other classes only need a bucket
+    MidiRateLimit noBurst = { 100, 0 };
+    CHECK(!setMidiRateLimit(MIDI_RATE_CLASS_NOTE, noBurst));
+}
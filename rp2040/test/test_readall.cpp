@@ -0,0 +1,160 @@
+// READALL is streamed by JsonStreamWriter; before, it was built as a
+// JsonDocument and printed with serializeJson(). This rebuilds that
+// document from the same settings and checks the two outputs are
+// identical byte for byte, for the defaults, after edits over Web Serial
+// and for IMU floats that %g-style formatting would print differently.
+// Needs the real ArduinoJson (ARDUINOJSON_DIR).
+
+#include "host_test.h"
+#include "web_serial_config.h"
+#include "config.h"
+#include "midi_filters.h"
+#include "imu_handler.h"
+#include "version.h"
+#include <ArduinoJson.h>
+#include <string>
+
+// What READALL printed before it was streamed: configToJson() into a
+// JsonDocument, then serializeJson()
+static std::string referenceReadAll() {
+    JsonDocument doc;
+    JsonArray filters = doc["filters"].to<JsonArray>();
+    for (int iface = 0; iface < MIDI_INTERFACE_COUNT; ++iface) {
+        JsonArray ifaceArr = filters.add<JsonArray>();
+        for (int msg = 0; msg < MIDI_MSG_COUNT; ++msg) {
+            ifaceArr.add(getMidiFilterState(iface, msg));
+        }
+    }
+    JsonArray destFilters = doc["destFilters"].to<JsonArray>();
+    for (int iface = 0; iface < MIDI_INTERFACE_COUNT; ++iface) {
+        JsonArray ifaceArr = destFilters.add<JsonArray>();
+        for (int msg = 0; msg < MIDI_MSG_COUNT; ++msg) {
+            ifaceArr.add(getMidiDestFilterState(iface, msg));
+        }
+    }
+    JsonArray channels = doc["channels"].to<JsonArray>();
+    for (int ch = 0; ch < 16; ++ch) {
+        channels.add(getChannelEnabledState(ch));
+    }
+    JsonArray sourceChannels = doc["sourceChannels"].to<JsonArray>();
+    JsonArray destChannels = doc["destChannels"].to<JsonArray>();
+    for (int iface = 0; iface < MIDI_INTERFACE_COUNT; ++iface) {
+        sourceChannels.add(getSourceChannelMask((MidiInterfaceType)iface));
+        destChannels.add(getDestChannelMask((MidiInterfaceType)iface));
+    }
+    JsonObject presets = doc["presets"].to<JsonObject>();
+    presets["active"] = getActiveMidiPreset();
+    JsonArray stored = presets["stored"].to<JsonArray>();
+    for (int slot = 0; slot < MIDI_PRESET_SLOTS; ++slot) {
+        stored.add(isMidiPresetStored(slot));
+    }
+    MidiPresetControl control = getMidiPresetControl();
+    presets["channel"] = control.channel;
+    presets["type"] = control.type == MIDI_PRESET_CONTROL_CC ? "CC" : "PC";
+    presets["cc"] = control.cc;
+
+    IMUConfig imuConfig = getIMUConfig();
+    JsonObject imu = doc["imu"].to<JsonObject>();
+    JsonObject roll = imu["roll"].to<JsonObject>();
+    roll["enabled"] = imuConfig.rollEnabled;
+    roll["channel"] = imuConfig.rollMidiChannel;
+    roll["cc"] = imuConfig.rollMidiCC;
+    roll["defaultValue"] = imuConfig.rollDefaultValue;
+    roll["toSerial"] = imuConfig.rollToSerial;
+    roll["toUSBDevice"] = imuConfig.rollToUSBDevice;
+    roll["toUSBHost"] = imuConfig.rollToUSBHost;
+    roll["sensitivity"] = imuConfig.rollSensitivity;
+    roll["range"] = imuConfig.rollRange;
+    JsonObject pitch = imu["pitch"].to<JsonObject>();
+    pitch["enabled"] = imuConfig.pitchEnabled;
+    pitch["channel"] = imuConfig.pitchMidiChannel;
+    pitch["cc"] = imuConfig.pitchMidiCC;
+    pitch["defaultValue"] = imuConfig.pitchDefaultValue;
+    pitch["toSerial"] = imuConfig.pitchToSerial;
+    pitch["toUSBDevice"] = imuConfig.pitchToUSBDevice;
+    pitch["toUSBHost"] = imuConfig.pitchToUSBHost;
+    pitch["sensitivity"] = imuConfig.pitchSensitivity;
+    pitch["range"] = imuConfig.pitchRange;
+    JsonObject yaw = imu["yaw"].to<JsonObject>();
+    yaw["enabled"] = imuConfig.yawEnabled;
+    yaw["channel"] = imuConfig.yawMidiChannel;
+    yaw["cc"] = imuConfig.yawMidiCC;
+    yaw["defaultValue"] = imuConfig.yawDefaultValue;
+    yaw["toSerial"] = imuConfig.yawToSerial;
+    yaw["toUSBDevice"] = imuConfig.yawToUSBDevice;
+    yaw["toUSBHost"] = imuConfig.yawToUSBHost;
+    yaw["sensitivity"] = imuConfig.yawSensitivity;
+    yaw["range"] = imuConfig.yawRange;
+
+    doc["version"] = FIRMWARE_VERSION;
+    std::string out;
+    serializeJson(doc, out);
+    return out + "\r\n";
+}
+
+// Send one command line and return everything printed in reply
+static std::string command(const char *line) {
+    Serial.discardOutput();
+    Serial.feed(line);
+    Serial.feed("\n");
+    while (Serial.available()) {
+        processWebSerialConfig();
+    }
+    return Serial.takeOutput();
+}
+
+static void checkReadAll() {
+    std::string streamed = command("{\"command\":\"READALL\"}");
+    std::string reference = referenceReadAll();
+    if (!CHECK(streamed == reference)) {
+        printf("  streamed:  %s  reference: %s", streamed.c_str(), reference.c_str());
+    }
+}
+
+static void setupConfig() {
+    static bool done = false;
+    if (!done) {
+        setupMidiFilters();
+        resetIMUConfig();
+        done = true;
+    }
+}
+
+TEST(DefaultConfig) {
+    setupConfig();
+    checkReadAll();
+}
+
+TEST(AfterEdits) {
+    setupConfig();
+    command("{\"command\":\"SET_FILTER\",\"dir\":\"source\",\"iface\":1,\"msg\":2,\"blocked\":true}");
+    command("{\"command\":\"SET_FILTER\",\"dir\":\"dest\",\"iface\":2,\"msg\":7,\"blocked\":true}");
+    command("{\"command\":\"SET_CHANNEL\",\"channel\":10,\"enabled\":false}");
+    command("{\"command\":\"SET_IMU_AXIS\",\"axis\":\"pitch\",\"enabled\":true,\"cc\":74,"
+            "\"sensitivity\":1.25,\"range\":123.456787}");
+    command("{\"command\":\"SAVE_PRESET\",\"slot\":2}");
+    command("{\"command\":\"SET_PRESET_CONTROL\",\"channel\":16,\"type\":\"CC\",\"cc\":3}");
+    checkReadAll();
+}
+
+TEST(FloatSettings) {
+    setupConfig();
+    static const float values[] = {
+        0.0f, 1.0f, 0.1f, 0.333333343f, 2.5f, 45.0f, 123.456787f, 179.999f,
+        1e-6f, 9999999.0f, 1e7f, 3.4028235e38f, -0.5f, -90.0f, 1.17549435e-38f,
+        24.3f, 999.9f, -999.9f, -0.0f, 1.19209290e-7f, -3.4028235e38f
+    };
+    const size_t count = sizeof(values) / sizeof(values[0]);
+    for (size_t i = 0; i < count; i++) {
+        IMUConfig config = getIMUConfig();
+        config.rollSensitivity = values[i];
+        config.rollRange = values[(i + 1) % count];
+        config.pitchSensitivity = values[(i + 2) % count];
+        config.pitchRange = values[(i + 3) % count];
+        config.yawSensitivity = values[(i + 4) % count];
+        config.yawRange = values[(i + 5) % count];
+        setIMUConfig(config);
+        checkReadAll();
+    }
+    resetIMUConfig();
+}
@@ -0,0 +1,208 @@
+// Web Serial commands arriving in fragments, as USB CDC delivers them: a
+// session of commands (edits, READALL, STATUS, a binary frame, an
+// overlong line) is fed a few bytes per loop() pass, and every pass runs
+// processWebSerialConfig() and handleDelayedEEPROMSave() like loop() does.
+// Checks that a pass never waits for the rest of a line (the simulated
+// clock does not move inside it), that the replies are the same however
+// the input is split, and that pass time stays bounded; reports the
+// slowest pass. Uses shim/json when ArduinoJson is not installed.
+
+#include "host_test.h"
+#include "fake_flash.h"
+#include "web_serial_config.h"
+#include "config.h"
+#include "config_journal.h"
+#include "midi_filters.h"
+#include "imu_handler.h"
+#include "json_arena.h"
+#include "config_frame.h"
+#include "crc_utils.h"
+#include <string>
+
+// Generous for a desktop CPU: a pass that waited on the Stream timeout
+// (1 s) or copied the backlog around would be far above it
+#define PASS_LIMIT_NS 5000000
+
+static const char *const session[] = {
+    "{\"command\":\"SET_CHANNEL\",\"channel\":3,\"enabled\":false}",
+    "{\"command\":\"SET_FILTER\",\"dir\":\"dest\",\"iface\":0,\"msg\":1,\"blocked\":true}",
+    "{\"command\":\"READALL\"}",
+    "{\"command\":\"PATCH\",\"path\":\"/channels/3\",\"value\":false}",
+    "{\"command\":\"STATUS\"}",
+    "{\"command\":\"SET_IMU_AXIS\",\"axis\":\"yaw\",\"enabled\":true,\"range\":90.5}",
+    "not json",
+    "{\"command\":\"SET_CHANNEL\",\"channel\":3,\"enabled\":true}",
+    "{\"command\":\"READALL\"}",
+};
+
+// CONFIG_OP_READ request frame: magic, COBS-encoded packet, 0x00
+static std::string readFrame() {
+    uint8_t packet[6] = { 7, CONFIG_OP_READ };
+    uint32_t crc = crc32(packet, 2);
+    for (int i = 0; i < 4; i++) {
+        packet[2 + i] = (uint8_t)(crc >> (8 * i));
+    }
+    std::string frame(1, (char)CONFIG_FRAME_MAGIC);
+    std::string block;
+    for (uint8_t byte : packet) {
+        if (byte == 0) {
+            frame += (char)(block.size() + 1) + block;
+            block.clear();
+        } else {
+            block += (char)byte;
+        }
+    }
+    frame += (char)(block.size() + 1) + block;
+    frame += '\0';
+    return frame;
+}
+
+// Session text with CRLF line ends, one line over WEB_SERIAL_LINE_MAX and
+// a binary frame
+static std::string sessionText() {
+    std::string text;
+    for (const char *line : session) {
+        text += line;
+        text += "\r\n";
+        if (line == session[4]) {
+            text += readFrame();
+        }
+    }
+    std::string overlong = "{\"command\":\"PATCH\",\"path\":\"/channels/0\",\"pad\":\"";
+    overlong.append(2000, 'x');
+    overlong += "\"}\n";
+    text.insert(text.find("\r\n") + 2, overlong);
+    return text;
+}
+
+// Command replies only. Debug lines (JSON and dualPrintf) and STATUS
+// counters depend on when the debounced saves happened to run, which moves
+// with the fragmentation.
+static std::string commandReplies(const std::string &output) {
+    std::string replies;
+    size_t start = 0;
+    while (start < output.size()) {
+        size_t end = output.find('\n', start);
+        end = end == std::string::npos ? output.size() : end + 1;
+        std::string line = output.substr(start, end - start);
+        size_t status = line.find("\"command\":\"STATUS\"");
+        if (status != std::string::npos) {
+            replies += line.substr(0, status) + "\n";
+        } else if (line.compare(0, 9, "{\"debug\":") != 0 && line.compare(0, 7, "[DEBUG]") != 0) {
+            replies += line;
+        }
+        start = end;
+    }
+    return replies;
+}
+
+static unsigned countLines(const std::string &text, const char *needle) {
+    unsigned count = 0;
+    for (size_t at = text.find(needle); at != std::string::npos; at = text.find(needle, at + 1)) {
+        count++;
+    }
+    return count;
+}
+
+typedef struct {
+    std::string replies;         // commandReplies() of the output
+    uint32_t saves;
+    uint32_t passes;
+    uint64_t slowestNs;
+    uint64_t slowestPartialNs;   // Slowest pass that ended mid-line
+    uint64_t totalNs;
+    bool clockMovedInPass;
+} SessionRun;
+
+static void setupSession() {
+    fakeFlashReset();
+    setupConfigJournal();
+    setupMidiFilters();
+    resetIMUConfig();
+    Serial.discardOutput();
+    while (Serial.available()) {
+        Serial.read();
+    }
+}
+
+// Feed `text` in fragments of 1..maxFragment bytes (0: all at once), one
+// fragment per loop() pass, one simulated millisecond apart, then keep
+// passing until the input is used up and the debounced save is done
+static SessionRun runSession(const std::string &text, unsigned maxFragment, uint32_t seed) {
+    setupSession();
+    SessionRun run = {};
+    size_t pos = 0;
+    uint32_t rng = seed;
+    uint32_t idlePasses = 0;
+
+    while (idlePasses < 1000) {
+        if (pos < text.size()) {
+            size_t size = text.size() - pos;
+            if (maxFragment > 0) {
+                rng = rng * 1664525 + 1013904223;
+                size_t fragment = 1 + (rng >> 16) % maxFragment;
+                size = fragment < size ? fragment : size;
+            }
+            Serial.feed(text.data() + pos, size);
+            pos += size;
+        } else if (!Serial.available()) {
+            idlePasses++;
+        }
+
+        unsigned long before = millis();
+        uint64_t start = hostBenchNanos();
+        processWebSerialConfig();
+        handleDelayedEEPROMSave();
+        uint64_t ns = hostBenchNanos() - start;
+        run.clockMovedInPass |= millis() != before;
+
+        run.passes++;
+        run.totalNs += ns;
+        run.slowestNs = ns > run.slowestNs ? ns : run.slowestNs;
+        if (pos < text.size() && text[pos - 1] != '\n') {
+            run.slowestPartialNs = ns > run.slowestPartialNs ? ns : run.slowestPartialNs;
+        }
+        std::string output = Serial.takeOutput();
+        run.saves += countLines(output, "Delayed config save complete");
+        run.replies += commandReplies(output);
+        shimAdvanceMillis(1);
+    }
+    return run;
+}
+
+TEST(RepliesDoNotDependOnFragmentation) {
+    std::string text = sessionText();
+    SessionRun whole = runSession(text, 0, 1);
+    SessionRun bytes = runSession(text, 1, 2);
+    SessionRun mixed = runSession(text, 64, 3);
+
+    // One reply per command, the overlong line rejected on its own
+    CHECK_EQ(countLines(whole.replies, "\"status\":\"Success\""), 6);
+    CHECK_EQ(countLines(whole.replies, "\"filters\":"), 2);
+    CHECK_EQ(countLines(whole.replies, "Line too long"), 1);
+    CHECK_EQ(countLines(whole.replies, "deserializeJson() failed"), 1);
+    CHECK(whole.replies.find((char)CONFIG_FRAME_MAGIC) != std::string::npos);
+    CHECK_EQ(whole.saves, 1);
+    CHECK(bytes.saves >= 1);
+    CHECK(bytes.replies == whole.replies);
+    CHECK(mixed.replies == whole.replies);
+    CHECK_EQ(jsonArena.stats().failures, 0);
+}
+
+TEST(LoopPassStaysBounded) {
+    std::string text = sessionText();
+    uint64_t slowest = 0, slowestPartial = 0, total = 0;
+    uint32_t passes = 0;
+    for (uint32_t seed = 1; seed <= 20; seed++) {
+        SessionRun run = runSession(text, 1 + seed * 7 % 96, seed);
+        CHECK(!run.clockMovedInPass);
+        slowest = run.slowestNs > slowest ? run.slowestNs : slowest;
+        slowestPartial = run.slowestPartialNs > slowestPartial ? run.slowestPartialNs : slowestPartial;
+        total += run.totalNs;
+        passes += run.passes;
+    }
+    CHECK(slowest < PASS_LIMIT_NS);
+    hostBenchReport("web_serial_pass_mean", (double)total / passes / 1000.0, "us");
+    hostBenchReport("web_serial_pass_slowest", slowest / 1000.0, "us");
+    hostBenchReport("web_serial_pass_slowest_mid_line", slowestPartial / 1000.0, "us");
+}
@@ -1,121 +1,88 @@
 #include "usb_device_midi_handlers.h"
 #include "midi_router.h"
+#include "midi_packet.h"
 #include "midi_instances.h"
 
-static void usbd_onNoteOn(byte channel, byte note, byte velocity) {
-  MidiMessage msg = {};
-  msg.type = MIDI_MSG_NOTE;
-  msg.subType = 0;
-  msg.channel = channel;
-  msg.data1 = note;
-  msg.data2 = velocity;
-  routeMidiMessage(MIDI_INTERFACE_USB_DEVICE, msg);
-}
+#define USB_DEVICE_TX_QUEUE_MASK (USB_DEVICE_TX_QUEUE_CAPACITY - 1)
 
-static void usbd_onNoteOff(byte channel, byte note, byte velocity) {
-  MidiMessage msg = {};
-  msg.type = MIDI_MSG_NOTE;
-  msg.subType = 1;
-  msg.channel = channel;
-  msg.data1 = note;
-  msg.data2 = velocity;
-  routeMidiMessage(MIDI_INTERFACE_USB_DEVICE, msg);
-}
+static_assert((USB_DEVICE_TX_QUEUE_CAPACITY & USB_DEVICE_TX_QUEUE_MASK) == 0, "USB_DEVICE_TX_QUEUE_CAPACITY must be a power of two");
+static_assert(USB_DEVICE_TX_RESERVE < USB_DEVICE_TX_QUEUE_CAPACITY - 1, "USB_DEVICE_TX_RESERVE leaves no room for other traffic");
 
-static void usbd_onControlChange(byte channel, byte controller, byte value) {
-  MidiMessage msg = {};
-  msg.type = MIDI_MSG_CONTROL_CHANGE;
-  msg.channel = channel;
-  msg.data1 = controller;
-  msg.data2 = value;
-  routeMidiMessage(MIDI_INTERFACE_USB_DEVICE, msg);
-}
+// Core 0 only: the USB device stack and every writer of this queue live there
+static uint8_t txPackets[USB_DEVICE_TX_QUEUE_CAPACITY][4];
+static uint16_t txHead = 0;
+static uint16_t txTail = 0;
+static volatile uint16_t txHighWater = 0;
+static volatile uint32_t txDrops = 0;
 
-static void usbd_onProgramChange(byte channel, byte program) {
-  MidiMessage msg = {};
-  msg.type = MIDI_MSG_PROGRAM_CHANGE;
-  msg.channel = channel;
-  msg.data1 = program;
-  routeMidiMessage(MIDI_INTERFACE_USB_DEVICE, msg);
+static uint16_t txDepth() {
+  return (txHead - txTail) & USB_DEVICE_TX_QUEUE_MASK;
 }
 
-static void usbd_onPolyAftertouch(byte channel, byte note, byte pressure) {
-  MidiMessage msg = {};
-  msg.type = MIDI_MSG_POLY_AFTERTOUCH;
-  msg.channel = channel;
-  msg.data1 = note;
-  msg.data2 = pressure;
-  routeMidiMessage(MIDI_INTERFACE_USB_DEVICE, msg);
+void setupUsbDeviceHandlers() {
+  txHead = 0;
+  txTail = 0;
 }
 
-static void usbd_onChannelAftertouch(byte channel, byte pressure) {
-  MidiMessage msg = {};
-  msg.type = MIDI_MSG_CHANNEL_AFTERTOUCH;
-  msg.channel = channel;
-  msg.data1 = pressure;
-  routeMidiMessage(MIDI_INTERFACE_USB_DEVICE, msg);
-}
+void loopUsbDeviceMidi() {
+  uint8_t packet[4];
 
-static void usbd_onPitchBend(byte channel, int bend) {
-  MidiMessage msg = {};
-  msg.type = MIDI_MSG_PITCH_BEND;
-  msg.channel = channel;
-  msg.pitchBend = bend;
-  routeMidiMessage(MIDI_INTERFACE_USB_DEVICE, msg);
-}
+  for (int i = 0; i < USB_DEVICE_RX_BUDGET; i++) {
+    // Leave packets in the endpoint (NAKing the computer) while the path
+    // towards the USB host is backed up
+    if (!midiRouterHasHeadroom()) {
+      break;
+    }
+    if (!usb_midi.readPacket(packet)) {
+      break;
+    }
 
-static void usbd_onSysEx(byte *array, unsigned size) {
-  MidiMessage msg = {};
-  msg.type = MIDI_MSG_SYSEX;
-  msg.channel = 0;
-  msg.sysexData = array;
-  msg.sysexSize = size;
-  routeMidiMessage(MIDI_INTERFACE_USB_DEVICE, msg);
+    MidiMessage msg;
+    if (decodeMidiPacket(packet, msg)) {
+      routeMidiMessage(MIDI_INTERFACE_USB_DEVICE, msg);
+    }
+  }
 }
 
-static void usbd_onClock() {
-  MidiMessage msg = {};
-  msg.type = MIDI_MSG_REALTIME;
-  msg.channel = 0;
-  msg.rtType = midi::Clock;
-  routeMidiMessage(MIDI_INTERFACE_USB_DEVICE, msg);
-}
+bool sendUsbDevicePacket(const uint8_t packet[4]) {
+  uint16_t next = (txHead + 1) & USB_DEVICE_TX_QUEUE_MASK;
+  if (next == txTail) {
+    txDrops++;
+    return false;
+  }
 
-static void usbd_onStart() {
-  MidiMessage msg = {};
-  msg.type = MIDI_MSG_REALTIME;
-  msg.channel = 0;
-  msg.rtType = midi::Start;
-  routeMidiMessage(MIDI_INTERFACE_USB_DEVICE, msg);
+  memcpy(txPackets[txHead], packet, 4);
+  txHead = next;
+
+  uint16_t depth = txDepth();
+  if (depth > txHighWater) {
+    txHighWater = depth;
+  }
+  return true;
 }
 
-static void usbd_onContinue() {
-  MidiMessage msg = {};
-  msg.type = MIDI_MSG_REALTIME;
-  msg.channel = 0;
-  msg.rtType = midi::Continue;
-  routeMidiMessage(MIDI_INTERFACE_USB_DEVICE, msg);
+uint16_t getUsbDeviceTxSpace(bool priority) {
+  uint16_t space = (USB_DEVICE_TX_QUEUE_CAPACITY - 1) - txDepth();
+  if (priority) {
+    return space;
+  }
+  return space > USB_DEVICE_TX_RESERVE ? space - USB_DEVICE_TX_RESERVE : 0;
 }
 
-static void usbd_onStop() {
-  MidiMessage msg = {};
-  msg.type = MIDI_MSG_REALTIME;
-  msg.channel = 0;
-  msg.rtType = midi::Stop;
-  routeMidiMessage(MIDI_INTERFACE_USB_DEVICE, msg);
+void flushUsbDeviceMidi() {
+  while (txTail != txHead) {
+    if (!usb_midi.writePacket(txPackets[txTail])) {
+      break; // Endpoint FIFO full, keep the rest for the next pass
+    }
+    txTail = (txTail + 1) & USB_DEVICE_TX_QUEUE_MASK;
+  }
 }
 
-void setupUsbDeviceHandlers() {
-  USB_D.setHandleNoteOn(usbd_onNoteOn);
-  USB_D.setHandleNoteOff(usbd_onNoteOff);
-  USB_D.setHandleControlChange(usbd_onControlChange);
-  USB_D.setHandleProgramChange(usbd_onProgramChange);
-  USB_D.setHandleAfterTouchPoly(usbd_onPolyAftertouch);
-  USB_D.setHandleAfterTouchChannel(usbd_onChannelAftertouch);
-  USB_D.setHandlePitchBend(usbd_onPitchBend);
-  USB_D.setHandleSystemExclusive(usbd_onSysEx);
-  USB_D.setHandleClock(usbd_onClock);
-  USB_D.setHandleStart(usbd_onStart);
-  USB_D.setHandleContinue(usbd_onContinue);
-  USB_D.setHandleStop(usbd_onStop);
+MidiQueueStats getUsbDeviceTxQueueStats() {
+  MidiQueueStats stats;
+  stats.depth = txDepth();
+  stats.highWater = txHighWater;
+  stats.drops = txDrops;
+  stats.coalesced = 0;
+  return stats;
 }
@@ -2,9 +2,35 @@
 #define USB_DEVICE_MIDI_HANDLERS_H
 
 #include <Arduino.h>
+#include "midi_queue.h"
 
-// Register USB Device MIDI callback handlers on the USB_D instance
-// Call this from setup() after USB_D.begin()
+// Outgoing packets staged per loop() pass (must be a power of two)
+#define USB_DEVICE_TX_QUEUE_CAPACITY 128
+
+// Staging slots that packets parked by the router may only take if they
+// are notes or real-time (midiIsPriorityPacket()); the rest is left for
+// what core 0 sends directly (DIN input, IMU, config replies)
+#define USB_DEVICE_TX_RESERVE 32
+
+// Packets read from the USB device port per loopUsbDeviceMidi() call
+#define USB_DEVICE_RX_BUDGET 32
+
+// Reset the USB device packet path. Call from setup() after usb_midi.begin()
 void setupUsbDeviceHandlers();
 
+// Read USB-MIDI event packets from the computer and feed the router
+void loopUsbDeviceMidi();
+
+// Stage a packet for the computer; written out by flushUsbDeviceMidi()
+bool sendUsbDevicePacket(const uint8_t packet[4]);
+
+// Free staging slots; without `priority` the reserved ones do not count
+uint16_t getUsbDeviceTxSpace(bool priority = false);
+
+// Write all staged packets back to back. Call once per loop() pass.
+void flushUsbDeviceMidi();
+
+// Fill level, high-water mark and drop count of the staging queue
+MidiQueueStats getUsbDeviceTxQueueStats();
+
 #endif // USB_DEVICE_MIDI_HANDLERS_H
@@ -4,6 +4,18 @@
 
 USING_NAMESPACE_MIDI
 
+// Router host port of the packet being processed (set by processMidiPacket)
+static uint8_t receivePort = 0;
+
+void usbh_setReceivePort(uint8_t port) {
+  receivePort = port;
+}
+
+static void routeFromReceivePort(MidiMessage &msg) {
+  msg.port = receivePort;
+  routeMidiMessage(MIDI_SOURCE_USB_HOST, msg);
+}
+
 void usbh_onNoteOff(byte channel, byte note, byte velocity) {
   MidiMessage msg = {};
   msg.type = MIDI_MSG_NOTE;
@@ -11,7 +23,7 @@ void usbh_onNoteOff(byte channel, byte note, byte velocity) {
   msg.channel = channel;
   msg.data1 = note;
   msg.data2 = velocity;
-  routeMidiMessage(MIDI_INTERFACE_USB_HOST, msg);
+  routeFromReceivePort(msg);
 }
 
 void usbh_onNoteOn(byte channel, byte note, byte velocity) {
@@ -21,7 +33,7 @@ void usbh_onNoteOn(byte channel, byte note, byte velocity) {
   msg.channel = channel;
   msg.data1 = note;
   msg.data2 = velocity;
-  routeMidiMessage(MIDI_INTERFACE_USB_HOST, msg);
+  routeFromReceivePort(msg);
 }
 
 void usbh_onPolyAftertouch(byte channel, byte note, byte amount) {
@@ -30,7 +42,7 @@ void usbh_onPolyAftertouch(byte channel, byte note, byte amount) {
   msg.channel = channel;
   msg.data1 = note;
   msg.data2 = amount;
-  routeMidiMessage(MIDI_INTERFACE_USB_HOST, msg);
+  routeFromReceivePort(msg);
 }
 
 void usbh_onControlChange(byte channel, byte controller, byte value) {
@@ -39,7 +51,7 @@ void usbh_onControlChange(byte channel, byte controller, byte value) {
   msg.channel = channel;
   msg.data1 = controller;
   msg.data2 = value;
-  routeMidiMessage(MIDI_INTERFACE_USB_HOST, msg);
+  routeFromReceivePort(msg);
 }
 
 void usbh_onProgramChange(byte channel, byte program) {
@@ -47,7 +59,7 @@ void usbh_onProgramChange(byte channel, byte program) {
   msg.type = MIDI_MSG_PROGRAM_CHANGE;
   msg.channel = channel;
   msg.data1 = program;
-  routeMidiMessage(MIDI_INTERFACE_USB_HOST, msg);
+  routeFromReceivePort(msg);
 }
 
 void usbh_onChannelAftertouch(byte channel, byte value) {
@@ -55,7 +67,7 @@ void usbh_onChannelAftertouch(byte channel, byte value) {
   msg.type = MIDI_MSG_CHANNEL_AFTERTOUCH;
   msg.channel = channel;
   msg.data1 = value;
-  routeMidiMessage(MIDI_INTERFACE_USB_HOST, msg);
+  routeFromReceivePort(msg);
 }
 
 void usbh_onPitchBend(byte channel, int value) {
@@ -63,7 +75,7 @@ void usbh_onPitchBend(byte channel, int value) {
   msg.type = MIDI_MSG_PITCH_BEND;
   msg.channel = channel;
   msg.pitchBend = value;
-  routeMidiMessage(MIDI_INTERFACE_USB_HOST, msg);
+  routeFromReceivePort(msg);
 }
 
 void usbh_onSysEx(byte *array, unsigned size) {
@@ -72,7 +84,7 @@ void usbh_onSysEx(byte *array, unsigned size) {
   msg.channel = 0;
   msg.sysexData = array;
   msg.sysexSize = size;
-  routeMidiMessage(MIDI_INTERFACE_USB_HOST, msg);
+  routeFromReceivePort(msg);
 }
 
 void usbh_onMidiClock() {
@@ -80,7 +92,7 @@ void usbh_onMidiClock() {
   msg.type = MIDI_MSG_REALTIME;
   msg.channel = 0;
   msg.rtType = midi::Clock;
-  routeMidiMessage(MIDI_INTERFACE_USB_HOST, msg);
+  routeFromReceivePort(msg);
 }
 
 void usbh_onMidiStart() {
@@ -88,7 +100,7 @@ void usbh_onMidiStart() {
   msg.type = MIDI_MSG_REALTIME;
   msg.channel = 0;
   msg.rtType = midi::Start;
-  routeMidiMessage(MIDI_INTERFACE_USB_HOST, msg);
+  routeFromReceivePort(msg);
 }
 
 void usbh_onMidiContinue() {
@@ -96,7 +108,7 @@ void usbh_onMidiContinue() {
   msg.type = MIDI_MSG_REALTIME;
   msg.channel = 0;
   msg.rtType = midi::Continue;
-  routeMidiMessage(MIDI_INTERFACE_USB_HOST, msg);
+  routeFromReceivePort(msg);
 }
 
 void usbh_onMidiStop() {
@@ -104,7 +116,7 @@ void usbh_onMidiStop() {
   msg.type = MIDI_MSG_REALTIME;
   msg.channel = 0;
   msg.rtType = midi::Stop;
-  routeMidiMessage(MIDI_INTERFACE_USB_HOST, msg);
+  routeFromReceivePort(msg);
 }
 
 void onNoteOff(Channel channel, byte note, byte velocity) {
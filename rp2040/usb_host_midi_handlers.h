@@ -4,6 +4,9 @@
 #include <Arduino.h>
 #include <MIDI.h>
 
+// Router host port (device, cable) that the following handler calls belong to
+void usbh_setReceivePort(uint8_t port);
+
 // USB Host MIDI handler functions (called by processMidiPacket in usb_host_wrapper.cpp)
 void usbh_onNoteOn(byte channel, byte note, byte velocity);
 void usbh_onNoteOff(byte channel, byte note, byte velocity);
@@ -5,6 +5,8 @@
 #include "usb_host_midi_handlers.h"
 #include "serial_utils.h"
 #include "led_utils.h"
+#include "sysex_assembler.h"
+#include "midi_packet.h"
 #include <MIDI.h>
 #include "pico/sync.h"
 
@@ -15,6 +17,88 @@ volatile bool midi_host_mounted = false;
 
 auto_init_mutex(midi_host_mutex);
 
+#define HOST_TX_QUEUE_MASK (HOST_TX_QUEUE_CAPACITY - 1)
+
+static_assert((HOST_TX_QUEUE_CAPACITY & HOST_TX_QUEUE_MASK) == 0, "HOST_TX_QUEUE_CAPACITY must be a power of two");
+static_assert(HOST_TX_RESERVE < HOST_TX_QUEUE_CAPACITY - HOST_TX_COALESCE_DEPTH, "HOST_TX_RESERVE leaves no room for other traffic");
+static_assert((SYSEX_MAX_LENGTH + 2) / 3 + HOST_TX_RESERVE < HOST_TX_QUEUE_CAPACITY, "HOST_TX_QUEUE_CAPACITY cannot hold a SysEx chunk");
+
+// Outgoing packets waiting for room in the TinyUSB endpoint FIFO, one queue
+// per host MIDI interface. Only touched on core 1 (which owns the host
+// stack); the counters are read from core 0 for STATUS.
+typedef struct {
+    uint8_t packets[HOST_TX_QUEUE_CAPACITY][4];
+    uint16_t head;
+    uint16_t tail;
+    volatile uint16_t highWater;
+    volatile uint32_t drops;
+    volatile uint32_t coalesced;
+} HostTxQueue;
+
+static HostTxQueue hostTxQueues[CFG_TUH_MIDI];
+
+// Devices whose input is left in the TinyUSB FIFO until the router has
+// room again; the device is NAKed meanwhile
+static bool hostRxPaused[CFG_TUH_MIDI];
+
+// Mounted devices and the router host ports assigned to their cables.
+// A port carries the same cable number in both directions. Both lookups
+// (port -> device/cable for output, device/cable -> port for input) are
+// plain table reads. Core 1 only, except the mounted mask.
+#define HOST_PORT_NONE 0xFF
+
+typedef struct {
+    uint8_t idx;
+    uint8_t cable;
+} HostMidiPort;
+
+static HostMidiDevice hostDevices[CFG_TUH_MIDI];
+static HostMidiPort hostPorts[MIDI_HOST_PORTS];
+static uint8_t hostPortByDevCable[CFG_TUH_MIDI][16];
+static volatile MidiEndpointMask hostPortMountedMask = 0;
+
+// Incoming SysEx is reassembled separately for every device and cable
+static SysExAssembler hostSysEx[CFG_TUH_MIDI][16];
+
+static void resetHostSysEx(uint8_t idx) {
+    if (idx >= CFG_TUH_MIDI) return;
+    for (int cable = 0; cable < 16; cable++) {
+        sysExAssemblerReset(hostSysEx[idx][cable]);
+        sysExAssemblerInit(hostSysEx[idx][cable], usbh_onSysEx);
+    }
+}
+
+static uint16_t hostTxDepth(const HostTxQueue &queue) {
+    return (queue.head - queue.tail) & HOST_TX_QUEUE_MASK;
+}
+
+static void resetHostTxQueue(uint8_t idx) {
+    if (idx >= CFG_TUH_MIDI) return;
+    hostTxQueues[idx].head = 0;
+    hostTxQueues[idx].tail = 0;
+}
+
+// Move as many queued packets as fit into the endpoint FIFO, then start a
+// single bulk transfer for all of them. If a transfer is already in flight
+// the flush is a no-op and tuh_midi_tx_cb() picks the data up when it ends.
+static void drainHostTxQueue(uint8_t idx) {
+    if (idx >= CFG_TUH_MIDI) return;
+    HostTxQueue &queue = hostTxQueues[idx];
+    bool wrote = false;
+
+    while (queue.tail != queue.head) {
+        if (!tuh_midi_packet_write(idx, queue.packets[queue.tail])) {
+            break; // FIFO full, retry from tuh_midi_tx_cb()
+        }
+        queue.tail = (queue.tail + 1) & HOST_TX_QUEUE_MASK;
+        wrote = true;
+    }
+
+    if (wrote) {
+        tuh_midi_write_flush(idx);
+    }
+}
+
 // Add general USB host callbacks for debugging
 void tuh_mount_cb(uint8_t daddr) {
     dualPrintf("USB Host: Device mounted at address %u\r\n", daddr);
@@ -32,35 +116,97 @@ bool tuh_configuration_set_cb(uint8_t daddr, uint8_t config_num) {
     return true; // Allow configuration to proceed
 }
 
+// Give each cable of a newly mounted device the next free host port.
+// Cables beyond MIDI_HOST_PORTS stay unaddressable.
+static void assignHostPorts(uint8_t idx, uint8_t cables) {
+    memset(hostPortByDevCable[idx], HOST_PORT_NONE, sizeof(hostPortByDevCable[idx]));
+    hostDevices[idx].ports = 0;
+
+    for (uint8_t cable = 0; cable < cables && cable < 16; cable++) {
+        uint8_t port = 0;
+        while (port < MIDI_HOST_PORTS && (hostPortMountedMask & routeToHostPort(port))) {
+            port++;
+        }
+        if (port == MIDI_HOST_PORTS) {
+            dualPrintf("USB Host: no free port for device idx %u cable %u\r\n", idx, cable);
+            break;
+        }
+        hostPorts[port].idx = idx;
+        hostPorts[port].cable = cable;
+        hostPortByDevCable[idx][cable] = port;
+        hostPortMountedMask |= routeToHostPort(port);
+        hostDevices[idx].ports++;
+        dualPrintf("USB Host: port %u = device idx %u cable %u\r\n", port, idx, cable);
+    }
+}
+
+static void releaseHostPorts(uint8_t idx) {
+    for (uint8_t cable = 0; cable < 16; cable++) {
+        uint8_t port = hostPortByDevCable[idx][cable];
+        if (port != HOST_PORT_NONE) {
+            hostPortMountedMask &= ~routeToHostPort(port);
+        }
+    }
+    memset(hostPortByDevCable[idx], HOST_PORT_NONE, sizeof(hostPortByDevCable[idx]));
+    hostDevices[idx].ports = 0;
+}
+
 // TinyUSB MIDI host callback implementations
 void tuh_midi_mount_cb(uint8_t idx, const tuh_midi_mount_cb_t* mount_cb_data) {
     dualPrintf("USB Host: MIDI device mounted at idx %u with device addr %u\r\n", 
                idx, mount_cb_data->daddr);
     triggerUsbLED();
-    
+    if (idx >= CFG_TUH_MIDI) return;
+
+    HostMidiDevice &device = hostDevices[idx];
+    device.daddr = mount_cb_data->daddr;
+    device.rxCables = mount_cb_data->rx_cable_count;
+    device.txCables = mount_cb_data->tx_cable_count;
+    resetHostTxQueue(idx);
+    resetHostSysEx(idx);
+    hostRxPaused[idx] = false;
+    assignHostPorts(idx, device.rxCables > device.txCables ? device.rxCables : device.txCables);
+    device.mounted = true;
+
     midi_dev_idx = idx;
     mutex_enter_blocking(&midi_host_mutex);
     midi_dev_addr = mount_cb_data->daddr;
     midi_host_mounted = true;
     mutex_exit(&midi_host_mutex);
     
-    // Call application callback with estimated cable counts
-    onMIDIconnect(midi_dev_addr, 1, 1); // Default to 1 IN and 1 OUT cable
+    onMIDIconnect(device.daddr, device.rxCables, device.txCables);
 }
 
 void tuh_midi_umount_cb(uint8_t idx) {
     dualPrintf("MIDI device at idx %u unmounted\r\n", idx);
     triggerUsbLED();
-    
-    if (midi_dev_idx == idx) {
-        // Call application callback before clearing state
-        onMIDIdisconnect(midi_dev_addr);
-        
+    if (idx >= CFG_TUH_MIDI || !hostDevices[idx].mounted) return;
+
+    // Call application callback before clearing state
+    onMIDIdisconnect(hostDevices[idx].daddr);
+
+    releaseHostPorts(idx);
+    resetHostTxQueue(idx);
+    resetHostSysEx(idx);
+    hostRxPaused[idx] = false;
+    hostDevices[idx].mounted = false;
+
+    // Fall back to any device that is still mounted
+    bool anyMounted = false;
+    for (uint8_t i = 0; i < CFG_TUH_MIDI; i++) {
+        if (hostDevices[i].mounted) {
+            midi_dev_idx = i;
+            anyMounted = true;
+            break;
+        }
+    }
+
+    mutex_enter_blocking(&midi_host_mutex);
+    midi_dev_addr = anyMounted ? hostDevices[midi_dev_idx].daddr : 0;
+    midi_host_mounted = anyMounted;
+    mutex_exit(&midi_host_mutex);
+    if (!anyMounted) {
         midi_dev_idx = 0;
-        mutex_enter_blocking(&midi_host_mutex);
-        midi_dev_addr = 0;
-        midi_host_mounted = false;
-        mutex_exit(&midi_host_mutex);
     }
 }
 
@@ -80,31 +226,60 @@ bool getMidiHostState(uint8_t *addr) {
     return mounted;
 }
 
-void tuh_midi_rx_cb(uint8_t idx, uint32_t xferred_bytes) {    
-    // Read MIDI packets
+// Process the packets waiting in a device's receive FIFO. Stops while the
+// router is short of queue space, so input is held back at the device
+// instead of being dropped on the way out.
+static void readHostMidi(uint8_t idx) {
     uint8_t packet[4];
-    
-    // Process all available packets
-    while (tuh_midi_packet_read(idx, packet)) {
+
+    hostRxPaused[idx] = false;
+    while (true) {
+        if (!midiRouterHasHeadroom()) {
+            hostRxPaused[idx] = true;
+            return;
+        }
+        if (!tuh_midi_packet_read(idx, packet)) {
+            return;
+        }
         triggerUsbLED();
-        processMidiPacket(packet);
+        processMidiPacket(idx, packet);
+    }
+}
+
+void tuh_midi_rx_cb(uint8_t idx, uint32_t xferred_bytes) {
+    (void)xferred_bytes;
+    if (idx < CFG_TUH_MIDI) {
+        readHostMidi(idx);
     }
 }
 
 void tuh_midi_tx_cb(uint8_t idx, uint32_t xferred_bytes) {
-    // TX callback - could be used for flow control if needed
-    (void)idx;
+    // Previous OUT transfer finished: FIFO space is free again
     (void)xferred_bytes;
+    drainHostTxQueue(idx);
 }
 
 // Process a received MIDI packet and convert to MIDI library format
-void processMidiPacket(uint8_t packet[4]) {
+void processMidiPacket(uint8_t idx, uint8_t packet[4]) {
     uint8_t cable = (packet[0] >> 4) & 0x0F;
     uint8_t cin = packet[0] & 0x0F;
     uint8_t msg[3] = {packet[1], packet[2], packet[3]};
         
     // Ignore invalid packets
     if (cin == 0) return;
+
+    // Cables without a router port are not forwarded
+    if (idx >= CFG_TUH_MIDI || !hostDevices[idx].mounted) return;
+    uint8_t port = hostPortByDevCable[idx][cable];
+    if (port == HOST_PORT_NONE) return;
+    usbh_setReceivePort(port);
+
+    // SysEx start/continue (CIN 0x4) and end (CIN 0x5-0x7) packets are
+    // reassembled per device and cable before being routed
+    if (cin == 0x4 || cin == 0x6 || cin == 0x7 || (cin == 0x5 && msg[0] == 0xF7)) {
+        sysExAssemblerFeed(hostSysEx[idx][cable], msg, midiPacketLength(cin));
+        return;
+    }
     
     // Extract message type and channel
     uint8_t status = msg[0];
@@ -179,43 +354,111 @@ void processMidiPacket(uint8_t packet[4]) {
                         usbh_onMidiStop();
                     }
                     break;
-                case 0xF0: // SysEx start - handle multi-packet SysEx
-                    // For simplicity, we'll handle single-packet SysEx for now
-                    // Full SysEx implementation would require buffering across packets
-                    if (cin == 0x4 || cin == 0x5 || cin == 0x6 || cin == 0x7) {
-                        // Single packet SysEx or SysEx end
-                        uint8_t sysex_data[3];
-                        uint8_t sysex_len = 0;
-                        
-                        if (cin == 0x4) sysex_len = 3; // 3-byte SysEx
-                        else if (cin == 0x5) sysex_len = 1; // 1-byte SysEx end
-                        else if (cin == 0x6) sysex_len = 2; // 2-byte SysEx end
-                        else if (cin == 0x7) sysex_len = 3; // 3-byte SysEx end
-                        
-                        for (int i = 0; i < sysex_len; i++) {
-                            sysex_data[i] = msg[i];
-                        }
-                        
-                        usbh_onSysEx(sysex_data, sysex_len);
-                    }
-                    break;
             }
             break;
     }
 }
 
-// Send a MIDI packet to the host device
-bool sendMidiPacket(uint8_t packet[4]) {
-    if (!midi_host_mounted) return false;
+// Queue a MIDI packet for a host device. The packet is written to the
+// endpoint by usb_host_wrapper_task() or tuh_midi_tx_cb(). Core 1 only.
+static bool enqueueHostPacket(uint8_t idx, const uint8_t packet[4]) {
+    if (idx >= CFG_TUH_MIDI || !hostDevices[idx].mounted) return false;
+
+    HostTxQueue &queue = hostTxQueues[idx];
+
+    // Congested: latest value wins for continuous controls. A 14-bit
+    // controller MSB whose LSB is still queued is kept, so the pair is
+    // never torn.
+    if (hostTxDepth(queue) >= HOST_TX_COALESCE_DEPTH) {
+        uint32_t key = midiCoalesceKey(packet);
+        if (key != 0) {
+            uint8_t *match = nullptr;
+            for (uint16_t i = queue.tail; i != queue.head; i = (i + 1) & HOST_TX_QUEUE_MASK) {
+                if (midiIsControllerLsbOf(queue.packets[i], packet)) {
+                    match = nullptr;
+                    break;
+                }
+                if (match == nullptr && midiCoalesceKey(queue.packets[i]) == key) {
+                    match = queue.packets[i];
+                }
+            }
+            if (match != nullptr) {
+                memcpy(match, packet, 4);
+                queue.coalesced++;
+                return true;
+            }
+        }
+    }
 
-    if (!tuh_midi_packet_write(midi_dev_idx, packet)) {
+    // The last HOST_TX_RESERVE slots are kept for notes and real-time
+    uint16_t limit = midiIsPriorityPacket(packet) ? 0 : HOST_TX_RESERVE;
+    if ((HOST_TX_QUEUE_CAPACITY - 1) - hostTxDepth(queue) <= limit) {
+        queue.drops++;
         return false;
     }
+    uint16_t next = (queue.head + 1) & HOST_TX_QUEUE_MASK;
 
-    tuh_midi_write_flush(midi_dev_idx);
+    memcpy(queue.packets[queue.head], packet, 4);
+    queue.head = next;
+
+    uint16_t depth = hostTxDepth(queue);
+    if (depth > queue.highWater) {
+        queue.highWater = depth;
+    }
     return true;
 }
 
+static uint16_t hostTxSpace(uint8_t idx, bool priority) {
+    if (idx >= CFG_TUH_MIDI || !hostDevices[idx].mounted) return 0;
+    uint16_t space = (HOST_TX_QUEUE_CAPACITY - 1) - hostTxDepth(hostTxQueues[idx]);
+    if (priority) {
+        return space;
+    }
+    return space > HOST_TX_RESERVE ? space - HOST_TX_RESERVE : 0;
+}
+
+// Legacy single-device output: the most recently mounted device
+bool sendMidiPacket(const uint8_t packet[4]) {
+    if (!midi_host_mounted) return false;
+    return enqueueHostPacket(midi_dev_idx, packet);
+}
+
+bool sendHostPortPacket(uint8_t port, const uint8_t packet[4]) {
+    if (port >= MIDI_HOST_PORTS || !(hostPortMountedMask & routeToHostPort(port))) return false;
+
+    const HostMidiPort &hostPort = hostPorts[port];
+    uint8_t out[4] = {
+        (uint8_t)((hostPort.cable << 4) | (packet[0] & 0x0F)), packet[1], packet[2], packet[3]
+    };
+    return enqueueHostPacket(hostPort.idx, out);
+}
+
+uint16_t getHostPortTxSpace(uint8_t port, bool priority) {
+    if (port >= MIDI_HOST_PORTS || !(hostPortMountedMask & routeToHostPort(port))) return 0;
+    return hostTxSpace(hostPorts[port].idx, priority);
+}
+
+MidiEndpointMask getMountedHostPortMask() {
+    return hostPortMountedMask;
+}
+
+bool getHostMidiDevice(uint8_t idx, HostMidiDevice *device) {
+    if (idx >= CFG_TUH_MIDI || device == nullptr) return false;
+    *device = hostDevices[idx];
+    return device->mounted;
+}
+
+MidiQueueStats getHostTxQueueStats(uint8_t idx) {
+    MidiQueueStats stats = {0, 0, 0, 0};
+    if (idx < CFG_TUH_MIDI) {
+        stats.depth = hostTxDepth(hostTxQueues[idx]);
+        stats.highWater = hostTxQueues[idx].highWater;
+        stats.drops = hostTxQueues[idx].drops;
+        stats.coalesced = hostTxQueues[idx].coalesced;
+    }
+    return stats;
+}
+
 // Helper functions to send specific MIDI messages
 bool sendNoteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
     uint8_t packet[4] = {0x09, (uint8_t)(0x90 | (channel - 1)), note, velocity};
@@ -260,28 +503,35 @@ bool sendRealTime(uint8_t rtByte) {
     return sendMidiPacket(packet);
 }
 
-bool sendSysEx(unsigned size, byte* array) {
-    if (!midi_host_mounted || size == 0) return false;
-    
-    // For simplicity, we'll handle small SysEx messages in a single packet
-    // Full implementation would need to split larger SysEx across multiple packets
-    if (size <= 3) {
-        uint8_t packet[4] = {0, 0, 0, 0};
-        
-        if (size == 1) packet[0] = 0x05; // 1-byte SysEx
-        else if (size == 2) packet[0] = 0x06; // 2-byte SysEx  
-        else if (size == 3) packet[0] = 0x07; // 3-byte SysEx
-        
-        for (unsigned i = 0; i < size; i++) {
-            packet[i + 1] = array[i];
-        }
-        
-        return sendMidiPacket(packet);
+// Split an arbitrary-length SysEx into CIN 0x4-0x7 packets. The message is
+// queued whole or not at all, so a full transmit queue never leaves a
+// receiver with half a message.
+bool sendHostPortSysEx(uint8_t port, unsigned size, const byte *array) {
+    if (size == 0 || array == nullptr) return false;
+    if (port >= MIDI_HOST_PORTS || !(hostPortMountedMask & routeToHostPort(port))) return false;
+
+    unsigned count = midiSysExPacketCount(array, size);
+    if (count > getHostPortTxSpace(port)) {
+        hostTxQueues[hostPorts[port].idx].drops += count;
+        return false;
     }
-    
-    // For larger SysEx, we'd need to implement multi-packet transmission
-    // This is a simplified version for now
-    return false;
+
+    MidiSysExEncoder encoder;
+    uint8_t packet[4];
+    midiSysExEncoderBegin(encoder, array, size);
+    while (midiSysExEncoderNext(encoder, packet)) {
+        sendHostPortPacket(port, packet);
+    }
+    return true;
+}
+
+// Legacy single-device output: cable 0 of the most recently mounted device
+bool sendSysEx(unsigned size, byte* array) {
+    if (!midi_host_mounted || midi_dev_idx >= CFG_TUH_MIDI) return false;
+
+    uint8_t port = hostPortByDevCable[midi_dev_idx][0];
+    if (port == HOST_PORT_NONE) return false;
+    return sendHostPortSysEx(port, size, array);
 }
 
 // MIDI event handlers (same as before)
@@ -391,4 +641,15 @@ void usb_host_wrapper_task() {
     // This function should be called in the main loop
     USBHost.task();
     // MIDI processing is now handled automatically by TinyUSB callbacks
+
+    // Pick up input held back for lack of router space, then push out
+    // everything queued since the last pass, one transfer per device
+    for (uint8_t idx = 0; idx < CFG_TUH_MIDI; idx++) {
+        if (hostDevices[idx].mounted) {
+            if (hostRxPaused[idx]) {
+                readHostMidi(idx);
+            }
+            drainHostTxQueue(idx);
+        }
+    }
 }
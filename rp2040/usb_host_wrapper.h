@@ -32,10 +32,38 @@
 #include <Adafruit_TinyUSB.h>
 #include "pio_usb.h"
 #include "usb_host_midi_handlers.h"
+#include "midi_queue.h"
+#include "midi_router.h"
 
 #define LANGUAGE_ID 0x0409  // English
 
-// MIDI host state
+// Packets buffered per host MIDI interface while the endpoint is busy
+// (must be a power of two). Holds a whole SYSEX_MAX_LENGTH chunk, which
+// sendHostPortSysEx() queues all at once.
+#define HOST_TX_QUEUE_CAPACITY 512
+
+// Queue depth from which a device counts as congested: continuous controls
+// (CC, pitch bend, aftertouch; see midiCoalesceKey()) then replace their
+// queued predecessor instead of growing the backlog. Notes and real-time
+// are always queued.
+#define HOST_TX_COALESCE_DEPTH 32
+
+// Queue slots only notes and real-time may take (midiIsPriorityPacket()),
+// so a flood of other traffic to a slow device cannot crowd them out
+#define HOST_TX_RESERVE 32
+
+// Every mounted MIDI device, indexed by TinyUSB MIDI interface index.
+// Only written on core 1; read from core 0 for STATUS.
+typedef struct {
+    bool mounted;
+    uint8_t daddr;
+    uint8_t rxCables;   // Cables the device sends on
+    uint8_t txCables;   // Cables the device receives on
+    uint8_t ports;      // Router host ports assigned to this device
+} HostMidiDevice;
+
+// MIDI host state. midi_host_mounted is true while any MIDI device is
+// mounted; midi_dev_idx/midi_dev_addr name the most recently mounted one.
 extern volatile uint8_t midi_dev_addr;
 extern uint8_t midi_dev_idx;
 extern volatile bool midi_host_mounted;
@@ -52,8 +80,23 @@ void onMIDIconnect(uint8_t devAddr, uint8_t nInCables, uint8_t nOutCables);
 void onMIDIdisconnect(uint8_t devAddr);
 
 // MIDI packet processing
-void processMidiPacket(uint8_t packet[4]);
-bool sendMidiPacket(uint8_t packet[4]);
+void processMidiPacket(uint8_t idx, uint8_t packet[4]);
+bool sendMidiPacket(const uint8_t packet[4]);
+
+// Output to a router host port, i.e. one cable of one device. The cable
+// number is filled into packet[0]. Core 1 only.
+bool sendHostPortPacket(uint8_t port, const uint8_t packet[4]);
+bool sendHostPortSysEx(uint8_t port, unsigned size, const byte *array);
+
+// Free transmit queue slots for a port's device; without `priority` the
+// slots kept for notes and real-time do not count
+uint16_t getHostPortTxSpace(uint8_t port, bool priority = false);
+
+// Router endpoints (routeToHostPort bits) of all ports currently mounted
+MidiEndpointMask getMountedHostPortMask();
+
+// Copy of the device table entry for a TinyUSB MIDI index
+bool getHostMidiDevice(uint8_t idx, HostMidiDevice *device);
 
 // Helper functions to send specific MIDI messages
 bool sendNoteOn(uint8_t channel, uint8_t note, uint8_t velocity);
@@ -69,6 +112,9 @@ bool sendRealTime(uint8_t rtByte);
 // Task functions
 void usb_host_wrapper_task();
 
+// Fill level, high-water mark and drop count of a host transmit queue
+MidiQueueStats getHostTxQueueStats(uint8_t idx);
+
 // Thread-safe accessor for host state (returns mounted, writes addr)
 bool getMidiHostState(uint8_t *addr);
 #endif
@@ -4,71 +4,379 @@
 #include "version.h"
 #include "midi_filters.h"
 #include "imu_handler.h"
+#include "midi_router.h"
+#include "usb_host_wrapper.h"
+#include "usb_device_midi_handlers.h"
+#include "sysex_assembler.h"
+#include "serial_midi_scheduler.h"
+#include "serial_midi_port.h"
+#include "midi_rate_limit.h"
+#include "flash_commit.h"
+#include "config_journal.h"
+#include "json_arena.h"
+#include "json_stream.h"
+#include "config_frame.h"
 #include <ArduinoJson.h>
 #include <Arduino.h>
 
-// Delayed EEPROM save mechanism
+// Delayed save: coalesces a burst of edits into one flash write. Keeping
+// the write away from USB host traffic is up to flash_commit.h.
 static bool pendingEEPROMSave = false;
 static uint32_t eepromSaveTime = 0;
-static const uint32_t EEPROM_SAVE_DELAY_MS = 3000; // 3 seconds delay
+static const uint32_t CONFIG_SAVE_DEBOUNCE_MS = 500;
 static bool imuCalibrationWasActive = false;
 
-void processWebSerialConfig() {
+void scheduleConfigSave() {
+    pendingEEPROMSave = true;
+    eepromSaveTime = millis() + CONFIG_SAVE_DEBOUNCE_MS;
+}
+
+// Indexed by MidiRateClass
+static const char *const rateClassNames[MIDI_RATE_CLASS_COUNT] = { "note", "control", "sysex", "realtime" };
+
+static void queueStatsToJson(JsonStreamWriter &json, const char *name, const MidiQueueStats &stats) {
+    json.beginObject(name);
+    json.member("depth", stats.depth);
+    json.member("highWater", stats.highWater);
+    json.member("drops", stats.drops);
+    json.member("coalesced", stats.coalesced);
+    json.endObject();
+}
+
+// Runtime counters for the STATUS command
+static void statusToJson(JsonStreamWriter &json) {
+    json.beginObject("queues");
+    queueStatsToJson(json, "toCore0", getCrossCoreQueueStats(0));
+    queueStatsToJson(json, "toCore1", getCrossCoreQueueStats(1));
+    queueStatsToJson(json, "deviceTx", getUsbDeviceTxQueueStats());
+    json.endObject();
+
+    // One entry per mounted USB host MIDI device, with its transmit queue
+    json.beginArray("hostDevices");
+    for (uint8_t idx = 0; idx < CFG_TUH_MIDI; idx++) {
+        HostMidiDevice device;
+        if (!getHostMidiDevice(idx, &device)) {
+            continue;
+        }
+        json.beginObject();
+        json.member("idx", idx);
+        json.member("addr", device.daddr);
+        json.member("rxCables", device.rxCables);
+        json.member("txCables", device.txCables);
+        json.member("ports", device.ports);
+        queueStatsToJson(json, "tx", getHostTxQueueStats(idx));
+        json.endObject();
+    }
+    json.endArray();
+
+    SysExAssemblerStats sysex = getSysExAssemblerStats();
+    json.beginObject("hostSysEx");
+    json.member("completed", sysex.completed);
+    json.member("chunks", sysex.chunks);
+    json.member("poolExhausted", sysex.poolExhausted);
+    json.member("buffersInUse", sysex.buffersInUse);
+    json.endObject();
+
+    // DIN output scheduler
+    SerialMidiSchedulerStats serialOut = getSerialMidiSchedulerStats();
+    json.beginObject("serialOut");
+    json.member("bytes", serialOut.bytes);
+    json.member("statusSaved", serialOut.statusSaved);
+    json.member("realtimeInserted", serialOut.realtimeInserted);
+    json.member("drops", serialOut.drops);
+    json.member("coalesced", serialOut.coalesced);
+    json.member("sysexTimeouts", serialOut.sysexTimeouts);
+    json.endObject();
+
+    // DIN UART: receive ring and wire-to-parser latency
+    SerialMidiPortStats serialPort = getSerialMidiPortStats();
+    json.beginObject("serialPort");
+    json.member("rxBytes", serialPort.rxBytes);
+    json.member("rxDropped", serialPort.rxDropped);
+    json.member("rxErrors", serialPort.rxErrors);
+    json.member("txBytes", serialPort.txBytes);
+    json.member("rxLatencyUs", serialPort.lastRxLatencyUs);
+    json.member("maxRxLatencyUs", serialPort.maxRxLatencyUs);
+    json.endObject();
+
+    // Indexed by endpoint: serial, usbDevice, then one entry per host port
+    json.beginArray("sysexLock");
+    for (uint8_t dest = 0; dest < MIDI_ENDPOINT_COUNT; dest++) {
+        SysExLockStats lock = getSysExLockStats(dest);
+        json.beginObject();
+        json.member("held", lock.held);
+        json.member("dropped", lock.dropped);
+        json.member("timeouts", lock.timeouts);
+        json.endObject();
+    }
+    json.endArray();
+
+    // Source flood protection: current limits, then counters indexed by
+    // endpoint like sysexLock
+    json.beginObject("rateLimits");
+    for (uint8_t cls = 0; cls < MIDI_RATE_CLASS_COUNT; cls++) {
+        MidiRateLimit limit = getMidiRateLimit((MidiRateClass)cls);
+        json.beginObject(rateClassNames[cls]);
+        json.member("rate", limit.rate);
+        json.member("burst", limit.burst);
+        json.endObject();
+    }
+    json.endObject();
+    json.beginArray("rateLimit");
+    for (uint8_t src = 0; src < MIDI_ENDPOINT_COUNT; src++) {
+        MidiRateStats rate = getMidiRateStats(src);
+        json.beginObject();
+        json.member("limited", rate.limited);
+        json.member("quarantines", rate.quarantines);
+        json.member("quarantineDrops", rate.quarantineDrops);
+        json.member("quarantined", rate.quarantined);
+        json.endObject();
+    }
+    json.endArray();
+
+    // Config saves: how long core 1 (USB host) was held per flash slice
+    FlashCommitStats flash = getFlashCommitStats();
+    ConfigJournalStats journal = getConfigJournalStats();
+    json.beginObject("flash");
+    json.member("journal", isConfigJournalAvailable());
+    json.member("records", journal.records);
+    json.member("preErases", journal.preErases);
+    json.member("slices", flash.slices);
+    json.member("erases", flash.erases);
+    json.member("parkTimeouts", flash.parkTimeouts);
+    json.member("lastProgramStallUs", flash.lastProgramStallUs);
+    json.member("maxProgramStallUs", flash.maxProgramStallUs);
+    json.member("lastEraseStallUs", flash.lastEraseStallUs);
+    json.member("maxEraseStallUs", flash.maxEraseStallUs);
+    json.member("maxParkWaitUs", flash.maxParkWaitUs);
+    json.endObject();
+
+    // Static memory behind every config JsonDocument
+    JsonArenaStats arena = jsonArena.stats();
+    json.beginObject("jsonArena");
+    json.member("size", arena.size);
+    json.member("used", arena.used);
+    json.member("peak", arena.peak);
+    json.member("failures", arena.failures);
+    json.endObject();
+}
+
+// Longest command line accepted; longer lines are discarded whole
+#define WEB_SERIAL_LINE_MAX 1536
+
+// Line assembly state. Bytes are taken as they arrive, so a partial line
+// never makes loop() wait for the rest of it.
+static char lineBuffer[WEB_SERIAL_LINE_MAX];
+static size_t lineLength = 0;
+static bool lineOverflow = false;
+static bool lineBinary = false;   // Binary frame (config_frame.h) rather than JSON
+
+// Consume available bytes up to the end of one line. Returns true once a
+// complete line is in lineBuffer (NUL-terminated, surrounding whitespace
+// removed); bytes after it stay in the Serial buffer for the next call.
+// A line starting with CONFIG_FRAME_MAGIC is a binary frame instead: it
+// ends at 0x00 and lineBinary is set.
+static bool assembleLine() {
     while (Serial.available()) {
-        String line = Serial.readStringUntil('\n');
-        line.trim();
-        if (line.length() == 0) continue; // Skip empty lines
-
-        // Serial.print("[DEBUG] Received line: ");
-        // Serial.println(line);
-
-        JsonDocument doc;
-        DeserializationError error = deserializeJson(doc, line);
-        if (error) {
-            Serial.print("{\"status\":\"deserializeJson() failed\",\"error\":\"");
-            Serial.print(error.c_str());
-            Serial.println("\"}");
+        int c = Serial.read();
+        if (c < 0) {
+            break;
+        }
+        if (lineLength == 0 && !lineBinary && !lineOverflow && c == CONFIG_FRAME_MAGIC) {
+            lineBinary = true;
             continue;
         }
-        // Print parsed keys for debugging
-        // Serial.print("[DEBUG] Parsed keys: ");
-        // for (JsonPair kv : doc.as<JsonObject>()) {
-        //     Serial.print(kv.key().c_str());
-        //     Serial.print(" ");
-        // }
-        // Serial.println();
-
-        String command = doc["command"] | "";
-        if (command == "READALL") {
-            JsonDocument outDoc;
-            configToJson(outDoc);
-            outDoc["version"] = FIRMWARE_VERSION;
-            serializeJson(outDoc, Serial);
-            Serial.println();
-        } else if (command == "SAVEALL") {
-            if (updateConfigFromJson(doc)) {
-                Serial.println("{\"debug\":\"Config applied in memory\"}");
-                                
-                // Schedule delayed EEPROM save to avoid USB Host interference
-                pendingEEPROMSave = true;
-                eepromSaveTime = millis() + EEPROM_SAVE_DELAY_MS;
-                Serial.println("{\"debug\":\"EEPROM save scheduled for 3 seconds\"}");
-                
-                // Flash both LEDs 5 times quickly using led_utils
-                blinkBothLEDs(2, 100);
-
-                Serial.println("{\"status\":\"Success\",\"command\":\"SAVEALL\",\"message\":\"Config applied immediately, saving to EEPROM in 3s\"}");
-            } else {
-                Serial.println("{\"status\":\"Invalid config JSON\",\"command\":\"SAVEALL\"}");
+        if (lineBinary) {
+            if (c == 0) {
+                if (lineOverflow) {
+                    lineOverflow = false;
+                    lineBinary = false;
+                    lineLength = 0;
+                    continue;
+                }
+                return true;
+            }
+            if (lineLength >= CONFIG_FRAME_MAX_ENCODED) {
+                lineOverflow = true;
+            } else if (!lineOverflow) {
+                lineBuffer[lineLength++] = (char)c;
             }
-        } else if (command == "CALIBRATE_IMU") {
-            Serial.println("{\"status\":\"Starting IMU calibration\",\"command\":\"CALIBRATE_IMU\",\"message\":\"Keep device flat and still for 10 seconds\"}");
-            startIMUCalibration();
+            continue;
+        }
+        if (c == '\n') {
+            if (lineOverflow) {
+                lineOverflow = false;
+                lineLength = 0;
+                Serial.println("{\"status\":\"Line too long\"}");
+                continue;
+            }
+            while (lineLength > 0 && isspace((unsigned char)lineBuffer[lineLength - 1])) {
+                lineLength--;
+            }
+            lineBuffer[lineLength] = '\0';
+            return true;
+        }
+        if (lineOverflow) {
+            continue;
+        }
+        if (lineLength == 0 && isspace(c)) {
+            continue; // Leading whitespace, including the \r of a CRLF
+        }
+        if (lineLength >= WEB_SERIAL_LINE_MAX - 1) {
+            lineOverflow = true;
+            continue;
+        }
+        lineBuffer[lineLength++] = (char)c;
+    }
+    return false;
+}
+
+static void handleCommand(const char *line, size_t length) {
+    JsonDocument doc(&jsonArena);
+    DeserializationError error = deserializeJson(doc, line, length);
+    if (error) {
+        Serial.print("{\"status\":\"deserializeJson() failed\",\"error\":\"");
+        Serial.print(error.c_str());
+        Serial.println("\"}");
+        return;
+    }
+
+    const char *command = doc["command"] | "";
+    if (strcmp(command, "READALL") == 0) {
+        // Streamed as it is built: no document, first byte out at once
+        JsonStreamWriter json(Serial);
+        json.beginObject();
+        configToJson(json);
+        json.member("version", FIRMWARE_VERSION);
+        json.endObject();
+        Serial.println();
+    } else if (strcmp(command, "SAVEALL") == 0) {
+        if (updateConfigFromJson(doc)) {
+            Serial.println("{\"debug\":\"Config applied in memory\"}");
+                            
+            scheduleConfigSave();
+            Serial.println("{\"debug\":\"Flash save scheduled\"}");
+            
+            // Flash both LEDs 5 times quickly using led_utils
+            blinkBothLEDs(2, 100);
+
+            Serial.println("{\"status\":\"Success\",\"command\":\"SAVEALL\",\"message\":\"Config applied immediately, saving to flash\"}");
+        } else {
+            Serial.println("{\"status\":\"Invalid config JSON\",\"command\":\"SAVEALL\"}");
+        }
+    } else if (strcmp(command, "SET_FILTER") == 0 || strcmp(command, "SET_CHANNEL") == 0 ||
+               strcmp(command, "SET_IMU_AXIS") == 0 || strcmp(command, "PATCH") == 0) {
+        // Incremental edits: one setting each, mapped onto a PATCH path
+        //   SET_FILTER   {"dir":"source"|"dest","iface":0-2,"msg":0-7,"blocked":bool}
+        //   SET_CHANNEL  {"channel":1-16,"enabled":bool}
+        //   SET_IMU_AXIS {"axis":"roll"|"pitch"|"yaw", ...axis fields}
+        //   PATCH        {"path":"/filters/0/2","value":true}
+        char path[32];
+        JsonVariantConst value;
+        if (strcmp(command, "SET_FILTER") == 0) {
+            const char *dir = doc["dir"] | "source";
+            snprintf(path, sizeof(path), "/%s/%d/%d", strcmp(dir, "dest") == 0 ? "destFilters" : "filters",
+                     doc["iface"] | -1, doc["msg"] | -1);
+            value = doc["blocked"];
+        } else if (strcmp(command, "SET_CHANNEL") == 0) {
+            snprintf(path, sizeof(path), "/channels/%d", (doc["channel"] | 0) - 1);
+            value = doc["enabled"];
+        } else if (strcmp(command, "SET_IMU_AXIS") == 0) {
+            snprintf(path, sizeof(path), "/imu/%s", doc["axis"] | "");
+            value = doc.as<JsonVariantConst>();
+        } else {
+            snprintf(path, sizeof(path), "%s", doc["path"] | "");
+            value = doc["value"];
+        }
+
+        if (patchConfig(path, value)) {
+            scheduleConfigSave();
+            Serial.print("{\"status\":\"Success\",\"command\":\"");
         } else {
-            Serial.print("{\"status\":\"Unknown command\",\"command\":\"");
-            Serial.print(command);
-            Serial.println("\"}");
+            Serial.print("{\"status\":\"Invalid setting\",\"command\":\"");
+        }
+        Serial.print(command);
+        Serial.println("\"}");
+    } else if (strcmp(command, "SAVE_PRESET") == 0) {
+        // Stores the live filter configuration in a preset slot
+        int slot = doc["slot"] | -1;
+        if (slot >= 0 && storeMidiPreset(slot)) {
+            scheduleConfigSave();
+            Serial.println("{\"status\":\"Success\",\"command\":\"SAVE_PRESET\"}");
+        } else {
+            Serial.println("{\"status\":\"Invalid preset slot\",\"command\":\"SAVE_PRESET\"}");
+        }
+    } else if (strcmp(command, "SELECT_PRESET") == 0) {
+        // Not persisted: the device boots with the last saved config
+        int slot = doc["slot"] | -1;
+        if (slot >= 0 && selectMidiPreset(slot)) {
+            Serial.println("{\"status\":\"Success\",\"command\":\"SELECT_PRESET\"}");
+        } else {
+            Serial.println("{\"status\":\"Preset slot not stored\",\"command\":\"SELECT_PRESET\"}");
+        }
+    } else if (strcmp(command, "SET_PRESET_CONTROL") == 0) {
+        // {"channel":1-16 (0 = off),"type":"PC"|"CC","cc":0-127}
+        const char *type = doc["type"] | "PC";
+        MidiPresetControl control;
+        control.channel = doc["channel"] | (uint8_t)0xFF;
+        control.type = strcmp(type, "CC") == 0   ? MIDI_PRESET_CONTROL_CC
+                       : strcmp(type, "PC") == 0 ? MIDI_PRESET_CONTROL_PROGRAM_CHANGE
+                                                 : 0xFF;
+        control.cc = doc["cc"].isNull() ? 0 : doc["cc"] | (uint8_t)0xFF;
+        if (isValidMidiPresetControl(control)) {
+            setMidiPresetControl(control);
+            scheduleConfigSave();
+            Serial.println("{\"status\":\"Success\",\"command\":\"SET_PRESET_CONTROL\"}");
+        } else {
+            Serial.println("{\"status\":\"Invalid preset control\",\"command\":\"SET_PRESET_CONTROL\"}");
+        }
+    } else if (strcmp(command, "SET_RATE_LIMIT") == 0) {
+        // {"class":"note"|"control"|"sysex"|"realtime","rate":per second (0 = off),"burst":N}
+        // (a SysEx burst must hold SYSEX_MAX_LENGTH bytes)
+        // Not persisted: the device boots with the default limits
+        const char *name = doc["class"] | "";
+        uint8_t cls = 0;
+        while (cls < MIDI_RATE_CLASS_COUNT && strcmp(name, rateClassNames[cls]) != 0) {
+            cls++;
+        }
+        long rate = doc["rate"] | -1L;
+        long burst = doc["burst"] | 0L;
+        MidiRateLimit limit = { (uint32_t)rate, (uint32_t)burst };
+        if (cls < MIDI_RATE_CLASS_COUNT && rate >= 0 && burst >= 0 && setMidiRateLimit((MidiRateClass)cls, limit)) {
+            Serial.println("{\"status\":\"Success\",\"command\":\"SET_RATE_LIMIT\"}");
+        } else {
+            Serial.println("{\"status\":\"Invalid rate limit\",\"command\":\"SET_RATE_LIMIT\"}");
+        }
+    } else if (strcmp(command, "STATUS") == 0) {
+        JsonStreamWriter json(Serial);
+        json.beginObject();
+        json.member("status", "Success");
+        json.member("command", "STATUS");
+        statusToJson(json);
+        json.endObject();
+        Serial.println();
+    } else if (strcmp(command, "CALIBRATE_IMU") == 0) {
+        Serial.println("{\"status\":\"Starting IMU calibration\",\"command\":\"CALIBRATE_IMU\",\"message\":\"Keep device flat and still for 10 seconds\"}");
+        startIMUCalibration();
+    } else {
+        Serial.print("{\"status\":\"Unknown command\",\"command\":\"");
+        Serial.print(command);
+        Serial.println("\"}");
+    }
+}
+
+void processWebSerialConfig() {
+    // At most one command per call keeps each loop() pass short
+    if (assembleLine()) {
+        if (lineBinary) {
+            if (handleConfigFrame((const uint8_t *)lineBuffer, lineLength)) {
+                scheduleConfigSave();
+            }
+            lineBinary = false;
+        } else if (lineLength > 0) {
+            handleCommand(lineBuffer, lineLength);
         }
+        lineLength = 0;
     }
 
     bool imuCalibrationActive = isIMUCalibrationActive();
@@ -78,12 +386,16 @@ void processWebSerialConfig() {
     imuCalibrationWasActive = imuCalibrationActive;
 }
 
-// Call this function regularly from the main loop to handle delayed EEPROM saves
+// Call this function regularly from the main loop to handle delayed config saves
 void handleDelayedEEPROMSave() {
     if (pendingEEPROMSave && millis() >= eepromSaveTime) {
-        Serial.println("{\"debug\":\"Starting delayed EEPROM save...\"}");
+        Serial.println("{\"debug\":\"Starting delayed config save...\"}");
         saveConfigToEEPROM();
-        Serial.println("{\"debug\":\"Delayed EEPROM save complete\"}");
+        Serial.println("{\"debug\":\"Delayed config save complete\"}");
         pendingEEPROMSave = false;
+    } else if (!pendingEEPROMSave) {
+        // The sector erase a journal switch needs is done here, while no
+        // save is waiting, rather than as part of a save
+        prepareConfigJournal();
     }
 }
@@ -7,4 +7,8 @@ void processWebSerialConfig();
 // Call this regularly in the main loop to handle delayed EEPROM saves
 void handleDelayedEEPROMSave();
 
+// Save the config to flash once changes have stopped for a moment
+// (debounced, so a burst of edits costs one flash write)
+void scheduleConfigSave();
+
 #endif // WEB_SERIAL_CONFIG_H
@@ -348,6 +348,70 @@ async function calibrateIMU() {
   }
 }
 
+// Incremental edits: each UI change is sent as one small command instead of
+// the whole SAVEALL document. Commands are chained so every reply is read
+// before the next command goes out.
+let commandChain: Promise<void> = Promise.resolve();
+
+function sendIncremental(cmd: { command: string, [key: string]: any }) {
+  if (!serialHandler.port) return;
+  commandChain = commandChain.then(async () => {
+    const cmdStr = JSON.stringify(cmd) + "\n";
+    await serialHandler.write(cmdStr);
+    logSent(cmdStr.trim());
+    for (let i = 0; i < 5; i++) { // Skip debug lines until the reply
+      const resp = await serialHandler.readLine();
+      if (resp) logRecv(resp);
+      if (resp && resp.includes(`"command":"${cmd.command}"`)) {
+        if (!resp.includes("Success")) logError(cmd.command + " rejected");
+        break;
+      }
+    }
+  }).catch((err: any) => logError("" + err));
+}
+
+// IMU axis fields: element id suffix and how to read the value
+const imuFields: { field: string, suffix: string, read: (el: HTMLInputElement) => any }[] = [
+  { field: "enabled", suffix: "enabled", read: el => el.checked },
+  { field: "channel", suffix: "channel", read: el => parseInt(el.value) },
+  { field: "cc", suffix: "cc", read: el => parseInt(el.value) },
+  { field: "defaultValue", suffix: "default", read: el => parseInt(el.value) },
+  { field: "toSerial", suffix: "serial", read: el => el.checked },
+  { field: "toUSBDevice", suffix: "usb-device", read: el => el.checked },
+  { field: "toUSBHost", suffix: "usb-host", read: el => el.checked },
+  { field: "sensitivity", suffix: "sensitivity", read: el => parseFloat(el.value) },
+  { field: "range", suffix: "range", read: el => parseFloat(el.value) }
+];
+
+function attachIncrementalHandlers() {
+  for (let iface = 0; iface < 3; iface++) {
+    for (let msg = 0; msg < 8; msg++) {
+      // REVERSED LOGIC: checked = allowed, the device stores blocked
+      const source = document.getElementById(`f-${iface}-${msg}`) as HTMLInputElement;
+      source?.addEventListener("change", () =>
+        sendIncremental({ command: "SET_FILTER", dir: "source", iface, msg, blocked: !source.checked }));
+      const dest = document.getElementById(`df-${iface}-${msg}`) as HTMLInputElement;
+      dest?.addEventListener("change", () =>
+        sendIncremental({ command: "SET_FILTER", dir: "dest", iface, msg, blocked: !dest.checked }));
+    }
+  }
+  for (let i = 0; i < 16; i++) {
+    const channel = document.getElementById(`ch-${i}`) as HTMLInputElement;
+    channel?.addEventListener("change", () =>
+      sendIncremental({ command: "SET_CHANNEL", channel: i + 1, enabled: channel.checked }));
+  }
+  for (const axis of ["roll", "pitch", "yaw"]) {
+    for (const { field, suffix, read } of imuFields) {
+      const el = document.getElementById(`${axis}-${suffix}`) as HTMLInputElement;
+      el?.addEventListener("change", () => {
+        const value = read(el);
+        if (typeof value === "number" && isNaN(value)) return;
+        sendIncremental({ command: "SET_IMU_AXIS", axis, [field]: value });
+      });
+    }
+  }
+}
+
 // Attach event listeners after DOM is ready
 document.addEventListener("DOMContentLoaded", () => {
   const connectBtn = document.getElementById("connectBtn") as HTMLButtonElement;
@@ -363,6 +427,7 @@ document.addEventListener("DOMContentLoaded", () => {
   fileInput?.addEventListener("change", handleFileUpload);
   exportBtn?.addEventListener("click", exportConfig);
   calibrateBtn?.addEventListener("click", calibrateIMU);
+  attachIncrementalHandlers();
 
   // Disable send button until connected
   sendBtn.disabled = true;
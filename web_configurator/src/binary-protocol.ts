@@ -0,0 +1,197 @@
+/**
+ * Binary config protocol (firmware: rp2040/config_frame.h, config.h).
+ * Frame: MAGIC, COBS(packet), 0x00
+ * Request packet:  id, opcode, payload, CRC32 (LE)
+ * Response packet: id, opcode | 0x80, status, payload, CRC32 (LE)
+ * Payloads are TLVs: type, length, value.
+ */
+
+export const FRAME_MAGIC = 0xa5;
+
+export const OP_READ = 0x01;
+export const OP_WRITE = 0x02;
+
+export const STATUS_OK = 0;
+export const STATUS_BAD_CRC = 1;
+export const STATUS_BAD_OPCODE = 2;
+export const STATUS_BAD_PAYLOAD = 3;
+
+export const TLV_FILTERS = 0x01;
+export const TLV_IMU_AXIS = 0x02;
+export const TLV_PRESET_CONTROL = 0x03;
+export const TLV_PRESETS = 0x04;
+export const TLV_VERSION = 0x05;
+
+const IMU_AXES = ["roll", "pitch", "yaw"];
+
+export function crc32(data: Uint8Array): number {
+  let crc = 0xffffffff;
+  for (const byte of data) {
+    crc ^= byte;
+    for (let bit = 0; bit < 8; bit++) {
+      crc = (crc >>> 1) ^ (0xedb88320 & -(crc & 1));
+    }
+  }
+  return (crc ^ 0xffffffff) >>> 0;
+}
+
+export function cobsEncode(data: Uint8Array): Uint8Array {
+  const out: number[] = [0];
+  let codeIndex = 0;
+  let code = 1;
+  for (const byte of data) {
+    if (byte === 0) {
+      out[codeIndex] = code;
+      codeIndex = out.length;
+      out.push(0);
+      code = 1;
+      continue;
+    }
+    out.push(byte);
+    if (++code === 0xff) {
+      out[codeIndex] = code;
+      codeIndex = out.length;
+      out.push(0);
+      code = 1;
+    }
+  }
+  out[codeIndex] = code;
+  return Uint8Array.from(out);
+}
+
+export function cobsDecode(data: Uint8Array): Uint8Array | null {
+  const out: number[] = [];
+  let i = 0;
+  while (i < data.length) {
+    const code = data[i++];
+    if (code === 0 || i + code - 1 > data.length) return null;
+    for (let j = 1; j < code; j++) out.push(data[i++]);
+    if (code !== 0xff && i < data.length) out.push(0);
+  }
+  return Uint8Array.from(out);
+}
+
+/** Packet with its CRC appended, COBS-encoded and framed */
+export function buildFrame(packet: Uint8Array): Uint8Array {
+  const withCrc = new Uint8Array(packet.length + 4);
+  withCrc.set(packet);
+  new DataView(withCrc.buffer).setUint32(packet.length, crc32(packet), true);
+  const encoded = cobsEncode(withCrc);
+  const frame = new Uint8Array(encoded.length + 2);
+  frame[0] = FRAME_MAGIC;
+  frame.set(encoded, 1);
+  frame[frame.length - 1] = 0;
+  return frame;
+}
+
+/** Decoded packet without its CRC, or null if COBS or CRC is wrong */
+export function parseFrame(encoded: Uint8Array): Uint8Array | null {
+  const packet = cobsDecode(encoded);
+  if (!packet || packet.length < 4) return null;
+  const body = packet.subarray(0, packet.length - 4);
+  const crc = new DataView(packet.buffer, packet.byteOffset).getUint32(packet.length - 4, true);
+  return crc === crc32(body) ? body : null;
+}
+
+export function parseTlvs(payload: Uint8Array): { type: number, value: Uint8Array }[] {
+  const tlvs: { type: number, value: Uint8Array }[] = [];
+  let pos = 0;
+  while (pos + 2 <= payload.length) {
+    const length = payload[pos + 1];
+    if (pos + 2 + length > payload.length) break;
+    tlvs.push({ type: payload[pos], value: payload.subarray(pos + 2, pos + 2 + length) });
+    pos += 2 + length;
+  }
+  return tlvs;
+}
+
+/** TLV payload to the same shape as the READALL JSON document */
+export function decodeConfig(payload: Uint8Array): any {
+  const config: any = { imu: {} };
+  for (const { type, value } of parseTlvs(payload)) {
+    const view = new DataView(value.buffer, value.byteOffset, value.byteLength);
+    if (type === TLV_FILTERS && value.length === 20) {
+      config.filters = [];
+      config.destFilters = [];
+      config.sourceChannels = [];
+      config.destChannels = [];
+      for (let iface = 0; iface < 3; iface++) {
+        const source: boolean[] = [];
+        const dest: boolean[] = [];
+        for (let msg = 0; msg < 8; msg++) {
+          source.push((value[iface] & (1 << msg)) !== 0);
+          dest.push((value[3 + iface] & (1 << msg)) !== 0);
+        }
+        config.filters.push(source);
+        config.destFilters.push(dest);
+        config.sourceChannels.push(view.getUint16(8 + iface * 2, true));
+        config.destChannels.push(view.getUint16(14 + iface * 2, true));
+      }
+      const channels = view.getUint16(6, true);
+      config.channels = [];
+      for (let ch = 0; ch < 16; ch++) config.channels.push((channels & (1 << ch)) !== 0);
+    } else if (type === TLV_IMU_AXIS && value.length === 16 && value[0] < 3) {
+      config.imu[IMU_AXES[value[0]]] = {
+        enabled: value[1] !== 0,
+        channel: value[2],
+        cc: value[3],
+        defaultValue: value[4],
+        toSerial: value[5] !== 0,
+        toUSBDevice: value[6] !== 0,
+        toUSBHost: value[7] !== 0,
+        sensitivity: view.getFloat32(8, true),
+        range: view.getFloat32(12, true)
+      };
+    } else if (type === TLV_PRESET_CONTROL && value.length === 3) {
+      config.presets = { ...config.presets, channel: value[0], type: value[1] === 1 ? "CC" : "PC", cc: value[2] };
+    } else if (type === TLV_PRESETS && value.length === 2) {
+      const stored: boolean[] = [];
+      for (let slot = 0; slot < 8; slot++) stored.push((value[1] & (1 << slot)) !== 0);
+      config.presets = { ...config.presets, active: view.getInt8(0), stored };
+    } else if (type === TLV_VERSION) {
+      config.version = new TextDecoder().decode(value);
+    }
+  }
+  return config;
+}
+
+function pushTlv(out: number[], type: number, value: Uint8Array) {
+  out.push(type, value.length, ...value);
+}
+
+/** SAVEALL-shaped config object to a TLV payload */
+export function encodeConfig(config: any): Uint8Array {
+  const out: number[] = [];
+  if (config.filters && config.channels) {
+    const filters = new Uint8Array(20);
+    const view = new DataView(filters.buffer);
+    for (let iface = 0; iface < 3; iface++) {
+      for (let msg = 0; msg < 8; msg++) {
+        if (config.filters[iface][msg]) filters[iface] |= 1 << msg;
+        if (config.destFilters?.[iface]?.[msg]) filters[3 + iface] |= 1 << msg;
+      }
+      view.setUint16(8 + iface * 2, config.sourceChannels?.[iface] ?? 0xffff, true);
+      view.setUint16(14 + iface * 2, config.destChannels?.[iface] ?? 0xffff, true);
+    }
+    let channels = 0;
+    config.channels.forEach((enabled: boolean, ch: number) => { if (enabled) channels |= 1 << ch; });
+    view.setUint16(6, channels, true);
+    pushTlv(out, TLV_FILTERS, filters);
+  }
+  IMU_AXES.forEach((name, axis) => {
+    const imu = config.imu?.[name];
+    if (!imu) return;
+    const value = new Uint8Array(16);
+    const view = new DataView(value.buffer);
+    value.set([axis, imu.enabled ? 1 : 0, imu.channel, imu.cc, imu.defaultValue,
+      imu.toSerial ? 1 : 0, imu.toUSBDevice ? 1 : 0, imu.toUSBHost ? 1 : 0]);
+    view.setFloat32(8, imu.sensitivity, true);
+    view.setFloat32(12, imu.range, true);
+    pushTlv(out, TLV_IMU_AXIS, value);
+  });
+  if (config.presets && config.presets.channel !== undefined) {
+    pushTlv(out, TLV_PRESET_CONTROL, Uint8Array.from([
+      config.presets.channel, config.presets.type === "CC" ? 1 : 0, config.presets.cc ?? 0]));
+  }
+  return Uint8Array.from(out);
+}
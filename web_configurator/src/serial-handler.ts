@@ -3,17 +3,25 @@
  * Usage:
  *   await serialHandler.init();
  *   await serialHandler.write(jsonString);
- *   const response = await serialHandler.read();
+ *   const response = await serialHandler.readLine();
+ * Binary protocol (binary-protocol.ts):
+ *   const config = await serialHandler.readConfigBinary();
+ *   await serialHandler.writeConfigBinary(config);
  */
 
+import { FRAME_MAGIC, OP_READ, OP_WRITE, STATUS_OK, buildFrame, parseFrame, decodeConfig, encodeConfig } from "./binary-protocol";
+
 export class SerialHandler {
-  reader: ReadableStreamDefaultReader | null = null;
-  writer: WritableStreamDefaultWriter | null = null;
+  // The port carries both JSON lines and binary frames, so it is read and
+  // written as raw bytes and text is decoded here
+  reader: ReadableStreamDefaultReader<Uint8Array> | null = null;
+  writer: WritableStreamDefaultWriter<Uint8Array> | null = null;
   port: SerialPort | null = null;
-  textDecoder: TextDecoderStream = new TextDecoderStream();
-  textEncoder: TextEncoderStream = new TextEncoderStream();
-  readableStreamClosed: Promise<void> | null = null;
-  writableStreamClosed: Promise<void> | null = null;
+  textDecoder: TextDecoder = new TextDecoder();
+  textEncoder: TextEncoder = new TextEncoder();
+  // Bytes received but not yet consumed by readLine()/readFrame()
+  private pending: Uint8Array = new Uint8Array(0);
+  private nextRequestId = 0;
 
   async init(): Promise<boolean> {
     if ('serial' in navigator) {
@@ -28,14 +36,12 @@ export class SerialHandler {
         }
         await this.port.open({ baudRate: 115200 });
         if (this.port.writable != null) {
-          this.writableStreamClosed = this.textEncoder.readable.pipeTo(this.port.writable);
-          this.writer = this.textEncoder.writable.getWriter();
+          this.writer = this.port.writable.getWriter();
         } else {
           throw Error("Port is not writable");
         }
         if (this.port.readable != null) {
-          this.readableStreamClosed = this.port.readable.pipeTo(this.textDecoder.writable);
-          this.reader = this.textDecoder.readable.getReader();
+          this.reader = this.port.readable.getReader();
         } else {
           throw Error("Port is not readable");
         }
@@ -51,28 +57,93 @@ export class SerialHandler {
   }
 
   async write(data: string): Promise<void> {
+    await this.writeBytes(this.textEncoder.encode(data));
+  }
+
+  async writeBytes(data: Uint8Array): Promise<void> {
     if (!this.writer) throw new Error("Serial port not open");
     await this.writer.write(data);
   }
 
-  async readLine(): Promise<string> {
+  // Append the next chunk from the port; false once the stream is done
+  private async fill(): Promise<boolean> {
     if (!this.reader) throw new Error("Serial port not open");
-    let buffer = "";
+    const { value, done } = await this.reader.read();
+    if (done) {
+      this.reader.releaseLock();
+      return false;
+    }
+    const merged = new Uint8Array(this.pending.length + value.length);
+    merged.set(this.pending);
+    merged.set(value, this.pending.length);
+    this.pending = merged;
+    return true;
+  }
+
+  // Remove and return the first `length` pending bytes
+  private take(length: number): Uint8Array {
+    const taken = this.pending.slice(0, length);
+    this.pending = this.pending.slice(length);
+    return taken;
+  }
+
+  async readLine(): Promise<string> {
     while (true) {
-      const { value, done } = await this.reader.read();
-      if (done) {
-        this.reader.releaseLock();
-        break;
-      }
-      buffer += value;
-      const idx = buffer.indexOf('\n');
+      const idx = this.pending.indexOf(0x0a);
       if (idx !== -1) {
-        const line = buffer.slice(0, idx);
-        buffer = buffer.slice(idx + 1);
-        return line.trim();
+        const line = this.take(idx + 1);
+        return this.textDecoder.decode(line).trim();
       }
+      if (!(await this.fill())) break;
     }
-    return buffer.trim();
+    return this.textDecoder.decode(this.take(this.pending.length)).trim();
+  }
+
+  /** Next binary frame's packet (CRC checked and removed); skips text in between */
+  async readFrame(): Promise<Uint8Array | null> {
+    while (true) {
+      const start = this.pending.indexOf(FRAME_MAGIC);
+      const end = start === -1 ? -1 : this.pending.indexOf(0, start);
+      if (end !== -1) {
+        this.take(start + 1);
+        const encoded = this.take(end - start - 1);
+        this.take(1);
+        return parseFrame(encoded);
+      }
+      if (!(await this.fill())) return null;
+    }
+  }
+
+  /** Send one request and wait for its response: status and payload */
+  async request(op: number, payload: Uint8Array = new Uint8Array(0)): Promise<{ status: number, payload: Uint8Array }> {
+    const id = this.nextRequestId;
+    this.nextRequestId = (this.nextRequestId + 1) & 0xff;
+    const packet = new Uint8Array(2 + payload.length);
+    packet[0] = id;
+    packet[1] = op;
+    packet.set(payload, 2);
+    await this.writeBytes(buildFrame(packet));
+
+    while (true) {
+      const response = await this.readFrame();
+      if (response === null) throw new Error("Serial port closed");
+      if (response.length >= 3 && response[0] === id && response[1] === (op | 0x80)) {
+        return { status: response[2], payload: response.subarray(3) };
+      }
+    }
+  }
+
+  /** Binary READALL: same shape as the JSON document */
+  async readConfigBinary(): Promise<any> {
+    const { status, payload } = await this.request(OP_READ);
+    if (status !== STATUS_OK) throw new Error("Read failed, status " + status);
+    return decodeConfig(payload);
+  }
+
+  /** Binary SAVEALL */
+  async writeConfigBinary(config: any): Promise<void> {
+    const { status } = await this.request(OP_WRITE, encodeConfig(config));
+    if (status !== STATUS_OK) throw new Error("Write failed, status " + status);
   }
 
   async close(): Promise<void> {
@@ -88,6 +159,7 @@ export class SerialHandler {
       await this.port.close();
       this.port = null;
     }
+    this.pending = new Uint8Array(0);
   }
 }
 